@@ -0,0 +1,279 @@
+/*
+ *  corpus_generator.cpp - Deterministic synthetic source trees for benchmarks
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/corpus_generator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace corpus_generation {
+namespace {
+constexpr std::array<std::string_view, 24> identifiers{
+    "buffer", "count",  "index",  "result", "value",   "node",
+    "offset", "length", "cursor", "state",  "handle",  "entry",
+    "width",  "height", "total",  "parser", "context", "options",
+    "stream", "begin",  "end",    "token",  "config",  "queue",
+};
+
+constexpr std::array<std::string_view, 8> operators{
+    " = ", " + ", " - ", " * ", " / ", " == ", " < ", " >= ",
+};
+
+constexpr std::array<std::string_view, 4> keywords{
+    "TODO",
+    "FIXME",
+    "BUG",
+    "HACK",
+};
+
+constexpr std::array<std::string_view, 4> owners{
+    "(alice)",
+    "(bob)",
+    "()",
+    "",
+};
+
+constexpr std::size_t max_line_length{100};
+
+std::string_view CommentMarker(const std::string_view extension) {
+    return extension == ".py" ? "#" : "//";
+}
+}  // namespace
+
+CorpusGenerator::CorpusGenerator(CorpusOptions options)
+    : options_{std::move(options)}, state_{options_.seed} {
+    if (options_.language_mix.empty()) {
+        throw std::invalid_argument{"Language mix must not be empty"};
+    }
+    if (options_.min_file_size == 0 ||
+        options_.max_file_size < options_.min_file_size) {
+        throw std::invalid_argument{"Invalid file size range"};
+    }
+    if (options_.files_per_directory == 0) {
+        options_.files_per_directory = 1;
+    }
+
+    for (const auto& [_, weight] : options_.language_mix) {
+        total_weight_ += weight;
+    }
+    if (total_weight_ == 0) {
+        throw std::invalid_argument{"Language weights must not all be zero"};
+    }
+}
+
+/*
+ * splitmix64, which is tiny, fast and fully specified.
+ */
+std::uint64_t CorpusGenerator::NextRandom() {
+    std::uint64_t mixed{state_ += 0x9e3779b97f4a7c15ull};
+    mixed = (mixed ^ (mixed >> 30)) * 0xbf58476d1ce4e5b9ull;
+    mixed = (mixed ^ (mixed >> 27)) * 0x94d049bb133111ebull;
+    return mixed ^ (mixed >> 31);
+}
+
+std::size_t CorpusGenerator::Below(const std::size_t bound) {
+    return static_cast<std::size_t>(NextRandom() % bound);
+}
+
+bool CorpusGenerator::Chance(const double probability) {
+    // 53 random bits scaled by a power of two is exact, so the comparison
+    // gives the same answer everywhere
+    const double uniform{static_cast<double>(NextRandom() >> 11) *
+                         0x1.0p-53};
+    return uniform < probability;
+}
+
+std::size_t CorpusGenerator::PickFileSize() {
+    const std::size_t low{options_.min_file_size};
+    const std::size_t high{options_.max_file_size};
+
+    if (options_.size_distribution == SizeDistribution::Uniform ||
+        low == high) {
+        return low + Below(high - low + 1);
+    }
+
+    // pick a power of two bucket uniformly, then a size uniformly inside it
+    std::size_t low_bit{0};
+    while ((std::size_t{2} << low_bit) <= low) {
+        low_bit++;
+    }
+    std::size_t high_bit{low_bit};
+    while ((std::size_t{2} << high_bit) <= high) {
+        high_bit++;
+    }
+
+    const std::size_t bit{low_bit + Below(high_bit - low_bit + 1)};
+    const std::size_t bucket_low{std::max(low, std::size_t{1} << bit)};
+    const std::size_t bucket_high{
+        std::min(high, (std::size_t{2} << bit) - 1)};
+    return bucket_low + Below(bucket_high - bucket_low + 1);
+}
+
+std::string_view CorpusGenerator::PickExtension() {
+    std::size_t pick{Below(total_weight_)};
+    for (const auto& [extension, weight] : options_.language_mix) {
+        if (pick < weight) {
+            return extension;
+        }
+        pick -= weight;
+    }
+    return options_.language_mix.back().first;
+}
+
+void CorpusGenerator::AppendCodeLine(std::string& contents) {
+    contents.append(4 * Below(3), ' ');
+    contents.append(identifiers[Below(identifiers.size())]);
+
+    const std::size_t terms{1 + Below(5)};
+    for (std::size_t term{0}; term < terms; ++term) {
+        contents.append(operators[Below(operators.size())]);
+        contents.append(identifiers[Below(identifiers.size())]);
+    }
+
+    if (Chance(0.1)) {
+        contents.append(" + \"https://example.com/path#anchor\"");
+    }
+    contents.push_back(';');
+    contents.push_back('\n');
+}
+
+void CorpusGenerator::AppendCommentLine(std::string& contents,
+                                        const std::string_view marker) {
+    const std::size_t line_start{contents.size()};
+
+    if (Chance(0.5)) {
+        AppendCodeLine(contents);
+        contents.pop_back();
+        contents.push_back(' ');
+    } else {
+        contents.append(4 * Below(3), ' ');
+    }
+    contents.append(marker);
+    contents.push_back(' ');
+
+    if (Chance(options_.keyword_density)) {
+        contents.append(keywords[Below(keywords.size())]);
+        contents.append(owners[Below(owners.size())]);
+        contents.append(": ");
+    }
+
+    while (contents.size() - line_start < max_line_length / 2 ||
+           (contents.size() - line_start < max_line_length && Chance(0.5))) {
+        contents.append(identifiers[Below(identifiers.size())]);
+        contents.push_back(' ');
+    }
+    contents.back() = '\n';
+}
+
+GeneratedFile CorpusGenerator::Next() {
+    const std::size_t file_index{generated_++};
+    const std::size_t directory{file_index / options_.files_per_directory};
+    const std::string_view extension{PickExtension()};
+    const std::string_view marker{CommentMarker(extension)};
+    const std::size_t target_size{PickFileSize()};
+
+    GeneratedFile file{};
+    file.relative_path = "d" + std::to_string(directory / 64) + "/d" +
+                         std::to_string(directory % 64) + "/file" +
+                         std::to_string(file_index) + std::string{extension};
+    file.contents.reserve(target_size + max_line_length * 2);
+
+    while (file.contents.size() < target_size) {
+        if (Chance(options_.comment_density)) {
+            AppendCommentLine(file.contents, marker);
+        } else {
+            AppendCodeLine(file.contents);
+        }
+    }
+    return file;
+}
+
+CorpusSummary WriteCorpus(const CorpusOptions& options,
+                          const std::filesystem::path& root) {
+    CorpusGenerator generator{options};
+    CorpusSummary summary{.files = 0, .bytes = 0};
+
+    for (std::size_t index{0}; index < options.file_count; ++index) {
+        const GeneratedFile file{generator.Next()};
+        const std::filesystem::path destination{root / file.relative_path};
+
+        std::filesystem::create_directories(destination.parent_path());
+        std::ofstream output{destination, std::ios::binary | std::ios::trunc};
+        output.write(file.contents.data(),
+                     static_cast<std::streamsize>(file.contents.size()));
+        if (!output.good()) {
+            throw std::filesystem::filesystem_error{
+                "Could not write corpus file", destination,
+                std::make_error_code(std::errc::io_error)};
+        }
+
+        summary.files++;
+        summary.bytes += file.contents.size();
+    }
+    return summary;
+}
+
+std::vector<std::pair<std::string, std::size_t>> ParseLanguageMix(
+    const std::string_view mix) {
+    std::vector<std::pair<std::string, std::size_t>> languages{};
+
+    std::size_t start{0};
+    while (start <= mix.size()) {
+        std::size_t end{mix.find(',', start)};
+        if (end == std::string_view::npos) {
+            end = mix.size();
+        }
+        const std::string_view item{mix.substr(start, end - start)};
+        const std::size_t equals{item.find('=')};
+        if (equals == std::string_view::npos || equals == 0) {
+            throw std::invalid_argument{"Expected .ext=weight, got: " +
+                                        std::string{item}};
+        }
+
+        std::size_t weight{0};
+        const std::string_view digits{item.substr(equals + 1)};
+        const auto [parsed_end, error]{std::from_chars(
+            digits.data(), digits.data() + digits.size(), weight)};
+        if (error != std::errc{} || parsed_end != digits.data() + digits.size()) {
+            throw std::invalid_argument{"Invalid weight in: " +
+                                        std::string{item}};
+        }
+
+        std::string extension{item.substr(0, equals)};
+        if (extension.front() != '.') {
+            extension.insert(extension.begin(), '.');
+        }
+        languages.emplace_back(std::move(extension), weight);
+        start = end + 1;
+    }
+    return languages;
+}
+
+}  // namespace corpus_generation
@@ -0,0 +1,108 @@
+/*
+ *  corpus_generator.hpp - Deterministic synthetic source trees for benchmarks
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef BENCH_INCLUDE_CORPUS_GENERATOR_HPP_
+#define BENCH_INCLUDE_CORPUS_GENERATOR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace corpus_generation {
+
+enum class SizeDistribution : std::uint8_t {
+    Uniform,
+    LogUniform,
+};
+
+struct CorpusOptions {
+    std::size_t file_count{10'000};
+    std::size_t min_file_size{512};
+    std::size_t max_file_size{64 * 1024};
+    SizeDistribution size_distribution{SizeDistribution::LogUniform};
+    double comment_density{0.2};
+    double keyword_density{0.05};
+    std::vector<std::pair<std::string, std::size_t>> language_mix{
+        {".cpp", 4}, {".h", 2}, {".py", 2}, {".rs", 1}, {".js", 1}};
+    std::size_t files_per_directory{64};
+    std::uint64_t seed{42};
+};
+
+struct GeneratedFile {
+    std::string relative_path;
+    std::string contents;
+};
+
+/*
+ * Produces the same sequence of files for the same options on every
+ * platform: only integer arithmetic and exact floating point comparisons
+ * are involved, so there is no dependence on the C library's math routines.
+ */
+class CorpusGenerator {
+ public:
+    explicit CorpusGenerator(CorpusOptions options);
+
+    GeneratedFile Next();
+
+ private:
+    std::uint64_t NextRandom();
+
+    std::size_t Below(std::size_t bound);
+
+    bool Chance(double probability);
+
+    std::size_t PickFileSize();
+
+    std::string_view PickExtension();
+
+    void AppendCodeLine(std::string& contents);
+
+    void AppendCommentLine(std::string& contents, std::string_view marker);
+
+ private:
+    CorpusOptions options_;
+    std::size_t total_weight_{0};
+    std::size_t generated_{0};
+    std::uint64_t state_;
+};
+
+struct CorpusSummary {
+    std::size_t files;
+    std::size_t bytes;
+};
+
+/*
+ * Writes options.file_count generated files below root, creating
+ * directories as needed.
+ */
+CorpusSummary WriteCorpus(const CorpusOptions& options,
+                          const std::filesystem::path& root);
+
+/*
+ * Parses a language mix such as ".cpp=4,.py=1" into extension/weight pairs.
+ * Throws std::invalid_argument on malformed input.
+ */
+std::vector<std::pair<std::string, std::size_t>> ParseLanguageMix(
+    std::string_view mix);
+
+}  // namespace corpus_generation
+#endif  // BENCH_INCLUDE_CORPUS_GENERATOR_HPP_
@@ -0,0 +1,652 @@
+/*
+ *  main.cpp - Stage and end to end benchmarks for Profile
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <print>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "argparse/argparse.hpp"
+#include "byte_scanner.hpp"
+#include "comment_lexer.hpp"
+#include "comment_syntax.hpp"
+#include "include/corpus_generator.hpp"
+#include "keyword_matcher.hpp"
+#include "language_registry.hpp"
+#include "profile.hpp"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+namespace {
+/*
+ * Every allocation made through operator new is counted, and its size kept
+ * in a header in front of it so that the bytes live at any moment, and their
+ * peak, are known as well. Over-aligned allocations are left uncounted.
+ */
+struct AllocationCounters {
+    std::atomic<std::uint64_t> allocations{0};
+    std::atomic<std::size_t> live_bytes{0};
+    std::atomic<std::size_t> peak_bytes{0};
+};
+
+AllocationCounters allocation_counters{};
+
+constexpr std::size_t allocation_header{alignof(std::max_align_t)};
+
+void* CountedAllocate(const std::size_t size) {
+    void* const block{std::malloc(size + allocation_header)};
+    if (block == nullptr) {
+        return nullptr;
+    }
+    *static_cast<std::size_t*>(block) = size;
+
+    allocation_counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    const std::size_t live{
+        allocation_counters.live_bytes.fetch_add(size,
+                                                 std::memory_order_relaxed) +
+        size};
+    std::size_t peak{
+        allocation_counters.peak_bytes.load(std::memory_order_relaxed)};
+    while (live > peak && !allocation_counters.peak_bytes.compare_exchange_weak(
+                              peak, live, std::memory_order_relaxed)) {
+    }
+    return static_cast<char*>(block) + allocation_header;
+}
+
+void CountedFree(void* const memory) {
+    if (memory == nullptr) {
+        return;
+    }
+    void* const block{static_cast<char*>(memory) - allocation_header};
+    allocation_counters.live_bytes.fetch_sub(
+        *static_cast<std::size_t*>(block), std::memory_order_relaxed);
+    std::free(block);
+}
+}  // namespace
+
+void* operator new(const std::size_t size) {
+    if (void* const memory{CountedAllocate(size)}) {
+        return memory;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* const memory) noexcept { CountedFree(memory); }
+
+void operator delete(void* const memory, std::size_t) noexcept {
+    CountedFree(memory);
+}
+
+namespace {
+/*
+ * Every line printed is a standalone JSON object so results can be appended
+ * to a log and compared between commits.
+ */
+struct Measurement {
+    std::size_t iterations;
+    double seconds;
+    std::size_t items_per_iteration;
+    std::size_t bytes_per_iteration;
+    std::uint64_t allocations{0};
+    std::size_t peak_heap_bytes{0};
+};
+
+void Report(const std::string_view benchmark, const Measurement& measurement) {
+    const double seconds_per_iteration{measurement.seconds /
+                                       static_cast<double>(measurement.iterations)};
+    const double items_per_second{
+        static_cast<double>(measurement.items_per_iteration) /
+        seconds_per_iteration};
+    const double megabytes_per_second{
+        static_cast<double>(measurement.bytes_per_iteration) /
+        seconds_per_iteration / 1e6};
+
+    const double allocations_per_iteration{
+        static_cast<double>(measurement.allocations) /
+        static_cast<double>(measurement.iterations)};
+
+    std::println(
+        "{{\"benchmark\":\"{}\",\"iterations\":{},"
+        "\"seconds_per_iteration\":{:.9f},\"items_per_second\":{:.1f},"
+        "\"megabytes_per_second\":{:.2f},"
+        "\"allocations_per_iteration\":{:.1f},\"peak_heap_bytes\":{}}}",
+        benchmark, measurement.iterations, seconds_per_iteration,
+        items_per_second, megabytes_per_second, allocations_per_iteration,
+        measurement.peak_heap_bytes);
+}
+
+/*
+ * Tracks the allocations made while it is alive, and how far the heap grew
+ * past where it started.
+ */
+class AllocationScope {
+ public:
+    AllocationScope()
+        : start_allocations_{allocation_counters.allocations.load()},
+          start_bytes_{allocation_counters.live_bytes.load()} {
+        allocation_counters.peak_bytes.store(start_bytes_);
+    }
+
+    std::uint64_t Allocations() const {
+        return allocation_counters.allocations.load() - start_allocations_;
+    }
+
+    std::size_t PeakBytes() const {
+        return allocation_counters.peak_bytes.load() - start_bytes_;
+    }
+
+ private:
+    const std::uint64_t start_allocations_;
+    const std::size_t start_bytes_;
+};
+
+/*
+ * The most memory the process has had resident so far, or nothing where
+ * that is not known.
+ */
+std::optional<std::size_t> PeakResidentBytes() {
+#if defined(_WIN32)
+    return std::nullopt;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return std::nullopt;
+    }
+#if defined(__APPLE__)
+    return static_cast<std::size_t>(usage.ru_maxrss);
+#else
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+void ReportPeakResident() {
+    if (const std::optional<std::size_t> peak{PeakResidentBytes()}) {
+        std::println(
+            "{{\"benchmark\":\"memory\",\"peak_resident_bytes\":{}}}",
+            peak.value());
+    }
+}
+
+/*
+ * Keeps the optimizer from discarding a benchmark body whose result is
+ * otherwise unused.
+ */
+volatile std::size_t sink{0};
+
+template <typename Body>
+Measurement Measure(const double min_seconds, const std::size_t items,
+                    const std::size_t bytes, Body&& body) {
+    using clock = std::chrono::steady_clock;
+
+    // one untimed pass to warm caches and fault in pages
+    sink = sink + body();
+
+    const AllocationScope allocations{};
+    std::size_t iterations{0};
+    const clock::time_point start{clock::now()};
+    std::chrono::duration<double> elapsed{};
+    do {
+        sink = sink + body();
+        iterations++;
+        elapsed = clock::now() - start;
+    } while (elapsed.count() < min_seconds);
+
+    return Measurement{
+        .iterations = iterations,
+        .seconds = elapsed.count(),
+        .items_per_iteration = items,
+        .bytes_per_iteration = bytes,
+        .allocations = allocations.Allocations(),
+        .peak_heap_bytes = allocations.PeakBytes(),
+    };
+}
+
+/*
+ * Like Measure, but runs prepare untimed before every timed iteration.
+ */
+template <typename Prepare, typename Body>
+Measurement MeasurePrepared(const double min_seconds, const std::size_t items,
+                            const std::size_t bytes, Prepare&& prepare,
+                            Body&& body) {
+    using clock = std::chrono::steady_clock;
+
+    std::size_t iterations{0};
+    std::uint64_t allocation_count{0};
+    std::size_t peak_heap_bytes{0};
+    std::chrono::duration<double> elapsed{};
+    do {
+        prepare();
+        const AllocationScope allocations{};
+        const clock::time_point start{clock::now()};
+        sink = sink + body();
+        elapsed += clock::now() - start;
+        iterations++;
+        allocation_count += allocations.Allocations();
+        peak_heap_bytes = std::max(peak_heap_bytes, allocations.PeakBytes());
+    } while (elapsed.count() < min_seconds);
+
+    return Measurement{
+        .iterations = iterations,
+        .seconds = elapsed.count(),
+        .items_per_iteration = items,
+        .bytes_per_iteration = bytes,
+        .allocations = allocation_count,
+        .peak_heap_bytes = peak_heap_bytes,
+    };
+}
+
+#if defined(__linux__)
+/*
+ * Drops the contents of every corpus file from the page cache, so the next
+ * scan has to read them from the disk again. Dirty pages cannot be dropped,
+ * hence the sync first. Directory entries and inodes stay cached.
+ */
+void EvictPageCache(const std::filesystem::path& corpus) {
+    for (const std::filesystem::directory_entry& entry :
+         std::filesystem::recursive_directory_iterator{corpus}) {
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+        if (const int descriptor{
+                open(entry.path().c_str(), O_RDONLY | O_CLOEXEC)};
+            descriptor >= 0) {
+            fdatasync(descriptor);
+            posix_fadvise(descriptor, 0, 0, POSIX_FADV_DONTNEED);
+            close(descriptor);
+        }
+    }
+}
+#endif
+
+/*
+ * The in-memory part of the corpus that the per-stage benchmarks run over.
+ */
+struct Sample {
+    std::vector<std::filesystem::path> paths{};
+    std::vector<std::string> contents{};
+    std::vector<const comment_lexing::Syntax*> syntaxes{};
+    std::vector<std::string_view> comments{};
+    std::size_t bytes{0};
+    std::size_t lines{0};
+    std::size_t comment_bytes{0};
+};
+
+Sample MakeSample(const corpus_generation::CorpusOptions& options,
+                  const std::size_t file_count) {
+    const language_registry::LanguageRegistry languages{};
+    corpus_generation::CorpusGenerator generator{options};
+    Sample sample{};
+
+    for (std::size_t index{0}; index < file_count; ++index) {
+        corpus_generation::GeneratedFile file{generator.Next()};
+        sample.paths.emplace_back(std::move(file.relative_path));
+        const std::optional<language_registry::Match> language{
+            languages.Find(sample.paths.back())};
+
+        sample.bytes += file.contents.size();
+        sample.contents.emplace_back(std::move(file.contents));
+        sample.syntaxes.push_back(
+            language.has_value()
+                ? language->language->syntax
+                : &comment_lexing::SyntaxFor(
+                      parser_info::CommentFormat::CFamily));
+    }
+
+    for (std::size_t index{0}; index < sample.contents.size(); ++index) {
+        comment_lexing::CommentLexer lexer{*sample.syntaxes[index]};
+        byte_scanner::ForEachLine(
+            sample.contents[index],
+            [&](const std::string_view line, std::size_t) {
+                sample.lines++;
+                for (const std::string_view comment : lexer.NextLine(line)) {
+                    sample.comments.push_back(comment);
+                    sample.comment_bytes += comment.size();
+                }
+            });
+    }
+    return sample;
+}
+
+void RunStageBenchmarks(const Sample& sample, const double min_seconds) {
+    const language_registry::LanguageRegistry languages{};
+
+    Report("extension_lookup",
+           Measure(min_seconds, sample.paths.size(), 0, [&]() {
+               std::size_t found{0};
+               for (const std::filesystem::path& path : sample.paths) {
+                   found += languages.Find(path).has_value();
+               }
+               return found;
+           }));
+
+    Report("line_splitting",
+           Measure(min_seconds, sample.lines, sample.bytes, [&]() {
+               std::size_t lines{0};
+               for (const std::string& contents : sample.contents) {
+                   byte_scanner::ForEachLine(
+                       contents,
+                       [&](const std::string_view, const std::size_t number) {
+                           lines += number;
+                       });
+               }
+               return lines;
+           }));
+
+    Report("comment_finding",
+           Measure(min_seconds, sample.lines, sample.bytes, [&]() {
+               std::size_t comments{0};
+               for (std::size_t index{0}; index < sample.contents.size();
+                    ++index) {
+                   comment_lexing::CommentLexer lexer{*sample.syntaxes[index]};
+                   byte_scanner::ForEachLine(
+                       sample.contents[index],
+                       [&](const std::string_view line, std::size_t) {
+                           comments += !lexer.NextLine(line).empty();
+                       });
+               }
+               return comments;
+           }));
+
+    const keyword_matching::KeywordAutomaton automaton{
+        parser_info::builtin_keywords};
+    Report("keyword_matching",
+           Measure(min_seconds, sample.comments.size(), sample.comment_bytes,
+                   [&]() {
+                       std::size_t matches{0};
+                       for (const std::string_view comment : sample.comments) {
+                           automaton.ForEachMatch(
+                               comment, [&matches](std::size_t, std::size_t) {
+                                   matches++;
+                               });
+                       }
+                       return matches;
+                   }));
+
+    const keyword_matching::LiteralPrefilter prefilter{
+        parser_info::builtin_keywords};
+    Report("literal_prefilter",
+           Measure(min_seconds, sample.lines, sample.bytes, [&]() {
+               std::size_t candidates{0};
+               for (const std::string& contents : sample.contents) {
+                   const char* const end{contents.data() + contents.size()};
+                   for (const char* candidate{
+                            prefilter.Next(contents.data(), end)};
+                        candidate != end;
+                        candidate = prefilter.Next(candidate + 1, end)) {
+                       candidates++;
+                   }
+               }
+               return candidates;
+           }));
+
+    const std::regex custom_regex{R"(\bXXX\w*|deprecated)"};
+    Report("custom_regex",
+           Measure(min_seconds, sample.comments.size(), sample.comment_bytes,
+                   [&]() {
+                       std::size_t matches{0};
+                       for (const std::string_view comment : sample.comments) {
+                           matches += std::regex_search(
+                               comment.begin(), comment.end(), custom_regex);
+                       }
+                       return matches;
+                   }));
+}
+
+/*
+ * Whole scans with each I/O backend, and with reads pipelined ahead of
+ * matching, over a warm page cache and (on Linux) a cold one.
+ */
+void RunEndToEndBenchmarks(const std::filesystem::path& corpus,
+                           const corpus_generation::CorpusSummary& summary,
+                           const double min_seconds) {
+    // the pipelined scans split the same threads between reading and
+    // matching, so every config runs as many as there are cores (two on a
+    // single core, where a pipeline needs at least one of each)
+    const std::size_t threads{profile::DefaultThreadCount()};
+    const std::size_t io_threads{std::max<std::size_t>(threads / 2, 1)};
+    const std::size_t match_threads{
+        std::max<std::size_t>(threads - io_threads, 1)};
+    const std::array configs{
+        std::pair{std::string_view{"end_to_end"},
+                  profile::ScanConfig{.directory = corpus}},
+        std::pair{std::string_view{"end_to_end_io_uring"},
+                  profile::ScanConfig{
+                      .directory = corpus,
+                      .io_backend = profile::IoBackend::IoUring,
+                  }},
+        std::pair{std::string_view{"end_to_end_pipelined"},
+                  profile::ScanConfig{
+                      .directory = corpus,
+                      .thread_count = match_threads,
+                      .io_thread_count = io_threads,
+                  }},
+        std::pair{std::string_view{"end_to_end_auto_tuned"},
+                  profile::ScanConfig{
+                      .directory = corpus,
+                      .thread_count = match_threads,
+                      .io_thread_count = io_threads,
+                      .auto_tune = true,
+                  }},
+    };
+
+    for (const auto& [name, config] : configs) {
+        const auto scan{[&]() { return profile::Scan(config).file_count; }};
+
+        Report(name, Measure(min_seconds, summary.files, summary.bytes, scan));
+#if defined(__linux__)
+        Report(std::format("{}_cold", name),
+               MeasurePrepared(min_seconds, summary.files, summary.bytes,
+                               [&]() { EvictPageCache(corpus); }, scan));
+#endif
+    }
+}
+
+/*
+ * Trees smaller than this fit the caches of a large machine too well for
+ * thread scaling to show.
+ */
+constexpr std::size_t thread_sweep_min_files{1'000'000};
+
+/*
+ * Whole scans with 1, 2, 4 and so on matching threads, up to and including
+ * DefaultThreadCount(), to show where adding threads stops paying off.
+ */
+void RunThreadSweep(const std::filesystem::path& corpus,
+                    const corpus_generation::CorpusSummary& summary,
+                    const double min_seconds) {
+    const std::size_t max_threads{profile::DefaultThreadCount()};
+    for (std::size_t threads{1};;
+         threads = std::min(threads * 2, max_threads)) {
+        const profile::ScanConfig config{
+            .directory = corpus,
+            .thread_count = threads,
+        };
+        Report(std::format("end_to_end_threads_{}", threads),
+               Measure(min_seconds, summary.files, summary.bytes, [&]() {
+                   return profile::Scan(config).file_count;
+               }));
+        if (threads == max_threads) {
+            return;
+        }
+    }
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    argparse::ArgumentParser argument_parser(
+        "profile-bench", "1.0.2", argparse::default_arguments::help);
+
+    argument_parser.add_argument("--files")
+        .help("Number Of Files In The Generated Corpus")
+        .default_value(std::size_t{2000})
+        .scan<'u', std::size_t>();
+
+    argument_parser.add_argument("--min-size")
+        .help("Smallest Generated File In Bytes")
+        .default_value(std::size_t{512})
+        .scan<'u', std::size_t>();
+
+    argument_parser.add_argument("--max-size")
+        .help("Largest Generated File In Bytes")
+        .default_value(std::size_t{64 * 1024})
+        .scan<'u', std::size_t>();
+
+    argument_parser.add_argument("--uniform-sizes")
+        .help("Draw File Sizes Uniformly Instead Of Log-Uniformly")
+        .flag();
+
+    argument_parser.add_argument("--comment-density")
+        .help("Fraction Of Lines That Carry A Comment")
+        .default_value(0.2)
+        .scan<'g', double>();
+
+    argument_parser.add_argument("--keyword-density")
+        .help("Fraction Of Comments That Contain A Keyword")
+        .default_value(0.05)
+        .scan<'g', double>();
+
+    argument_parser.add_argument("--languages")
+        .help("Language Mix As .ext=weight Pairs, e.g. .cpp=4,.py=1")
+        .default_value(std::string{".cpp=4,.h=2,.py=2,.rs=1,.js=1"});
+
+    argument_parser.add_argument("--seed")
+        .help("Seed For The Corpus Generator")
+        .default_value(std::uint64_t{42})
+        .scan<'u', std::uint64_t>();
+
+    argument_parser.add_argument("--sample-files")
+        .help("Files Kept In Memory For The Per-Stage Benchmarks")
+        .default_value(std::size_t{500})
+        .scan<'u', std::size_t>();
+
+    argument_parser.add_argument("--min-time")
+        .help("Minimum Seconds Spent Timing Each Benchmark")
+        .default_value(0.5)
+        .scan<'g', double>();
+
+    argument_parser.add_argument("--corpus")
+        .help("Directory To Write The Corpus To (Default: A Temporary One)");
+
+    argument_parser.add_argument("--keep-corpus")
+        .help("Do Not Delete The Generated Corpus Afterwards")
+        .flag();
+
+    argument_parser.add_argument("--stages-only")
+        .help("Skip Writing The Corpus And The End To End Benchmark")
+        .flag();
+
+    argument_parser.add_argument("--thread-sweep")
+        .help("Also Time End To End Scans At 1, 2, 4, ... Threads, Over A "
+              "Corpus Of At Least 1000000 Files")
+        .flag();
+
+    try {
+        argument_parser.parse_args(argc, argv);
+
+        const bool thread_sweep{argument_parser.get<bool>("--thread-sweep")};
+        corpus_generation::CorpusOptions options{
+            .file_count =
+                thread_sweep
+                    ? std::max(argument_parser.get<std::size_t>("--files"),
+                               thread_sweep_min_files)
+                    : argument_parser.get<std::size_t>("--files"),
+            .min_file_size = argument_parser.get<std::size_t>("--min-size"),
+            .max_file_size = argument_parser.get<std::size_t>("--max-size"),
+            .size_distribution =
+                argument_parser.get<bool>("--uniform-sizes")
+                    ? corpus_generation::SizeDistribution::Uniform
+                    : corpus_generation::SizeDistribution::LogUniform,
+            .comment_density = argument_parser.get<double>("--comment-density"),
+            .keyword_density = argument_parser.get<double>("--keyword-density"),
+            .language_mix = corpus_generation::ParseLanguageMix(
+                argument_parser.get<std::string>("--languages")),
+            .files_per_directory = 64,
+            .seed = argument_parser.get<std::uint64_t>("--seed"),
+        };
+        const double min_seconds{argument_parser.get<double>("--min-time")};
+
+        const Sample sample{MakeSample(
+            options, std::min(options.file_count,
+                              argument_parser.get<std::size_t>(
+                                  "--sample-files")))};
+        std::println(
+            "{{\"benchmark\":\"metadata\",\"seed\":{},\"files\":{},"
+            "\"sample_files\":{},\"sample_bytes\":{},\"sample_lines\":{},"
+            "\"sample_comments\":{}}}",
+            options.seed, options.file_count, sample.paths.size(),
+            sample.bytes, sample.lines, sample.comments.size());
+
+        RunStageBenchmarks(sample, min_seconds);
+
+        if (argument_parser.get<bool>("--stages-only")) {
+            ReportPeakResident();
+            return 0;
+        }
+
+        const std::filesystem::path corpus{
+            argument_parser.present("--corpus")
+                .value_or((std::filesystem::temp_directory_path() /
+                           ("profile-bench-" + std::to_string(options.seed)))
+                              .string())};
+        std::filesystem::remove_all(corpus);
+        const corpus_generation::CorpusSummary summary{
+            corpus_generation::WriteCorpus(options,
+                                           std::filesystem::absolute(corpus))};
+
+        RunEndToEndBenchmarks(std::filesystem::canonical(corpus), summary,
+                              min_seconds);
+        if (thread_sweep) {
+            RunThreadSweep(std::filesystem::canonical(corpus), summary,
+                           min_seconds);
+        }
+        ReportPeakResident();
+
+        if (!argument_parser.get<bool>("--keep-corpus")) {
+            std::filesystem::remove_all(corpus);
+        }
+    } catch (const std::exception& err) {
+        std::cerr << "Benchmark failed: " << err.what() << std::endl;
+        std::cerr << argument_parser;
+        return 1;
+    }
+
+    return 0;
+}
@@ -16,8 +16,86 @@ pub fn build(b: *std.Build) void {
         .{ .name = "main.cpp", .directory = "src/" },
         .{ .name = "directory_validator.cpp", .directory = "src/" },
         .{ .name = "Parser.cpp", .directory = "src/" },
+        .{ .name = "profile.cpp", .directory = "src/" },
+        .{ .name = "keyword_matcher.cpp", .directory = "src/" },
+        .{ .name = "regex_prefilter.cpp", .directory = "src/" },
+        .{ .name = "language_registry.cpp", .directory = "src/" },
+        .{ .name = "comment_lexer.cpp", .directory = "src/" },
+        .{ .name = "file_reader.cpp", .directory = "src/" },
+        .{ .name = "directory_walker.cpp", .directory = "src/" },
+        .{ .name = "tar_reader.cpp", .directory = "src/" },
+        .{ .name = "uring_reader.cpp", .directory = "src/" },
+        .{ .name = "ignore_rules.cpp", .directory = "src/" },
+        .{ .name = "scan_cache.cpp", .directory = "src/" },
+        .{ .name = "output_collector.cpp", .directory = "src/" },
+        .{ .name = "result_format.cpp", .directory = "src/" },
+        .{ .name = "watch_mode.cpp", .directory = "src/" },
+        .{ .name = "scan_statistics.cpp", .directory = "src/" },
+        .{ .name = "path_arena.cpp", .directory = "src/" },
+        .{ .name = "partial_result.cpp", .directory = "src/" },
+        .{ .name = "inflate.cpp", .directory = "src/" },
+        .{ .name = "git_repository.cpp", .directory = "src/" },
     };
 
+    const bench_files: []const SourceFile = comptime &.{
+        .{ .name = "main.cpp", .directory = "bench/" },
+        .{ .name = "corpus_generator.cpp", .directory = "bench/" },
+    };
+
+    const test_files: []const SourceFile = comptime &.{
+        .{ .name = "main.cpp", .directory = "tests/" },
+        .{ .name = "inflate_test.cpp", .directory = "tests/" },
+        .{ .name = "git_repository_test.cpp", .directory = "tests/" },
+        .{ .name = "comment_lexer_test.cpp", .directory = "tests/" },
+        .{ .name = "tar_reader_test.cpp", .directory = "tests/" },
+        .{ .name = "keyword_matcher_test.cpp", .directory = "tests/" },
+        .{ .name = "regex_prefilter_test.cpp", .directory = "tests/" },
+        .{ .name = "ignore_rules_test.cpp", .directory = "tests/" },
+        .{ .name = "partial_result_test.cpp", .directory = "tests/" },
+        .{ .name = "scan_cache_test.cpp", .directory = "tests/" },
+        .{ .name = "parser_test.cpp", .directory = "tests/" },
+        .{ .name = "language_registry_test.cpp", .directory = "tests/" },
+        .{ .name = "watch_mode_test.cpp", .directory = "tests/" },
+    };
+
+    const cpp_flags = [_][]const u8{
+        "-std=c++23",
+        "-Wall",
+        "-Wextra",
+        "-Wpedantic",
+        "-Wshadow",
+        "-Wconversion",
+        "-Werror",
+    };
+
+    const modlibrary = b.createModule(.{
+        .target = target,
+        .optimize = optimize,
+        .link_libcpp = true,
+        .link_libc = false,
+    });
+
+    // everything except src/main.cpp, which files lists first, makes up the
+    // library that the CLI and the benchmarks link against
+    inline for (files[1..]) |file| {
+        modlibrary.addCSourceFile(.{
+            .file = b.path(file.directory ++ file.name),
+            .language = .cpp,
+            .flags = &([_][]const u8{ "-MJ", file.name ++ ".json.tmp" } ++
+                cpp_flags),
+        });
+    }
+    modlibrary.addIncludePath(b.path("src/include/"));
+
+    const libprofile = b.addLibrary(.{
+        .linkage = .static,
+        .name = "profile",
+        .root_module = modlibrary,
+    });
+    libprofile.installHeadersDirectory(b.path("src/include/"), "profile", .{});
+
+    b.installArtifact(libprofile);
+
     const modprofile = b.addModule("profile", .{
         .target = target,
         .optimize = optimize,
@@ -25,25 +103,17 @@ pub fn build(b: *std.Build) void {
         .link_libc = false,
     });
 
-    inline for (files) |file| {
+    inline for (files[0..1]) |file| {
         modprofile.addCSourceFile(.{
             .file = b.path(file.directory ++ file.name),
             .language = .cpp,
-            .flags = &.{
-                "-MJ",
-                file.name ++ ".json.tmp",
-                "-std=c++23",
-                "-Wall",
-                "-Wextra",
-                "-Wpedantic",
-                "-Wshadow",
-                "-Wconversion",
-                "-Werror",
-            },
+            .flags = &([_][]const u8{ "-MJ", file.name ++ ".json.tmp" } ++
+                cpp_flags),
         });
     }
     modprofile.addIncludePath(b.path("src/include/"));
     modprofile.addSystemIncludePath(modargparse.path("include/"));
+    modprofile.linkLibrary(libprofile);
 
     const exeprofile = b.addExecutable(.{
         .name = "profile",
@@ -61,6 +131,69 @@ pub fn build(b: *std.Build) void {
         run_cmd.addArgs(args);
     }
 
+    const modbench = b.createModule(.{
+        .target = target,
+        .optimize = optimize,
+        .link_libcpp = true,
+        .link_libc = false,
+    });
+
+    inline for (bench_files) |file| {
+        modbench.addCSourceFile(.{
+            .file = b.path(file.directory ++ file.name),
+            .language = .cpp,
+            .flags = &cpp_flags,
+        });
+    }
+    modbench.addIncludePath(b.path("src/include/"));
+    modbench.addSystemIncludePath(modargparse.path("include/"));
+    modbench.linkLibrary(libprofile);
+
+    const exebench = b.addExecutable(.{
+        .name = "profile-bench",
+        .root_module = modbench,
+    });
+
+    const bench_step = b.step(
+        "bench",
+        "Run the benchmark suite (results are printed as JSON lines)",
+    );
+    const bench_cmd = b.addRunArtifact(exebench);
+    bench_step.dependOn(&bench_cmd.step);
+
+    if (b.args) |args| {
+        bench_cmd.addArgs(args);
+    }
+
+    const modtest = b.createModule(.{
+        .target = target,
+        .optimize = optimize,
+        .link_libcpp = true,
+        .link_libc = false,
+    });
+
+    inline for (test_files) |file| {
+        modtest.addCSourceFile(.{
+            .file = b.path(file.directory ++ file.name),
+            .language = .cpp,
+            .flags = &cpp_flags,
+        });
+    }
+    modtest.addIncludePath(b.path("src/include/"));
+    modtest.linkLibrary(libprofile);
+
+    const exetest = b.addExecutable(.{
+        .name = "profile-test",
+        .root_module = modtest,
+    });
+
+    const test_step = b.step(
+        "test",
+        "Run the tests (the git reader's need git on the PATH)",
+    );
+    const test_cmd = b.addRunArtifact(exetest);
+    test_step.dependOn(&test_cmd.step);
+
     const modcompiledb = b.createModule(.{
         .optimize = optimize,
         .target = b.resolveTargetQuery(
@@ -82,6 +215,7 @@ pub fn build(b: *std.Build) void {
             std.process.getCwdAlloc(b.allocator) catch unreachable,
         },
     );
+    cleanup_command.step.dependOn(&libprofile.step);
     cleanup_command.step.dependOn(&exeprofile.step);
     cleanup_step.dependOn(&cleanup_command.step);
     b.getInstallStep().dependOn(cleanup_step);
@@ -19,272 +19,1789 @@
 #include "include/Parser.hpp"
 
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <filesystem>
-#include <fstream>
-#include <iomanip>
-#include <ios>
-#include <iostream>
+#include <format>
+#include <functional>
+#include <iterator>
+#include <memory>
 #include <mutex>
 #include <optional>
-#include <ostream>
-#include <print>
 #include <regex>
+#include <span>
+#include <stdexcept>
+#include <stop_token>
 #include <string>
 #include <string_view>
+#include <system_error>
 #include <thread>
 #include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "include/byte_scanner.hpp"
+#include "include/comment_lexer.hpp"
+#include "include/comment_syntax.hpp"
+#include "include/directory_walker.hpp"
+#include "include/file_reader.hpp"
+#include "include/file_result.hpp"
+#include "include/ignore_rules.hpp"
+#include "include/language_registry.hpp"
+#include "include/path_arena.hpp"
+#include "include/profile.hpp"
+#include "include/regex_prefilter.hpp"
+#include "include/scan_cache.hpp"
+#include "include/scan_statistics.hpp"
+#include "include/tar_reader.hpp"
+#include "include/uring_reader.hpp"
+
 namespace parser_info {
-Parser::Parser(const bool&& verbose_printing)
+namespace {
+/*
+ * Custom regexes past this index have no bit in the candidate mask and are
+ * always run.
+ */
+constexpr std::size_t prefiltered_custom_limit{64};
+
+/*
+ * How many files read ahead (archive members, or files the I/O stage read)
+ * each matching worker may have waiting in memory before the reader stops
+ * to let the pool catch up.
+ */
+constexpr std::size_t buffered_files_per_worker{4};
+
+/*
+ * Once a file has this many lines holding a keyword candidate, and they make
+ * up more than one line in dense_candidate_ratio, counting stops searching
+ * for candidates and matches every comment left in the file instead.
+ */
+constexpr std::size_t dense_candidate_lines{32};
+constexpr std::size_t dense_candidate_ratio{8};
+
+/*
+ * With the tuner on, waiting workers look up their stage this often, so one
+ * moved while it waits starts waiting on its new stage soon after.
+ */
+constexpr std::chrono::milliseconds role_poll_interval{5};
+
+/*
+ * The tuner looks at the read buffers every tune_interval. After a move
+ * that cost throughput it moves the worker back and leaves the split alone
+ * for tune_hold_steps intervals.
+ */
+constexpr std::chrono::milliseconds tune_interval{50};
+constexpr std::size_t tune_hold_steps{4};
+
+/*
+ * FNV-1a over bytes, carrying on from hash.
+ */
+constexpr std::uint64_t fnv_offset_basis{14695981039346656037ull};
+
+std::uint64_t HashBytes(const std::string_view bytes, std::uint64_t hash) {
+    for (const char byte : bytes) {
+        hash ^= static_cast<unsigned char>(byte);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/*
+ * Replaces the contents of shard_path with below_root, the part of a
+ * directory's path below its root, spelled the way InShard hashes it: with
+ * '/' between components and no separator in front, whatever the platform.
+ */
+void ShardPath(const std::string_view below_root, std::string& shard_path) {
+    constexpr char separator{
+        static_cast<char>(std::filesystem::path::preferred_separator)};
+    shard_path.assign(below_root);
+    std::ranges::replace(shard_path, separator, '/');
+    shard_path.erase(0, shard_path.find_first_not_of('/'));
+}
+
+/*
+ * Whether any directory above path is one of paths.
+ */
+bool IsBelowAny(const std::filesystem::path& path,
+                const std::unordered_set<std::string>& paths) {
+    for (std::filesystem::path parent{path.parent_path()};
+         parent.has_relative_path(); parent = parent.parent_path()) {
+        if (paths.contains(parent.string())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * The roots in their lexically normal form, with no trailing separator, so
+ * the paths found below a root do not depend on how it was spelled.
+ */
+std::vector<std::filesystem::path> ScanRoots(
+    const profile::ScanConfig& config) {
+    std::vector<std::filesystem::path> roots{config.directory};
+    roots.insert(roots.end(), config.extra_directories.cbegin(),
+                 config.extra_directories.cend());
+    for (std::filesystem::path& root : roots) {
+        root = root.lexically_normal();
+        if (!root.has_filename()) {
+            root = root.parent_path();
+        }
+    }
+    return roots;
+}
+
+std::vector<std::string> RequiredLiterals(
+    const std::vector<std::string>& patterns) {
+    std::vector<std::string> literals{};
+    for (std::size_t index{0}; index < patterns.size(); ++index) {
+        literals.push_back(index < prefiltered_custom_limit
+                               ? regex_prefilter::RequiredLiteral(
+                                     patterns[index])
+                               : std::string{});
+    }
+    return literals;
+}
+
+/*
+ * The built-in keywords followed by every non-empty custom literal, so a
+ * single automaton pass over a comment finds both.
+ */
+std::vector<keyword_matching::KeywordAutomaton::Keyword> CombinedKeywords(
+    const std::vector<std::string>& literals) {
+    std::vector<keyword_matching::KeywordAutomaton::Keyword> keywords{
+        builtin_keywords.cbegin(), builtin_keywords.cend()};
+    for (const std::string& literal : literals) {
+        if (!literal.empty()) {
+            keywords.emplace_back(literal, false);
+        }
+    }
+    return keywords;
+}
+}  // namespace
+
+Parser::Parser(const profile::ScanConfig& config,
+               profile::HitCallback on_hits, const bool keep_index)
     : keyword_pairs_{{
-          {std::regex("\\bTODO(\\(\\w*\\))?"), 0, "TODO"},
-          {std::regex("\\bFIXME(\\(\\w*\\))?"), 0, "FIXME"},
-          {std::regex("\\bBUG(\\(\\w*\\))?"), 0, "BUG"},
-          {std::regex("\\bHACK(\\(\\w*\\))?"), 0, "HACK"},
+          {0, "TODO"},
+          {0, "FIXME"},
+          {0, "BUG"},
+          {0, "HACK"},
       }},
-      jobs_{},
-      job_lock_{},
-      data_lock_{},
+      custom_patterns_{config.custom_regexes},
+      custom_literals_{RequiredLiterals(custom_patterns_)},
+      keyword_automaton_{CombinedKeywords(custom_literals_)},
+      literal_prefilter_{CombinedKeywords(custom_literals_)},
+      literal_candidates_{},
+      unfiltered_customs_{0},
+      count_only_{false},
+      read_stage_{},
+      match_stage_{},
+      worker_states_{},
+      io_workers_{0},
+      pending_jobs_{0},
+      jobs_finished_{false},
+      stop_source_{},
+      cancel_token_{config.stop_token},
+      thresholds_{},
+      max_hits_{config.max_hits},
+      gate_counts_{},
+      gate_hits_{0},
+      stopped_early_{false},
       file_type_frequencies_{},
-      comment_formats_{
-          {".c", CommentFormat::DoubleSlash},
-          {".cpp", CommentFormat::DoubleSlash},
-          {".h", CommentFormat::DoubleSlash},
-          {".hpp", CommentFormat::DoubleSlash},
-          {".js", CommentFormat::DoubleSlash},
-          {".rs", CommentFormat::DoubleSlash},
-          {".ts", CommentFormat::DoubleSlash},
-          {".zig", CommentFormat::DoubleSlash},
-          {".cs", CommentFormat::DoubleSlash},
-          {".py", CommentFormat::PoundSign},
-      },
+      languages_{config.language_file},
       custom_regexes_{std::nullopt},
+      scan_cache_{std::nullopt},
       thread_pool_{},
-      job_semaphore_{0},
       file_count_{0},
-      verbose_printing_{verbose_printing} {}
+      errors_{},
+      index_{},
+      scanned_directories_{},
+      read_buffers_{},
+      scan_statistics_{},
+      roots_{ScanRoots(config)},
+      on_hits_{std::move(on_hits)},
+      thread_count_{config.thread_count != 0 ? config.thread_count
+                                              : profile::DefaultThreadCount()},
+      io_thread_count_{config.io_thread_count},
+      worker_count_{profile::WorkerCount(config)},
+      split_file_limit_{config.split_file_limit},
+      split_chunk_size_{std::max<std::size_t>(config.split_chunk_size, 1)},
+      paths_{worker_count_ + 1},
+      collect_hits_{static_cast<bool>(on_hits_)},
+      use_ignore_files_{config.use_ignore_files},
+      batch_reads_{config.io_backend == profile::IoBackend::IoUring},
+      keep_index_{keep_index},
+      auto_tune_{config.auto_tune},
+      gated_{!keep_index &&
+             (!config.thresholds.empty() || config.max_hits.has_value())},
+      shard_{keep_index ? std::nullopt : config.shard} {
+    if (shard_.has_value() && shard_->index >= shard_->count) {
+        throw std::invalid_argument{std::format(
+            "No shard {} of {}", shard_->index + 1, shard_->count)};
+    }
 
-Parser::Parser(const bool&& verbose_printing,
-               const std::vector<std::string>&& custom_regexes)
-    : keyword_pairs_{{
-          {std::regex("\\bTODO(\\(\\w*\\))?"), 0, "TODO"},
-          {std::regex("\\bFIXME(\\(\\w*\\))?"), 0, "FIXME"},
-          {std::regex("\\bBUG(\\(\\w*\\))?"), 0, "BUG"},
-          {std::regex("\\bHACK(\\(\\w*\\))?"), 0, "HACK"},
-      }},
-      jobs_{},
-      job_lock_{},
-      data_lock_{},
-      file_type_frequencies_{},
-      comment_formats_{
-          {".c", CommentFormat::DoubleSlash},
-          {".cpp", CommentFormat::DoubleSlash},
-          {".h", CommentFormat::DoubleSlash},
-          {".hpp", CommentFormat::DoubleSlash},
-          {".js", CommentFormat::DoubleSlash},
-          {".rs", CommentFormat::DoubleSlash},
-          {".ts", CommentFormat::DoubleSlash},
-          {".zig", CommentFormat::DoubleSlash},
-          {".cs", CommentFormat::DoubleSlash},
-          {".py", CommentFormat::PoundSign},
-      },
-      custom_regexes_{std::make_optional(
-          std::vector<std::tuple<std::regex, std::string_view, std::size_t>>{
-              custom_regexes.size()})},
-      thread_pool_{},
-      job_semaphore_{0},
-      file_count_{0},
-      verbose_printing_{verbose_printing} {
-    for (const std::string& regex : custom_regexes) {
-        custom_regexes_->emplace_back(
-            std::make_tuple<std::regex, std::string_view, std::size_t>(
-                std::regex{regex}, std::string_view{regex}, 0));
+    if (!custom_patterns_.empty()) {
+        custom_regexes_.emplace();
+        custom_regexes_->reserve(custom_patterns_.size());
+        for (const std::string& regex : custom_patterns_) {
+            custom_regexes_->emplace_back(
+                std::make_tuple<std::regex, std::string_view, std::size_t>(
+                    std::regex{regex}, std::string_view{regex}, 0));
+        }
     }
-}
 
-namespace {
-inline std::string_view::iterator FindCommentPosition(
-    const Parser::CommentFormat& comment_format, const std::string_view line) {
-    switch (comment_format) {
-        case Parser::CommentFormat::DoubleSlash:
-            return std::ranges::find_first_of(line, "//");
-        case Parser::CommentFormat::PoundSign:
-            return std::ranges::find_first_of(line, "#");
+    for (std::size_t index{0}; index < custom_literals_.size(); ++index) {
+        if (index >= prefiltered_custom_limit) {
             break;
+        } else if (custom_literals_[index].empty()) {
+            unfiltered_customs_ |= std::uint64_t{1} << index;
+        } else {
+            literal_candidates_.push_back(std::uint64_t{1} << index);
+        }
+    }
+
+    for (const auto& [pattern, limit] : config.thresholds) {
+        const auto keyword{std::ranges::find(
+            keyword_pairs_, std::string_view{pattern},
+            [](const auto& pair) { return std::get<1>(pair); })};
+        const auto custom{std::ranges::find(custom_patterns_, pattern)};
+        if (keyword != keyword_pairs_.end()) {
+            thresholds_.emplace_back(
+                static_cast<std::size_t>(keyword - keyword_pairs_.begin()),
+                limit);
+        } else if (custom != custom_patterns_.end()) {
+            thresholds_.emplace_back(
+                keyword_pairs_.size() +
+                    static_cast<std::size_t>(custom - custom_patterns_.begin()),
+                limit);
+        } else {
+            throw std::invalid_argument{
+                std::format("No pattern {} to set a threshold on", pattern)};
+        }
+    }
+
+    // a custom regex without a required literal can match on any line
+    count_only_ = !collect_hits_ && unfiltered_customs_ == 0 &&
+                  custom_patterns_.size() <= prefiltered_custom_limit;
+
+    if (config.cache_file.has_value()) {
+        std::vector<std::string_view> patterns{};
+        for (const auto& [_, keyword_literal] : keyword_pairs_) {
+            patterns.emplace_back(keyword_literal);
+        }
+        patterns.insert(patterns.end(), custom_patterns_.cbegin(),
+                        custom_patterns_.cend());
+        patterns.emplace_back(collect_hits_ ? "log" : "no-log");
+        patterns.emplace_back(languages_.Fingerprint());
+
+        scan_cache_.emplace(config.cache_file.value(),
+                            scan_cache::HashPatterns(patterns));
     }
 }
-}  // namespace
 
-void Parser::ThreadWaitingRoom() {
-    std::filesystem::path entry{};
+void Parser::ThreadWaitingRoom(const std::stop_token stop,
+                               const std::size_t worker) {
+    using scan_statistics::Clock;
+
+    Job job{};
+    WorkerState& state{worker_states_[worker]};
+    Clock::time_point idle_start{Clock::now()};
+
+    // cached files are mostly never read, so batching their reads would
+    // only read them for nothing
+    if (batch_reads_ && !scan_cache_.has_value() && io_thread_count_ == 0) {
+        state.batch_reader = std::make_unique<uring_reading::BatchReader>();
+        if (!state.batch_reader->IsAvailable()) {
+            state.batch_reader.reset();
+        }
+    }
 
     while (true) {
-        job_semaphore_.acquire();
-
-        if (std::unique_lock<std::mutex> lock{job_lock_}; !jobs_.empty())
-            [[likely]] {
-            entry.swap(jobs_.front());
-            jobs_.pop();
-        } else [[unlikely]] {
-            job_semaphore_.release();
+        Stage& stage{this->StageOf(worker)};
+        if (!auto_tune_) {
+            stage.jobs.acquire();
+        } else if (!stage.jobs.try_acquire_for(role_poll_interval)) {
+            continue;
+        }
+
+        if (jobs_finished_.load(std::memory_order_acquire) ||
+            stop.stop_requested()) [[unlikely]] {
+            state.counters.AddIdle(Clock::now() - idle_start);
             return;
         }
 
-        this->RecursivelyParseFiles(entry);
+        std::optional<JobKind> job_kind{std::nullopt};
+        while (!job_kind.has_value()) {
+            job_kind = this->TakeJob(stage, worker, job);
+        }
+
+        const Clock::time_point busy_start{Clock::now()};
+        state.counters.AddIdle(busy_start - idle_start);
+        if (scan_statistics_.ClaimQueueSample(busy_start)) [[unlikely]] {
+            state.counters.RecordQueueDepth(
+                scan_statistics_.SinceStart(busy_start),
+                pending_jobs_.load(std::memory_order_relaxed));
+        }
+
+        switch (job_kind.value()) {
+            case JobKind::Directory:
+                this->ExpandDirectory(worker, job);
+                break;
+            case JobKind::File:
+                if (io_thread_count_ != 0 && &stage == &read_stage_) {
+                    this->ReadAhead(std::move(job), state);
+                    job = Job{};
+                    break;
+                }
+                state.matched_jobs.store(
+                    state.matched_jobs.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+                if (job.split_file != nullptr) {
+                    this->ParseChunk(job, state);
+                    job.split_file.reset();
+                    break;
+                } else if (state.batch_reader != nullptr &&
+                           !job.contents.has_value()) {
+                    this->ParseFileBatch(worker, std::move(job), state);
+                    break;
+                } else if (job.prefetched.has_value()) {
+                    state.prefetched = job.prefetched.value();
+                    this->RecursivelyParseFiles(job, state);
+                    state.prefetched.reset();
+                    this->ReturnContents(std::move(job.prefetched.value()));
+                    job.prefetched.reset();
+                    break;
+                }
+                this->RecursivelyParseFiles(job, state);
+                if (job.contents.has_value()) {
+                    this->ReturnContents(std::move(job.contents.value()));
+                    job.contents.reset();
+                }
+                break;
+        }
+
+        idle_start = Clock::now();
+        state.counters.AddBusy(idle_start - busy_start);
+
+        this->FinishJob();
     }
 }
 
-std::optional<Parser::CommentFormat> Parser::IsValidFile(
-    const std::string&& extension) {
-    if (comment_formats_.contains(extension)) {
-        if (std::scoped_lock<std::mutex> lock{data_lock_};
-            file_type_frequencies_.contains(extension)) {
-            file_type_frequencies_[extension]++;
-        } else {
-            file_type_frequencies_.emplace(extension, 1);
+/*
+ * Every worker gets a permit on every stage, whichever one it is waiting
+ * on; RunWorkers drains whatever is left over once they have all gone.
+ */
+void Parser::FinishJob() {
+    if (pending_jobs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        jobs_finished_.store(true, std::memory_order_release);
+        read_stage_.jobs.release(static_cast<std::ptrdiff_t>(worker_count_));
+        if (io_thread_count_ != 0) {
+            match_stage_.jobs.release(
+                static_cast<std::ptrdiff_t>(worker_count_));
+        }
+    }
+}
+
+void Parser::SubmitFile(const std::size_t worker, Job&& file) {
+    Stage& stage{this->MatchStage()};
+    pending_jobs_.fetch_add(1, std::memory_order_relaxed);
+    {
+        WorkQueue& queue{stage.queues[worker]};
+        std::scoped_lock<std::mutex> lock{queue.lock};
+        queue.files.push_front(std::move(file));
+    }
+    stage.jobs.release();
+}
+
+Parser::Stage& Parser::StageOf(const std::size_t worker) {
+    if (io_thread_count_ == 0) {
+        return read_stage_;
+    }
+    return worker + io_workers_.load(std::memory_order_relaxed) >=
+                   worker_count_
+               ? read_stage_
+               : match_stage_;
+}
+
+Parser::Stage& Parser::MatchStage() {
+    return io_thread_count_ != 0 ? match_stage_ : read_stage_;
+}
+
+std::optional<Parser::JobKind> Parser::TakeJob(Stage& stage,
+                                               const std::size_t worker,
+                                               Job& job) {
+    std::vector<WorkQueue>& queues{stage.queues};
+    {
+        WorkQueue& own{queues[worker]};
+        std::scoped_lock<std::mutex> lock{own.lock};
+
+        if (!own.files.empty()) [[likely]] {
+            job = std::move(own.files.back());
+            own.files.pop_back();
+            return JobKind::File;
+        } else if (!own.directories.empty()) {
+            job = std::move(own.directories.back());
+            own.directories.pop_back();
+            return JobKind::Directory;
         }
+    }
+
+    for (std::size_t offset{1}; offset < queues.size(); ++offset) {
+        WorkQueue& victim{queues[(worker + offset) % queues.size()]};
+        std::scoped_lock<std::mutex> lock{victim.lock};
+
+        if (!victim.directories.empty()) {
+            job = std::move(victim.directories.front());
+            victim.directories.pop_front();
+            return JobKind::Directory;
+        } else if (!victim.files.empty()) {
+            job = std::move(victim.files.front());
+            victim.files.pop_front();
+            return JobKind::File;
+        }
+    }
+
+    return std::nullopt;
+}
+
+/*
+ * Children are added to the path arena by name only, and files are dropped
+ * right away unless their extension is recognized, so the queues only ever
+ * hold files that will be read.
+ */
+void Parser::ExpandDirectory(const std::size_t worker, const Job& directory) {
+    const scan_statistics::Clock::time_point start{
+        scan_statistics::Clock::now()};
+    WorkerState& state{worker_states_[worker]};
+    paths_.Resolve(directory.path, state.path);
+    if (shard_.has_value()) {
+        ShardPath(std::string_view{state.path}.substr(
+                      paths_.Root(directory.path).size()),
+                  state.shard_path);
+    }
+    directory_walking::DirectoryStream stream{state.path};
+    if (!stream.IsOpen()) {
+        state.statistics.errors.push_back(
+            std::format("Could not open directory {}", state.path));
+        return;
+    }
 
-        return comment_formats_.at(extension);
+    std::vector<Job>& directories{state.child_directories};
+    std::vector<Job>& files{state.child_files};
+    std::vector<std::string_view>& ignore_files{state.ignore_files};
+    directories.clear();
+    files.clear();
+    ignore_files.clear();
+    std::shared_ptr<const ignore_rules::IgnoreScope> children_scope{
+        directory.ignore_scope};
+
+    while (const std::optional<directory_walking::Entry> entry{
+               stream.Next()}) {
+        if (stop_source_.stop_requested()) [[unlikely]] {
+            return;
+        }
+        switch (entry->kind) {
+            case directory_walking::EntryKind::File:
+                if (use_ignore_files_) {
+                    if (const auto ignore_file{
+                            std::ranges::find(ignore_rules::ignore_file_names,
+                                              entry->name)};
+                        ignore_file != ignore_rules::ignore_file_names.end()) {
+                        ignore_files.push_back(*ignore_file);
+                    }
+                }
+                if (languages_.Find(entry->name).has_value() &&
+                    this->InShard(state.shard_path, entry->name)) {
+                    files.push_back(Job{
+                        .path = paths_.Add(worker, directory.path, entry->name),
+                    });
+                }
+                break;
+            case directory_walking::EntryKind::Directory:
+                if (use_ignore_files_ && entry->name == ".git") {
+                    break;
+                }
+                directories.push_back(Job{
+                    .path = paths_.Add(worker, directory.path, entry->name),
+                });
+                break;
+            case directory_walking::EntryKind::Other:
+                break;
+        }
+    }
+
+    if (use_ignore_files_ && !ignore_files.empty()) {
+        // keep the rules in the order of ignore_file_names, whatever order
+        // the directory listed them in
+        std::ranges::sort(ignore_files, {}, [](const std::string_view name) {
+            return std::ranges::find(ignore_rules::ignore_file_names, name) -
+                   ignore_rules::ignore_file_names.begin();
+        });
+        children_scope = ignore_rules::IgnoreScope::Extend(
+            directory.ignore_scope, std::filesystem::path{state.path},
+            ignore_files);
+    }
+
+    if (const auto& scope{children_scope}; scope != nullptr) {
+        const auto ignored{[&](const Job& child, const bool is_directory) {
+            state.child_path.assign(state.path);
+            path_arena::PathArena::AppendName(state.child_path,
+                                              paths_.Name(child.path));
+            return scope->IsIgnored(std::string_view{state.child_path},
+                                    is_directory);
+        }};
+        std::erase_if(directories,
+                      [&](const Job& child) { return ignored(child, true); });
+        std::erase_if(files,
+                      [&](const Job& child) { return ignored(child, false); });
+        for (Job& child : directories) {
+            child.ignore_scope = scope;
+        }
+    }
+
+    if (keep_index_) {
+        state.statistics.scanned_directories.emplace_back(
+            std::filesystem::path{state.path}, directory.ignore_scope,
+            children_scope);
+    }
+
+    state.counters.AddPhase(scan_statistics::Phase::DirectoryEnumeration,
+                            scan_statistics::Clock::now() - start);
+
+    const std::size_t new_jobs{directories.size() + files.size()};
+    if (new_jobs == 0) {
+        return;
+    }
+
+    pending_jobs_.fetch_add(new_jobs, std::memory_order_relaxed);
+    {
+        WorkQueue& own{read_stage_.queues[worker]};
+        std::scoped_lock<std::mutex> lock{own.lock};
+        std::ranges::move(directories, std::back_inserter(own.directories));
+        std::ranges::move(files, std::back_inserter(own.files));
+    }
+    read_stage_.jobs.release(static_cast<std::ptrdiff_t>(new_jobs));
+}
+
+/*
+ * The hash covers the path below the root, '/' separated and with no
+ * leading separator, so an archive member hashes the same as the file it
+ * was packed from does when scanning the directory the archive was made of.
+ */
+bool Parser::InShard(const std::string_view directory,
+                     const std::string_view name) const {
+    if (!shard_.has_value()) {
+        return true;
+    }
+    const std::uint64_t hash{
+        directory.empty()
+            ? HashBytes(name, fnv_offset_basis)
+            : HashBytes(name, HashBytes("/", HashBytes(directory,
+                                                       fnv_offset_basis)))};
+    return hash % shard_->count == shard_->index;
+}
+
+const comment_lexing::Syntax* Parser::IsValidFile(
+    const std::string_view file, WorkerStatistics& statistics) {
+    if (const std::optional<language_registry::Match> found{
+            languages_.Find(file)}) {
+        statistics.extension_counts[found->extension]++;
+        return found->language->syntax;
     } else {
-        return std::nullopt;
+        return nullptr;
+    }
+}
+
+bool Parser::IsSourceFile(const std::string_view file) const {
+    return languages_.Find(file).has_value();
+}
+
+/*
+ * Walks down to every file the way ExpandDirectory would have, one
+ * directory at a time, remembering which directories the walk would skip
+ * and the rules that apply to the children of every other one, so files
+ * sharing a directory only look at it once.
+ */
+std::vector<std::optional<std::string>> Parser::Select(
+    const std::filesystem::path& root,
+    const std::span<const std::string> files) const {
+    struct Directory {
+        bool skipped{false};
+        std::shared_ptr<const ignore_rules::IgnoreScope> scope{};
+    };
+
+    std::unordered_map<std::string, Directory> directories{};
+    const auto rules_below{
+        [this](const std::shared_ptr<const ignore_rules::IgnoreScope>& parent,
+               const std::string& path) {
+            if (!use_ignore_files_) {
+                return parent;
+            }
+            std::vector<std::string_view> ignore_files{};
+            for (const std::string_view name : ignore_rules::ignore_file_names) {
+                std::error_code error{};
+                if (std::filesystem::is_regular_file(
+                        std::filesystem::path{path} / name, error)) {
+                    ignore_files.push_back(name);
+                }
+            }
+            return ignore_files.empty()
+                       ? parent
+                       : ignore_rules::IgnoreScope::Extend(
+                             parent, std::filesystem::path{path}, ignore_files);
+        }};
+
+    const std::string root_path{root.string()};
+    directories.emplace(std::string{},
+                        Directory{.scope = rules_below(nullptr, root_path)});
+
+    std::vector<std::optional<std::string>> selected{};
+    selected.reserve(files.size());
+    for (const std::string_view file : files) {
+        if (!this->IsSourceFile(file)) {
+            selected.emplace_back(std::nullopt);
+            continue;
+        }
+
+        std::string path{root_path};
+        const Directory* parent{&directories.at({})};
+        for (std::size_t start{0}, end{file.find('/')};
+             end != std::string_view::npos && !parent->skipped;
+             start = end + 1, end = file.find('/', start)) {
+            const std::string_view name{file.substr(start, end - start)};
+            path_arena::PathArena::AppendName(path, name);
+            const std::string key{file.substr(0, end)};
+            if (const auto known{directories.find(key)};
+                known != directories.end()) {
+                parent = &known->second;
+                continue;
+            }
+
+            Directory directory{};
+            directory.skipped =
+                use_ignore_files_ &&
+                (name == ".git" ||
+                 (parent->scope != nullptr &&
+                  parent->scope->IsIgnored(std::string_view{path}, true)));
+            if (!directory.skipped) {
+                directory.scope = rules_below(parent->scope, path);
+            }
+            parent = &directories.emplace(key, std::move(directory))
+                          .first->second;
+        }
+
+        if (parent->skipped) {
+            selected.emplace_back(std::nullopt);
+            continue;
+        }
+        const std::size_t separator{file.rfind('/')};
+        path_arena::PathArena::AppendName(
+            path, file.substr(separator == std::string_view::npos
+                                  ? 0
+                                  : separator + 1));
+        if (parent->scope != nullptr &&
+            parent->scope->IsIgnored(std::string_view{path}, false)) {
+            selected.emplace_back(std::nullopt);
+        } else {
+            selected.emplace_back(std::move(path));
+        }
     }
+    return selected;
 }
 
-void Parser::RecursivelyParseFiles(const std::filesystem::path& current_file) {
-    std::optional<CommentFormat> comment_format{
-        this->IsValidFile(current_file.extension().string())};
+std::size_t Parser::PatternCount() const {
+    return keyword_pairs_.size() +
+           (custom_regexes_.has_value() ? custom_regexes_->size() : 0);
+}
 
-    if (!comment_format.has_value()) {
+void Parser::RecursivelyParseFiles(const Job& file, WorkerState& state) {
+    const std::string& current_file{state.path};
+    paths_.Resolve(file.path, state.path);
+    const comment_lexing::Syntax* const syntax{
+        this->IsValidFile(current_file, state.statistics)};
+
+    if (syntax == nullptr) {
         return;
     } else {
-        file_count_.fetch_add(1);
-    }
-
-    std::ifstream file_stream{current_file};
-    std::size_t line_count{1};
-
-    for (std::string line{}; std::getline(file_stream, line); ++line_count) {
-        const std::string_view full_view{line};
-
-        if (std::string_view sub_str{
-                FindCommentPosition(comment_format.value(), full_view),
-                full_view.cend()};
-            !sub_str.empty()) {
-            for (auto& [keyword_regex, keyword_count, keyword_literal] :
-                 keyword_pairs_) {
-                if (std::regex_search(sub_str.cbegin(), sub_str.cend(),
-                                      keyword_regex)) {
-                    if (verbose_printing_) {
-                        std::println(
-                            "{0} Found: \nFile: {1}\nLine Number: {2}\nLine: "
-                            "{3}\n",
-                            keyword_literal, current_file.c_str(), line_count,
-                            line);
-                    }
+        state.statistics.file_count++;
+    }
 
-                    keyword_count.fetch_add(1);
+    const scan_statistics::Clock::time_point start{
+        scan_statistics::Clock::now()};
+    FileResult& result{state.result};
+    result.Reset(this->PatternCount());
+
+    if (file.contents.has_value()) {
+        comment_lexing::CommentLexer lexer{*syntax};
+        this->ScanContents(lexer, file.contents.value(), result, state);
+        state.counters.RecordFile(scan_statistics::Clock::now() - start,
+                                  current_file);
+        this->RecordFileResult(current_file, result, state);
+        return;
+    }
+
+    std::optional<scan_cache::FileStamp> stamp{std::nullopt};
+    if (scan_cache_.has_value()) {
+        stamp = scan_cache::StampFile(current_file);
+        if (stamp.has_value() &&
+            scan_cache_->Lookup(current_file, stamp.value(),
+                                this->PatternCount(), result)) {
+            this->RecordFileResult(current_file, result, state);
+            return;
+        }
+    }
+
+    const std::optional<std::string_view> contents{
+        state.prefetched.has_value() ? state.prefetched
+                                     : state.reader.Load(current_file)};
+    state.counters.AddPhase(scan_statistics::Phase::FileRead,
+                            scan_statistics::Clock::now() - start);
+    if (!contents.has_value()) {
+        this->RecordFileResult(current_file, result, state);
+        return;
+    }
+
+    if (contents->size() >= split_file_limit_ && thread_count_ > 1) {
+        this->SplitLargeFile(current_file, *syntax, contents.value(), stamp,
+                             start, state);
+        return;
+    }
+
+    comment_lexing::CommentLexer lexer{*syntax};
+    this->ScanContents(lexer, contents.value(), result, state);
+    state.counters.RecordFile(scan_statistics::Clock::now() - start,
+                              current_file);
+
+    if (stamp.has_value()) {
+        scan_cache_->Store(current_file, stamp.value(), result);
+    }
+    this->RecordFileResult(current_file, result, state);
+}
+
+/*
+ * Reads file together with as many of the plain files queued behind it on
+ * this worker's own queue as fit in one batch. Files without a recognized
+ * extension are left out of the batch, since they are never read.
+ */
+void Parser::ParseFileBatch(const std::size_t worker, Job&& file,
+                            WorkerState& state) {
+    std::vector<Job>& batch{state.batch};
+    batch.clear();
+    batch.push_back(std::move(file));
+    {
+        WorkQueue& own{read_stage_.queues[worker]};
+        std::scoped_lock<std::mutex> lock{own.lock};
+        // each job taken here takes its permit as well, or a worker could
+        // wake up for it and find every queue empty
+        while (batch.size() < uring_reading::BatchReader::batch_size &&
+               !own.files.empty() && !own.files.back().contents.has_value() &&
+               own.files.back().split_file == nullptr &&
+               read_stage_.jobs.try_acquire()) {
+            batch.push_back(std::move(own.files.back()));
+            own.files.pop_back();
+        }
+    }
+
+    std::vector<std::string>& files{state.batch_files};
+    std::vector<const char*>& paths{state.batch_paths};
+    std::vector<std::size_t>& slots{state.batch_slots};
+    files.resize(std::max(files.size(), batch.size()));
+    paths.clear();
+    slots.clear();
+    for (const Job& job : batch) {
+        if (languages_.Find(paths_.Name(job.path)).has_value()) {
+            slots.push_back(paths.size());
+            paths_.Resolve(job.path, files[paths.size()]);
+            paths.push_back(files[paths.size()].c_str());
+        } else {
+            slots.push_back(paths.size() + batch.size());
+        }
+    }
+
+    const scan_statistics::Clock::time_point start{
+        scan_statistics::Clock::now()};
+    const std::span<const std::optional<std::string_view>> contents{
+        state.batch_reader->Read(paths)};
+    state.counters.AddPhase(scan_statistics::Phase::FileRead,
+                            scan_statistics::Clock::now() - start);
+
+    for (std::size_t index{0}; index < batch.size(); ++index) {
+        if (slots[index] < contents.size()) {
+            state.prefetched = contents[slots[index]];
+        }
+        this->RecursivelyParseFiles(batch[index], state);
+        state.prefetched.reset();
+    }
+
+    // the first job is finished by the caller like any other
+    for (std::size_t index{1}; index < batch.size(); ++index) {
+        this->FinishJob();
+    }
+    if (!state.batch_reader->IsAvailable()) {
+        state.batch_reader.reset();
+    }
+}
+
+void Parser::MatchComment(const std::size_t line_count,
+                          const std::string_view line,
+                          const std::span<const std::string_view> comments,
+                          FileResult& result) const {
+    std::uint32_t found_keywords{0};
+    std::array<std::size_t, builtin_keywords.size()> keyword_columns{};
+    std::uint64_t custom_candidates{unfiltered_customs_};
+    for (const std::string_view sub_str : comments) {
+        const std::size_t comment_column{
+            static_cast<std::size_t>(sub_str.data() - line.data())};
+        keyword_automaton_.ForEachMatch(
+            sub_str, [&](const std::size_t keyword, const std::size_t begin) {
+                if (keyword < keyword_pairs_.size()) {
+                    if (!(found_keywords & (std::uint32_t{1} << keyword))) {
+                        keyword_columns[keyword] = comment_column + begin;
+                    }
+                    found_keywords |= std::uint32_t{1} << keyword;
+                } else {
+                    custom_candidates |=
+                        literal_candidates_[keyword - keyword_pairs_.size()];
                 }
+            });
+    }
+
+    for (std::size_t index{0}; index < keyword_pairs_.size(); ++index) {
+        if (found_keywords & (std::uint32_t{1} << index)) {
+            result.pattern_counts[index]++;
+            if (collect_hits_) {
+                result.hits.emplace_back(
+                    line_count, index, line, keyword_columns[index],
+                    std::get<1>(keyword_pairs_[index]).size());
             }
+        }
+    }
 
-            if (custom_regexes_.has_value()) {
-                for (auto& [regex, literal, count] : custom_regexes_.value()) {
-                    if (std::regex_search(sub_str.cbegin(), sub_str.cend(),
-                                          regex)) {
-                        if (verbose_printing_) {
-                            std::println(
-                                "Regex {0} Found: \nFile: {1}\nLine Number: "
-                                "{2}\nLine: "
-                                "{3}\n",
-                                literal, current_file.c_str(), line_count,
-                                line);
-                        }
-
-                        std::scoped_lock<std::mutex> lock{data_lock_};
-                        count++;
+    if (custom_regexes_.has_value()) {
+        std::size_t index{keyword_pairs_.size()};
+        std::match_results<std::string_view::const_iterator> match{};
+        for (const auto& [regex, _, __] : custom_regexes_.value()) {
+            const std::size_t custom{index - keyword_pairs_.size()};
+            const bool candidate{custom >= prefiltered_custom_limit ||
+                                 ((custom_candidates >> custom) & 1) != 0};
+            // the first comment it matches in counts; the match position is
+            // only worth extracting for hits
+            for (const std::string_view sub_str :
+                 candidate ? comments : std::span<const std::string_view>{}) {
+                if (collect_hits_
+                        ? std::regex_search(sub_str.cbegin(), sub_str.cend(),
+                                            match, regex)
+                        : std::regex_search(sub_str.cbegin(), sub_str.cend(),
+                                            regex)) {
+                    result.pattern_counts[index]++;
+                    if (collect_hits_) {
+                        result.hits.emplace_back(
+                            line_count, index, line,
+                            static_cast<std::size_t>(sub_str.data() -
+                                                     line.data()) +
+                                static_cast<std::size_t>(match.position(0)),
+                            static_cast<std::size_t>(match.length(0)));
                     }
+                    break;
                 }
             }
+            ++index;
         }
     }
 }
 
-void Parser::ReportSummary() const {
-    std::cout
-        << std::endl
-        << "------------------------------------ Summary ------------------"
-           "-----------------"
-        << std::endl;
-    std::cout << std::endl
-              << std::left << std::setw(19) << "File Extension" << std::left
-              << "|" << std::left << std::setw(20) << "Files" << std::endl;
-    std::cout
-        << "---------------------------------------------------------------"
-           "-----------------"
-        << std::endl;
-    for (const auto& [file_extension, frequency] : file_type_frequencies_) {
-        std::cout << std::left << std::setw(19) << file_extension << "|"
-                  << std::setw(20) << frequency << std::endl;
-        std::cout
-            << "---------------------------------------------------------------"
-               "-----------------"
-            << std::endl;
+/*
+ * Comments are located for the whole file first and matched afterwards,
+ * which keeps each pass tight and lets both be timed once per file.
+ */
+Parser::ContentTotals Parser::ParseContents(
+    comment_lexing::CommentLexer& lexer, const std::string_view contents,
+    FileResult& result, WorkerState& state) const {
+    using scan_statistics::Clock;
+
+    std::vector<CommentLine>& comments{state.comments};
+    std::vector<std::string_view>& spans{state.comment_spans};
+    std::size_t line_total{0};
+    std::size_t comment_bytes{0};
+    comments.clear();
+    spans.clear();
+
+    const Clock::time_point locate_start{Clock::now()};
+    byte_scanner::ForEachLine(contents, [&](const std::string_view line,
+                                            const std::size_t line_count) {
+        line_total = line_count;
+        if (const std::span<const std::string_view> line_comments{
+                lexer.NextLine(line)};
+            !line_comments.empty()) {
+            comments.emplace_back(line_count, line, spans.size(),
+                                  line_comments.size());
+            for (const std::string_view comment : line_comments) {
+                spans.push_back(comment);
+                comment_bytes += comment.size();
+            }
+        }
+    });
+
+    const Clock::time_point match_start{Clock::now()};
+    for (const auto& [line_number, line, first, count] : comments) {
+        this->MatchComment(line_number, line,
+                           std::span{spans}.subspan(first, count), result);
     }
+    const Clock::time_point match_end{Clock::now()};
+
+    state.counters.AddPhase(scan_statistics::Phase::CommentLocation,
+                            match_start - locate_start);
+    state.counters.AddPhase(scan_statistics::Phase::PatternMatching,
+                            match_end - match_start);
+    return ContentTotals{.lines = line_total, .comment_bytes = comment_bytes};
 }
 
-void Parser::ParseFiles(const std::filesystem::path& current_file) {
-    const std::uint32_t thread_capacity = std::thread::hardware_concurrency();
+void Parser::ScanContents(comment_lexing::CommentLexer& lexer,
+                          const std::string_view contents, FileResult& result,
+                          WorkerState& state) const {
+    const ContentTotals totals{
+        count_only_ ? this->CountContents(lexer, contents, result, state)
+                    : this->ParseContents(lexer, contents, result, state)};
+    state.counters.AddContents(contents.size(), totals.lines,
+                               totals.comment_bytes);
+}
 
-    std::cout << "Concurrent Threads Supported: " << thread_capacity
-              << std::endl
-              << std::endl;
+/*
+ * Only a line holding a candidate, an occurrence of a keyword or of a custom
+ * regex's required literal anywhere in it, can add to the counts, so the
+ * candidates are found with a vectorized search over the whole buffer and
+ * only their lines are matched. The lexer still sees every line up to the
+ * last candidate, since whether a line is in a comment depends on the ones
+ * before it, but nothing past that line is split or lexed at all; its lines
+ * are only counted. The counts come out the same as ParseContents's, and so
+ * do the statistics, but for the comment bytes past the last candidate.
+ */
+Parser::ContentTotals Parser::CountContents(
+    comment_lexing::CommentLexer& lexer, const std::string_view contents,
+    FileResult& result, WorkerState& state) const {
+    using scan_statistics::Clock;
 
-    for (std::uint32_t threads{0}; threads < thread_capacity; threads++) {
-        thread_pool_.emplace_back(&Parser::ThreadWaitingRoom, this);
-    }
+    const Clock::time_point start{Clock::now()};
+    const char* const end{contents.data() + contents.size()};
+    const char* candidate{literal_prefilter_.Next(contents.data(), end)};
+    // searching for candidates and matching their lines; everything else is
+    // locating comments
+    Clock::duration matching{Clock::now() - start};
+    std::size_t line_total{0};
+    std::size_t candidate_lines{0};
+    std::size_t comment_bytes{0};
 
-    std::filesystem::recursive_directory_iterator directory_iterator(
-        current_file);
+    // a candidate left on the newline ending the file has no line after it
+    const char* cursor{contents.data()};
+    while (candidate != end && cursor != end) {
+        const char* const line_end{byte_scanner::FindByte(cursor, end, '\n')};
+        const std::string_view line{cursor, line_end};
+        const std::span<const std::string_view> line_comments{
+            lexer.NextLine(line)};
+        line_total++;
+        for (const std::string_view comment : line_comments) {
+            comment_bytes += comment.size();
+        }
 
-    std::ranges::for_each(
-        directory_iterator, [this](const std::filesystem::path& entry) {
-            if (!(std::filesystem::is_symlink(entry) ||
-                  std::filesystem::is_directory(entry))) [[likely]] {
-                {
-                    std::unique_lock<std::mutex> lock{job_lock_};
-                    jobs_.emplace(std::move(entry));
-                }
-                job_semaphore_.release();
+        if (candidate < line_end) {
+            const Clock::time_point match_start{Clock::now()};
+            candidate_lines++;
+            if (!line_comments.empty()) {
+                this->MatchComment(line_total, line, line_comments, result);
             }
+            // with candidates this close together, searching for the next
+            // one costs more than matching every comment on the way to it
+            candidate = candidate_lines >= dense_candidate_lines &&
+                                candidate_lines * dense_candidate_ratio >
+                                    line_total
+                            ? line_end
+                            : literal_prefilter_.Next(line_end, end);
+            matching += Clock::now() - match_start;
+        }
+        cursor = line_end == end ? end : line_end + 1;
+    }
+
+    // counted the way ForEachLine splits them, a last line without a
+    // newline included
+    for (const char* newline{byte_scanner::FindByte(cursor, end, '\n')};
+         newline != end;
+         newline = byte_scanner::FindByte(newline + 1, end, '\n')) {
+        line_total++;
+    }
+    if (cursor != end && end[-1] != '\n') {
+        line_total++;
+    }
+
+    state.counters.AddPhase(scan_statistics::Phase::CommentLocation,
+                            Clock::now() - start - matching);
+    state.counters.AddPhase(scan_statistics::Phase::PatternMatching, matching);
+    return ContentTotals{.lines = line_total, .comment_bytes = comment_bytes};
+}
+
+/*
+ * Chunk boundaries fall right after a newline, so every chunk holds whole
+ * lines and the line numbers of each one follow from the line counts of
+ * the chunks before it.
+ */
+void Parser::SplitLargeFile(const std::string_view current_file,
+                            const comment_lexing::Syntax& syntax,
+                            const std::string_view contents,
+                            const std::optional<scan_cache::FileStamp>& stamp,
+                            const scan_statistics::Clock::time_point start,
+                            WorkerState& state) {
+    const std::shared_ptr<SplitFile> file{std::make_shared<SplitFile>()};
+    file->path = current_file;
+    file->syntax = &syntax;
+    file->memory = state.reader.Keep();
+    file->stamp = stamp;
+    file->start = start;
+
+    const char* const end{contents.data() + contents.size()};
+    for (const char* chunk_begin{contents.data()}; chunk_begin != end;) {
+        const char* chunk_end{
+            static_cast<std::size_t>(end - chunk_begin) > split_chunk_size_
+                ? byte_scanner::FindByte(chunk_begin + split_chunk_size_, end,
+                                         '\n')
+                : end};
+        chunk_end = chunk_end == end ? end : chunk_end + 1;
+        file->chunks.push_back(Chunk{
+            .text = std::string_view{chunk_begin, chunk_end},
+            .totals = {},
+            .result = {},
+            .lexer = std::nullopt,
         });
+        chunk_begin = chunk_end;
+    }
+    file->unfinished_chunks.store(file->chunks.size());
 
-    std::ranges::for_each(thread_pool_, [this](std::jthread& t) {
-        job_semaphore_.release();
-        t.join();
-    });
+    // the chunks go to the back of this worker's queue, where it takes them
+    // from first while idle workers steal them from the front
+    Stage& stage{this->MatchStage()};
+    pending_jobs_.fetch_add(file->chunks.size(), std::memory_order_relaxed);
+    {
+        WorkQueue& own{stage.queues[state.worker]};
+        std::scoped_lock<std::mutex> lock{own.lock};
+        for (std::size_t chunk{file->chunks.size()}; chunk-- != 0;) {
+            own.files.push_back(Job{
+                .path = path_arena::no_path,
+                .ignore_scope = nullptr,
+                .contents = std::nullopt,
+                .split_file = file,
+                .chunk = chunk,
+            });
+        }
+    }
+    stage.jobs.release(static_cast<std::ptrdiff_t>(file->chunks.size()));
+}
+
+void Parser::ParseChunk(const Job& chunk, WorkerState& state) {
+    SplitFile& file{*chunk.split_file};
+    Chunk& part{file.chunks[chunk.chunk]};
+
+    comment_lexing::CommentLexer lexer{*file.syntax};
+    part.result.Reset(this->PatternCount());
+    part.totals = this->ParseContents(lexer, part.text, part.result, state);
+    part.lexer.emplace(lexer);
+
+    if (file.unfinished_chunks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        this->FinishSplitFile(file, state);
+    }
+}
+
+/*
+ * Every chunk but the first was lexed as if it started in code. That guess
+ * only fails when a comment or literal runs across the boundary before it,
+ * in which case the chunk is lexed again from where the previous one really
+ * left off. The result is the same as parsing the file in one go, and so
+ * are the statistics, which are only added once every chunk is final.
+ */
+void Parser::FinishSplitFile(SplitFile& file, WorkerState& state) {
+    FileResult& result{state.result};
+    result.Reset(this->PatternCount());
+    std::size_t line_offset{0};
+    std::size_t comment_bytes{0};
+    std::size_t bytes{0};
+
+    for (std::size_t index{0}; index < file.chunks.size(); ++index) {
+        Chunk& chunk{file.chunks[index]};
+        if (index != 0 && !file.chunks[index - 1].lexer->InCode()) {
+            comment_lexing::CommentLexer lexer{
+                file.chunks[index - 1].lexer.value()};
+            chunk.result.Reset(this->PatternCount());
+            chunk.totals =
+                this->ParseContents(lexer, chunk.text, chunk.result, state);
+            chunk.lexer.emplace(lexer);
+        }
+
+        for (std::size_t pattern{0}; pattern < result.pattern_counts.size();
+             ++pattern) {
+            result.pattern_counts[pattern] +=
+                chunk.result.pattern_counts[pattern];
+        }
+        for (Hit& hit : chunk.result.hits) {
+            hit.line_number += line_offset;
+            result.hits.push_back(std::move(hit));
+        }
+        line_offset += chunk.totals.lines;
+        comment_bytes += chunk.totals.comment_bytes;
+        bytes += chunk.text.size();
+    }
+    state.counters.AddContents(bytes, line_offset, comment_bytes);
 
-    std::cout << "Files Profiled: " << file_count_.load() << std::endl;
-    for (const auto& [_, keyword_count, keyword_literal] : keyword_pairs_) {
-        std::cout << keyword_literal << "s Found: " << keyword_count
-                  << std::endl;
-    }  // TODO(not_a_real_todo) test
+    state.counters.RecordFile(scan_statistics::Clock::now() - file.start,
+                              file.path);
+    if (file.stamp.has_value()) {
+        scan_cache_->Store(file.path, file.stamp.value(), result);
+    }
+    this->RecordFileResult(file.path, result, state);
+}
+
+void Parser::RecordFileResult(const std::string_view current_file,
+                              const FileResult& result, WorkerState& state) {
+    if (!result.hits.empty()) {
+        state.records.clear();
+        for (const auto& [line_number, pattern, line, column, length] :
+             result.hits) {
+            state.records.push_back(profile::HitRecord{
+                .line_number = line_number,
+                .pattern = pattern,
+                .keyword = pattern < keyword_pairs_.size()
+                               ? std::get<1>(keyword_pairs_[pattern])
+                               : std::get<1>(custom_regexes_.value()
+                                                 [pattern -
+                                                  keyword_pairs_.size()]),
+                .line = line,
+                .column = column,
+                .length = length,
+                .custom = pattern >= keyword_pairs_.size(),
+            });
+        }
+
+        // only files with hits pay for a std::filesystem::path
+        state.hit_path = current_file;
+        on_hits_(profile::FileHits{
+            .worker = state.worker,
+            .path = state.hit_path,
+            .hits = state.records,
+        });
+    }
+
+    for (std::size_t index{0}; index < result.pattern_counts.size(); ++index) {
+        state.statistics.pattern_counts[index] += result.pattern_counts[index];
+    }
+    if (gated_) {
+        this->CheckThresholds(result.pattern_counts);
+    }
+
+    if (keep_index_) {
+        state.statistics.indexed_files.emplace_back(std::string{current_file},
+                                                    result.pattern_counts);
+    }
+}
+
+/*
+ * Totals only ever grow, so whichever worker pushes one past its limit is
+ * the one to stop the scan, and the merged counts still show it exceeded.
+ */
+void Parser::CheckThresholds(const std::span<const std::size_t> counts) {
+    std::size_t hits{0};
+    for (std::size_t index{0}; index < counts.size(); ++index) {
+        if (counts[index] != 0) {
+            gate_counts_[index].fetch_add(counts[index],
+                                          std::memory_order_relaxed);
+            hits += counts[index];
+        }
+    }
+    if (hits == 0) {
+        return;
+    }
+
+    const bool too_many_hits{
+        max_hits_.has_value() &&
+        gate_hits_.fetch_add(hits, std::memory_order_relaxed) + hits >
+            max_hits_.value()};
+    if (too_many_hits ||
+        std::ranges::any_of(thresholds_, [this](const auto& threshold) {
+            return gate_counts_[threshold.first].load(
+                       std::memory_order_relaxed) > threshold.second;
+        })) {
+        stop_source_.request_stop();
+    }
+}
+
+/*
+ * A permit per worker on every stage, as in FinishJob, wakes them all, and
+ * a read buffer for each of them, plus one for the thread feeding an
+ * archive, frees whatever is stuck waiting to read. Both are drained or
+ * dropped once the pool has joined.
+ */
+void Parser::WakeStoppedWorkers() {
+    read_stage_.jobs.release(static_cast<std::ptrdiff_t>(worker_count_));
+    if (io_thread_count_ != 0) {
+        match_stage_.jobs.release(static_cast<std::ptrdiff_t>(worker_count_));
+    }
+    if (read_buffers_ != nullptr) {
+        read_buffers_->slots.release(
+            static_cast<std::ptrdiff_t>(worker_count_ + 1));
+    }
+}
+
+void Parser::MergeWorkerStatistics() {
+    std::vector<const scan_statistics::WorkerCounters*> counters{};
+    for (const WorkerState& state : worker_states_) {
+        counters.push_back(&state.counters);
+    }
+    scan_statistics_.Merge(counters);
+
+    for (WorkerState& state : worker_states_) {
+        auto& [file_count, pattern_counts, extension_counts, errors,
+               indexed_files, scanned_directories] = state.statistics;
+
+        file_count_ += file_count;
+
+        for (std::size_t index{0}; index < keyword_pairs_.size(); ++index) {
+            std::get<0>(keyword_pairs_[index]) += pattern_counts[index];
+        }
+
+        if (custom_regexes_.has_value()) {
+            std::size_t index{keyword_pairs_.size()};
+            for (auto& [_, __, count] : custom_regexes_.value()) {
+                count += pattern_counts[index++];
+            }
+        }
+
+        for (const auto& [extension, frequency] : extension_counts) {
+            file_type_frequencies_[std::string{extension}] += frequency;
+        }
+
+        errors_.insert(errors_.end(), errors.cbegin(), errors.cend());
+
+        for (auto& [path, counts] : indexed_files) {
+            IndexedFile file{
+                .extension = std::filesystem::path{path}.extension().string(),
+                .pattern_counts = std::move(counts),
+            };
+            index_.insert_or_assign(std::move(path), std::move(file));
+        }
+        std::ranges::move(scanned_directories,
+                          std::back_inserter(scanned_directories_));
+    }
+}
+
+void Parser::Unindex(const IndexedFile& file) {
+    file_count_--;
+    if (const auto frequency{file_type_frequencies_.find(file.extension)};
+        frequency != file_type_frequencies_.end() && --frequency->second == 0) {
+        file_type_frequencies_.erase(frequency);
+    }
+
+    for (std::size_t index{0}; index < keyword_pairs_.size(); ++index) {
+        std::get<0>(keyword_pairs_[index]) -= file.pattern_counts[index];
+    }
+    if (custom_regexes_.has_value()) {
+        std::size_t index{keyword_pairs_.size()};
+        for (auto& [_, __, count] : custom_regexes_.value()) {
+            count -= file.pattern_counts[index++];
+        }
+    }
+}
+
+/*
+ * Paths below a directory sort right after its name plus a separator, but
+ * not necessarily right after the name itself ("a/b.txt" sorts between "a/b"
+ * and "a/b/c"), so the exact entry and the subtree are dropped separately.
+ */
+void Parser::Forget(const std::filesystem::path& path) {
+    const std::string file{path.string()};
+    if (const auto found{index_.find(file)}; found != index_.end()) {
+        this->Unindex(found->second);
+        index_.erase(found);
+    }
+
+    const std::string prefix{
+        file + static_cast<char>(std::filesystem::path::preferred_separator)};
+    std::string prefix_end{prefix};
+    prefix_end.back()++;
+
+    auto entry{index_.lower_bound(prefix)};
+    while (entry != index_.end() && entry->first < prefix_end) {
+        this->Unindex(entry->second);
+        entry = index_.erase(entry);
+    }
+}
+
+profile::ScanSummary Parser::Summarize() const {
+    profile::ScanSummary summary{
+        .file_count = file_count_,
+        .thread_count = worker_count_,
+        .patterns = {},
+        .extension_counts = file_type_frequencies_,
+        .errors = errors_,
+        .exceeded = {},
+        .stopped_early = stopped_early_,
+        .statistics = scan_statistics_,
+    };
+
+    for (const auto& [keyword_count, keyword_literal] : keyword_pairs_) {
+        summary.patterns.emplace_back(std::string{keyword_literal},
+                                      keyword_count, false);
+    }
     if (custom_regexes_.has_value()) {
-        std::cout
-            << std::endl
-            << "------------------------------------ Customs ------------------"
-               "-----------------"
-            << std::endl;
         for (const auto& [_, literal, count] : custom_regexes_.value()) {
-            std::cout << "Amount of " << literal << " Found: " << count
-                      << std::endl;
+            summary.patterns.emplace_back(std::string{literal}, count, true);
+        }
+    }
+
+    std::size_t hits{0};
+    for (const profile::PatternTotal& total : summary.patterns) {
+        hits += total.count;
+    }
+    for (const auto& [pattern, limit] : thresholds_) {
+        if (summary.patterns[pattern].count > limit) {
+            summary.exceeded.push_back(std::format(
+                "{}>{}", summary.patterns[pattern].pattern, limit));
         }
     }
-    this->ReportSummary();
-    std::cout << std::endl;
+    if (max_hits_.has_value() && hits > max_hits_.value()) {
+        summary.exceeded.push_back(std::format("hits>{}", max_hits_.value()));
+    }
+
+    return summary;
+}
+
+std::optional<std::span<const std::size_t>> Parser::FileCounts(
+    const std::string_view file) const {
+    if (const auto found{index_.find(std::string{file})};
+        found != index_.end()) {
+        return std::span<const std::size_t>{found->second.pattern_counts};
+    }
+    return std::nullopt;
+}
+
+void Parser::RunWorkers(std::vector<Job>&& directories,
+                        std::vector<Job>&& files,
+                        const std::function<void()>& feed) {
+    read_stage_.queues = std::vector<WorkQueue>(worker_count_);
+    match_stage_.queues = std::vector<WorkQueue>(
+        io_thread_count_ != 0 ? worker_count_ : 0);
+    worker_states_ = std::vector<WorkerState>(worker_count_);
+    for (std::size_t worker{0}; worker < worker_states_.size(); ++worker) {
+        worker_states_[worker].worker = worker;
+        worker_states_[worker].statistics.pattern_counts.assign(
+            this->PatternCount(), 0);
+    }
+    io_workers_.store(io_thread_count_);
+    errors_.clear();
+    scan_statistics_ = scan_statistics::ScanStatistics{};
+    stop_source_ = std::stop_source{};
+    stopped_early_ = false;
+    if (gated_) {
+        gate_counts_ =
+            std::vector<std::atomic<std::size_t>>(this->PatternCount());
+        gate_hits_.store(0);
+    }
+
+    const std::size_t seeded_jobs{directories.size() + files.size()};
+    if (seeded_jobs == 0 && !feed) {
+        return;
+    }
+
+    if (feed || io_thread_count_ != 0) {
+        read_buffers_ = std::make_unique<ReadBuffers>(
+            thread_count_ * buffered_files_per_worker);
+    }
+
+    // the feed counts as a job until it returns, so the pool cannot run dry
+    // and shut down while more files are still on their way
+    jobs_finished_.store(false);
+    pending_jobs_.store(seeded_jobs + (feed ? 1 : 0));
+    scan_statistics_.Start();
+    std::ranges::move(directories, std::back_inserter(
+                                       read_stage_.queues.front().directories));
+    std::ranges::move(files,
+                      std::back_inserter(read_stage_.queues.front().files));
+    read_stage_.jobs.release(static_cast<std::ptrdiff_t>(seeded_jobs));
+
+    {
+        // the caller's stop token stops the scan the same way a threshold
+        // does; neither can touch the pool once it has joined
+        const std::stop_callback wake{
+            stop_source_.get_token(), [this]() { this->WakeStoppedWorkers(); }};
+        const std::stop_callback cancel{
+            cancel_token_, [this]() { stop_source_.request_stop(); }};
+
+        for (std::size_t worker{0}; worker < worker_count_; ++worker) {
+            thread_pool_.emplace_back(&Parser::ThreadWaitingRoom, this,
+                                      stop_source_.get_token(), worker);
+        }
+
+        // an archive is read by the feed alone, so there is no split to tune
+        std::jthread tuner{};
+        if (auto_tune_ && io_thread_count_ != 0 && !feed) {
+            tuner = std::jthread{
+                [this](const std::stop_token stop) { this->AutoTune(stop); }};
+        }
+
+        if (feed) {
+            feed();
+            this->FinishJob();
+        }
+
+        std::ranges::for_each(thread_pool_,
+                              [](std::jthread& t) { t.join(); });
+        thread_pool_.clear();
+    }
+
+    // workers that found the scan finished on one stage leave their permits
+    // on the other unused
+    while (read_stage_.jobs.try_acquire()) {
+    }
+    while (match_stage_.jobs.try_acquire()) {
+    }
+    // whatever was still queued when the scan stopped is dropped here
+    stopped_early_ = stop_source_.stop_requested();
+    read_stage_.queues.clear();
+    match_stage_.queues.clear();
+    read_buffers_.reset();
+    this->MergeWorkerStatistics();
+}
+
+/*
+ * Every root is a job of the same pass, so the pool is only started once
+ * however many there are. One root inside another is left to the outer
+ * one, whose scan covers it.
+ */
+profile::ScanSummary Parser::ParseFiles() {
+    paths_.Clear();
+    std::unordered_set<std::string> root_paths{};
+    for (const std::filesystem::path& root : roots_) {
+        root_paths.insert(root.string());
+    }
+
+    std::vector<Job> directories{};
+    std::unordered_set<std::string> seen_paths{};
+    for (const std::filesystem::path& root : roots_) {
+        if (IsBelowAny(root, root_paths) ||
+            !seen_paths.insert(root.string()).second) {
+            continue;
+        }
+        directories.push_back(Job{
+            .path = paths_.Add(worker_count_, path_arena::no_path,
+                               root.string()),
+        });
+    }
+    this->RunWorkers(std::move(directories), {});
+
+    if (scan_cache_.has_value() && !scan_cache_->Save()) {
+        errors_.emplace_back("Could not write scan cache");
+    }
+    if (keep_index_) {
+        // rescanned files have changed by definition, so they would only
+        // ever miss in the cache
+        scan_cache_.reset();
+    }
+
+    return this->Summarize();
+}
+
+profile::ScanSummary Parser::ParseArchive(
+    const std::filesystem::path& archive) {
+    paths_.Clear();
+    tar_reading::TarReader reader{archive};
+    if (!reader.IsOpen()) {
+        this->RunWorkers({}, {});
+        errors_.push_back(
+            std::format("Could not open archive {}", archive.string()));
+        return this->Summarize();
+    }
+
+    this->RunWorkers({}, {}, [this, &reader]() { this->FeedArchive(reader); });
+
+    return this->Summarize();
+}
+
+/*
+ * Members are filtered on their name before their contents are read, so
+ * anything that is not a recognized source file is skipped over without
+ * being copied.
+ */
+void Parser::FeedArchive(tar_reading::TarReader& reader) {
+    std::size_t member_count{0};
+
+    while (const std::optional<tar_reading::Member> member{reader.Next()}) {
+        if (stop_source_.stop_requested()) {
+            break;
+        } else if (!languages_.Find(std::string_view{member->path})
+                        .has_value() ||
+                   !this->InShard({}, member->path)) {
+            continue;
+        } else if (use_ignore_files_ &&
+                   std::ranges::any_of(std::filesystem::path{member->path},
+                                       [](const auto& component) {
+                                           return component == ".git";
+                                       })) {
+            continue;
+        }
+
+        std::string contents{this->TakeBuffer()};
+        if (!reader.ReadContents(contents)) {
+            this->ReturnContents(std::move(contents));
+            break;
+        }
+        this->SubmitFile(member_count++ % worker_count_,
+                         Job{
+                             .path = paths_.Add(worker_count_,
+                                                path_arena::no_path,
+                                                member->path),
+                             .ignore_scope = nullptr,
+                             .contents = std::move(contents),
+                         });
+    }
+
+    // workers only add their errors once the pool has joined
+    if (reader.Error().has_value()) {
+        errors_.push_back(reader.Error().value());
+    }
+}
+
+/*
+ * The files were found by whoever listed them, so only the cache is left
+ * to share with a walk of the roots.
+ */
+profile::ScanSummary Parser::ParseFileList(
+    const std::span<const std::string> files) {
+    paths_.Clear();
+    std::vector<Job> jobs{};
+    jobs.reserve(files.size());
+    for (const std::string& file : files) {
+        jobs.push_back(Job{
+            .path = paths_.Add(worker_count_, path_arena::no_path, file),
+        });
+    }
+    this->RunWorkers({}, std::move(jobs));
+
+    if (scan_cache_.has_value() && !scan_cache_->Save()) {
+        errors_.emplace_back("Could not write scan cache");
+    }
+    if (keep_index_) {
+        scan_cache_.reset();
+    }
+
+    return this->Summarize();
+}
+
+profile::ScanSummary Parser::ParseSnapshot(
+    const std::span<const std::string> paths,
+    const std::function<bool(std::size_t, std::string&)>& load) {
+    paths_.Clear();
+    this->RunWorkers({}, {}, [this, paths, &load]() {
+        this->FeedSnapshot(paths, load);
+    });
+
+    return this->Summarize();
+}
+
+void Parser::FeedSnapshot(
+    const std::span<const std::string> paths,
+    const std::function<bool(std::size_t, std::string&)>& load) {
+    for (std::size_t index{0}; index < paths.size(); ++index) {
+        if (stop_source_.stop_requested()) {
+            break;
+        }
+
+        std::string contents{this->TakeBuffer()};
+        if (!load(index, contents)) {
+            this->ReturnContents(std::move(contents));
+            errors_.push_back(std::format("Could not read {}", paths[index]));
+            continue;
+        }
+        this->SubmitFile(index % worker_count_,
+                         Job{
+                             .path = paths_.Add(worker_count_,
+                                                path_arena::no_path,
+                                                paths[index]),
+                             .ignore_scope = nullptr,
+                             .contents = std::move(contents),
+                         });
+    }
+}
+
+std::string Parser::TakeBuffer() {
+    ReadBuffers& buffers{*read_buffers_};
+    buffers.slots.acquire();
+    buffers.filled.fetch_add(1, std::memory_order_relaxed);
+
+    std::scoped_lock<std::mutex> lock{buffers.spare_lock};
+    if (buffers.spare_contents.empty()) {
+        return std::string{};
+    }
+    std::string contents{std::move(buffers.spare_contents.back())};
+    buffers.spare_contents.pop_back();
+    return contents;
+}
+
+void Parser::ReturnContents(std::string&& contents) {
+    // an unusually large member should not keep its buffer for the rest of
+    // the archive
+    if (contents.capacity() <= file_io::FileReader::small_file_limit) {
+        std::scoped_lock<std::mutex> lock{read_buffers_->spare_lock};
+        read_buffers_->spare_contents.push_back(std::move(contents));
+    }
+    read_buffers_->filled.fetch_sub(1, std::memory_order_relaxed);
+    read_buffers_->slots.release();
+}
+
+/*
+ * Reads file into a read buffer for the matching stage, which blocks while
+ * every buffer is filled. Files too large for one (which the matcher maps
+ * instead), files that can not be opened and files the cache may already
+ * know are handed on unread, for the matcher to deal with the usual way.
+ */
+void Parser::ReadAhead(Job&& file, WorkerState& state) {
+    const scan_statistics::Clock::time_point start{
+        scan_statistics::Clock::now()};
+    if (!scan_cache_.has_value()) {
+        paths_.Resolve(file.path, state.path);
+        std::string contents{this->TakeBuffer()};
+        if (file_io::FileReader::ReadSmall(state.path, contents)) {
+            file.prefetched = std::move(contents);
+        } else {
+            this->ReturnContents(std::move(contents));
+        }
+    }
+    state.counters.AddPhase(scan_statistics::Phase::FileRead,
+                            scan_statistics::Clock::now() - start);
+
+    // spread over the matchers' queues, which they steal from one another
+    this->SubmitFile(state.handoffs++ % worker_count_, std::move(file));
+}
+
+/*
+ * Read buffers that stay mostly filled mean the matchers can not keep up,
+ * so a worker moves from reading to matching; buffers that stay mostly
+ * empty mean the matchers are waiting on the readers, so one moves the
+ * other way. Each stage keeps at least one worker. A move is undone if
+ * fewer jobs got matched in the interval after it than in the one before.
+ */
+void Parser::AutoTune(const std::stop_token stop) {
+    std::mutex lock{};
+    std::condition_variable_any wake{};
+    std::unique_lock<std::mutex> guard{lock};
+
+    std::uint64_t matched_before{0};
+    std::uint64_t last_total{0};
+    bool moved{false};
+    bool moved_to_matching{false};
+    std::size_t hold{0};
+
+    while (!wake.wait_for(guard, stop, tune_interval, [] { return false; })) {
+        if (stop.stop_requested()) {
+            return;
+        }
+
+        std::uint64_t total{0};
+        for (const WorkerState& state : worker_states_) {
+            total += state.matched_jobs.load(std::memory_order_relaxed);
+        }
+        const std::uint64_t matched{total - last_total};
+        last_total = total;
+
+        if (moved && matched < matched_before) {
+            if (moved_to_matching) {
+                io_workers_.fetch_add(1, std::memory_order_relaxed);
+            } else {
+                io_workers_.fetch_sub(1, std::memory_order_relaxed);
+            }
+            hold = tune_hold_steps;
+        }
+        moved = false;
+        matched_before = matched;
+
+        if (hold != 0) {
+            hold--;
+            continue;
+        }
+
+        const std::size_t filled{
+            read_buffers_->filled.load(std::memory_order_relaxed)};
+        const std::size_t slot_count{read_buffers_->slot_count};
+        const std::size_t io_workers{
+            io_workers_.load(std::memory_order_relaxed)};
+        if (filled * 4 >= slot_count * 3 && io_workers > 1) {
+            io_workers_.store(io_workers - 1, std::memory_order_relaxed);
+            moved = true;
+            moved_to_matching = true;
+        } else if (filled * 4 <= slot_count && io_workers + 1 < worker_count_) {
+            io_workers_.store(io_workers + 1, std::memory_order_relaxed);
+            moved = true;
+            moved_to_matching = false;
+        }
+    }
+}
+
+/*
+ * A target below another target is skipped: scanning the outer one covers
+ * it, and scanning it as well would count its files twice.
+ */
+void Parser::Rescan(const std::span<const Target> targets) {
+    paths_.Clear();
+    std::unordered_set<std::string> target_paths{};
+    for (const Target& target : targets) {
+        target_paths.insert(target.path.string());
+    }
+
+    std::unordered_set<std::string> seen_paths{};
+    std::vector<Job> directories{};
+    std::vector<Job> files{};
+
+    for (const Target& target : targets) {
+        if (IsBelowAny(target.path, target_paths) ||
+            !seen_paths.insert(target.path.string()).second) {
+            continue;
+        }
+
+        this->Forget(target.path);
+
+        std::error_code error{};
+        const std::filesystem::file_status status{
+            std::filesystem::symlink_status(target.path, error)};
+        const bool has_rules{target.ignore_scope != nullptr};
+        const Job job{
+            .path = paths_.Add(worker_count_, path_arena::no_path,
+                               target.path.string()),
+            .ignore_scope = target.ignore_scope,
+        };
+
+        if (std::filesystem::is_directory(status)) {
+            if (!(use_ignore_files_ && target.path.filename() == ".git") &&
+                !(has_rules &&
+                  target.ignore_scope->IsIgnored(target.path, true))) {
+                directories.push_back(job);
+            }
+        } else if (std::filesystem::is_regular_file(status)) {
+            if (!(has_rules &&
+                  target.ignore_scope->IsIgnored(target.path, false))) {
+                files.push_back(job);
+            }
+        }
+    }
+
+    this->RunWorkers(std::move(directories), std::move(files));
+}
+
+const std::vector<std::filesystem::path>& Parser::Roots() const {
+    return roots_;
+}
+
+std::vector<Parser::ScannedDirectory> Parser::TakeScannedDirectories() {
+    return std::exchange(scanned_directories_, {});
 }
 
 }  // namespace parser_info
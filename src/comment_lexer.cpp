@@ -0,0 +1,722 @@
+/*
+ *  comment_lexer.cpp - Streaming, language aware location of comments
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/comment_lexer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "include/byte_scanner.hpp"
+#include "include/comment_syntax.hpp"
+#include "include/keyword_matcher.hpp"
+
+namespace comment_lexing {
+namespace {
+using parser_info::CommentFormat;
+
+constexpr std::size_t max_raw_delimiter{16};
+
+/*
+ * Indexed by CommentFormat.
+ */
+constexpr std::array<Syntax, 10> syntax_table{{
+    // CFamily
+    {
+        .line_comment = "//",
+        .block_open = "/*",
+        .block_close = "*/",
+        .code_bytes = {{'/', '"', '\''}, 3},
+        .nested_blocks = false,
+        .line_continuation = true,
+        .char_literals = true,
+        .multiline_strings = false,
+        .backtick_strings = false,
+        .regex_literals = false,
+        .cpp_raw_strings = true,
+        .verbatim_strings = true,
+        .rust_raw_strings = false,
+        .zig_multiline = false,
+        .triple_quotes = false,
+        .docstrings = false,
+        .raw_backticks = false,
+        .word_start_comments = false,
+        .long_brackets = false,
+    },
+    // JavaScript
+    {
+        .line_comment = "//",
+        .block_open = "/*",
+        .block_close = "*/",
+        .code_bytes = {{'/', '"', '\'', '`'}, 4},
+        .nested_blocks = false,
+        .line_continuation = false,
+        .char_literals = false,
+        .multiline_strings = false,
+        .backtick_strings = true,
+        .regex_literals = true,
+        .cpp_raw_strings = false,
+        .verbatim_strings = false,
+        .rust_raw_strings = false,
+        .zig_multiline = false,
+        .triple_quotes = false,
+        .docstrings = false,
+        .raw_backticks = false,
+        .word_start_comments = false,
+        .long_brackets = false,
+    },
+    // Rust
+    {
+        .line_comment = "//",
+        .block_open = "/*",
+        .block_close = "*/",
+        .code_bytes = {{'/', '"', '\''}, 3},
+        .nested_blocks = true,
+        .line_continuation = false,
+        .char_literals = true,
+        .multiline_strings = true,
+        .backtick_strings = false,
+        .regex_literals = false,
+        .cpp_raw_strings = false,
+        .verbatim_strings = false,
+        .rust_raw_strings = true,
+        .zig_multiline = false,
+        .triple_quotes = false,
+        .docstrings = false,
+        .raw_backticks = false,
+        .word_start_comments = false,
+        .long_brackets = false,
+    },
+    // Zig
+    {
+        .line_comment = "//",
+        .block_open = {},
+        .block_close = {},
+        .code_bytes = {{'/', '"', '\'', '\\'}, 4},
+        .nested_blocks = false,
+        .line_continuation = false,
+        .char_literals = true,
+        .multiline_strings = false,
+        .backtick_strings = false,
+        .regex_literals = false,
+        .cpp_raw_strings = false,
+        .verbatim_strings = false,
+        .rust_raw_strings = false,
+        .zig_multiline = true,
+        .triple_quotes = false,
+        .docstrings = false,
+        .raw_backticks = false,
+        .word_start_comments = false,
+        .long_brackets = false,
+    },
+    // Python
+    {
+        .line_comment = "#",
+        .block_open = {},
+        .block_close = {},
+        .code_bytes = {{'#', '"', '\''}, 3},
+        .nested_blocks = false,
+        .line_continuation = false,
+        .char_literals = false,
+        .multiline_strings = false,
+        .backtick_strings = false,
+        .regex_literals = false,
+        .cpp_raw_strings = false,
+        .verbatim_strings = false,
+        .rust_raw_strings = false,
+        .zig_multiline = false,
+        .triple_quotes = true,
+        .docstrings = true,
+        .raw_backticks = false,
+        .word_start_comments = false,
+        .long_brackets = false,
+    },
+    // Go
+    {
+        .line_comment = "//",
+        .block_open = "/*",
+        .block_close = "*/",
+        .code_bytes = {{'/', '"', '\'', '`'}, 4},
+        .nested_blocks = false,
+        .line_continuation = false,
+        .char_literals = true,
+        .multiline_strings = false,
+        .backtick_strings = false,
+        .regex_literals = false,
+        .cpp_raw_strings = false,
+        .verbatim_strings = false,
+        .rust_raw_strings = false,
+        .zig_multiline = false,
+        .triple_quotes = false,
+        .docstrings = false,
+        .raw_backticks = true,
+        .word_start_comments = false,
+        .long_brackets = false,
+    },
+    // Java
+    {
+        .line_comment = "//",
+        .block_open = "/*",
+        .block_close = "*/",
+        .code_bytes = {{'/', '"', '\''}, 3},
+        .nested_blocks = false,
+        .line_continuation = false,
+        .char_literals = true,
+        .multiline_strings = false,
+        .backtick_strings = false,
+        .regex_literals = false,
+        .cpp_raw_strings = false,
+        .verbatim_strings = false,
+        .rust_raw_strings = false,
+        .zig_multiline = false,
+        .triple_quotes = true,
+        .docstrings = false,
+        .raw_backticks = false,
+        .word_start_comments = false,
+        .long_brackets = false,
+    },
+    // Kotlin
+    {
+        .line_comment = "//",
+        .block_open = "/*",
+        .block_close = "*/",
+        .code_bytes = {{'/', '"', '\''}, 3},
+        .nested_blocks = true,
+        .line_continuation = false,
+        .char_literals = true,
+        .multiline_strings = false,
+        .backtick_strings = false,
+        .regex_literals = false,
+        .cpp_raw_strings = false,
+        .verbatim_strings = false,
+        .rust_raw_strings = false,
+        .zig_multiline = false,
+        .triple_quotes = true,
+        .docstrings = false,
+        .raw_backticks = false,
+        .word_start_comments = false,
+        .long_brackets = false,
+    },
+    // Shell
+    {
+        .line_comment = "#",
+        .block_open = {},
+        .block_close = {},
+        .code_bytes = {{'#', '"', '\''}, 3},
+        .nested_blocks = false,
+        .line_continuation = false,
+        .char_literals = false,
+        .multiline_strings = true,
+        .backtick_strings = false,
+        .regex_literals = false,
+        .cpp_raw_strings = false,
+        .verbatim_strings = false,
+        .rust_raw_strings = false,
+        .zig_multiline = false,
+        .triple_quotes = false,
+        .docstrings = false,
+        .raw_backticks = false,
+        .word_start_comments = true,
+        .long_brackets = false,
+    },
+    // Lua
+    {
+        .line_comment = "--",
+        .block_open = "--[[",
+        .block_close = "]]",
+        .code_bytes = {{'-', '"', '\'', '['}, 4},
+        .nested_blocks = false,
+        .line_continuation = false,
+        .char_literals = false,
+        .multiline_strings = false,
+        .backtick_strings = false,
+        .regex_literals = false,
+        .cpp_raw_strings = false,
+        .verbatim_strings = false,
+        .rust_raw_strings = false,
+        .zig_multiline = false,
+        .triple_quotes = false,
+        .docstrings = false,
+        .raw_backticks = false,
+        .word_start_comments = false,
+        .long_brackets = true,
+    },
+}};
+
+bool StartsWith(const char* const position, const char* const end,
+                const std::string_view prefix) {
+    return !prefix.empty() &&
+           static_cast<std::size_t>(end - position) >= prefix.size() &&
+           std::string_view{position, prefix.size()} == prefix;
+}
+
+bool IsDigit(const char character) {
+    return character >= '0' && character <= '9';
+}
+
+bool IsSpace(const char character) {
+    return character == ' ' || character == '\t' || character == '\r' ||
+           character == '\f' || character == '\v';
+}
+
+/*
+ * Whether a shell comment may start at position: only at the start of a
+ * word, so the '#' in $# or ${#name} does not count.
+ */
+bool StartsWord(const std::string_view line, const char* const position) {
+    return position == line.data() || IsSpace(position[-1]) ||
+           std::string_view{";&|()"}.find(position[-1]) !=
+               std::string_view::npos;
+}
+
+bool StartsMarker(const std::string_view marker, const char character) {
+    return !marker.empty() && marker.front() == character;
+}
+
+/*
+ * The length of the Lua long bracket ([[, [=[, [==[ and so on) opening at
+ * position, or zero if there is none. level is set to its number of '='.
+ */
+std::size_t LongBracketLength(const char* const position,
+                              const char* const end, std::size_t& level) {
+    if (*position != '[') {
+        return 0;
+    }
+    const char* after{position + 1};
+    while (after < end && *after == '=') {
+        after++;
+    }
+    if (after == end || *after != '[') {
+        return 0;
+    }
+    level = static_cast<std::size_t>(after - position - 1);
+    return static_cast<std::size_t>(after + 1 - position);
+}
+
+/*
+ * Whether a '/' at position may start a regex literal rather than be a
+ * division, judged by the last non-blank character before it.
+ */
+bool CanStartRegex(const std::string_view line, const char* position) {
+    while (position != line.data() && IsSpace(position[-1])) {
+        position--;
+    }
+    if (position == line.data()) {
+        return true;
+    }
+    return std::string_view{"(,=:[!&|?{};+-*%<>~^"}.find(position[-1]) !=
+           std::string_view::npos;
+}
+
+/*
+ * Returns the position just past the regex literal starting at position, or
+ * nullptr if the line ends before it does.
+ */
+const char* SkipRegexLiteral(const char* position, const char* const end) {
+    bool in_class{false};
+    for (++position; position < end; ++position) {
+        switch (*position) {
+            case '\\':
+                ++position;
+                break;
+            case '[':
+                in_class = true;
+                break;
+            case ']':
+                in_class = false;
+                break;
+            case '/':
+                if (!in_class) {
+                    return position + 1;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return nullptr;
+}
+}  // namespace
+
+const Syntax& SyntaxFor(const CommentFormat format) {
+    return syntax_table[static_cast<std::size_t>(format)];
+}
+
+CommentLexer::CommentLexer(const CommentFormat format)
+    : syntax_{SyntaxFor(format)} {}
+
+CommentLexer::CommentLexer(const Syntax& syntax) : syntax_{syntax} {}
+
+bool CommentLexer::InCode() const { return mode_ == Mode::Code; }
+
+std::span<const std::string_view> CommentLexer::NextLine(
+    const std::string_view line) {
+    const char* position{line.data()};
+    const char* const end{line.data() + line.size()};
+    comments_.clear();
+
+    while (position != end) {
+        switch (mode_) {
+            case Mode::Code: {
+                const char* const candidate{byte_scanner::FindAnyByte(
+                    position, end, syntax_.code_bytes)};
+                position =
+                    candidate == end ? end : this->LexCode(line, candidate);
+                if (position == nullptr) {
+                    position = end;
+                }
+                break;
+            }
+            case Mode::LineComment:
+                this->MarkComment(position, end);
+                position = end;
+                break;
+            case Mode::BlockComment:
+                position = this->LexBlockComment(position, end);
+                break;
+            case Mode::Quoted:
+                position = this->LexQuoted(position, end);
+                break;
+            case Mode::Delimited:
+                position = this->LexDelimited(position, end);
+                break;
+            case Mode::Verbatim:
+                position = this->LexVerbatim(position, end);
+                break;
+        }
+    }
+
+    const bool continued{line.ends_with('\\') || line.ends_with("\\\r")};
+    if ((mode_ == Mode::LineComment && !continued) ||
+        (mode_ == Mode::Quoted && !quoted_multiline_ && !continued)) {
+        mode_ = Mode::Code;
+    }
+
+    return comments_;
+}
+
+const char* CommentLexer::LexCode(const std::string_view line,
+                                  const char* const position) {
+    const char* const begin{line.data()};
+    const char* const end{line.data() + line.size()};
+    const char character{*position};
+
+    // Lua block comments and long strings share their brackets, which can
+    // carry any number of '=', so they are matched before anything else
+    if (syntax_.long_brackets) {
+        const bool comment{StartsWith(position, end, syntax_.line_comment)};
+        const char* const bracket{comment ? position + 2 : position};
+        std::size_t level{0};
+        if (const std::size_t length{
+                bracket < end ? LongBracketLength(bracket, end, level) : 0};
+            length != 0) {
+            closing_.assign("]");
+            closing_.append(level, '=');
+            closing_.push_back(']');
+            mode_ = Mode::Delimited;
+            delimited_escapes_ = false;
+            in_docstring_ = comment;
+            if (comment) {
+                this->MarkComment(position, bracket + length);
+            }
+            return bracket + length;
+        } else if (character == '[') {
+            return position + 1;
+        }
+    }
+
+    if (StartsWith(position, end, syntax_.line_comment) &&
+        (!syntax_.word_start_comments || StartsWord(line, position))) {
+        this->MarkComment(position, end);
+        if (syntax_.line_continuation) {
+            mode_ = Mode::LineComment;
+        }
+        return nullptr;
+    }
+
+    if (StartsWith(position, end, syntax_.block_open)) {
+        this->MarkComment(position, position + syntax_.block_open.size());
+        mode_ = Mode::BlockComment;
+        depth_ = 1;
+        return position + syntax_.block_open.size();
+    }
+
+    switch (character) {
+        case '/':
+            if (syntax_.regex_literals && CanStartRegex(line, position)) {
+                if (const char* const after{SkipRegexLiteral(position, end)}) {
+                    return after;
+                }
+            }
+            return position + 1;
+
+        case '\\':
+            // a Zig \\ line is a string running to the end of the line
+            if (syntax_.zig_multiline && position + 1 < end &&
+                position[1] == '\\') {
+                return end;
+            }
+            return position + 1;
+
+        case '`':
+            if (syntax_.raw_backticks) {
+                closing_.assign("`");
+                mode_ = Mode::Delimited;
+                delimited_escapes_ = false;
+                in_docstring_ = false;
+                return position + 1;
+            }
+            if (syntax_.backtick_strings) {
+                mode_ = Mode::Quoted;
+                quote_ = '`';
+                quoted_multiline_ = true;
+                return position + 1;
+            }
+            // otherwise a quote like any other, as in language files
+            break;
+
+        default:
+            break;
+    }
+
+    // the first byte of a comment marker that did not start a comment
+    if (StartsMarker(syntax_.line_comment, character) ||
+        StartsMarker(syntax_.block_open, character)) {
+        return position + 1;
+    }
+
+    if (syntax_.triple_quotes && end - position >= 3 &&
+        position[1] == character && position[2] == character) {
+        // a triple quoted string that starts a statement is a docstring
+        const char* before{position};
+        while (before != begin && std::string_view{"rRbBuUfF"}.find(
+                                      before[-1]) != std::string_view::npos) {
+            before--;
+        }
+        in_docstring_ =
+            syntax_.docstrings && std::all_of(begin, before, IsSpace);
+        if (in_docstring_) {
+            this->MarkComment(position, position + 3);
+        }
+        mode_ = Mode::Delimited;
+        closing_.assign(3, character);
+        delimited_escapes_ = true;
+        return position + 3;
+    }
+
+    if (character == '\'' && syntax_.char_literals) {
+        if (syntax_.cpp_raw_strings && position != begin &&
+            IsDigit(position[-1])) {
+            // C++14 digit separator
+            return position + 1;
+        }
+        if (syntax_.rust_raw_strings && position + 1 < end &&
+            position[1] != '\\') {
+            // a Rust lifetime unless the quote closes within one character
+            const char* const limit{std::min(end, position + 6)};
+            const char* closing{std::find(position + 2, limit, '\'')};
+            const bool ascii{static_cast<unsigned char>(position[1]) < 0x80};
+            if (closing == limit || (ascii && closing != position + 2)) {
+                return position + 1;
+            }
+            return closing + 1;
+        }
+    }
+
+    if (character == '"' && position != begin) {
+        const char previous{position[-1]};
+
+        if (syntax_.verbatim_strings &&
+            (previous == '@' ||
+             (previous == '$' && position - begin >= 2 &&
+              position[-2] == '@'))) {
+            mode_ = Mode::Verbatim;
+            return position + 1;
+        }
+
+        if (syntax_.cpp_raw_strings && previous == 'R') {
+            const char* prefix{position - 1};
+            while (prefix != begin &&
+                   keyword_matching::IsWordCharacter(prefix[-1])) {
+                prefix--;
+            }
+            const std::string_view encoding{prefix, position};
+            const char* const limit{
+                std::min(end, position + 1 + max_raw_delimiter + 1)};
+            const char* const open{std::find(position + 1, limit, '(')};
+
+            if ((encoding == "R" || encoding == "u8R" || encoding == "uR" ||
+                 encoding == "UR" || encoding == "LR") &&
+                open != limit) {
+                closing_.assign(")");
+                closing_.append(position + 1, open);
+                closing_.push_back('"');
+                mode_ = Mode::Delimited;
+                delimited_escapes_ = false;
+                in_docstring_ = false;
+                return open + 1;
+            }
+        }
+
+        if (syntax_.rust_raw_strings) {
+            const char* hashes{position};
+            while (hashes != begin && hashes[-1] == '#') {
+                hashes--;
+            }
+            const char* const marker{hashes - 1};
+            if (hashes != begin && *marker == 'r' &&
+                (marker == begin ||
+                 !keyword_matching::IsWordCharacter(marker[-1]) ||
+                 (marker[-1] == 'b' &&
+                  (marker - 1 == begin ||
+                   !keyword_matching::IsWordCharacter(marker[-2]))))) {
+                closing_.assign("\"");
+                closing_.append(hashes, position);
+                mode_ = Mode::Delimited;
+                delimited_escapes_ = false;
+                in_docstring_ = false;
+                return position + 1;
+            }
+        }
+    }
+
+    mode_ = Mode::Quoted;
+    quote_ = character;
+    // without character literals every quote makes a string
+    quoted_multiline_ = syntax_.multiline_strings &&
+                        (character == '"' || !syntax_.char_literals);
+    return position + 1;
+}
+
+const char* CommentLexer::LexBlockComment(const char* position,
+                                          const char* const end) {
+    const char* const segment{position};
+    const byte_scanner::ByteSet delimiters{
+        {syntax_.block_close.front(), syntax_.block_open.front()}, 2};
+
+    while (true) {
+        const char* const candidate{
+            syntax_.nested_blocks
+                ? byte_scanner::FindAnyByte(position, end, delimiters)
+                : byte_scanner::FindByte(position, end,
+                                         syntax_.block_close.front())};
+        if (candidate == end) {
+            this->MarkComment(segment, end);
+            return end;
+        }
+
+        if (StartsWith(candidate, end, syntax_.block_close)) {
+            position = candidate + syntax_.block_close.size();
+            if (--depth_ == 0) {
+                this->MarkComment(segment, position);
+                mode_ = Mode::Code;
+                return position;
+            }
+        } else if (syntax_.nested_blocks &&
+                   StartsWith(candidate, end, syntax_.block_open)) {
+            depth_++;
+            position = candidate + syntax_.block_open.size();
+        } else {
+            position = candidate + 1;
+        }
+    }
+}
+
+const char* CommentLexer::LexQuoted(const char* position,
+                                    const char* const end) {
+    const byte_scanner::ByteSet delimiters{{quote_, '\\'}, 2};
+
+    while (true) {
+        const char* const candidate{
+            byte_scanner::FindAnyByte(position, end, delimiters)};
+        if (candidate == end) {
+            return end;
+        } else if (*candidate == '\\') {
+            position = std::min(candidate + 2, end);
+        } else {
+            mode_ = Mode::Code;
+            return candidate + 1;
+        }
+    }
+}
+
+const char* CommentLexer::LexDelimited(const char* position,
+                                       const char* const end) {
+    const char* const segment{position};
+    const byte_scanner::ByteSet delimiters{{closing_.front(), '\\'}, 2};
+
+    while (true) {
+        const char* const candidate{
+            delimited_escapes_
+                ? byte_scanner::FindAnyByte(position, end, delimiters)
+                : byte_scanner::FindByte(position, end, closing_.front())};
+        if (candidate == end) {
+            if (in_docstring_) {
+                this->MarkComment(segment, end);
+            }
+            return end;
+        }
+
+        if (delimited_escapes_ && *candidate == '\\') {
+            position = std::min(candidate + 2, end);
+        } else if (StartsWith(candidate, end, closing_)) {
+            position = candidate + closing_.size();
+            if (in_docstring_) {
+                this->MarkComment(segment, position);
+            }
+            in_docstring_ = false;
+            mode_ = Mode::Code;
+            return position;
+        } else {
+            position = candidate + 1;
+        }
+    }
+}
+
+const char* CommentLexer::LexVerbatim(const char* position,
+                                      const char* const end) {
+    while (true) {
+        const char* const candidate{byte_scanner::FindByte(position, end, '"')};
+        if (candidate == end) {
+            return end;
+        } else if (candidate + 1 < end && candidate[1] == '"') {
+            position = candidate + 2;
+        } else {
+            mode_ = Mode::Code;
+            return candidate + 1;
+        }
+    }
+}
+
+/*
+ * An opening delimiter and the text lexed after it are marked separately,
+ * and are joined back into one comment here.
+ */
+void CommentLexer::MarkComment(const char* const begin, const char* const end) {
+    if (!comments_.empty() &&
+        comments_.back().data() + comments_.back().size() == begin) {
+        comments_.back() = std::string_view{comments_.back().data(), end};
+    } else {
+        comments_.emplace_back(begin, end);
+    }
+}
+
+}  // namespace comment_lexing
@@ -0,0 +1,129 @@
+/*
+ *  directory_walker.cpp - readdir based directory enumeration
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/directory_walker.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+namespace directory_walking {
+
+#if !defined(_WIN32)
+namespace {
+EntryKind KindFromStat(DIR* directory, const char* name) {
+    struct stat entry_info{};
+    if (fstatat(dirfd(directory), name, &entry_info, AT_SYMLINK_NOFOLLOW) !=
+        0) {
+        return EntryKind::Other;
+    } else if (S_ISREG(entry_info.st_mode)) {
+        return EntryKind::File;
+    } else if (S_ISDIR(entry_info.st_mode)) {
+        return EntryKind::Directory;
+    } else {
+        return EntryKind::Other;
+    }
+}
+}  // namespace
+
+DirectoryStream::DirectoryStream(const std::filesystem::path& directory)
+    : DirectoryStream{directory.native()} {}
+
+DirectoryStream::DirectoryStream(const std::string& directory)
+    : handle_{opendir(directory.c_str())} {}
+
+DirectoryStream::~DirectoryStream() {
+    if (handle_ != nullptr) {
+        closedir(static_cast<DIR*>(handle_));
+    }
+}
+
+bool DirectoryStream::IsOpen() const { return handle_ != nullptr; }
+
+std::optional<Entry> DirectoryStream::Next() {
+    DIR* directory{static_cast<DIR*>(handle_)};
+
+    while (const dirent* entry{readdir(directory)}) {
+        const std::string_view name{entry->d_name};
+        if (name == "." || name == "..") {
+            continue;
+        }
+
+        switch (entry->d_type) {
+            case DT_REG:
+                return Entry{name, EntryKind::File};
+            case DT_DIR:
+                return Entry{name, EntryKind::Directory};
+            case DT_UNKNOWN:
+                return Entry{name, KindFromStat(directory, entry->d_name)};
+            default:
+                return Entry{name, EntryKind::Other};
+        }
+    }
+
+    return std::nullopt;
+}
+#else
+DirectoryStream::DirectoryStream(const std::filesystem::path& directory) {
+    std::error_code error{};
+    iterator_ = std::filesystem::directory_iterator{directory, error};
+    open_ = !error;
+}
+
+DirectoryStream::DirectoryStream(const std::string& directory)
+    : DirectoryStream{std::filesystem::path{directory}} {}
+
+DirectoryStream::~DirectoryStream() = default;
+
+bool DirectoryStream::IsOpen() const { return open_; }
+
+std::optional<Entry> DirectoryStream::Next() {
+    std::error_code error{};
+    if (iterator_ == std::filesystem::directory_iterator{}) {
+        return std::nullopt;
+    }
+
+    const std::filesystem::directory_entry& entry{*iterator_};
+    EntryKind kind{EntryKind::Other};
+    if (entry.is_symlink(error)) {
+        kind = EntryKind::Other;
+    } else if (entry.is_regular_file(error)) {
+        kind = EntryKind::File;
+    } else if (entry.is_directory(error)) {
+        kind = EntryKind::Directory;
+    }
+
+    current_name_ = entry.path().filename().string();
+    iterator_.increment(error);
+    if (error) {
+        iterator_ = std::filesystem::directory_iterator{};
+    }
+
+    return Entry{current_name_, kind};
+}
+#endif
+
+}  // namespace directory_walking
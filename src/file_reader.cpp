@@ -0,0 +1,223 @@
+/*
+ *  file_reader.cpp - mmap and scratch-buffer backed file loading
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/file_reader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace file_io {
+
+FileReader::~FileReader() { this->Unmap(); }
+
+void FileReader::Unmap() {
+#if !defined(_WIN32)
+    if (mapping_ != nullptr) {
+        munmap(mapping_, mapping_size_);
+    }
+#endif
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+}
+
+std::shared_ptr<const void> FileReader::Keep() {
+#if !defined(_WIN32)
+    if (mapping_ != nullptr) {
+        std::shared_ptr<const void> mapping{
+            mapping_, [size = mapping_size_](const void* memory) {
+                munmap(const_cast<void*>(memory), size);
+            }};
+        mapping_ = nullptr;
+        mapping_size_ = 0;
+        return mapping;
+    }
+#endif
+    scratch_capacity_ = 0;
+    return std::shared_ptr<const void>{
+        scratch_.release(),
+        [](const void* memory) { delete[] static_cast<const char*>(memory); }};
+}
+
+bool FileReader::ReserveScratch(const std::size_t size) {
+    if (size <= scratch_capacity_) {
+        return true;
+    }
+
+    std::size_t capacity{scratch_capacity_ == 0 ? 4096 : scratch_capacity_};
+    while (capacity < size) {
+        capacity *= 2;
+    }
+
+    std::unique_ptr<char[]> grown{new (std::nothrow) char[capacity]};
+    if (!grown) {
+        return false;
+    }
+
+    if (scratch_capacity_ != 0) {
+        std::memcpy(grown.get(), scratch_.get(), scratch_capacity_);
+    }
+    scratch_ = std::move(grown);
+    scratch_capacity_ = capacity;
+    return true;
+}
+
+#if !defined(_WIN32)
+std::optional<std::string_view> FileReader::Load(
+    const std::filesystem::path& file) {
+    return this->Load(file.native());
+}
+
+std::optional<std::string_view> FileReader::Load(const std::string& file) {
+    this->Unmap();
+
+    const int descriptor{open(file.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (descriptor < 0) {
+        return std::nullopt;
+    }
+
+    struct stat file_info{};
+    if (fstat(descriptor, &file_info) != 0 || !S_ISREG(file_info.st_mode)) {
+        close(descriptor);
+        return std::nullopt;
+    }
+
+    const std::size_t size{static_cast<std::size_t>(file_info.st_size)};
+
+    if (size > small_file_limit) {
+        if (void* mapping{
+                mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0)};
+            mapping != MAP_FAILED) [[likely]] {
+            close(descriptor);
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            mapping_ = mapping;
+            mapping_size_ = size;
+            return std::string_view{static_cast<const char*>(mapping), size};
+        }
+    }
+
+    if (!this->ReserveScratch(size)) {
+        close(descriptor);
+        return std::nullopt;
+    }
+
+    std::size_t filled{0};
+    while (filled < size) {
+        const ssize_t count{
+            read(descriptor, scratch_.get() + filled, size - filled)};
+        if (count <= 0) {
+            break;
+        }
+        filled += static_cast<std::size_t>(count);
+    }
+
+    close(descriptor);
+    return std::string_view{scratch_.get(), filled};
+}
+
+bool FileReader::ReadSmall(const std::string& file, std::string& contents) {
+    const int descriptor{open(file.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (descriptor < 0) {
+        return false;
+    }
+
+    struct stat file_info{};
+    if (fstat(descriptor, &file_info) != 0 || !S_ISREG(file_info.st_mode) ||
+        static_cast<std::size_t>(file_info.st_size) > small_file_limit) {
+        close(descriptor);
+        return false;
+    }
+
+    contents.resize(static_cast<std::size_t>(file_info.st_size));
+    std::size_t filled{0};
+    while (filled < contents.size()) {
+        const ssize_t count{read(descriptor, contents.data() + filled,
+                                 contents.size() - filled)};
+        if (count <= 0) {
+            break;
+        }
+        filled += static_cast<std::size_t>(count);
+    }
+
+    close(descriptor);
+    contents.resize(filled);
+    return true;
+}
+#else
+std::optional<std::string_view> FileReader::Load(
+    const std::filesystem::path& file) {
+    std::FILE* stream{_wfopen(file.c_str(), L"rb")};
+    if (stream == nullptr) {
+        return std::nullopt;
+    }
+
+    std::size_t filled{0};
+    for (std::size_t count{1}; count != 0; filled += count) {
+        if (filled == scratch_capacity_ &&
+            !this->ReserveScratch(scratch_capacity_ + 1)) {
+            std::fclose(stream);
+            return std::nullopt;
+        }
+        count = std::fread(scratch_.get() + filled, 1,
+                           scratch_capacity_ - filled, stream);
+    }
+
+    std::fclose(stream);
+    return std::string_view{scratch_.get(), filled};
+}
+
+std::optional<std::string_view> FileReader::Load(const std::string& file) {
+    return this->Load(std::filesystem::path{file});
+}
+
+bool FileReader::ReadSmall(const std::string& file, std::string& contents) {
+    std::error_code error{};
+    const std::filesystem::path path{file};
+    const std::uintmax_t size{std::filesystem::file_size(path, error)};
+    if (error || size > small_file_limit) {
+        return false;
+    }
+
+    std::FILE* stream{_wfopen(path.c_str(), L"rb")};
+    if (stream == nullptr) {
+        return false;
+    }
+    contents.resize(static_cast<std::size_t>(size));
+    contents.resize(std::fread(contents.data(), 1, contents.size(), stream));
+    std::fclose(stream);
+    return true;
+}
+#endif
+
+}  // namespace file_io
@@ -0,0 +1,1254 @@
+/*
+ *  git_repository.cpp - Reading git repositories straight from .git
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/git_repository.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "include/file_reader.hpp"
+#include "include/inflate.hpp"
+#include "include/scan_cache.hpp"
+
+namespace git_reading {
+namespace {
+constexpr std::size_t id_size{std::tuple_size_v<ObjectId>};
+
+// the type bits of a mode, as stored in trees and the index
+constexpr std::uint32_t mode_type_mask{0170000};
+constexpr std::uint32_t mode_directory{0040000};
+constexpr std::uint32_t mode_regular{0100000};
+
+// pack entry types past the four object types
+constexpr std::uint8_t offset_delta{6};
+constexpr std::uint8_t reference_delta{7};
+
+/*
+ * git itself refuses to build delta chains anywhere near this long.
+ */
+constexpr std::size_t max_delta_depth{10000};
+
+// pack index version 2: magic, version, fanout, then the sorted names
+constexpr std::string_view pack_index_magic{"\377tOc"};
+constexpr std::size_t pack_index_names{8 + 256 * 4};
+
+// each thread checks at least this many index entries against the disk
+constexpr std::size_t entries_per_thread{1024};
+
+std::uint32_t ReadBigEndian(const std::string_view bytes,
+                            const std::size_t offset, const std::size_t size) {
+    std::uint32_t value{0};
+    for (std::size_t index{0}; index < size; ++index) {
+        value = value << 8 |
+                static_cast<unsigned char>(bytes[offset + index]);
+    }
+    return value;
+}
+
+std::string_view Trim(std::string_view text) {
+    while (!text.empty() &&
+           std::isspace(static_cast<unsigned char>(text.front()))) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() &&
+           std::isspace(static_cast<unsigned char>(text.back()))) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+std::optional<std::string> ReadText(const std::filesystem::path& file) {
+    std::error_code error{};
+    if (!std::filesystem::is_regular_file(file, error)) {
+        return std::nullopt;
+    }
+    std::ifstream input{file, std::ios::binary};
+    std::string text{std::istreambuf_iterator<char>{input},
+                     std::istreambuf_iterator<char>{}};
+    if (input.bad()) {
+        return std::nullopt;
+    }
+    return text;
+}
+
+std::optional<std::uint8_t> HexDigit(const char digit) {
+    if (digit >= '0' && digit <= '9') {
+        return static_cast<std::uint8_t>(digit - '0');
+    } else if (digit >= 'a' && digit <= 'f') {
+        return static_cast<std::uint8_t>(digit - 'a' + 10);
+    } else if (digit >= 'A' && digit <= 'F') {
+        return static_cast<std::uint8_t>(digit - 'A' + 10);
+    }
+    return std::nullopt;
+}
+
+bool IsHex(const std::string_view text) {
+    return std::ranges::all_of(
+        text, [](const char digit) { return HexDigit(digit).has_value(); });
+}
+
+/*
+ * Exactly one full object name, as refs and commits spell them.
+ */
+std::optional<ObjectId> ParseHex(const std::string_view hex) {
+    if (hex.size() != id_size * 2 || !IsHex(hex)) {
+        return std::nullopt;
+    }
+    ObjectId id{};
+    for (std::size_t index{0}; index < id_size; ++index) {
+        id[index] = static_cast<std::uint8_t>(
+            HexDigit(hex[index * 2]).value() << 4 |
+            HexDigit(hex[index * 2 + 1]).value());
+    }
+    return id;
+}
+
+/*
+ * The value of the header line starting with key in a commit or tag, up to
+ * the blank line before the message.
+ */
+std::vector<std::string_view> HeaderValues(std::string_view object,
+                                           const std::string_view key) {
+    std::vector<std::string_view> values{};
+    while (!object.empty()) {
+        const std::size_t end{object.find('\n')};
+        const std::string_view line{object.substr(0, end)};
+        if (line.empty()) {
+            break;
+        } else if (line.size() > key.size() && line.starts_with(key) &&
+                   line[key.size()] == ' ') {
+            values.push_back(line.substr(key.size() + 1));
+        }
+        object.remove_prefix(end == std::string_view::npos ? object.size()
+                                                           : end + 1);
+    }
+    return values;
+}
+
+std::optional<ObjectType> ParseType(const std::string_view name) {
+    if (name == "commit") {
+        return ObjectType::Commit;
+    } else if (name == "tree") {
+        return ObjectType::Tree;
+    } else if (name == "blob") {
+        return ObjectType::Blob;
+    } else if (name == "tag") {
+        return ObjectType::Tag;
+    }
+    return std::nullopt;
+}
+
+std::string_view PackedName(const std::string_view index,
+                            const std::size_t position) {
+    return index.substr(pack_index_names + position * id_size, id_size);
+}
+
+std::string_view IdBytes(const ObjectId& id) {
+    return {reinterpret_cast<const char*>(id.data()), id.size()};
+}
+
+/*
+ * The first position in a version 2 pack index whose name is not below id,
+ * searching only names that share its first byte.
+ */
+std::size_t PackLowerBound(const std::string_view index, const ObjectId& id) {
+    std::size_t first{
+        id[0] == 0 ? 0 : ReadBigEndian(index, 8 + (id[0] - 1u) * 4, 4)};
+    std::size_t last{ReadBigEndian(index, 8 + id[0] * 4u, 4)};
+    while (first < last) {
+        const std::size_t middle{first + (last - first) / 2};
+        if (PackedName(index, middle) < IdBytes(id)) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return first;
+}
+
+std::optional<std::uint64_t> PackOffset(const std::string_view index,
+                                        const std::size_t count,
+                                        const ObjectId& id) {
+    const std::size_t position{PackLowerBound(index, id)};
+    if (position >= count || PackedName(index, position) != IdBytes(id)) {
+        return std::nullopt;
+    }
+
+    // names are followed by a CRC and then an offset for every object;
+    // offsets past 2 GiB live in a table of their own after those
+    const std::size_t offsets{pack_index_names + count * (id_size + 4)};
+    const std::uint32_t offset{ReadBigEndian(index, offsets + position * 4, 4)};
+    if ((offset & 0x80000000u) == 0) {
+        return offset;
+    }
+    const std::size_t large{offsets + count * 4 +
+                            (offset & 0x7fffffffu) * std::size_t{8}};
+    if (large + 8 > index.size() - 2 * id_size) {
+        return std::nullopt;
+    }
+    return std::uint64_t{ReadBigEndian(index, large, 4)} << 32 |
+           ReadBigEndian(index, large + 4, 4);
+}
+
+/*
+ * Rebuilds an object from its delta base (see git's pack-format
+ * documentation): two sizes, then instructions that either copy a range of
+ * the base or insert the bytes that follow them.
+ */
+bool ApplyDelta(const std::string_view base, const std::string_view delta,
+                std::string& output) {
+    std::size_t position{0};
+    const auto read_size{[&]() -> std::optional<std::uint64_t> {
+        std::uint64_t size{0};
+        for (unsigned shift{0}; position < delta.size() && shift < 64;
+             shift += 7) {
+            const auto byte{static_cast<unsigned char>(delta[position++])};
+            size |= std::uint64_t{byte & 0x7fu} << shift;
+            if ((byte & 0x80) == 0) {
+                return size;
+            }
+        }
+        return std::nullopt;
+    }};
+
+    const std::optional<std::uint64_t> base_size{read_size()};
+    const std::optional<std::uint64_t> result_size{read_size()};
+    if (!base_size.has_value() || !result_size.has_value() ||
+        base_size.value() != base.size()) {
+        return false;
+    }
+
+    output.clear();
+    output.reserve(static_cast<std::size_t>(result_size.value()));
+    while (position < delta.size()) {
+        const auto instruction{static_cast<unsigned char>(delta[position++])};
+        if ((instruction & 0x80) != 0) {
+            std::size_t copy_offset{0};
+            std::size_t copy_size{0};
+            for (unsigned byte{0}; byte < 7; ++byte) {
+                if ((instruction & (1u << byte)) == 0) {
+                    continue;
+                } else if (position >= delta.size()) {
+                    return false;
+                }
+                const std::size_t value{
+                    static_cast<unsigned char>(delta[position++])};
+                if (byte < 4) {
+                    copy_offset |= value << (8 * byte);
+                } else {
+                    copy_size |= value << (8 * (byte - 4));
+                }
+            }
+            if (copy_size == 0) {
+                copy_size = 0x10000;
+            }
+            if (copy_offset > base.size() ||
+                base.size() - copy_offset < copy_size) {
+                return false;
+            }
+            output.append(base.substr(copy_offset, copy_size));
+        } else if (instruction != 0) {
+            if (delta.size() - position < instruction) {
+                return false;
+            }
+            output.append(delta.substr(position, instruction));
+            position += instruction;
+        } else {
+            return false;
+        }
+    }
+    return output.size() == result_size.value();
+}
+
+/*
+ * The TREE extension of the index: for every directory, its name, how many
+ * index entries it covers (-1 once a change has made the cached tree
+ * stale), how many subdirectories follow, and the tree's name if it is
+ * still valid. Directories follow their parent depth first.
+ */
+bool ParseCachedTree(std::string_view& data, const std::string& parent,
+                     std::unordered_map<std::string, ObjectId>& trees) {
+    const std::size_t name_end{data.find('\0')};
+    const std::size_t line_end{data.find('\n', name_end)};
+    if (line_end == std::string_view::npos) {
+        return false;
+    }
+    const std::string_view name{data.substr(0, name_end)};
+    const std::string_view counts{
+        data.substr(name_end + 1, line_end - name_end - 1)};
+    data.remove_prefix(line_end + 1);
+
+    const std::size_t separator{counts.find(' ')};
+    if (separator == std::string_view::npos) {
+        return false;
+    }
+    int entry_count{0};
+    std::size_t subtree_count{0};
+    const auto [entries_end, entries_error]{std::from_chars(
+        counts.data(), counts.data() + separator, entry_count)};
+    const auto [subtrees_end, subtrees_error]{
+        std::from_chars(counts.data() + separator + 1,
+                        counts.data() + counts.size(), subtree_count)};
+    if (entries_error != std::errc{} || subtrees_error != std::errc{}) {
+        return false;
+    }
+
+    const std::string path{parent.empty() ? std::string{name}
+                                          : parent + "/" + std::string{name}};
+    if (entry_count >= 0) {
+        if (data.size() < id_size) {
+            return false;
+        }
+        ObjectId id{};
+        std::memcpy(id.data(), data.data(), id_size);
+        trees.insert_or_assign(path, id);
+        data.remove_prefix(id_size);
+    }
+
+    for (std::size_t subtree{0}; subtree < subtree_count; ++subtree) {
+        if (!ParseCachedTree(data, path, trees)) {
+            return false;
+        }
+    }
+    return true;
+}
+}  // namespace
+
+std::string ToHex(const ObjectId& id) {
+    constexpr std::string_view digits{"0123456789abcdef"};
+    std::string hex{};
+    hex.reserve(id.size() * 2);
+    for (const std::uint8_t byte : id) {
+        hex.push_back(digits[byte >> 4]);
+        hex.push_back(digits[byte & 0xf]);
+    }
+    return hex;
+}
+
+/*
+ * A pack is known by its index from the start; the pack itself is only
+ * opened once an object is read from it.
+ */
+struct Repository::Pack {
+    std::filesystem::path pack_file{};
+    std::shared_ptr<const void> index_memory{};
+    std::string_view index{};
+    std::size_t object_count{0};
+    bool opened{false};
+    std::shared_ptr<const void> pack_memory{};
+    std::string_view pack{};
+};
+
+struct Repository::IndexEntry {
+    std::string path{};
+    ObjectId id{};
+    std::uint32_t mode{0};
+    // the stat data recorded when the entry was last refreshed, cut down
+    // to 32 bits the way the index stores it
+    std::uint32_t modified_seconds{0};
+    std::uint32_t modified_nanoseconds{0};
+    std::uint32_t inode{0};
+    std::uint32_t size{0};
+    // staged in more than one version during a merge
+    bool conflicted{false};
+    // left out of a sparse checkout
+    bool skip_worktree{false};
+    // added with git add -N, so its id is no content yet
+    bool intent_to_add{false};
+    // set when the base tree has a file at path, with its blob
+    bool in_base{false};
+    ObjectId base{};
+};
+
+Repository::Repository(const std::filesystem::path& directory) {
+    std::error_code error{};
+    std::filesystem::path current{std::filesystem::canonical(directory, error)};
+    if (error) {
+        throw std::runtime_error{
+            std::format("Could not open directory {}", directory.string())};
+    }
+
+    while (true) {
+        const std::filesystem::path dot_git{current / ".git"};
+        if (std::filesystem::is_directory(dot_git, error)) {
+            git_directory_ = dot_git;
+            break;
+        } else if (std::filesystem::is_regular_file(dot_git, error)) {
+            // linked worktrees and submodules point at their git directory
+            const std::string link{ReadText(dot_git).value_or("")};
+            const std::string_view line{Trim(link)};
+            if (!line.starts_with("gitdir:")) {
+                throw std::runtime_error{std::format(
+                    "{} does not point at a git directory", dot_git.string())};
+            }
+            git_directory_ =
+                (current / std::filesystem::path{Trim(line.substr(7))})
+                    .lexically_normal();
+            break;
+        } else if (!current.has_relative_path()) {
+            throw std::runtime_error{std::format(
+                "{} is not inside a git working tree", directory.string())};
+        }
+        current = current.parent_path();
+    }
+    work_tree_ = current;
+
+    common_directory_ = git_directory_;
+    if (const std::optional<std::string> common{
+            ReadText(git_directory_ / "commondir")}) {
+        common_directory_ =
+            (git_directory_ / std::filesystem::path{Trim(common.value())})
+                .lexically_normal();
+    }
+
+    if (const std::optional<std::string> config{
+            ReadText(common_directory_ / "config")}) {
+        std::string lowered{config.value()};
+        std::ranges::transform(lowered, lowered.begin(), [](const char c) {
+            return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        });
+        for (std::string_view text{lowered}; !text.empty();) {
+            const std::size_t end{text.find('\n')};
+            const std::string_view line{Trim(text.substr(0, end))};
+            if (line.starts_with("objectformat") &&
+                line.find("sha256") != std::string_view::npos) {
+                throw std::runtime_error{
+                    "Repositories using SHA-256 object names are not "
+                    "supported"};
+            }
+            text.remove_prefix(end == std::string_view::npos ? text.size()
+                                                             : end + 1);
+        }
+    }
+
+    // alternates may list alternates of their own
+    object_directories_.push_back(common_directory_ / "objects");
+    for (std::size_t index{0}; index < object_directories_.size(); ++index) {
+        const std::string alternates{
+            ReadText(object_directories_[index] / "info" / "alternates")
+                .value_or("")};
+        for (std::string_view text{alternates}; !text.empty();) {
+            const std::size_t end{text.find('\n')};
+            const std::string_view line{Trim(text.substr(0, end))};
+            text.remove_prefix(end == std::string_view::npos ? text.size()
+                                                             : end + 1);
+            if (line.empty() || line.starts_with('#')) {
+                continue;
+            }
+            const std::filesystem::path alternate{
+                (object_directories_[index] / std::filesystem::path{line})
+                    .lexically_normal()};
+            if (std::ranges::find(object_directories_, alternate) ==
+                object_directories_.end()) {
+                object_directories_.push_back(alternate);
+            }
+        }
+    }
+
+    for (const std::filesystem::path& objects : object_directories_) {
+        for (std::filesystem::directory_iterator entry{objects / "pack", error};
+             !error && entry != std::filesystem::directory_iterator{};
+             entry.increment(error)) {
+            if (entry->path().extension() != ".idx") {
+                continue;
+            }
+
+            file_io::FileReader reader{};
+            const std::optional<std::string_view> index{
+                reader.Load(entry->path())};
+            if (!index.has_value() ||
+                index->size() < pack_index_names + 2 * id_size ||
+                !index->starts_with(pack_index_magic) ||
+                ReadBigEndian(index.value(), 4, 4) != 2) {
+                continue;
+            }
+            const std::size_t count{
+                ReadBigEndian(index.value(), pack_index_names - 4, 4)};
+            if (index->size() <
+                pack_index_names + count * (id_size + 8) + 2 * id_size) {
+                continue;
+            }
+
+            auto pack{std::make_unique<Pack>()};
+            pack->pack_file = entry->path();
+            pack->pack_file.replace_extension(".pack");
+            pack->index = index.value();
+            pack->index_memory = reader.Keep();
+            pack->object_count = count;
+            packs_.push_back(std::move(pack));
+        }
+        error.clear();
+    }
+}
+
+Repository::~Repository() = default;
+
+const std::filesystem::path& Repository::WorkTree() const {
+    return work_tree_;
+}
+
+bool Repository::ReadBlob(const ObjectId& id, std::string& contents) {
+    ObjectType type{};
+    return this->ReadObject(id, type, contents) && type == ObjectType::Blob;
+}
+
+bool Repository::ReadObject(const ObjectId& id, ObjectType& type,
+                            std::string& data) {
+    for (const std::unique_ptr<Pack>& pack : packs_) {
+        if (const std::optional<std::uint64_t> offset{
+                PackOffset(pack->index, pack->object_count, id)}) {
+            return this->ReadPackedObject(*pack, offset.value(), type, data);
+        }
+    }
+    return this->ReadLooseObject(id, type, data);
+}
+
+bool Repository::ReadLooseObject(const ObjectId& id, ObjectType& type,
+                                 std::string& data) {
+    const std::string hex{ToHex(id)};
+    file_io::FileReader reader{};
+    for (const std::filesystem::path& objects : object_directories_) {
+        const std::optional<std::string_view> compressed{
+            reader.Load(objects / hex.substr(0, 2) / hex.substr(2))};
+        if (!compressed.has_value()) {
+            continue;
+        } else if (!inflating::InflateZlib(compressed.value(), data)) {
+            return false;
+        }
+
+        // "type size\0" and then the object
+        const std::size_t header_end{data.find('\0')};
+        const std::size_t separator{data.find(' ')};
+        if (header_end == std::string::npos || separator > header_end) {
+            return false;
+        }
+        const std::optional<ObjectType> parsed{
+            ParseType(std::string_view{data}.substr(0, separator))};
+        std::size_t size{0};
+        const auto [size_end, size_error]{
+            std::from_chars(data.data() + separator + 1,
+                            data.data() + header_end, size)};
+        if (!parsed.has_value() || size_error != std::errc{} ||
+            size != data.size() - header_end - 1) {
+            return false;
+        }
+        type = parsed.value();
+        data.erase(0, header_end + 1);
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Follows a chain of deltas down to the whole object at its end, then
+ * applies them in reverse. Offset deltas name a base in the same pack,
+ * reference deltas one anywhere in the repository.
+ */
+bool Repository::ReadPackedObject(Pack& pack, std::uint64_t offset,
+                                  ObjectType& type, std::string& data) {
+    if (!pack.opened) {
+        pack.opened = true;
+        file_io::FileReader reader{};
+        if (const std::optional<std::string_view> contents{
+                reader.Load(pack.pack_file)};
+            contents.has_value() && contents->size() >= 12 + id_size &&
+            contents->starts_with("PACK")) {
+            pack.pack = contents.value();
+            pack.pack_memory = reader.Keep();
+        }
+    }
+    // the pack ends in a checksum of everything before it
+    const std::size_t end{pack.pack.empty() ? 0
+                                            : pack.pack.size() - id_size};
+
+    std::vector<std::string> deltas{};
+    for (std::size_t depth{0};; ++depth) {
+        if (depth > max_delta_depth || offset >= end) {
+            return false;
+        }
+
+        std::size_t position{static_cast<std::size_t>(offset)};
+        auto byte{static_cast<unsigned char>(pack.pack[position++])};
+        const auto kind{static_cast<std::uint8_t>((byte >> 4) & 7)};
+        std::uint64_t size{byte & 0xfu};
+        for (unsigned shift{4}; (byte & 0x80) != 0; shift += 7) {
+            if (position >= end || shift > 57) {
+                return false;
+            }
+            byte = static_cast<unsigned char>(pack.pack[position++]);
+            size |= std::uint64_t{byte & 0x7fu} << shift;
+        }
+
+        if (kind == offset_delta) {
+            // the distance back to the base, with a bias added at every
+            // byte so that no distance has two spellings
+            std::uint64_t distance{0};
+            do {
+                if (position >= end || distance >> 56 != 0) {
+                    return false;
+                }
+                byte = static_cast<unsigned char>(pack.pack[position++]);
+                distance = (distance << 7) | (byte & 0x7fu);
+            } while ((byte & 0x80) != 0 && ++distance != 0);
+            if (distance > offset) {
+                return false;
+            }
+            deltas.emplace_back();
+            if (!inflating::InflateZlib(
+                    pack.pack.substr(position, end - position), deltas.back(),
+                    static_cast<std::size_t>(size))) {
+                return false;
+            }
+            offset -= distance;
+        } else if (kind == reference_delta) {
+            if (end - position < id_size) {
+                return false;
+            }
+            ObjectId base{};
+            std::memcpy(base.data(), pack.pack.data() + position, id_size);
+            position += id_size;
+            deltas.emplace_back();
+            if (!inflating::InflateZlib(
+                    pack.pack.substr(position, end - position), deltas.back(),
+                    static_cast<std::size_t>(size)) ||
+                !this->ReadObject(base, type, data)) {
+                return false;
+            }
+            break;
+        } else if (kind >= 1 && kind <= 4) {
+            if (!inflating::InflateZlib(
+                    pack.pack.substr(position, end - position), data,
+                    static_cast<std::size_t>(size)) ||
+                data.size() != size) {
+                return false;
+            }
+            type = static_cast<ObjectType>(kind);
+            break;
+        } else {
+            return false;
+        }
+    }
+
+    for (auto delta{deltas.rbegin()}; delta != deltas.rend(); ++delta) {
+        if (!ApplyDelta(data, *delta, scratch_)) {
+            return false;
+        }
+        data.swap(scratch_);
+    }
+    return true;
+}
+
+std::optional<ObjectId> Repository::FindAbbreviated(
+    const std::string_view prefix) {
+    std::vector<ObjectId> found{};
+    const auto add{[&found](const ObjectId& id) {
+        if (std::ranges::find(found, id) == found.end()) {
+            found.push_back(id);
+        }
+    }};
+
+    ObjectId lowest{};
+    for (std::size_t index{0}; index < prefix.size(); ++index) {
+        lowest[index / 2] |= static_cast<std::uint8_t>(
+            HexDigit(prefix[index]).value() << (index % 2 == 0 ? 4 : 0));
+    }
+    for (const std::unique_ptr<Pack>& pack : packs_) {
+        for (std::size_t position{PackLowerBound(pack->index, lowest)};
+             position < pack->object_count; ++position) {
+            ObjectId id{};
+            std::memcpy(id.data(), PackedName(pack->index, position).data(),
+                        id_size);
+            if (!ToHex(id).starts_with(prefix)) {
+                break;
+            }
+            add(id);
+        }
+    }
+
+    std::error_code error{};
+    for (const std::filesystem::path& objects : object_directories_) {
+        for (std::filesystem::directory_iterator entry{
+                 objects / std::string{prefix.substr(0, 2)}, error};
+             !error && entry != std::filesystem::directory_iterator{};
+             entry.increment(error)) {
+            const std::string name{entry->path().filename().string()};
+            if (name.starts_with(prefix.substr(2))) {
+                if (const std::optional<ObjectId> id{
+                        ParseHex(std::string{prefix.substr(0, 2)} + name)}) {
+                    add(id.value());
+                }
+            }
+        }
+        error.clear();
+    }
+
+    if (found.size() > 1) {
+        throw std::runtime_error{
+            std::format("Abbreviated object name {} is ambiguous", prefix)};
+    } else if (found.empty()) {
+        return std::nullopt;
+    }
+    return found.front();
+}
+
+/*
+ * Loose refs, HEAD among them, take precedence over packed ones. Refs only
+ * one worktree has (HEAD, ORIG_HEAD and the like) live in its own git
+ * directory; everything else is shared through the common directory.
+ */
+std::optional<ObjectId> Repository::ReadRef(const std::string_view name) {
+    std::string current{name};
+    // symbolic refs may point at symbolic refs, but not in a loop
+    for (std::size_t depth{0}; depth < 8; ++depth) {
+        std::optional<std::string> text{ReadText(git_directory_ / current)};
+        if (!text.has_value() && common_directory_ != git_directory_) {
+            text = ReadText(common_directory_ / current);
+        }
+
+        if (text.has_value()) {
+            const std::string_view line{Trim(text.value())};
+            if (line.starts_with("ref:")) {
+                current = Trim(line.substr(4));
+                continue;
+            }
+            // FETCH_HEAD follows the name with where it was fetched from
+            return ParseHex(line.substr(0, line.find_first_of(" \t\n")));
+        }
+
+        const std::string packed{
+            ReadText(common_directory_ / "packed-refs").value_or("")};
+        for (std::string_view lines{packed}; !lines.empty();) {
+            const std::size_t end{lines.find('\n')};
+            const std::string_view line{Trim(lines.substr(0, end))};
+            lines.remove_prefix(end == std::string_view::npos ? lines.size()
+                                                              : end + 1);
+            if (const std::size_t separator{line.find(' ')};
+                separator != std::string_view::npos && !line.starts_with('#') &&
+                !line.starts_with('^') &&
+                line.substr(separator + 1) == current) {
+                return ParseHex(line.substr(0, separator));
+            }
+        }
+        return std::nullopt;
+    }
+    return std::nullopt;
+}
+
+ObjectId Repository::Peel(ObjectId id, const ObjectType wanted) {
+    std::string object{};
+    ObjectType type{};
+    while (true) {
+        if (!this->ReadObject(id, type, object)) {
+            throw std::runtime_error{
+                std::format("Could not read object {}", ToHex(id))};
+        } else if (type == wanted) {
+            return id;
+        }
+
+        std::vector<std::string_view> next{};
+        if (type == ObjectType::Tag) {
+            next = HeaderValues(object, "object");
+        } else if (type == ObjectType::Commit && wanted == ObjectType::Tree) {
+            next = HeaderValues(object, "tree");
+        }
+        const std::optional<ObjectId> parsed{
+            next.size() == 1 ? ParseHex(next.front()) : std::nullopt};
+        if (!parsed.has_value()) {
+            throw std::runtime_error{std::format(
+                "Object {} is not a {}", ToHex(id),
+                wanted == ObjectType::Commit ? "commit" : "tree")};
+        }
+        id = parsed.value();
+    }
+}
+
+std::vector<ObjectId> Repository::Parents(const ObjectId& commit) {
+    std::string object{};
+    ObjectType type{};
+    if (!this->ReadObject(commit, type, object) ||
+        type != ObjectType::Commit) {
+        throw std::runtime_error{
+            std::format("Could not read commit {}", ToHex(commit))};
+    }
+
+    std::vector<ObjectId> parents{};
+    for (const std::string_view parent : HeaderValues(object, "parent")) {
+        if (const std::optional<ObjectId> id{ParseHex(parent)}) {
+            parents.push_back(id.value());
+        }
+    }
+    return parents;
+}
+
+/*
+ * Names are looked up the way git does: as given (HEAD, FETCH_HEAD or a
+ * full ref), then under refs, refs/tags, refs/heads and refs/remotes, and
+ * as a remote's default branch. A full hex name is taken as is; a shorter
+ * one only when no ref has that name.
+ */
+ObjectId Repository::ResolveCommit(const std::string_view revision) {
+    const std::size_t name_end{revision.find_first_of("~^")};
+    std::string_view name{revision.substr(0, name_end)};
+    if (name == "@") {
+        name = "HEAD";
+    }
+
+    std::optional<ObjectId> id{std::nullopt};
+    if (name.empty()) {
+        id = std::nullopt;
+    } else if (name.size() == id_size * 2 && IsHex(name)) {
+        id = ParseHex(name);
+    } else {
+        constexpr std::array<std::pair<std::string_view, std::string_view>, 6>
+            rules{{
+                {"", ""},
+                {"refs/", ""},
+                {"refs/tags/", ""},
+                {"refs/heads/", ""},
+                {"refs/remotes/", ""},
+                {"refs/remotes/", "/HEAD"},
+            }};
+        for (const auto& [before, after] : rules) {
+            std::string ref{before};
+            ref.append(name).append(after);
+            id = this->ReadRef(ref);
+            if (id.has_value()) {
+                break;
+            }
+        }
+        if (!id.has_value() && name.size() >= 4 && IsHex(name)) {
+            id = this->FindAbbreviated(name);
+        }
+    }
+    if (!id.has_value()) {
+        throw std::runtime_error{std::format("Unknown revision {}", name)};
+    }
+
+    ObjectId commit{this->Peel(id.value(), ObjectType::Commit)};
+    std::string_view steps{name_end == std::string_view::npos
+                               ? std::string_view{}
+                               : revision.substr(name_end)};
+    while (!steps.empty()) {
+        const char step{steps.front()};
+        steps.remove_prefix(1);
+        std::size_t count{1};
+        const std::size_t digits{std::min(steps.find_first_not_of("0123456789"),
+                                          steps.size())};
+        if (digits != 0) {
+            const auto [count_end, count_error]{std::from_chars(
+                steps.data(), steps.data() + digits, count)};
+            if (count_error != std::errc{}) {
+                throw std::runtime_error{
+                    std::format("Unknown revision {}", revision)};
+            }
+            steps.remove_prefix(digits);
+        }
+
+        if (step != '~' && step != '^') {
+            throw std::runtime_error{
+                std::format("Unknown revision {}", revision)};
+        } else if (step == '^' && count == 0) {
+            continue;
+        }
+        // ~N takes the first parent N times, ^N the Nth parent once
+        for (std::size_t generation{0}; generation < (step == '~' ? count : 1);
+             ++generation) {
+            const std::vector<ObjectId> parents{this->Parents(commit)};
+            const std::size_t parent{step == '~' ? 0 : count - 1};
+            if (parent >= parents.size()) {
+                throw std::runtime_error{
+                    std::format("Revision {} does not exist", revision)};
+            }
+            commit = parents[parent];
+        }
+    }
+    return commit;
+}
+
+/*
+ * Both the tree and the index are sorted by path, byte by byte, so the
+ * entries below a directory are a contiguous run of the index and a file is
+ * found by binary search.
+ */
+void Repository::CompareTree(
+    const ObjectId& id, const std::string& prefix, const std::size_t first,
+    const std::size_t last, std::vector<IndexEntry>& entries,
+    const std::function<bool(std::string_view)>& wanted,
+    std::vector<ChangedFile>& deleted) {
+    // the index caches the tree of a directory nothing has been staged in
+    // since it was last written, so an equal one means every entry below it
+    // is exactly what the base has
+    if (const auto cached{cached_trees_.find(prefix)};
+        cached != cached_trees_.end() && cached->second == id) {
+        for (std::size_t index{first}; index < last; ++index) {
+            entries[index].in_base = true;
+            entries[index].base = entries[index].id;
+        }
+        return;
+    }
+
+    std::string tree{};
+    ObjectType type{};
+    if (!this->ReadObject(id, type, tree) || type != ObjectType::Tree) {
+        throw std::runtime_error{
+            std::format("Could not read tree {}", ToHex(id))};
+    }
+
+    const auto begin{entries.begin() + static_cast<std::ptrdiff_t>(first)};
+    const auto end{entries.begin() + static_cast<std::ptrdiff_t>(last)};
+    std::string path{};
+    // every entry is "mode name\0" followed by the binary object name
+    for (std::size_t position{0}; position < tree.size();) {
+        const std::size_t separator{tree.find(' ', position)};
+        const std::size_t name_end{tree.find('\0', separator)};
+        if (name_end == std::string::npos ||
+            tree.size() - name_end - 1 < id_size) {
+            throw std::runtime_error{
+                std::format("Tree {} is corrupt", ToHex(id))};
+        }
+        std::uint32_t mode{0};
+        std::from_chars(tree.data() + position, tree.data() + separator, mode,
+                        8);
+        const std::string_view name{
+            std::string_view{tree}.substr(separator + 1,
+                                          name_end - separator - 1)};
+        ObjectId child{};
+        std::memcpy(child.data(), tree.data() + name_end + 1, id_size);
+        position = name_end + 1 + id_size;
+
+        path.assign(prefix);
+        if (!path.empty()) {
+            path.push_back('/');
+        }
+        path.append(name);
+
+        if ((mode & mode_type_mask) == mode_directory) {
+            // a directory's entries sort between "name/" and "name0"
+            const std::string below{path + '/'};
+            const std::string past{path + '0'};
+            const auto lower{
+                std::ranges::lower_bound(begin, end, below, {},
+                                         &IndexEntry::path)};
+            const auto upper{std::ranges::lower_bound(lower, end, past, {},
+                                                      &IndexEntry::path)};
+            this->CompareTree(
+                child, path, static_cast<std::size_t>(lower - entries.begin()),
+                static_cast<std::size_t>(upper - entries.begin()), entries,
+                wanted, deleted);
+            continue;
+        } else if ((mode & mode_type_mask) != mode_regular) {
+            // submodules and symbolic links hold no source to scan
+            continue;
+        }
+
+        if (const auto entry{
+                std::ranges::lower_bound(begin, end, path, {},
+                                         &IndexEntry::path)};
+            entry != end && entry->path == path) {
+            entry->in_base = true;
+            entry->base = child;
+        } else if (wanted(path)) {
+            deleted.push_back(ChangedFile{
+                .path = path,
+                .base = child,
+                .deleted = true,
+            });
+        }
+    }
+}
+
+/*
+ * Supports index versions 2 to 4; version 4 spells each path as how much
+ * of the previous one to drop and what to append. Every version ends in
+ * optional extensions and a checksum.
+ */
+void Repository::ReadIndex(const std::string_view index,
+                           std::vector<IndexEntry>& entries) {
+    const auto corrupt{[]() {
+        return std::runtime_error{"The git index is corrupt"};
+    }};
+    if (index.size() < 12 + id_size || !index.starts_with("DIRC")) {
+        throw corrupt();
+    }
+    const std::uint32_t version{ReadBigEndian(index, 4, 4)};
+    const std::uint32_t count{ReadBigEndian(index, 8, 4)};
+    if (version < 2 || version > 4) {
+        throw std::runtime_error{
+            std::format("Git index version {} is not supported", version)};
+    }
+
+    const std::size_t end{index.size() - id_size};
+    std::size_t position{12};
+    std::string path{};
+    for (std::uint32_t entry{0}; entry < count; ++entry) {
+        // stat data, mode and sizes, the object name and flags
+        constexpr std::size_t fixed_size{62};
+        if (end - position < fixed_size) {
+            throw corrupt();
+        }
+        const std::uint16_t flags{
+            static_cast<std::uint16_t>(ReadBigEndian(index, position + 60, 2))};
+        std::size_t header_size{fixed_size};
+        std::uint16_t extended_flags{0};
+        if (version >= 3 && (flags & 0x4000) != 0) {
+            if (end - position < fixed_size + 2) {
+                throw corrupt();
+            }
+            extended_flags = static_cast<std::uint16_t>(
+                ReadBigEndian(index, position + fixed_size, 2));
+            header_size += 2;
+        }
+
+        std::size_t name_start{position + header_size};
+        if (version == 4) {
+            std::size_t dropped{0};
+            unsigned char byte{0};
+            do {
+                if (name_start >= end) {
+                    throw corrupt();
+                }
+                byte = static_cast<unsigned char>(index[name_start++]);
+                dropped = (dropped << 7) | (byte & 0x7fu);
+            } while ((byte & 0x80) != 0 && ++dropped != 0);
+            if (dropped > path.size()) {
+                throw corrupt();
+            }
+            path.resize(path.size() - dropped);
+        } else {
+            path.clear();
+        }
+        const std::size_t name_end{index.find('\0', name_start)};
+        if (name_end == std::string_view::npos || name_end >= end) {
+            throw corrupt();
+        }
+        path.append(index.substr(name_start, name_end - name_start));
+
+        const IndexEntry* const previous{entries.empty() ? nullptr
+                                                         : &entries.back()};
+        const std::uint32_t mode{ReadBigEndian(index, position + 24, 4)};
+        if ((mode & mode_type_mask) == mode_directory) {
+            throw std::runtime_error{"Sparse git indexes are not supported"};
+        } else if (previous != nullptr && previous->path == path) {
+            // the other stages of a conflicted path
+            entries.back().conflicted = true;
+        } else {
+            IndexEntry& added{entries.emplace_back()};
+            added.path = path;
+            std::memcpy(added.id.data(), index.data() + position + 40,
+                        id_size);
+            added.mode = mode;
+            added.modified_seconds = ReadBigEndian(index, position + 8, 4);
+            added.modified_nanoseconds = ReadBigEndian(index, position + 12, 4);
+            added.inode = ReadBigEndian(index, position + 20, 4);
+            added.size = ReadBigEndian(index, position + 36, 4);
+            added.conflicted = (flags & 0x3000) != 0;
+            added.skip_worktree = (extended_flags & 0x4000) != 0;
+            added.intent_to_add = (extended_flags & 0x2000) != 0;
+        }
+
+        // versions 2 and 3 pad entries with 1 to 8 NULs to a multiple of 8
+        position = version == 4
+                       ? name_end + 1
+                       : position + ((header_size + (name_end - name_start) +
+                                      8) &
+                                     ~std::size_t{7});
+        if (position > end) {
+            throw corrupt();
+        }
+    }
+
+    while (end - position >= 8) {
+        const std::string_view signature{index.substr(position, 4)};
+        const std::size_t size{ReadBigEndian(index, position + 4, 4)};
+        position += 8;
+        if (size > end - position) {
+            throw corrupt();
+        }
+        std::string_view data{index.substr(position, size)};
+        position += size;
+
+        if (signature == "link") {
+            throw std::runtime_error{"Split git indexes are not supported"};
+        } else if (signature == "TREE" && !data.empty() &&
+                   !ParseCachedTree(data, {}, cached_trees_)) {
+            // a stale cache only costs reading more trees
+            cached_trees_.clear();
+        }
+    }
+}
+
+std::vector<ChangedFile> Repository::ChangesSince(
+    const ObjectId& commit,
+    const std::function<bool(std::string_view path)>& wanted,
+    const std::size_t thread_count) {
+    const ObjectId tree{this->Peel(commit, ObjectType::Tree)};
+
+    std::vector<IndexEntry> entries{};
+    cached_trees_.clear();
+    const std::filesystem::path index_file{git_directory_ / "index"};
+    const std::optional<scan_cache::FileStamp> index_stamp{
+        scan_cache::StampFile(index_file)};
+    if (index_stamp.has_value()) {
+        file_io::FileReader reader{};
+        const std::optional<std::string_view> index{reader.Load(index_file)};
+        if (!index.has_value()) {
+            throw std::runtime_error{std::format(
+                "Could not read the git index {}", index_file.string())};
+        }
+        this->ReadIndex(index.value(), entries);
+    }
+
+    std::vector<ChangedFile> changes{};
+    this->CompareTree(tree, {}, 0, entries.size(), entries, wanted, changes);
+
+    enum class Status : std::uint8_t {
+        Skipped,
+        Unchanged,
+        // the same size as in the index, but the rest of the stat data
+        // differs or can not be trusted, so the contents decide
+        Unverified,
+        Modified,
+        Missing,
+    };
+    std::vector<Status> statuses(entries.size(), Status::Skipped);
+
+    // git's own test for a file that may have changed since the index last
+    // looked at it: any stat difference, or a modification in the same
+    // instant the index was written, which the index could not have seen.
+    // Short of a different size, either one only takes comparing the
+    // contents to rule out, as after a file was merely touched
+    const auto check{[&](const std::size_t first, const std::size_t last) {
+        std::string file{};
+        for (std::size_t index{first}; index < last; ++index) {
+            const IndexEntry& entry{entries[index]};
+            if ((entry.mode & mode_type_mask) != mode_regular ||
+                entry.skip_worktree || !wanted(entry.path)) {
+                continue;
+            }
+
+            file.assign((work_tree_ / entry.path).string());
+            const std::optional<scan_cache::FileStamp> stamp{
+                scan_cache::StampFile(file)};
+            if (!stamp.has_value()) {
+                statuses[index] = Status::Missing;
+                continue;
+            }
+
+            const std::int64_t seconds{stamp->modified / 1'000'000'000};
+            const std::int64_t nanoseconds{stamp->modified % 1'000'000'000};
+            const bool same_size{
+                static_cast<std::uint32_t>(stamp->size) == entry.size};
+            const bool same{
+                same_size &&
+                static_cast<std::uint32_t>(stamp->inode) == entry.inode &&
+                static_cast<std::uint32_t>(seconds) == entry.modified_seconds &&
+                (entry.modified_nanoseconds == 0 ||
+                 static_cast<std::uint32_t>(nanoseconds) ==
+                     entry.modified_nanoseconds)};
+            if (!same_size || entry.conflicted || entry.intent_to_add) {
+                statuses[index] = Status::Modified;
+            } else if (!same || stamp->modified >= index_stamp->modified) {
+                statuses[index] = Status::Unverified;
+            } else {
+                statuses[index] = Status::Unchanged;
+            }
+        }
+    }};
+
+    const std::size_t threads{std::max<std::size_t>(
+        std::min(thread_count, entries.size() / entries_per_thread), 1)};
+    {
+        std::vector<std::jthread> checkers{};
+        const std::size_t share{(entries.size() + threads - 1) / threads};
+        for (std::size_t thread{1}; thread < threads; ++thread) {
+            checkers.emplace_back(check, thread * share,
+                                  std::min((thread + 1) * share,
+                                           entries.size()));
+        }
+        check(0, std::min(share, entries.size()));
+    }
+
+    file_io::FileReader reader{};
+    std::string indexed{};
+    for (std::size_t index{0}; index < entries.size(); ++index) {
+        const IndexEntry& entry{entries[index]};
+        const std::optional<ObjectId> base{
+            entry.in_base ? std::optional{entry.base} : std::nullopt};
+        if (statuses[index] == Status::Unverified) {
+            const std::optional<std::string_view> contents{
+                reader.Load(work_tree_ / entry.path)};
+            statuses[index] = contents.has_value() &&
+                                      this->ReadBlob(entry.id, indexed) &&
+                                      contents.value() == indexed
+                                  ? Status::Unchanged
+                                  : Status::Modified;
+        }
+        switch (statuses[index]) {
+            case Status::Skipped:
+            case Status::Unverified:
+                break;
+            case Status::Missing:
+                if (base.has_value()) {
+                    changes.push_back(ChangedFile{
+                        .path = entry.path,
+                        .base = base,
+                        .deleted = true,
+                    });
+                }
+                break;
+            case Status::Unchanged:
+                if (base.has_value() && base.value() == entry.id) {
+                    break;
+                }
+                [[fallthrough]];
+            case Status::Modified:
+                changes.push_back(ChangedFile{
+                    .path = entry.path,
+                    .base = base,
+                    .deleted = false,
+                });
+                break;
+        }
+    }
+
+    std::ranges::sort(changes, {}, &ChangedFile::path);
+    return changes;
+}
+
+}  // namespace git_reading
@@ -0,0 +1,339 @@
+/*
+ *  ignore_rules.cpp - Parsing and matching of .gitignore style rules
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/ignore_rules.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace ignore_rules {
+namespace {
+constexpr std::string_view wildcard_characters{"*?[\\"};
+
+/*
+ * Matches a character class starting just past its '['. On success class_end
+ * is set to the index just past the closing ']'.
+ */
+bool MatchClass(const std::string_view pattern, std::size_t position,
+                const char character, std::size_t& class_end) {
+    bool negated{false};
+    if (position < pattern.size() &&
+        (pattern[position] == '!' || pattern[position] == '^')) {
+        negated = true;
+        position++;
+    }
+
+    bool matched{false};
+    bool first{true};
+    while (position < pattern.size() && (first || pattern[position] != ']')) {
+        first = false;
+        char low{pattern[position]};
+        if (low == '\\' && position + 1 < pattern.size()) {
+            low = pattern[++position];
+        }
+        char high{low};
+        if (position + 2 < pattern.size() && pattern[position + 1] == '-' &&
+            pattern[position + 2] != ']') {
+            high = pattern[position + 2];
+            if (high == '\\' && position + 3 < pattern.size()) {
+                high = pattern[++position + 2];
+            }
+            position += 2;
+        }
+        matched = matched || (low <= character && character <= high);
+        position++;
+    }
+
+    if (position >= pattern.size()) {
+        // an unterminated class never matches, like in git
+        return false;
+    }
+    class_end = position + 1;
+    return matched != negated;
+}
+
+bool MatchFrom(const std::string_view pattern, std::size_t position,
+               const std::string_view text, std::size_t offset) {
+    while (position < pattern.size()) {
+        const char current{pattern[position]};
+
+        if (current == '*') {
+            const bool segment_start{position == 0 ||
+                                     pattern[position - 1] == '/'};
+            if (segment_start && pattern.substr(position, 2) == "**" &&
+                (position + 2 == pattern.size() ||
+                 pattern[position + 2] == '/')) {
+                if (position + 2 == pattern.size()) {
+                    return true;
+                }
+                // "**/" matches zero or more whole directories
+                const std::size_t rest{position + 3};
+                while (true) {
+                    if (MatchFrom(pattern, rest, text, offset)) {
+                        return true;
+                    }
+                    offset = text.find('/', offset);
+                    if (offset == std::string_view::npos) {
+                        return false;
+                    }
+                    offset++;
+                }
+            }
+
+            while (position < pattern.size() && pattern[position] == '*') {
+                position++;
+            }
+            while (true) {
+                if (MatchFrom(pattern, position, text, offset)) {
+                    return true;
+                }
+                if (offset == text.size() || text[offset] == '/') {
+                    return false;
+                }
+                offset++;
+            }
+        }
+
+        if (offset == text.size()) {
+            return false;
+        }
+
+        switch (current) {
+            case '?':
+                if (text[offset] == '/') {
+                    return false;
+                }
+                position++;
+                break;
+            case '[': {
+                std::size_t class_end{0};
+                if (text[offset] == '/' ||
+                    !MatchClass(pattern, position + 1, text[offset],
+                                class_end)) {
+                    return false;
+                }
+                position = class_end;
+                break;
+            }
+            case '\\':
+                if (position + 1 < pattern.size()) {
+                    position++;
+                }
+                [[fallthrough]];
+            default:
+                if (pattern[position] != text[offset]) {
+                    return false;
+                }
+                position++;
+                break;
+        }
+        offset++;
+    }
+
+    return offset == text.size();
+}
+
+std::string PathString(const std::filesystem::path& path) {
+#if defined(_WIN32)
+    return path.generic_string();
+#else
+    return path.native();
+#endif
+}
+}  // namespace
+
+bool GlobMatch(const std::string_view pattern, const std::string_view text) {
+    return MatchFrom(pattern, 0, text, 0);
+}
+
+void RuleSet::AddRules(const std::string_view text) {
+    std::size_t start{0};
+    while (start < text.size()) {
+        std::size_t end{text.find('\n', start)};
+        if (end == std::string_view::npos) {
+            end = text.size();
+        }
+        this->AddRule(text.substr(start, end - start));
+        start = end + 1;
+    }
+}
+
+void RuleSet::AddRule(std::string_view line) {
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    // trailing spaces are dropped unless escaped with a backslash
+    while (!line.empty() && line.back() == ' ' &&
+           !(line.size() >= 2 && line[line.size() - 2] == '\\')) {
+        line.remove_suffix(1);
+    }
+    if (line.empty() || line.front() == '#') {
+        return;
+    }
+
+    Rule rule{
+        .pattern = {},
+        .kind = MatchKind::Glob,
+        .negated = false,
+        .directory_only = false,
+        .anchored = false,
+    };
+
+    if (line.front() == '!') {
+        rule.negated = true;
+        line.remove_prefix(1);
+    }
+    if (!line.empty() && line.back() == '/') {
+        rule.directory_only = true;
+        line.remove_suffix(1);
+    }
+    if (line.find('/') != std::string_view::npos) {
+        rule.anchored = true;
+        if (line.front() == '/') {
+            line.remove_prefix(1);
+        }
+    }
+    if (line.empty()) {
+        return;
+    }
+
+    if (line.find_first_of(wildcard_characters) == std::string_view::npos) {
+        rule.kind = MatchKind::Literal;
+        rule.pattern = line;
+    } else if (!rule.anchored && line.front() == '*' &&
+               line.find_first_of(wildcard_characters, 1) ==
+                   std::string_view::npos) {
+        rule.kind = MatchKind::Suffix;
+        rule.pattern = line.substr(1);
+    } else {
+        rule.pattern = line;
+    }
+
+    rules_.push_back(std::move(rule));
+}
+
+std::optional<bool> RuleSet::Match(const std::string_view relative_path,
+                                   const bool is_directory) const {
+    const std::size_t last_separator{relative_path.rfind('/')};
+    const std::string_view name{
+        last_separator == std::string_view::npos
+            ? relative_path
+            : relative_path.substr(last_separator + 1)};
+
+    for (auto rule{rules_.crbegin()}; rule != rules_.crend(); ++rule) {
+        if (rule->directory_only && !is_directory) {
+            continue;
+        }
+
+        const std::string_view target{rule->anchored ? relative_path : name};
+        bool matched{false};
+        switch (rule->kind) {
+            case MatchKind::Literal:
+                matched = target == rule->pattern;
+                break;
+            case MatchKind::Suffix:
+                matched = target.ends_with(rule->pattern);
+                break;
+            case MatchKind::Glob:
+                matched = GlobMatch(rule->pattern, target);
+                break;
+        }
+
+        if (matched) {
+            return !rule->negated;
+        }
+    }
+
+    return std::nullopt;
+}
+
+IgnoreScope::IgnoreScope(std::shared_ptr<const IgnoreScope> parent,
+                         std::string base, RuleSet rules)
+    : parent_{std::move(parent)},
+      base_{std::move(base)},
+      rules_{std::move(rules)} {}
+
+std::shared_ptr<const IgnoreScope> IgnoreScope::Extend(
+    std::shared_ptr<const IgnoreScope> parent,
+    const std::filesystem::path& directory,
+    const std::span<const std::string_view> ignore_files) {
+    RuleSet rules{};
+    for (const std::string_view ignore_file : ignore_files) {
+        std::ifstream input{directory / ignore_file, std::ios::binary};
+        const std::string text{std::istreambuf_iterator<char>{input},
+                               std::istreambuf_iterator<char>{}};
+        rules.AddRules(text);
+    }
+
+    if (rules.Empty()) {
+        return parent;
+    }
+
+    std::string base{PathString(directory)};
+    if (!base.ends_with('/')) {
+        base.push_back('/');
+    }
+    return std::shared_ptr<const IgnoreScope>{
+        new IgnoreScope{std::move(parent), std::move(base), std::move(rules)}};
+}
+
+bool IgnoreScope::IsIgnored(const std::filesystem::path& path,
+                            const bool is_directory) const {
+#if defined(_WIN32)
+    return this->IsIgnored(std::string_view{path.string()}, is_directory);
+#else
+    return this->IsIgnored(std::string_view{path.native()}, is_directory);
+#endif
+}
+
+bool IgnoreScope::IsIgnored(const std::string_view path,
+                            const bool is_directory) const {
+#if defined(_WIN32)
+    std::string generic_path{path};
+    std::ranges::replace(generic_path, '\\', '/');
+    const std::string_view full_path{generic_path};
+#else
+    const std::string_view full_path{path};
+#endif
+
+    for (const IgnoreScope* scope{this}; scope != nullptr;
+         scope = scope->parent_.get()) {
+        if (!full_path.starts_with(scope->base_)) {
+            continue;
+        }
+
+        const std::optional<bool> ignored{scope->rules_.Match(
+            full_path.substr(scope->base_.size()), is_directory)};
+        if (ignored.has_value()) {
+            return ignored.value();
+        }
+    }
+
+    return false;
+}
+
+}  // namespace ignore_rules
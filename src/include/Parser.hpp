@@ -23,62 +23,512 @@
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <filesystem>
+#include <functional>
 #include <limits>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <optional>
-#include <queue>
 #include <regex>
 #include <semaphore>
+#include <stop_token>
+#include <span>
 #include <string>
 #include <string_view>
 #include <thread>
 #include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "comment_lexer.hpp"
+#include "comment_syntax.hpp"
+#include "file_reader.hpp"
+#include "file_result.hpp"
+#include "ignore_rules.hpp"
+#include "keyword_matcher.hpp"
+#include "language_registry.hpp"
+#include "path_arena.hpp"
+#include "profile.hpp"
+#include "scan_cache.hpp"
+#include "scan_statistics.hpp"
+#include "tar_reader.hpp"
+#include "uring_reader.hpp"
+
 namespace parser_info {
 
+/*
+ * The engine behind profile::Scan. Everything a scan finds is reported
+ * through the hit callback and the returned summary.
+ *
+ * With keep_index set, every profiled file's counts are also remembered, so
+ * that after the first scan Rescan can bring the totals up to date with just
+ * the paths that changed, and FileCounts can tell what any one file holds.
+ */
 class Parser {
+    struct SplitFile;
+
  public:
-    enum class CommentFormat : std::uint8_t {
-        DoubleSlash,
-        PoundSign,
+    /*
+     * A queued file or directory, named by its id in the scan's path arena.
+     * Directories carry the ignore rules in effect for their parent; files
+     * have already been checked against them. Archive members carry their
+     * contents, having no file on disk to read, and chunks of a split file
+     * name the file and chunk instead of a path. Files the I/O stage read
+     * ahead carry what it read, and are otherwise parsed like any other.
+     */
+    struct Job {
+        path_arena::PathId path{path_arena::no_path};
+        std::shared_ptr<const ignore_rules::IgnoreScope> ignore_scope{};
+        std::optional<std::string> contents{};
+        std::optional<std::string> prefetched{};
+        std::shared_ptr<SplitFile> split_file{};
+        std::size_t chunk{0};
+    };
+
+    /*
+     * A file or directory to scan again, with the ignore rules in effect for
+     * its parent.
+     */
+    struct Target {
+        std::filesystem::path path{};
+        std::shared_ptr<const ignore_rules::IgnoreScope> ignore_scope{};
+    };
+
+    /*
+     * A directory the scan descended into: the rules that applied to the
+     * directory itself and the ones that apply to its children.
+     */
+    struct ScannedDirectory {
+        std::filesystem::path path{};
+        std::shared_ptr<const ignore_rules::IgnoreScope> parent_scope{};
+        std::shared_ptr<const ignore_rules::IgnoreScope> ignore_scope{};
     };
 
-    explicit Parser(const bool&& verbose_printing);
-    explicit Parser(const bool&& verbose_printing,
-                    const std::vector<std::string>&& custom_regexes);
+    Parser(const profile::ScanConfig& config, profile::HitCallback on_hits,
+           bool keep_index = false);
+
+    profile::ScanSummary ParseFiles();
+
+    /*
+     * Scans the regular files of a tar archive ("-" for stdin) in a single
+     * streaming pass: the calling thread reads members and hands them to the
+     * pool as they arrive. Members are reported by their path inside the
+     * archive; ignore files and the cache do not apply.
+     */
+    profile::ScanSummary ParseArchive(const std::filesystem::path& archive);
+
+    /*
+     * Scans just files, which are taken to be source files a scan of the
+     * roots would visit (see Select), without walking any directory.
+     */
+    profile::ScanSummary ParseFileList(std::span<const std::string> files);
+
+    /*
+     * Scans contents that are not on disk, such as the files of an older
+     * revision: load fills in the contents of paths[index], reusing the
+     * buffer it is handed, and is called on the calling thread one path
+     * after another while the pool parses what it already loaded. A path
+     * load returns false for is reported as an error and skipped. The cache
+     * does not apply.
+     */
+    profile::ScanSummary ParseSnapshot(
+        std::span<const std::string> paths,
+        const std::function<bool(std::size_t index, std::string& contents)>&
+            load);
+
+    /*
+     * Whether the name of file is that of a source file in one of the
+     * scanned languages. Safe to call from any thread.
+     */
+    bool IsSourceFile(std::string_view file) const;
+
+    /*
+     * For each of files, given relative to root with '/' between
+     * components, the path a scan of root would reach it by, or nullopt if
+     * the scan would not visit it: for a file that is no source file, or
+     * that is inside a .git directory or excluded by ignore rules when they
+     * apply. The files need not exist, but the ignore files of the
+     * directories they are in are read.
+     */
+    std::vector<std::optional<std::string>> Select(
+        const std::filesystem::path& root,
+        std::span<const std::string> files) const;
+
+    /*
+     * Drops everything indexed at or below each target's path, then scans
+     * the targets that still exist. Targets are checked against their
+     * ignore rules like any other child. Requires keep_index.
+     */
+    void Rescan(std::span<const Target> targets);
+
+    /*
+     * config.directory followed by config.extra_directories, each in its
+     * lexically normal form.
+     */
+    const std::vector<std::filesystem::path>& Roots() const;
+
+    /*
+     * The directories entered since the last call. Only recorded with
+     * keep_index.
+     */
+    std::vector<ScannedDirectory> TakeScannedDirectories();
 
-    void ParseFiles(const std::filesystem::path& current_file);
+    /*
+     * Totals over everything scanned so far, with the statistics and errors
+     * of the latest pass.
+     */
+    profile::ScanSummary Summarize() const;
+
+    /*
+     * The pattern counts of an indexed file, as spelled when it was
+     * scanned, in pattern id order. Requires keep_index.
+     */
+    std::optional<std::span<const std::size_t>> FileCounts(
+        std::string_view file) const;
 
  private:
-    std::optional<CommentFormat> IsValidFile(const std::string&& file);
+    /*
+     * Counters owned by a single worker. Nothing in here is shared while the
+     * scan runs; RunWorkers folds every worker's block into the totals once
+     * the pool has joined.
+     */
+    struct WorkerStatistics {
+        std::size_t file_count{0};
+        std::vector<std::size_t> pattern_counts{};
+        std::unordered_map<std::string_view, std::size_t> extension_counts{};
+        std::vector<std::string> errors{};
+        std::vector<std::pair<std::string, std::vector<std::size_t>>>
+            indexed_files{};
+        std::vector<ScannedDirectory> scanned_directories{};
+    };
+
+    struct IndexedFile {
+        std::string extension{};
+        std::vector<std::size_t> pattern_counts{};
+    };
+
+    /*
+     * A line that contains a comment, found while locating comments and
+     * matched against the patterns afterwards. Its comments are the
+     * comment_count in WorkerState::comment_spans from first_comment on.
+     */
+    struct CommentLine {
+        std::size_t line_number;
+        std::string_view line;
+        std::size_t first_comment;
+        std::size_t comment_count;
+    };
+
+    /*
+     * Scratch space and statistics owned by a single worker, padded out to
+     * its own cache lines. Everything in here is reused from job to job, so
+     * once warmed up a worker parses files without allocating.
+     */
+    struct alignas(64) WorkerState {
+        std::size_t worker{0};
+        file_io::FileReader reader{};
+        FileResult result{};
+        std::vector<CommentLine> comments{};
+        std::vector<std::string_view> comment_spans{};
+        std::vector<profile::HitRecord> records{};
+        // the path of the job at hand, spelled out
+        std::string path{};
+        std::string child_path{};
+        // the part of path below its root that shards hash
+        std::string shard_path{};
+        std::filesystem::path hit_path{};
+        std::vector<Job> child_directories{};
+        std::vector<Job> child_files{};
+        std::vector<std::string_view> ignore_files{};
+        // set up by the worker itself when reads are batched
+        std::unique_ptr<uring_reading::BatchReader> batch_reader{};
+        std::vector<Job> batch{};
+        std::vector<std::string> batch_files{};
+        std::vector<const char*> batch_paths{};
+        std::vector<std::size_t> batch_slots{};
+        // what the batch or the I/O stage read for the file being parsed,
+        // if anything
+        std::optional<std::string_view> prefetched{};
+        // files this worker handed to the matching stage, and the jobs it
+        // finished there, which the tuner reads while the scan runs
+        std::size_t handoffs{0};
+        std::atomic<std::uint64_t> matched_jobs{0};
+        WorkerStatistics statistics{};
+        scan_statistics::WorkerCounters counters{};
+    };
+
+    /*
+     * The syntax of file's language, or nullptr if it is not a source file.
+     */
+    const comment_lexing::Syntax* IsValidFile(std::string_view file,
+                                              WorkerStatistics& statistics);
+
+    void MergeWorkerStatistics();
+
+    /*
+     * Shared by whatever reads files ahead (the thread reading an archive,
+     * or the I/O stage) and the workers parsing them. Read buffers travel
+     * from a reader to a worker and back, so files are read without
+     * allocating, and slots bounds how many of them can wait in memory at
+     * once; filled counts the ones that do.
+     */
+    struct ReadBuffers {
+        explicit ReadBuffers(const std::size_t count)
+            : slots{static_cast<std::ptrdiff_t>(count)}, slot_count{count} {}
+
+        std::counting_semaphore<std::numeric_limits<std::ptrdiff_t>::max()>
+            slots;
+        const std::size_t slot_count;
+        std::atomic<std::size_t> filled{0};
+        std::mutex spare_lock{};
+        std::vector<std::string> spare_contents{};
+    };
+
+    /*
+     * feed, when set, runs on the calling thread alongside the pool and may
+     * hand it more files through SubmitFile until it returns.
+     */
+    void RunWorkers(std::vector<Job>&& directories, std::vector<Job>&& files,
+                    const std::function<void()>& feed = {});
+
+    /*
+     * Hands file to the matching stage, on worker's queue.
+     */
+    void SubmitFile(std::size_t worker, Job&& file);
+
+    void FinishJob();
+
+    void FeedArchive(tar_reading::TarReader& reader);
+
+    void FeedSnapshot(
+        std::span<const std::string> paths,
+        const std::function<bool(std::size_t, std::string&)>& load);
+
+    /*
+     * A spare read buffer, waiting for one to come back while all of them
+     * are filled.
+     */
+    std::string TakeBuffer();
+
+    void ReturnContents(std::string&& contents);
+
+    void ReadAhead(Job&& file, WorkerState& state);
+
+    void AutoTune(std::stop_token stop);
+
+    void Forget(const std::filesystem::path& path);
+
+    void Unindex(const IndexedFile& file);
+
+    std::size_t PatternCount() const;
+
+    void RecursivelyParseFiles(const Job& file, WorkerState& state);
+
+    void ParseFileBatch(std::size_t worker, Job&& file, WorkerState& state);
+
+    /*
+     * The lines of some contents and the bytes of comment in them, left for
+     * the caller to add to the statistics once it knows they are final.
+     */
+    struct ContentTotals {
+        std::size_t lines{0};
+        std::size_t comment_bytes{0};
+    };
+
+    ContentTotals ParseContents(comment_lexing::CommentLexer& lexer,
+                                std::string_view contents, FileResult& result,
+                                WorkerState& state) const;
+
+    /*
+     * Counts what ParseContents would, without finding any hits or line
+     * numbers, and leaves lexer wherever the last line that could hold a
+     * match left it.
+     */
+    ContentTotals CountContents(comment_lexing::CommentLexer& lexer,
+                                std::string_view contents, FileResult& result,
+                                WorkerState& state) const;
+
+    /*
+     * CountContents when the scan only counts, ParseContents otherwise, with
+     * the totals added to the statistics. Whole files only; chunks of a
+     * split file need ParseContents's line count and final lexer state.
+     */
+    void ScanContents(comment_lexing::CommentLexer& lexer,
+                      std::string_view contents, FileResult& result,
+                      WorkerState& state) const;
+
+    /*
+     * Matches the comments on one line. Each pattern counts once for the
+     * line, wherever and however often it occurs in them.
+     */
+    void MatchComment(std::size_t line_number, std::string_view line,
+                      std::span<const std::string_view> comments,
+                      FileResult& result) const;
+
+    /*
+     * A run of whole lines of a split file. Everything in it is found as if
+     * the chunk started in code, with line numbers counted from the chunk's
+     * first line; lexer is left as the chunk's last line left it.
+     */
+    struct Chunk {
+        std::string_view text{};
+        ContentTotals totals{};
+        FileResult result{};
+        std::optional<comment_lexing::CommentLexer> lexer{};
+    };
+
+    /*
+     * A file large enough to be split into chunks for several workers to
+     * parse at once. Whoever finishes the last chunk stitches the chunks
+     * back together in FinishSplitFile.
+     */
+    struct SplitFile {
+        std::string path{};
+        const comment_lexing::Syntax* syntax{nullptr};
+        std::shared_ptr<const void> memory{};
+        std::optional<scan_cache::FileStamp> stamp{};
+        scan_statistics::Clock::time_point start{};
+        std::vector<Chunk> chunks{};
+        std::atomic<std::size_t> unfinished_chunks{0};
+    };
+
+    void SplitLargeFile(std::string_view current_file,
+                        const comment_lexing::Syntax& syntax,
+                        std::string_view contents,
+                        const std::optional<scan_cache::FileStamp>& stamp,
+                        scan_statistics::Clock::time_point start,
+                        WorkerState& state);
+
+    void ParseChunk(const Job& chunk, WorkerState& state);
+
+    void FinishSplitFile(SplitFile& file, WorkerState& state);
+
+    void RecordFileResult(std::string_view current_file,
+                          const FileResult& result, WorkerState& state);
+
+    enum class JobKind : std::uint8_t {
+        Directory,
+        File,
+    };
+
+    /*
+     * One job deque per worker. The owning worker pushes and pops at the
+     * back; idle workers steal from the front, preferring directories since
+     * expanding one is what creates more work for everyone else.
+     */
+    struct alignas(64) WorkQueue {
+        std::mutex lock{};
+        std::deque<Job> directories{};
+        std::deque<Job> files{};
+    };
+
+    /*
+     * The workers of a stage wait on jobs, which holds a permit for every
+     * job queued in the stage, and steal only from each other. Every stage
+     * has a queue for every worker, since the tuner may move any worker
+     * from one stage to the other.
+     */
+    struct Stage {
+        std::vector<WorkQueue> queues{};
+        std::counting_semaphore<std::numeric_limits<std::ptrdiff_t>::max()>
+            jobs{0};
+    };
+
+    /*
+     * The last io_workers_ workers walk directories and read files; the
+     * rest match. Without I/O threads every worker is in read_stage_ and
+     * matches what it reads itself.
+     */
+    Stage& StageOf(std::size_t worker);
+
+    Stage& MatchStage();
+
+    std::optional<JobKind> TakeJob(Stage& stage, std::size_t worker,
+                                   Job& job);
+
+    void ExpandDirectory(std::size_t worker, const Job& directory);
+
+    /*
+     * Whether the file name, in directory as spelled below its root, is in
+     * the shard being scanned. Always true for an unsharded scan.
+     */
+    bool InShard(std::string_view directory, std::string_view name) const;
 
-    void ReportSummary() const;
+    void ThreadWaitingRoom(std::stop_token stop, std::size_t worker);
 
-    void RecursivelyParseFiles(const std::filesystem::path& current_file);
+    /*
+     * Adds a file's counts to the running totals the thresholds are checked
+     * against, and stops the scan once one of them is exceeded.
+     */
+    void CheckThresholds(std::span<const std::size_t> counts);
 
-    void ThreadWaitingRoom();
+    /*
+     * Releases every worker waiting for a job, and anything waiting for a
+     * read buffer, so that they notice the scan was stopped.
+     */
+    void WakeStoppedWorkers();
 
  private:
-    std::array<
-        std::tuple<std::regex, std::atomic<std::size_t>, std::string_view>, 4>
-        keyword_pairs_{};
-    std::queue<std::filesystem::path> jobs_{};
-    std::mutex job_lock_{};
-    std::mutex data_lock_{};
+    std::array<std::tuple<std::size_t, std::string_view>, 4> keyword_pairs_{};
+    const std::vector<std::string> custom_patterns_{};
+    const std::vector<std::string> custom_literals_{};
+    const keyword_matching::KeywordAutomaton keyword_automaton_;
+    const keyword_matching::LiteralPrefilter literal_prefilter_;
+    std::vector<std::uint64_t> literal_candidates_{};
+    std::uint64_t unfiltered_customs_{0};
+    // no hits are wanted and every custom regex has a required literal
+    bool count_only_{false};
+    Stage read_stage_{};
+    Stage match_stage_{};
+    std::vector<WorkerState> worker_states_{};
+    std::atomic<std::size_t> io_workers_{0};
+    std::atomic<std::size_t> pending_jobs_{0};
+    std::atomic<bool> jobs_finished_{false};
+    // replaced for every pass, since a stop can not be taken back
+    std::stop_source stop_source_{};
+    const std::stop_token cancel_token_{};
+    // pattern index and limit of every threshold
+    std::vector<std::pair<std::size_t, std::size_t>> thresholds_{};
+    const std::optional<std::size_t> max_hits_{};
+    // running totals the thresholds are checked against while a pass runs
+    std::vector<std::atomic<std::size_t>> gate_counts_{};
+    std::atomic<std::size_t> gate_hits_{0};
+    bool stopped_early_{false};
     std::unordered_map<std::string, std::size_t> file_type_frequencies_{};
-    const std::unordered_map<std::string_view, CommentFormat>
-        comment_formats_{};
+    const language_registry::LanguageRegistry languages_;
     std::optional<
         std::vector<std::tuple<std::regex, std::string_view, std::size_t>>>
         custom_regexes_{std::nullopt};
+    std::optional<scan_cache::ScanCache> scan_cache_{std::nullopt};
     std::vector<std::jthread> thread_pool_{};
-    std::counting_semaphore<std::numeric_limits<std::ptrdiff_t>::max()>
-        job_semaphore_{0};
-    std::atomic<std::size_t> file_count_{};
-    const bool verbose_printing_{};
+    std::size_t file_count_{};
+    std::vector<std::string> errors_{};
+    std::map<std::string, IndexedFile> index_{};
+    std::vector<ScannedDirectory> scanned_directories_{};
+    std::unique_ptr<ReadBuffers> read_buffers_{};
+    scan_statistics::ScanStatistics scan_statistics_{};
+    const std::vector<std::filesystem::path> roots_{};
+    const profile::HitCallback on_hits_{};
+    // matching threads, and every thread including the I/O stage's
+    const std::size_t thread_count_{};
+    const std::size_t io_thread_count_{};
+    const std::size_t worker_count_{};
+    const std::size_t split_file_limit_{};
+    const std::size_t split_chunk_size_{};
+    // one writer per worker, and the last for the thread that seeds the pool
+    path_arena::PathArena paths_;
+    const bool collect_hits_{};
+    const bool use_ignore_files_{};
+    const bool batch_reads_{};
+    const bool keep_index_{};
+    const bool auto_tune_{};
+    // thresholds and shards only apply to one-off scans, never to an index
+    // kept up to date
+    const bool gated_{};
+    const std::optional<profile::Shard> shard_{};
 };
 
 }  // namespace parser_info
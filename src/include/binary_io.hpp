@@ -0,0 +1,95 @@
+/*
+ *  binary_io.hpp - Helpers shared by the binary file formats
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_BINARY_IO_HPP_
+#define SRC_INCLUDE_BINARY_IO_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace binary_io {
+
+/*
+ * Appends the bytes of value as they are laid out in memory.
+ */
+template <typename Integer>
+void Append(std::string& buffer, const Integer value) {
+    char bytes[sizeof(Integer)];
+    std::memcpy(bytes, &value, sizeof(Integer));
+    buffer.append(bytes, sizeof(Integer));
+}
+
+/*
+ * Appends text after its length as a 32-bit count, for Cursor::ReadText.
+ */
+inline void AppendText(std::string& buffer, const std::string_view text) {
+    Append(buffer, static_cast<std::uint32_t>(text.size()));
+    buffer.append(text);
+}
+
+/*
+ * Bounds-checked reader over what Append wrote. Once a read runs past the
+ * end every later read fails too, so callers only need to check at the end.
+ */
+class Cursor {
+ public:
+    explicit Cursor(const std::string_view buffer) : buffer_{buffer} {}
+
+    template <typename Integer>
+    Integer Read() {
+        Integer value{};
+        if (ok_ && buffer_.size() - position_ >= sizeof(Integer)) {
+            std::memcpy(&value, buffer_.data() + position_, sizeof(Integer));
+            position_ += sizeof(Integer);
+        } else {
+            ok_ = false;
+        }
+        return value;
+    }
+
+    std::string_view ReadBytes(const std::size_t length) {
+        if (ok_ && buffer_.size() - position_ >= length) {
+            const std::string_view bytes{buffer_.substr(position_, length)};
+            position_ += length;
+            return bytes;
+        }
+        ok_ = false;
+        return {};
+    }
+
+    std::string ReadText() {
+        return std::string{this->ReadBytes(this->Read<std::uint32_t>())};
+    }
+
+    bool Ok() const { return ok_; }
+
+    std::size_t Position() const { return position_; }
+
+    bool AtEnd() const { return position_ == buffer_.size(); }
+
+ private:
+    std::string_view buffer_;
+    std::size_t position_{0};
+    bool ok_{true};
+};
+
+}  // namespace binary_io
+#endif  // SRC_INCLUDE_BINARY_IO_HPP_
@@ -0,0 +1,180 @@
+/*
+ *  byte_scanner.hpp - Vectorized byte search kernels for buffer scanning
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_BYTE_SCANNER_HPP_
+#define SRC_INCLUDE_BYTE_SCANNER_HPP_
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace byte_scanner {
+
+/*
+ * Returns a pointer to the first occurrence of needle in [begin, end), or end
+ * if there is none. The widest vector unit the target was compiled for is
+ * used for the bulk of the range; the tail (and targets without SSE2/AVX2)
+ * fall back to memchr.
+ */
+inline const char* FindByte(const char* begin, const char* const end,
+                            const char needle) {
+#if defined(__AVX2__)
+    const __m256i pattern{_mm256_set1_epi8(needle)};
+    for (; end - begin >= 32; begin += 32) {
+        const __m256i block{
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin))};
+        if (const unsigned mask{static_cast<unsigned>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, pattern)))};
+            mask != 0) {
+            return begin + std::countr_zero(mask);
+        }
+    }
+#elif defined(__SSE2__)
+    const __m128i pattern{_mm_set1_epi8(needle)};
+    for (; end - begin >= 16; begin += 16) {
+        const __m128i block{
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin))};
+        if (const unsigned mask{static_cast<unsigned>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern)))};
+            mask != 0) {
+            return begin + std::countr_zero(mask);
+        }
+    }
+#endif
+    if (begin == end) {
+        return end;
+    }
+
+    const void* found{
+        std::memchr(begin, needle, static_cast<std::size_t>(end - begin))};
+    return found == nullptr ? end : static_cast<const char*>(found);
+}
+
+/*
+ * Up to four bytes to search for at once with FindAnyByte.
+ */
+struct ByteSet {
+    std::array<char, 4> bytes{};
+    std::size_t count{0};
+
+    /*
+     * All four slots, with the unused ones repeating the first byte, so
+     * searches can always compare against exactly four bytes.
+     */
+    constexpr std::array<char, 4> Padded() const {
+        std::array<char, 4> padded{bytes};
+        for (std::size_t index{count}; index < padded.size(); ++index) {
+            padded[index] = bytes[0];
+        }
+        return padded;
+    }
+};
+
+/*
+ * Returns a pointer to the first byte in [begin, end) that is in needles, or
+ * end if there is none. Vectorized the same way as FindByte, comparing each
+ * block against all four (padded) needles.
+ */
+inline const char* FindAnyByte(const char* begin, const char* const end,
+                               const ByteSet& needles) {
+    const std::array<char, 4> padded{needles.Padded()};
+#if defined(__AVX2__) || defined(__SSE2__)
+    const char* const start{begin};
+    const __m128i first{_mm_set1_epi8(padded[0])};
+    const __m128i second{_mm_set1_epi8(padded[1])};
+    const __m128i third{_mm_set1_epi8(padded[2])};
+    const __m128i fourth{_mm_set1_epi8(padded[3])};
+    const auto match_mask{[&](const char* const at) {
+        const __m128i block{
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(at))};
+        return static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, first),
+                                      _mm_cmpeq_epi8(block, second)),
+                         _mm_or_si128(_mm_cmpeq_epi8(block, third),
+                                      _mm_cmpeq_epi8(block, fourth)))));
+    }};
+#endif
+#if defined(__AVX2__)
+    const __m256i wide_first{_mm256_set1_epi8(padded[0])};
+    const __m256i wide_second{_mm256_set1_epi8(padded[1])};
+    const __m256i wide_third{_mm256_set1_epi8(padded[2])};
+    const __m256i wide_fourth{_mm256_set1_epi8(padded[3])};
+    for (; end - begin >= 32; begin += 32) {
+        const __m256i block{
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin))};
+        const __m256i matches{_mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, wide_first),
+                            _mm256_cmpeq_epi8(block, wide_second)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, wide_third),
+                            _mm256_cmpeq_epi8(block, wide_fourth)))};
+        if (const unsigned mask{
+                static_cast<unsigned>(_mm256_movemask_epi8(matches))};
+            mask != 0) {
+            return begin + std::countr_zero(mask);
+        }
+    }
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+    for (; end - begin >= 16; begin += 16) {
+        if (const unsigned mask{match_mask(begin)}; mask != 0) {
+            return begin + std::countr_zero(mask);
+        }
+    }
+    if (begin != end && end - start >= 16) {
+        // one more block ending exactly at end, ignoring the bytes that
+        // were already checked
+        const unsigned mask{match_mask(end - 16) >> (16 - (end - begin))};
+        return mask != 0 ? begin + std::countr_zero(mask) : end;
+    }
+#endif
+    for (; begin != end; ++begin) {
+        const char character{*begin};
+        if ((character == padded[0]) | (character == padded[1]) |
+            (character == padded[2]) | (character == padded[3])) {
+            return begin;
+        }
+    }
+    return end;
+}
+
+/*
+ * Calls on_line(line, line_number) for every line of contents, numbered from
+ * one. Lines are split on '\n' exactly like std::getline splits a stream, so
+ * a trailing newline does not produce an extra empty line.
+ */
+template <typename Callback>
+inline void ForEachLine(const std::string_view contents, Callback&& on_line) {
+    const char* const contents_end{contents.data() + contents.size()};
+    std::size_t line_number{1};
+
+    for (const char* cursor{contents.data()}; cursor != contents_end;
+         ++line_number) {
+        const char* const line_end{FindByte(cursor, contents_end, '\n')};
+        on_line(std::string_view{cursor, line_end}, line_number);
+        cursor = line_end == contents_end ? contents_end : line_end + 1;
+    }
+}
+
+}  // namespace byte_scanner
+#endif  // SRC_INCLUDE_BYTE_SCANNER_HPP_
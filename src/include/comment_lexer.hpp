@@ -0,0 +1,135 @@
+/*
+ *  comment_lexer.hpp - Streaming, language aware location of comments
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_COMMENT_LEXER_HPP_
+#define SRC_INCLUDE_COMMENT_LEXER_HPP_
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "byte_scanner.hpp"
+#include "comment_syntax.hpp"
+
+namespace comment_lexing {
+
+/*
+ * One row of the syntax table: everything the lexer needs to know about a
+ * CommentFormat.
+ */
+struct Syntax {
+    std::string_view line_comment;
+    std::string_view block_open;
+    std::string_view block_close;
+    // bytes that can start a comment or a literal while in code
+    byte_scanner::ByteSet code_bytes;
+    bool nested_blocks;
+    bool line_continuation;    // a trailing '\' continues a // comment
+    bool char_literals;        // 'x' is a character, not a string
+    bool multiline_strings;    // "..." may span lines
+    bool backtick_strings;     // `...` template literals
+    bool regex_literals;       // /.../ after an operator
+    bool cpp_raw_strings;      // R"delimiter(...)delimiter"
+    bool verbatim_strings;     // @"..." with "" as the escape
+    bool rust_raw_strings;     // r#"..."#
+    bool zig_multiline;        // \\ starts a string running to the line end
+    bool triple_quotes;        // """...""" and '''...'''
+    bool docstrings;           // a triple quoted statement is a comment
+    bool raw_backticks;        // `...` without escapes
+    bool word_start_comments;  // the line comment only starts a word
+    bool long_brackets;        // [==[...]==] strings, --[==[...]==] comments
+};
+
+const Syntax& SyntaxFor(parser_info::CommentFormat format);
+
+/*
+ * Finds the comments of a file one line at a time. Whether the lexer is in
+ * code, a block comment, a docstring or a string literal carries over from
+ * one line to the next, so the lines of a file must be fed in order. In code
+ * only the bytes in Syntax::code_bytes are looked at, and inside comments
+ * and literals only their closing delimiters are, both with vectorized
+ * searches.
+ */
+class CommentLexer {
+ public:
+    explicit CommentLexer(parser_info::CommentFormat format);
+
+    /*
+     * syntax must outlive the lexer.
+     */
+    explicit CommentLexer(const Syntax& syntax);
+
+    /*
+     * Returns the comments on line in order, each one running from its
+     * opening delimiter to its closing one or the end of the line, so that
+     * no code or string literal between two comments is part of either.
+     * Empty if the line has no comment. The views are only valid until the
+     * next call; line must not include its newline.
+     */
+    std::span<const std::string_view> NextLine(std::string_view line);
+
+    /*
+     * Whether the lexer is outside of every comment and literal, as it is
+     * at the start of a file. Nothing else carries over to the next line
+     * from there, so any two lexers in code behave the same from then on.
+     */
+    bool InCode() const;
+
+ private:
+    enum class Mode : std::uint8_t {
+        Code,
+        LineComment,
+        BlockComment,
+        Quoted,
+        Delimited,
+        Verbatim,
+    };
+
+    /*
+     * Handles the byte at position while in code and returns where to
+     * continue, or nullptr when the rest of the line is a comment.
+     */
+    const char* LexCode(std::string_view line, const char* position);
+
+    const char* LexBlockComment(const char* position, const char* end);
+
+    const char* LexQuoted(const char* position, const char* end);
+
+    const char* LexDelimited(const char* position, const char* end);
+
+    const char* LexVerbatim(const char* position, const char* end);
+
+    void MarkComment(const char* begin, const char* end);
+
+ private:
+    const Syntax& syntax_;
+    Mode mode_{Mode::Code};
+    // what ends the current Delimited literal or docstring
+    std::string closing_{};
+    char quote_{'"'};
+    bool quoted_multiline_{false};
+    bool delimited_escapes_{false};
+    bool in_docstring_{false};
+    std::uint32_t depth_{0};
+    std::vector<std::string_view> comments_{};
+};
+
+}  // namespace comment_lexing
+#endif  // SRC_INCLUDE_COMMENT_LEXER_HPP_
@@ -0,0 +1,92 @@
+/*
+ *  comment_syntax.hpp - Recognized languages, comment markers and keywords
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_COMMENT_SYNTAX_HPP_
+#define SRC_INCLUDE_COMMENT_SYNTAX_HPP_
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+#include "keyword_matcher.hpp"
+
+namespace parser_info {
+
+/*
+ * Languages grouped by how their comments and string literals are written.
+ * Each one has its own row in the comment lexer's syntax table.
+ */
+enum class CommentFormat : std::uint8_t {
+    CFamily,     // C, C++ and C#: //, /* */, raw and verbatim strings
+    JavaScript,  // JavaScript and TypeScript: adds `templates` and /regex/
+    Rust,        // nested /* */ and r#"raw"# strings
+    Zig,         // // only, with \\ multiline strings
+    Python,      // #, with docstrings treated as comments
+    Go,          // //, /* */ and `raw` strings
+    Java,        // //, /* */ and """text blocks"""
+    Kotlin,      // Kotlin and Swift: nested /* */ and """strings"""
+    Shell,       // # at the start of a word, strings spanning lines
+    Lua,         // --, --[[ ]] and [[long strings]]
+};
+
+/*
+ * Built-in keywords, in the same order as Parser's keyword_pairs_. Each one
+ * behaves like the regex \bKEYWORD(\(\w*\))? - the optional owner suffix
+ * never changes whether a line matches, so only the word boundary is checked.
+ */
+constexpr std::array<keyword_matching::KeywordAutomaton::Keyword, 4>
+    builtin_keywords{{
+        {"TODO", true},
+        {"FIXME", true},
+        {"BUG", true},
+        {"HACK", true},
+    }};
+
+/*
+ * A language recognized out of the box. extensions lists every extension
+ * (leading dot included) that marks one of its files, separated by spaces.
+ */
+struct BuiltinLanguage {
+    std::string_view name;
+    std::string_view extensions;
+    CommentFormat format;
+};
+
+/*
+ * Every built-in language. language_registry hashes their extensions at
+ * compile time, so adding a language here is all it takes.
+ */
+constexpr std::array<BuiltinLanguage, 14> builtin_languages{{
+    {"C", ".c .h", CommentFormat::CFamily},
+    {"C++", ".cpp .hpp .cc .hh .cxx .hxx", CommentFormat::CFamily},
+    {"C#", ".cs", CommentFormat::CFamily},
+    {"JavaScript", ".js .mjs .cjs .jsx", CommentFormat::JavaScript},
+    {"TypeScript", ".ts .mts .cts .tsx", CommentFormat::JavaScript},
+    {"Rust", ".rs", CommentFormat::Rust},
+    {"Zig", ".zig", CommentFormat::Zig},
+    {"Python", ".py .pyi", CommentFormat::Python},
+    {"Go", ".go", CommentFormat::Go},
+    {"Java", ".java", CommentFormat::Java},
+    {"Kotlin", ".kt .kts", CommentFormat::Kotlin},
+    {"Swift", ".swift", CommentFormat::Kotlin},
+    {"Shell", ".sh .bash .zsh", CommentFormat::Shell},
+    {"Lua", ".lua", CommentFormat::Lua},
+}};
+
+}  // namespace parser_info
+#endif  // SRC_INCLUDE_COMMENT_SYNTAX_HPP_
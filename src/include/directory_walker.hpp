@@ -0,0 +1,76 @@
+/*
+ *  directory_walker.hpp - Single directory enumeration without extra stats
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_DIRECTORY_WALKER_HPP_
+#define SRC_INCLUDE_DIRECTORY_WALKER_HPP_
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace directory_walking {
+
+enum class EntryKind : std::uint8_t {
+    File,
+    Directory,
+    Other,
+};
+
+struct Entry {
+    std::string_view name;
+    EntryKind kind;
+};
+
+/*
+ * Lists the immediate children of one directory. On POSIX systems the entry
+ * type comes straight from readdir's d_type, so no stat call is made unless
+ * the filesystem reports DT_UNKNOWN. Symlinks are reported as Other and are
+ * never followed.
+ *
+ * The name in a returned Entry is only valid until the next call to Next.
+ */
+class DirectoryStream {
+ public:
+    explicit DirectoryStream(const std::filesystem::path& directory);
+
+    /*
+     * The same for a path already spelled out as a narrow string.
+     */
+    explicit DirectoryStream(const std::string& directory);
+    DirectoryStream(const DirectoryStream&) = delete;
+    DirectoryStream& operator=(const DirectoryStream&) = delete;
+    ~DirectoryStream();
+
+    bool IsOpen() const;
+
+    std::optional<Entry> Next();
+
+ private:
+#if defined(_WIN32)
+    std::filesystem::directory_iterator iterator_{};
+    std::string current_name_{};
+    bool open_{false};
+#else
+    void* handle_{nullptr};
+#endif
+};
+
+}  // namespace directory_walking
+#endif  // SRC_INCLUDE_DIRECTORY_WALKER_HPP_
@@ -0,0 +1,84 @@
+/*
+ *  file_reader.hpp - Zero-copy file loading for the parser worker threads
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_FILE_READER_HPP_
+#define SRC_INCLUDE_FILE_READER_HPP_
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace file_io {
+
+/*
+ * Loads whole files for one thread at a time. Small files are read into a
+ * scratch buffer that is reused from file to file, so the common case of
+ * many small sources costs no allocations. Files past small_file_limit are
+ * memory mapped instead of copied where the platform allows it.
+ *
+ * The view returned by Load stays valid until the next call to Load or the
+ * reader is destroyed.
+ */
+class FileReader {
+ public:
+    static constexpr std::size_t small_file_limit{256 * 1024};
+
+    FileReader() = default;
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
+    ~FileReader();
+
+    std::optional<std::string_view> Load(const std::filesystem::path& file);
+
+    /*
+     * The same for a path already spelled out as a narrow string, which
+     * spares building a std::filesystem::path on POSIX systems.
+     */
+    std::optional<std::string_view> Load(const std::string& file);
+
+    /*
+     * Reads a file of at most small_file_limit bytes into contents, reusing
+     * whatever capacity it has. Returns false, having read nothing, for a
+     * file that is larger or can not be opened; Load deals with both.
+     */
+    static bool ReadSmall(const std::string& file, std::string& contents);
+
+    /*
+     * Hands over the memory behind the view Load returned last, so that it
+     * stays valid past the next Load for as long as the returned handle (or
+     * a copy of it) lives.
+     */
+    std::shared_ptr<const void> Keep();
+
+ private:
+    void Unmap();
+
+    bool ReserveScratch(std::size_t size);
+
+ private:
+    std::unique_ptr<char[]> scratch_{};
+    std::size_t scratch_capacity_{0};
+    void* mapping_{nullptr};
+    std::size_t mapping_size_{0};
+};
+
+}  // namespace file_io
+#endif  // SRC_INCLUDE_FILE_READER_HPP_
@@ -0,0 +1,57 @@
+/*
+ *  file_result.hpp - Per-file scan results shared by the parser and caches
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_FILE_RESULT_HPP_
+#define SRC_INCLUDE_FILE_RESULT_HPP_
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace parser_info {
+
+/*
+ * Pattern ids number the built-in keywords first (in keyword_pairs_ order),
+ * followed by the custom regexes in the order they were passed. column and
+ * length locate the match within line, which views the file's contents (or
+ * the scan cache) and so is only valid until the file's result is recorded.
+ */
+struct Hit {
+    std::size_t line_number;
+    std::size_t pattern;
+    std::string_view line;
+    std::size_t column;
+    std::size_t length;
+};
+
+/*
+ * Everything a single file contributed to a scan. Hits are only collected
+ * when the scan was given a hit callback.
+ */
+struct FileResult {
+    std::vector<std::size_t> pattern_counts{};
+    std::vector<Hit> hits{};
+
+    void Reset(const std::size_t pattern_count) {
+        pattern_counts.assign(pattern_count, 0);
+        hits.clear();
+    }
+};
+
+}  // namespace parser_info
+#endif  // SRC_INCLUDE_FILE_RESULT_HPP_
@@ -0,0 +1,175 @@
+/*
+ *  git_repository.hpp - Reading git repositories straight from .git
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_GIT_REPOSITORY_HPP_
+#define SRC_INCLUDE_GIT_REPOSITORY_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace git_reading {
+
+/*
+ * A SHA-1 object name; repositories using SHA-256 are not supported.
+ */
+using ObjectId = std::array<std::uint8_t, 20>;
+
+std::string ToHex(const ObjectId& id);
+
+enum class ObjectType : std::uint8_t {
+    Commit = 1,
+    Tree = 2,
+    Blob = 3,
+    Tag = 4,
+};
+
+/*
+ * A file that differs between the working tree and a revision.
+ */
+struct ChangedFile {
+    // relative to the top of the working tree, '/' separated
+    std::string path{};
+    // the file's blob at the revision, nullopt for a file added since
+    std::optional<ObjectId> base{std::nullopt};
+    // gone from the working tree
+    bool deleted{false};
+};
+
+/*
+ * Reads the repository a working tree belongs to without running git: refs
+ * and packed refs, the index, and objects both loose and packed (deltas
+ * included). Nothing is ever written, and nothing is fetched.
+ *
+ * Owned by a single thread.
+ */
+class Repository {
+ public:
+    /*
+     * Opens the repository directory is in, looking upwards from it the way
+     * git does. Linked worktrees and alternate object directories work;
+     * throws std::runtime_error outside of a working tree, or for a
+     * repository using SHA-256 object names.
+     */
+    explicit Repository(const std::filesystem::path& directory);
+    Repository(const Repository&) = delete;
+    Repository& operator=(const Repository&) = delete;
+    ~Repository();
+
+    const std::filesystem::path& WorkTree() const;
+
+    /*
+     * The commit revision names: a full or abbreviated object name, HEAD
+     * (or @), or a branch, tag or remote-tracking branch, followed by any
+     * number of ~N (Nth first-parent ancestor) and ^N (Nth parent) steps.
+     * Tags are followed to the commit they point at. Throws
+     * std::runtime_error for a revision that can not be resolved.
+     */
+    ObjectId ResolveCommit(std::string_view revision);
+
+    /*
+     * Every file the working tree adds, modifies or deletes relative to the
+     * tree of commit, for paths wanted returns true for. Staged and
+     * unstaged changes both count; untracked files do not, as with
+     * git diff. Files whose stat data still matches the index are taken to
+     * hold what the index says without being read, others of the size the
+     * index has are compared with the index's version, and unchanged
+     * directories are skipped wholesale where the index caches their
+     * trees, so the cost grows with the size of the change rather than the
+     * tree. The stat checks are spread over thread_count threads, and
+     * wanted may be called from any of them. Throws std::runtime_error for
+     * an index or tree that can not be read, including split and sparse
+     * indexes, which are not supported.
+     */
+    std::vector<ChangedFile> ChangesSince(
+        const ObjectId& commit,
+        const std::function<bool(std::string_view path)>& wanted,
+        std::size_t thread_count);
+
+    /*
+     * Reads the blob id into contents, reusing its capacity. Returns false
+     * if it is missing, corrupt or not a blob.
+     */
+    bool ReadBlob(const ObjectId& id, std::string& contents);
+
+ private:
+    struct Pack;
+
+    struct IndexEntry;
+
+    /*
+     * Reads the entries of the index, one for every path (the stages of a
+     * conflicted path are folded into one), and the trees it caches.
+     */
+    void ReadIndex(std::string_view index, std::vector<IndexEntry>& entries);
+
+    bool ReadObject(const ObjectId& id, ObjectType& type, std::string& data);
+
+    bool ReadLooseObject(const ObjectId& id, ObjectType& type,
+                         std::string& data);
+
+    bool ReadPackedObject(Pack& pack, std::uint64_t offset, ObjectType& type,
+                          std::string& data);
+
+    /*
+     * The object named by a hex prefix, if exactly one object has it.
+     */
+    std::optional<ObjectId> FindAbbreviated(std::string_view prefix);
+
+    std::optional<ObjectId> ReadRef(std::string_view name);
+
+    /*
+     * The commit or tree id names, following tags.
+     */
+    ObjectId Peel(ObjectId id, ObjectType wanted);
+
+    std::vector<ObjectId> Parents(const ObjectId& commit);
+
+    /*
+     * Compares the tree id, found at prefix, with the index entries below
+     * it, recording the base blob of every entry the tree has and the
+     * files it has that the index does not.
+     */
+    void CompareTree(const ObjectId& id, const std::string& prefix,
+                     std::size_t first, std::size_t last,
+                     std::vector<IndexEntry>& entries,
+                     const std::function<bool(std::string_view)>& wanted,
+                     std::vector<ChangedFile>& deleted);
+
+ private:
+    std::filesystem::path work_tree_{};
+    std::filesystem::path git_directory_{};
+    // shared by every worktree of the repository
+    std::filesystem::path common_directory_{};
+    std::vector<std::filesystem::path> object_directories_{};
+    std::vector<std::unique_ptr<Pack>> packs_{};
+    // the index's cached tree of every directory it has a valid one for
+    std::unordered_map<std::string, ObjectId> cached_trees_{};
+    std::string scratch_{};
+};
+
+}  // namespace git_reading
+#endif  // SRC_INCLUDE_GIT_REPOSITORY_HPP_
@@ -0,0 +1,134 @@
+/*
+ *  ignore_rules.hpp - .gitignore style rules for pruning the directory walk
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_IGNORE_RULES_HPP_
+#define SRC_INCLUDE_IGNORE_RULES_HPP_
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ignore_rules {
+
+/*
+ * Ignore files read from every directory, in increasing order of precedence.
+ */
+constexpr std::array<std::string_view, 2> ignore_file_names{
+    ".gitignore",
+    ".profileignore",
+};
+
+/*
+ * Matches a gitignore glob against a '/' separated path: '*' and '?' never
+ * match a '/', "[...]" is a character class ('!' or '^' negates it), a
+ * backslash escapes the next character, and "**" as a whole path segment
+ * matches any number of directories.
+ */
+bool GlobMatch(std::string_view pattern, std::string_view text);
+
+/*
+ * The rules of one ignore file (or several concatenated), compiled once.
+ * Patterns without wildcards and "*.ext" style patterns are compared
+ * directly; everything else goes through GlobMatch.
+ */
+class RuleSet {
+ public:
+    /*
+     * Adds every rule in the text of an ignore file. Later rules take
+     * precedence over earlier ones.
+     */
+    void AddRules(std::string_view text);
+
+    bool Empty() const { return rules_.empty(); }
+
+    /*
+     * relative_path is relative to the directory the rules were read from.
+     * Returns whether the last matching rule ignores the path, or nullopt if
+     * no rule matches it.
+     */
+    std::optional<bool> Match(std::string_view relative_path,
+                              bool is_directory) const;
+
+ private:
+    enum class MatchKind : std::uint8_t {
+        Literal,
+        Suffix,
+        Glob,
+    };
+
+    struct Rule {
+        std::string pattern;
+        MatchKind kind;
+        bool negated;
+        bool directory_only;
+        bool anchored;
+    };
+
+    void AddRule(std::string_view line);
+
+ private:
+    std::vector<Rule> rules_{};
+};
+
+/*
+ * The rules in effect for one directory: its own ignore files plus those of
+ * every ancestor below the scan root. Scopes are shared by all directories
+ * that add no ignore files of their own, so most directories cost nothing.
+ */
+class IgnoreScope {
+ public:
+    /*
+     * Returns a scope for directory that adds the rules in the given ignore
+     * files (names relative to directory) to parent, or parent itself when
+     * none of them contain any rules.
+     */
+    static std::shared_ptr<const IgnoreScope> Extend(
+        std::shared_ptr<const IgnoreScope> parent,
+        const std::filesystem::path& directory,
+        std::span<const std::string_view> ignore_files);
+
+    /*
+     * path must lie below the directory this scope was created for. Deeper
+     * scopes take precedence over their ancestors.
+     */
+    bool IsIgnored(const std::filesystem::path& path, bool is_directory) const;
+
+    /*
+     * The same for a path already spelled out as a narrow string, with the
+     * platform's separators.
+     */
+    bool IsIgnored(std::string_view path, bool is_directory) const;
+
+ private:
+    IgnoreScope(std::shared_ptr<const IgnoreScope> parent, std::string base,
+                RuleSet rules);
+
+ private:
+    std::shared_ptr<const IgnoreScope> parent_;
+    std::string base_;
+    RuleSet rules_;
+};
+
+}  // namespace ignore_rules
+#endif  // SRC_INCLUDE_IGNORE_RULES_HPP_
@@ -0,0 +1,41 @@
+/*
+ *  inflate.hpp - Decompression of zlib streams
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_INFLATE_HPP_
+#define SRC_INCLUDE_INFLATE_HPP_
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace inflating {
+
+/*
+ * Decompresses the zlib stream (RFC 1950 around RFC 1951 deflate data) at
+ * the start of input into output, replacing whatever it held. Anything in
+ * input past the end of the stream is ignored, as git packs store objects
+ * back to back. size_hint, if known, is reserved up front.
+ *
+ * Returns false for a stream that is malformed, truncated, uses a preset
+ * dictionary or fails its Adler-32 checksum.
+ */
+bool InflateZlib(std::string_view input, std::string& output,
+                 std::size_t size_hint = 0);
+
+}  // namespace inflating
+#endif  // SRC_INCLUDE_INFLATE_HPP_
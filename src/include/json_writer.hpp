@@ -0,0 +1,62 @@
+/*
+ *  json_writer.hpp - Helpers shared by everything that emits JSON
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_JSON_WRITER_HPP_
+#define SRC_INCLUDE_JSON_WRITER_HPP_
+
+#include <format>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+namespace json_writing {
+
+/*
+ * Appends text as a quoted JSON string. Bytes are copied through as they
+ * are, so UTF-8 stays UTF-8.
+ */
+inline void AppendJsonString(std::string& buffer, const std::string_view text) {
+    buffer.push_back('"');
+    for (const char character : text) {
+        switch (character) {
+            case '"':
+                buffer.append("\\\"");
+                break;
+            case '\\':
+                buffer.append("\\\\");
+                break;
+            case '\n':
+                buffer.append("\\n");
+                break;
+            case '\t':
+                buffer.append("\\t");
+                break;
+            default:
+                if (static_cast<unsigned char>(character) < 0x20) {
+                    std::format_to(std::back_inserter(buffer), "\\u{:04x}",
+                                   static_cast<unsigned>(character));
+                } else {
+                    buffer.push_back(character);
+                }
+        }
+    }
+    buffer.push_back('"');
+}
+
+}  // namespace json_writing
+#endif  // SRC_INCLUDE_JSON_WRITER_HPP_
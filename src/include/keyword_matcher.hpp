@@ -0,0 +1,144 @@
+/*
+ *  keyword_matcher.hpp - Multi-pattern keyword automaton for comment scanning
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_KEYWORD_MATCHER_HPP_
+#define SRC_INCLUDE_KEYWORD_MATCHER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "byte_scanner.hpp"
+
+namespace keyword_matching {
+
+/*
+ * Same definition as \w in an ECMAScript std::regex: [A-Za-z0-9_]
+ */
+constexpr bool IsWordCharacter(const char character) {
+    return (character >= 'a' && character <= 'z') ||
+           (character >= 'A' && character <= 'Z') ||
+           (character >= '0' && character <= '9') || character == '_';
+}
+
+/*
+ * Aho-Corasick automaton flattened into a full DFA (one transition per byte
+ * per state), so a whole text is matched against every keyword in a single
+ * pass. Keywords flagged with word_boundary only match where a regex "\b"
+ * would hold right before them, with the start of the text treated the same
+ * way std::regex_search treats it.
+ */
+class KeywordAutomaton {
+ public:
+    struct Keyword {
+        std::string_view literal;
+        bool word_boundary;
+    };
+
+    explicit KeywordAutomaton(std::span<const Keyword> keywords);
+
+    /*
+     * Calls on_match(keyword_index, match_begin) for every occurrence of
+     * every keyword in text, in order of where each occurrence ends.
+     */
+    template <typename Callback>
+    void ForEachMatch(const std::string_view text, Callback&& on_match) const {
+        std::uint32_t state{0};
+
+        for (std::size_t position{0}; position < text.size(); ++position) {
+            state = transitions_[(state << 8) |
+                                 static_cast<unsigned char>(text[position])];
+
+            for (std::uint32_t output{output_offsets_[state]};
+                 output < output_offsets_[state + 1]; ++output) {
+                const Pattern& pattern{patterns_[outputs_[output]]};
+                const std::size_t begin{position + 1 - pattern.length};
+
+                if (!pattern.word_boundary ||
+                    IsWordBoundary(text, begin)) [[likely]] {
+                    on_match(outputs_[output], begin);
+                }
+            }
+        }
+    }
+
+ private:
+    struct Pattern {
+        std::size_t length;
+        bool word_boundary;
+    };
+
+    static bool IsWordBoundary(const std::string_view text,
+                               const std::size_t position) {
+        const bool before{position != 0 &&
+                          IsWordCharacter(text[position - 1])};
+        return before != IsWordCharacter(text[position]);
+    }
+
+    std::vector<Pattern> patterns_{};
+    std::vector<std::uint32_t> transitions_{};
+    std::vector<std::uint32_t> output_offsets_{};
+    std::vector<std::uint32_t> outputs_{};
+};
+
+/*
+ * Finds where any of a set of keywords occurs in a text, regardless of word
+ * boundaries, so that every match a KeywordAutomaton over the same keywords
+ * finds starts at one of them. Each keyword is anchored on its rarest byte,
+ * going by how often bytes show up in source code, so that a keyword like
+ * "include" is not looked for at every 'i'. Anchor bytes are grouped four to
+ * a group, each group is searched for with byte_scanner::FindAnyByte, and
+ * the keywords are compared in full only around the bytes found.
+ */
+class LiteralPrefilter {
+ public:
+    explicit LiteralPrefilter(
+        std::span<const KeywordAutomaton::Keyword> keywords);
+
+    /*
+     * The start of the first occurrence of a keyword in [begin, end), or end
+     * if there is none.
+     */
+    const char* Next(const char* begin, const char* end) const;
+
+ private:
+    static constexpr std::size_t first_window{256};
+
+    struct Literal {
+        std::string text;
+        std::size_t anchor;
+    };
+
+    /*
+     * The earliest start in [begin, end) of a keyword anchored on the byte
+     * at position, or end if no keyword occurs around it.
+     */
+    const char* KeywordAround(const char* position, const char* begin,
+                              const char* end) const;
+
+ private:
+    std::vector<byte_scanner::ByteSet> groups_{};
+    std::vector<Literal> literals_{};
+    std::size_t longest_anchor_{0};
+};
+
+}  // namespace keyword_matching
+#endif  // SRC_INCLUDE_KEYWORD_MATCHER_HPP_
@@ -0,0 +1,321 @@
+/*
+ *  language_registry.hpp - Perfect hashed lookup of languages by extension
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_LANGUAGE_REGISTRY_HPP_
+#define SRC_INCLUDE_LANGUAGE_REGISTRY_HPP_
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "comment_lexer.hpp"
+#include "comment_syntax.hpp"
+
+namespace language_registry {
+
+/*
+ * One slot of an extension table. language indexes the registry's languages,
+ * built-in ones first in the order of parser_info::builtin_languages; free
+ * slots have an empty extension.
+ */
+struct ExtensionSlot {
+    std::string_view extension{};
+    std::uint32_t language{0};
+};
+
+/*
+ * FNV-1a over the code units of extension, starting from a seeded basis.
+ * Narrow and wide paths hash the same ASCII extension alike.
+ */
+template <typename Char>
+constexpr std::uint64_t HashExtension(
+    const std::basic_string_view<Char> extension, const std::uint64_t seed) {
+    std::uint64_t hash{0xcbf29ce484222325 ^ seed};
+    for (const Char unit : extension) {
+        hash ^= static_cast<std::make_unsigned_t<Char>>(unit);
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+/*
+ * The slot hash lands in, out of slot_count (a power of two), taken from the
+ * top bits of a multiplicative mix since FNV's low bits are weak.
+ */
+constexpr std::size_t SlotIndex(const std::uint64_t hash,
+                                const std::size_t slot_count) {
+    const std::uint64_t mixed{(hash ^ (hash >> 32)) * 0x9e3779b97f4a7c15};
+    return static_cast<std::size_t>(mixed >>
+                                    (64 - std::countr_zero(slot_count)));
+}
+
+template <typename Char>
+constexpr bool SameExtension(const std::string_view stored,
+                             const std::basic_string_view<Char> extension) {
+    return stored.size() == extension.size() &&
+           std::ranges::equal(stored, extension, [](char left, Char right) {
+               return static_cast<unsigned char>(left) ==
+                      static_cast<std::make_unsigned_t<Char>>(right);
+           });
+}
+
+/*
+ * At most a quarter full, so a seed without collisions turns up quickly.
+ */
+constexpr std::size_t SlotCountFor(const std::size_t extension_count) {
+    return std::max<std::size_t>(16, std::bit_ceil(extension_count) * 4);
+}
+
+/*
+ * Tries seeds until every entry lands in a slot of its own, making the table
+ * a perfect hash: a lookup costs one hash, one slot and one comparison.
+ * Returns the seed, or nullopt if none of the first few thousand work, which
+ * is certain when entries repeat an extension.
+ */
+constexpr std::optional<std::uint64_t> PlaceExtensions(
+    const std::span<ExtensionSlot> slots,
+    const std::span<const ExtensionSlot> entries) {
+    constexpr std::uint64_t seed_limit{4096};
+
+    for (std::uint64_t seed{0}; seed < seed_limit; ++seed) {
+        std::ranges::fill(slots, ExtensionSlot{});
+        const bool placed{
+            std::ranges::all_of(entries, [&](const ExtensionSlot& entry) {
+                ExtensionSlot& slot{slots[SlotIndex(
+                    HashExtension(entry.extension, seed), slots.size())]};
+                if (!slot.extension.empty()) {
+                    return false;
+                }
+                slot = entry;
+                return true;
+            })};
+        if (placed) {
+            return seed;
+        }
+    }
+    return std::nullopt;
+}
+
+/*
+ * Calls visit with every extension in a space separated list.
+ */
+template <typename Visit>
+constexpr void ForEachExtension(const std::string_view extensions,
+                                Visit&& visit) {
+    std::size_t start{0};
+    while (start < extensions.size()) {
+        std::size_t end{extensions.find(' ', start)};
+        if (end == std::string_view::npos) {
+            end = extensions.size();
+        }
+        if (end != start) {
+            visit(extensions.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+}
+
+template <std::size_t SlotCount>
+struct ExtensionTable {
+    std::array<ExtensionSlot, SlotCount> slots{};
+    std::uint64_t seed{0};
+    bool complete{false};
+};
+
+constexpr std::size_t CountBuiltinExtensions() {
+    std::size_t count{0};
+    for (const parser_info::BuiltinLanguage& language :
+         parser_info::builtin_languages) {
+        ForEachExtension(language.extensions,
+                         [&count](std::string_view) { count++; });
+    }
+    return count;
+}
+
+constexpr std::size_t builtin_extension_count{CountBuiltinExtensions()};
+
+constexpr ExtensionTable<SlotCountFor(builtin_extension_count)>
+MakeBuiltinTable() {
+    std::array<ExtensionSlot, builtin_extension_count> entries{};
+    std::size_t next{0};
+    for (std::uint32_t language{0};
+         language < parser_info::builtin_languages.size(); ++language) {
+        ForEachExtension(
+            parser_info::builtin_languages[language].extensions,
+            [&](const std::string_view extension) {
+                entries[next++] = ExtensionSlot{extension, language};
+            });
+    }
+
+    ExtensionTable<SlotCountFor(builtin_extension_count)> table{};
+    const std::optional<std::uint64_t> seed{
+        PlaceExtensions(table.slots, entries)};
+    table.seed = seed.value_or(0);
+    table.complete = seed.has_value();
+    return table;
+}
+
+/*
+ * The extensions of every built-in language, hashed while compiling.
+ */
+constexpr ExtensionTable<SlotCountFor(builtin_extension_count)>
+    builtin_extensions{MakeBuiltinTable()};
+
+static_assert(builtin_extensions.complete,
+              "Every built-in extension must belong to a single language");
+
+/*
+ * What std::filesystem::path::extension would return, as a view into path:
+ * the filename from its last '.' on, or nothing for dotfiles, "." and "..".
+ */
+template <typename Char>
+constexpr std::basic_string_view<Char> ExtensionOf(
+    const std::basic_string_view<Char> path) {
+    std::size_t start{0};
+    for (std::size_t index{path.size()}; index != 0; --index) {
+        const Char unit{path[index - 1]};
+        if (unit == Char{'/'} ||
+            unit == Char{std::filesystem::path::preferred_separator}) {
+            start = index;
+            break;
+        }
+    }
+
+    const std::basic_string_view<Char> filename{path.substr(start)};
+    const std::size_t dot{filename.rfind(Char{'.'})};
+    if (dot == std::basic_string_view<Char>::npos || dot == 0 ||
+        (dot == 1 && filename.size() == 2 && filename[0] == Char{'.'})) {
+        return {};
+    }
+    return filename.substr(dot);
+}
+
+/*
+ * A language as scans see it, whether built in or from a language file.
+ */
+struct Language {
+    std::string_view name;
+    std::string_view extensions;
+    const comment_lexing::Syntax* syntax;
+};
+
+/*
+ * The extension a file was recognized by, as registered (so it lives as long
+ * as the registry), and its language.
+ */
+struct Match {
+    std::string_view extension;
+    const Language* language;
+};
+
+/*
+ * Every language a scan recognizes. Without a language file lookups go
+ * straight to builtin_extensions; languages defined in one are hashed into
+ * an equivalent table when the registry is built.
+ *
+ * A language file holds one section per language:
+ *
+ *   [Ruby]
+ *   extensions = .rb .rake
+ *   line_comment = #
+ *   block_comment = =begin =end
+ *   nested_comments = false
+ *   quotes = "'
+ *
+ * extensions and at least one kind of comment are required. quotes lists
+ * which of " ' and ` start strings ("' when left out). Lines starting with
+ * '#' or ';' are comments. A defined language takes over its extensions from
+ * any built-in one.
+ */
+class LanguageRegistry {
+ public:
+    /*
+     * Throws std::runtime_error naming the line of the first problem in
+     * language_file.
+     */
+    explicit LanguageRegistry(
+        const std::optional<std::filesystem::path>& language_file =
+            std::nullopt);
+    LanguageRegistry(const LanguageRegistry&) = delete;
+    LanguageRegistry& operator=(const LanguageRegistry&) = delete;
+
+    /*
+     * The language of file by its extension. Never allocates.
+     */
+    std::optional<Match> Find(const std::filesystem::path& file) const;
+
+    /*
+     * The same for a narrow path or a bare file name.
+     */
+    std::optional<Match> Find(std::string_view file) const;
+
+    std::span<const Language> Languages() const;
+
+    /*
+     * The defined languages written out in full, empty without any. Changes
+     * whenever they do, so cached results can be keyed on it.
+     */
+    const std::string& Fingerprint() const;
+
+ private:
+    struct Definition {
+        std::string name{};
+        std::string extensions{};
+        std::string line_comment{};
+        std::string block_open{};
+        std::string block_close{};
+        std::string quotes{"\"'"};
+        bool nested_comments{false};
+        std::size_t line_number{0};
+    };
+
+    void Load(const std::filesystem::path& language_file);
+
+    void HashExtensions(const std::filesystem::path& language_file);
+
+    template <typename Char>
+    std::optional<Match> FindExtension(std::basic_string_view<Char> file) const;
+
+ private:
+    std::vector<Definition> definitions_{};
+    std::vector<comment_lexing::Syntax> syntaxes_{};
+    std::vector<Language> languages_{};
+    std::vector<ExtensionSlot> defined_slots_{};
+    std::span<const ExtensionSlot> slots_{builtin_extensions.slots};
+    std::uint64_t seed_{builtin_extensions.seed};
+    std::string fingerprint_{};
+};
+
+/*
+ * The comment markers of syntax as they are written, separated by spaces:
+ * the line comment, the block comment's opening and closing markers and
+ * """ for languages with docstrings.
+ */
+std::string DescribeComments(const comment_lexing::Syntax& syntax);
+
+}  // namespace language_registry
+#endif  // SRC_INCLUDE_LANGUAGE_REGISTRY_HPP_
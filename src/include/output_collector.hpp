@@ -0,0 +1,91 @@
+/*
+ *  output_collector.hpp - Per-worker buffering of verbose scan output
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_OUTPUT_COLLECTOR_HPP_
+#define SRC_INCLUDE_OUTPUT_COLLECTOR_HPP_
+
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace output_collection {
+
+/*
+ * Gathers formatted output from every worker without making them contend on
+ * the output stream. Each worker appends a file's worth of text to its own
+ * buffer and then ends the record:
+ *
+ *  - unsorted, the buffer is handed to the stream in one large write once it
+ *    passes flush_threshold, so workers only meet on the stream lock once
+ *    per quarter megabyte of output
+ *  - sorted, every record is kept with its key and Finish writes them out
+ *    ordered by key, which makes the output identical from run to run
+ */
+class OutputCollector {
+ public:
+    static constexpr std::size_t flush_threshold{256 * 1024};
+
+    OutputCollector(std::FILE* stream, std::size_t worker_count, bool sorted);
+
+    std::string& Buffer(const std::size_t worker) {
+        return buffers_[worker].text;
+    }
+
+    /*
+     * Sorted records are ordered by the file they came from.
+     */
+    void EndRecord(std::size_t worker, const std::filesystem::path& file);
+
+    /*
+     * Writes out everything still buffered. Only call once every worker is
+     * done appending.
+     */
+    void Finish();
+
+    /*
+     * Writes text straight to the stream, for output that belongs to no
+     * worker such as headers and trailers.
+     */
+    void Write(std::string_view text);
+
+    /*
+     * Bytes handed to the stream so far.
+     */
+    std::size_t BytesWritten() const { return bytes_written_; }
+
+ private:
+    struct alignas(64) WorkerBuffer {
+        std::string text{};
+        std::vector<std::pair<std::string, std::string>> records{};
+    };
+
+ private:
+    std::FILE* stream_;
+    std::vector<WorkerBuffer> buffers_;
+    std::mutex write_lock_{};
+    std::size_t bytes_written_{0};
+    const bool sorted_;
+};
+
+}  // namespace output_collection
+#endif  // SRC_INCLUDE_OUTPUT_COLLECTOR_HPP_
@@ -0,0 +1,81 @@
+/*
+ *  partial_result.hpp - Saving and merging the results of sharded scans
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_PARTIAL_RESULT_HPP_
+#define SRC_INCLUDE_PARTIAL_RESULT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "profile.hpp"
+
+namespace partial_results {
+
+constexpr std::uint32_t format_version{2};
+
+/*
+ * The summary of one shard of a scan, statistics and exceeded thresholds
+ * aside, and the thresholds the scan was run with, which only the merged
+ * totals can be held to.
+ */
+struct PartialResult {
+    profile::Shard shard{};
+    profile::ScanSummary summary{};
+    std::vector<profile::Threshold> thresholds{};
+    std::optional<std::size_t> max_hits{std::nullopt};
+};
+
+/*
+ * Files are binary, in native byte order, and only meant to be merged on
+ * the kind of machine that wrote them:
+ *
+ *   "PRFSHARD", u32 format_version, u32 shard index, u32 shard count,
+ *   u32 stopped_early, u64 file_count, u64 thread_count,
+ *   u32 count of patterns, each u32 custom, u64 count, u32 length, name
+ *   u32 count of extensions, each u64 files, u32 length, name
+ *   u32 count of errors, each u32 length, text
+ *   u32 count of thresholds, each u64 limit, u32 length, pattern
+ *   u32 has max_hits, u64 max_hits
+ *
+ * The file is written in full under a temporary name first and then renamed
+ * over file. Returns false if it could not be written.
+ */
+bool WritePartial(const std::filesystem::path& file,
+                  const PartialResult& partial);
+
+/*
+ * std::nullopt if file can not be read, was written by another format
+ * version or is not a partial result at all.
+ */
+std::optional<PartialResult> ReadPartial(const std::filesystem::path& file);
+
+/*
+ * The summary of the whole scan the partials are the shards of, with its
+ * totals checked against the thresholds the shards were run with. Throws
+ * std::invalid_argument when a shard is missing or given twice, when the
+ * partials split the scan a different number of ways, or when they count
+ * different patterns or were run with different thresholds.
+ */
+profile::ScanSummary MergePartials(std::span<const PartialResult> partials);
+
+}  // namespace partial_results
+#endif  // SRC_INCLUDE_PARTIAL_RESULT_HPP_
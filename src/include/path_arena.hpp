@@ -0,0 +1,154 @@
+/*
+ *  path_arena.hpp - Compact storage for the paths a scan visits
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_PATH_ARENA_HPP_
+#define SRC_INCLUDE_PATH_ARENA_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace path_arena {
+
+using PathId = std::uint32_t;
+
+constexpr PathId no_path{std::numeric_limits<PathId>::max()};
+
+/*
+ * Hands out memory from large blocks with a pointer bump, and frees nothing
+ * until Reset, which keeps the blocks for whatever is allocated next. Owned
+ * by a single thread.
+ */
+class BumpArena {
+ public:
+    static constexpr std::size_t block_size{64 * 1024};
+
+    BumpArena() = default;
+    BumpArena(const BumpArena&) = delete;
+    BumpArena& operator=(const BumpArena&) = delete;
+    BumpArena(BumpArena&&) = default;
+    BumpArena& operator=(BumpArena&&) = default;
+
+    /*
+     * A copy of text that lives until the next Reset.
+     */
+    std::string_view Copy(std::string_view text);
+
+    void Reset();
+
+ private:
+    struct Block {
+        std::unique_ptr<char[]> memory{};
+        std::size_t size{0};
+    };
+
+    char* Allocate(std::size_t size);
+
+ private:
+    std::vector<Block> blocks_{};
+    std::size_t current_{0};
+    std::size_t used_{0};
+};
+
+/*
+ * Every path a scan queues, each stored as the id of its parent plus its
+ * own name, so a directory's path is kept once however many children it
+ * has and a queued file costs a 32-bit id instead of a full path. Roots
+ * (and archive members) are stored whole, with no parent.
+ *
+ * Nodes live in buckets that double in size and never move once allocated,
+ * so a small scan stays small and a huge one needs few buckets. Any number of
+ * threads may add nodes at once, each through its own writer slot, which
+ * takes ids from a shared counter in runs and copies names into its own
+ * BumpArena. A node may be read by any thread that learned its id through
+ * something that synchronizes with the thread that added it, such as a
+ * mutex protected queue.
+ */
+class PathArena {
+ public:
+    explicit PathArena(std::size_t writer_count);
+    PathArena(const PathArena&) = delete;
+    PathArena& operator=(const PathArena&) = delete;
+    ~PathArena();
+
+    /*
+     * Throws std::length_error once every 32-bit id has been handed out.
+     */
+    PathId Add(std::size_t writer, PathId parent, std::string_view name);
+
+    std::string_view Name(PathId path) const;
+
+    /*
+     * The name of the root path is under, which is path itself for a root.
+     */
+    std::string_view Root(PathId path) const;
+
+    /*
+     * Replaces the contents of full_path with path spelled out, joined with
+     * the platform's separator the way std::filesystem::path::operator/
+     * would join it.
+     */
+    void Resolve(PathId path, std::string& full_path) const;
+
+    /*
+     * Appends name to full_path as a child of it.
+     */
+    static void AppendName(std::string& full_path, std::string_view name);
+
+    /*
+     * Forgets every node while keeping their memory. Only valid while no
+     * other thread uses the arena.
+     */
+    void Clear();
+
+ private:
+    struct Node {
+        const char* name;
+        std::uint32_t length;
+        PathId parent;
+    };
+
+    struct alignas(64) Writer {
+        BumpArena names{};
+        std::uint64_t next{0};
+        std::uint64_t end{0};
+    };
+
+    // bucket b holds 2^(first_bucket_bits + b) nodes
+    static constexpr std::size_t first_bucket_bits{10};
+    static constexpr std::size_t bucket_count{33 - first_bucket_bits};
+    static constexpr std::uint64_t id_run{256};
+
+    const Node& At(PathId path) const;
+
+    Node& Claim(PathId path);
+
+ private:
+    std::array<std::atomic<Node*>, bucket_count> buckets_{};
+    std::vector<Writer> writers_;
+    std::atomic<std::uint64_t> next_run_{0};
+};
+
+}  // namespace path_arena
+#endif  // SRC_INCLUDE_PATH_ARENA_HPP_
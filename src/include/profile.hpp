@@ -0,0 +1,286 @@
+/*
+ *  profile.hpp - Public interface for embedding the scanner as a library
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_PROFILE_HPP_
+#define SRC_INCLUDE_PROFILE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "scan_statistics.hpp"
+
+namespace profile {
+
+enum class IoBackend : std::uint8_t {
+    Blocking,  // one open, read and close after another on every worker
+    IoUring,   // batches of reads through io_uring, where the kernel has it
+};
+
+/*
+ * Fails a scan once pattern, a built-in keyword or a custom regex as
+ * written, has been found in more than limit comment lines.
+ */
+struct Threshold {
+    std::string pattern{};
+    std::size_t limit{0};
+};
+
+/*
+ * Part index of count disjoint parts of a scan. Each file goes to the part
+ * picked by a hash of its path relative to the root it was found under,
+ * '/' separated (or its path inside an archive), so every machine scanning
+ * the same tree agrees on which files belong to which part however the root
+ * is spelled.
+ */
+struct Shard {
+    std::size_t index{0};
+    std::size_t count{1};
+};
+
+struct ScanConfig {
+    std::filesystem::path directory{"."};
+    /*
+     * More roots scanned in the same pass as directory, on the same threads.
+     * A root inside another root is only scanned once.
+     */
+    std::vector<std::filesystem::path> extra_directories{};
+    /*
+     * A tar archive to scan instead of directory, "-" to read one from
+     * stdin. Hits report paths relative to the archive.
+     */
+    std::optional<std::filesystem::path> archive{std::nullopt};
+    std::vector<std::string> custom_regexes{};
+    /*
+     * Extra language definitions; see language_registry::LanguageRegistry.
+     */
+    std::optional<std::filesystem::path> language_file{std::nullopt};
+    /*
+     * Scans saving the same cache file at the same time, such as shards run
+     * in parallel, overwrite each other's entries, so they need one each.
+     */
+    std::optional<std::filesystem::path> cache_file{std::nullopt};
+    bool use_ignore_files{true};
+    /*
+     * Threads matching patterns. Zero picks DefaultThreadCount().
+     */
+    std::size_t thread_count{0};
+    /*
+     * Threads walking directories and reading files ahead of the matching
+     * threads, which then only parse what was read into a bounded set of
+     * buffers. Zero has every thread walk, read and match on its own.
+     */
+    std::size_t io_thread_count{0};
+    /*
+     * Moves threads between walking and reading and matching as the scan
+     * goes, based on how full the read buffers are and how fast files get
+     * matched. Only applies with io_thread_count set; the total number of
+     * threads stays the same.
+     */
+    bool auto_tune{false};
+    /*
+     * IoUring falls back to Blocking wherever io_uring is unavailable, and
+     * is not used by scans with io_thread_count set.
+     */
+    IoBackend io_backend{IoBackend::Blocking};
+    /*
+     * With more than one thread, files at least split_file_limit bytes long
+     * are cut into line aligned chunks of about split_chunk_size bytes that
+     * any idle thread can pick up, so one huge file does not keep a single
+     * thread busy long after the rest have run dry.
+     */
+    std::size_t split_file_limit{16 * 1024 * 1024};
+    std::size_t split_chunk_size{4 * 1024 * 1024};
+    /*
+     * The scan stops as soon as it exceeds one of these, without visiting
+     * the rest of the tree; see ScanSummary::exceeded.
+     */
+    std::vector<Threshold> thresholds{};
+    /*
+     * The same for the matches of every pattern taken together.
+     */
+    std::optional<std::size_t> max_hits{std::nullopt};
+    /*
+     * Stops the scan early once a stop is requested on it, from any thread.
+     */
+    std::stop_token stop_token{};
+    /*
+     * Only scans the files of this part; see MergeSummaries.
+     */
+    std::optional<Shard> shard{std::nullopt};
+};
+
+/*
+ * A single pattern found in a comment. Pattern ids number the built-in
+ * keywords first, followed by the custom regexes in the order they were
+ * configured; keyword is the keyword literal or the regex as written. column
+ * and length give the span of the match within line, in bytes.
+ */
+struct HitRecord {
+    std::size_t line_number;
+    std::size_t pattern;
+    std::string_view keyword;
+    std::string_view line;
+    std::size_t column;
+    std::size_t length;
+    bool custom;
+};
+
+/*
+ * Every hit in one file. worker identifies the scanning thread, is below the
+ * scan's WorkerCount, and no two threads ever share one, so per-worker state
+ * needs no locking.
+ */
+struct FileHits {
+    std::size_t worker;
+    const std::filesystem::path& path;
+    std::span<const HitRecord> hits;
+};
+
+/*
+ * Called once for every file with at least one hit, from the worker threads
+ * and so possibly concurrently. Everything it is handed is only valid for
+ * the duration of the call.
+ */
+using HitCallback = std::function<void(const FileHits&)>;
+
+struct PatternTotal {
+    std::string pattern;
+    std::size_t count;
+    bool custom;
+};
+
+struct ScanSummary {
+    std::size_t file_count{0};
+    std::size_t thread_count{0};
+    std::vector<PatternTotal> patterns{};
+    std::unordered_map<std::string, std::size_t> extension_counts{};
+    /*
+     * Directories that could not be opened and caches that could not be
+     * written. None of them stop a scan.
+     */
+    std::vector<std::string> errors{};
+    /*
+     * The thresholds the scan exceeded, as "pattern>limit" ("hits>limit"
+     * for max_hits).
+     */
+    std::vector<std::string> exceeded{};
+    /*
+     * Set when a threshold or the stop token cut the scan short, in which
+     * case everything above only covers the files scanned up to then.
+     */
+    bool stopped_early{false};
+    scan_statistics::ScanStatistics statistics{};
+};
+
+/*
+ * How the matches of one pattern moved between a revision and the working
+ * tree, file by file: a file holding three more matches than it used to
+ * adds three, one holding two fewer removes two.
+ */
+struct PatternChange {
+    std::string pattern;
+    std::size_t added;
+    std::size_t removed;
+    bool custom;
+};
+
+struct ChangeSummary {
+    /*
+     * The scan of the files added or modified since the revision, in which
+     * thresholds are checked against the added counts.
+     */
+    ScanSummary summary{};
+    // the full object name of the commit the revision named
+    std::string base{};
+    // source files deleted since the revision
+    std::size_t deleted_files{0};
+    std::vector<PatternChange> changes{};
+};
+
+std::size_t DefaultThreadCount();
+
+/*
+ * How many threads a scan with config runs, the I/O threads included.
+ */
+std::size_t WorkerCount(const ScanConfig& config);
+
+/*
+ * Scans config.directory (or config.archive) and blocks until every file
+ * has been profiled, or until the scan is stopped early. Hits are only
+ * collected when on_hits is set. Throws std::regex_error for a custom regex
+ * that does not compile, std::runtime_error for a language file that can not
+ * be loaded and std::invalid_argument for a threshold on an unknown pattern
+ * or a shard that does not exist.
+ */
+ScanSummary Scan(const ScanConfig& config, const HitCallback& on_hits = {});
+
+/*
+ * Scans only the files of config's roots that the working tree adds or
+ * modifies relative to revision (anything git_reading::Repository can
+ * resolve), reading the git repository the roots are in directly, and
+ * scans the revision's version of every modified or deleted file from its
+ * objects to tell what changed. Staged and unstaged changes count alike;
+ * untracked files do not. Hits are only reported for the working tree.
+ *
+ * Throws what Scan throws, std::runtime_error for roots outside of one git
+ * working tree or a revision or repository that can not be read, and
+ * std::invalid_argument for an archive or a shard, which are not
+ * supported.
+ */
+ChangeSummary ScanChanges(const ScanConfig& config, std::string_view revision,
+                          const HitCallback& on_hits = {});
+
+/*
+ * The summary without its statistics as a single line of JSON:
+ *
+ *   {"files":N,"threads":N,"patterns":[{"pattern":"TODO","count":N,
+ *    "custom":false},...],"extensions":{".cpp":N,...},"errors":["..."],
+ *    "exceeded":["BUG>0",...],"stopped_early":false}
+ */
+std::string SummaryJson(const ScanSummary& summary);
+
+/*
+ * The thresholds summary exceeds, spelled the way ScanSummary::exceeded
+ * spells them. Throws std::invalid_argument for a threshold on a pattern
+ * the summary does not count.
+ */
+std::vector<std::string> ExceededThresholds(
+    const ScanSummary& summary, std::span<const Threshold> thresholds,
+    std::optional<std::size_t> max_hits);
+
+/*
+ * Adds up the summaries of scans for the same patterns, such as the shards
+ * of one sharded scan, into the summary a single scan over all of them
+ * would have returned, statistics aside. Nothing is exceeded in it, since
+ * what each scan exceeded says nothing about the totals; check those with
+ * ExceededThresholds. Throws std::invalid_argument if the summaries count
+ * different patterns.
+ */
+ScanSummary MergeSummaries(std::span<const ScanSummary> summaries);
+
+}  // namespace profile
+#endif  // SRC_INCLUDE_PROFILE_HPP_
@@ -0,0 +1,41 @@
+/*
+ *  regex_prefilter.hpp - Literal extraction for prefiltering custom regexes
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_REGEX_PREFILTER_HPP_
+#define SRC_INCLUDE_REGEX_PREFILTER_HPP_
+
+#include <string>
+#include <string_view>
+
+namespace regex_prefilter {
+
+/*
+ * Returns the longest run of literal characters that every match of an
+ * ECMAScript regex must contain, or an empty string when no such run can be
+ * proven. The analysis is conservative: only characters outside of groups,
+ * classes and alternations that are not made optional by a quantifier (or
+ * by any one of several stacked on them) count, and any top level '|' gives
+ * up entirely.
+ *
+ * A text that does not contain the literal can be rejected without running
+ * the regex at all.
+ */
+std::string RequiredLiteral(std::string_view pattern);
+
+}  // namespace regex_prefilter
+#endif  // SRC_INCLUDE_REGEX_PREFILTER_HPP_
@@ -0,0 +1,165 @@
+/*
+ *  result_format.hpp - Machine readable encodings of hits and summaries
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_RESULT_FORMAT_HPP_
+#define SRC_INCLUDE_RESULT_FORMAT_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "profile.hpp"
+
+namespace result_formatting {
+
+enum class OutputFormat : std::uint8_t {
+    Text,
+    JsonLines,
+    Binary,
+};
+
+std::optional<OutputFormat> ParseOutputFormat(std::string_view name);
+
+/*
+ * JSON Lines: one object per line. Every hit is
+ *
+ *   {"type":"hit","path":"...","line_number":N,"pattern":N,"keyword":"...",
+ *    "custom":false,"column":N,"length":N,"line":"..."}
+ *
+ * and the stream ends with {"type":"summary","summary":{...}} holding
+ * profile::SummaryJson. A scan of the changes since a revision writes
+ *
+ *   {"type":"changes","revision":"...","base":"...","deleted_files":N,
+ *    "changes":[{"pattern":"TODO","added":N,"removed":N,"custom":false},...]}
+ *
+ * right before its summary.
+ */
+void AppendJsonHits(std::string& buffer, const profile::FileHits& file);
+
+void AppendJsonChanges(std::string& buffer, std::string_view revision,
+                       const profile::ChangeSummary& changes);
+
+void AppendJsonSummary(std::string& buffer,
+                       const profile::ScanSummary& summary);
+
+/*
+ * Binary: a fixed layout meant to be memory mapped and read in place. All
+ * integers are in native byte order and every record starts on an 8 byte
+ * boundary, so each one can be read through the matching struct below:
+ *
+ *   BinaryHeader
+ *   for every file with hits:
+ *       BinaryFile, followed by hit_count x BinaryHit
+ *   summary, starting at BinaryTrailer::summary_offset:
+ *       BinaryPattern for every pattern, in pattern id order
+ *       BinaryExtension for every recognized extension
+ *       BinaryError for every error
+ *   BinaryTrailer, always the last 32 bytes
+ *
+ * Records begin with their kind and their size in bytes; size includes the
+ * record's text and the zero padding after it, so adding size to a record's
+ * offset gives the next one. The text of a record follows its struct
+ * directly and is not NUL terminated.
+ */
+enum class RecordKind : std::uint32_t {
+    File = 1,
+    Hit = 2,
+    Pattern = 3,
+    Extension = 4,
+    Error = 5,
+};
+
+constexpr std::uint32_t binary_format_version{1};
+
+struct BinaryHeader {
+    std::array<char, 8> magic;  // "PRFHITS" and a NUL
+    std::uint32_t version;
+    std::uint32_t reserved;
+};
+
+struct BinaryFile {
+    RecordKind kind;
+    std::uint32_t size;
+    std::uint32_t hit_count;
+    std::uint32_t path_length;
+};
+
+struct BinaryHit {
+    RecordKind kind;
+    std::uint32_t size;
+    std::uint64_t line_number;
+    std::uint32_t pattern;
+    std::uint32_t column;
+    std::uint32_t length;
+    std::uint32_t line_length;
+};
+
+struct BinaryPattern {
+    RecordKind kind;
+    std::uint32_t size;
+    std::uint64_t count;
+    std::uint32_t pattern;
+    std::uint32_t custom;
+    std::uint32_t name_length;
+    std::uint32_t reserved;
+};
+
+struct BinaryExtension {
+    RecordKind kind;
+    std::uint32_t size;
+    std::uint64_t files;
+    std::uint32_t name_length;
+    std::uint32_t reserved;
+};
+
+struct BinaryError {
+    RecordKind kind;
+    std::uint32_t size;
+    std::uint32_t text_length;
+    std::uint32_t reserved;
+};
+
+struct BinaryTrailer {
+    std::array<char, 8> magic;  // "PRFTRAIL", no NUL
+    std::uint64_t summary_offset;
+    std::uint64_t file_count;
+    std::uint64_t thread_count;
+};
+
+static_assert(sizeof(BinaryHeader) == 16 && sizeof(BinaryFile) == 16 &&
+              sizeof(BinaryHit) == 32 && sizeof(BinaryPattern) == 32 &&
+              sizeof(BinaryExtension) == 24 && sizeof(BinaryError) == 16 &&
+              sizeof(BinaryTrailer) == 32);
+
+void AppendBinaryHeader(std::string& buffer);
+
+void AppendBinaryHits(std::string& buffer, const profile::FileHits& file);
+
+/*
+ * summary_offset is where the summary records start in the whole output,
+ * i.e. everything written before buffer's current contents plus their size.
+ */
+void AppendBinarySummary(std::string& buffer,
+                         const profile::ScanSummary& summary,
+                         std::uint64_t summary_offset);
+
+}  // namespace result_formatting
+#endif  // SRC_INCLUDE_RESULT_FORMAT_HPP_
@@ -0,0 +1,131 @@
+/*
+ *  scan_cache.hpp - Persistent per-file result cache for incremental scans
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_SCAN_CACHE_HPP_
+#define SRC_INCLUDE_SCAN_CACHE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "file_reader.hpp"
+#include "file_result.hpp"
+
+namespace scan_cache {
+
+/*
+ * The metadata a cached result is keyed on besides its path. Modification
+ * time is kept in nanoseconds where the platform provides them.
+ */
+struct FileStamp {
+    std::uint64_t size;
+    std::int64_t modified;
+    std::uint64_t inode;
+
+    bool operator==(const FileStamp&) const = default;
+};
+
+std::optional<FileStamp> StampFile(const std::filesystem::path& file);
+
+/*
+ * The same for a path already spelled out as a narrow string.
+ */
+std::optional<FileStamp> StampFile(const std::string& file);
+
+/*
+ * FNV-1a over every pattern (and anything else that changes what a scan
+ * reports). A cache written under a different hash is ignored entirely.
+ */
+std::uint64_t HashPatterns(std::span<const std::string_view> patterns);
+
+/*
+ * On-disk layout, all integers in native byte order:
+ *
+ *   header:  char magic[8] "PRFCACHE", u32 version, u32 reserved,
+ *            u64 pattern_hash, u64 entry_count
+ *   entry:   u32 entry_length, u32 path_length, u64 size, i64 modified,
+ *            u64 inode, u32 pattern_count, u32 hit_count,
+ *            char path[path_length], u64 counts[pattern_count],
+ *            hit_count x { u64 line_number, u32 pattern, u32 column,
+ *                          u32 length, u32 line_length,
+ *                          char line[line_length] }
+ *
+ * Loading only indexes the entries of the (memory mapped) file; counts and
+ * hits are decoded on demand, and entries that are still valid are copied
+ * back out verbatim by Save, whether this run visited their file or not.
+ */
+class ScanCache {
+ public:
+    ScanCache(std::filesystem::path cache_file, std::uint64_t pattern_hash);
+    ScanCache(const ScanCache&) = delete;
+    ScanCache& operator=(const ScanCache&) = delete;
+
+    /*
+     * Fills result and returns true when path was cached with exactly this
+     * stamp. Safe to call from several workers, along with Store, as long
+     * as no two of them work on the same path.
+     */
+    bool Lookup(std::string_view path, const FileStamp& stamp,
+                std::size_t pattern_count, parser_info::FileResult& result);
+
+    void Store(std::string_view path, const FileStamp& stamp,
+               const parser_info::FileResult& result);
+
+    /*
+     * Rewrites the cache file with every entry stored, reused or still
+     * valid. Runs sharing a cache file must not save at the same time.
+     */
+    bool Save() const;
+
+ private:
+    enum class EntryUse : std::uint8_t {
+        Untouched,
+        Reused,
+        Replaced,
+    };
+
+    struct CachedEntry {
+        std::size_t index;
+        std::string_view record;
+        FileStamp stamp;
+    };
+
+    void Index(std::string_view contents);
+
+ private:
+    static constexpr std::uint32_t format_version{3};
+
+    std::filesystem::path cache_file_{};
+    std::uint64_t pattern_hash_{};
+    file_io::FileReader reader_{};
+    std::unordered_map<std::string_view, CachedEntry> cached_entries_{};
+    std::vector<EntryUse> uses_{};
+    std::mutex fresh_lock_{};
+    std::string fresh_records_{};
+    std::size_t fresh_count_{0};
+};
+
+}  // namespace scan_cache
+#endif  // SRC_INCLUDE_SCAN_CACHE_HPP_
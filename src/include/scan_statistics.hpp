@@ -0,0 +1,167 @@
+/*
+ *  scan_statistics.hpp - Per-worker timing and throughput counters
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_SCAN_STATISTICS_HPP_
+#define SRC_INCLUDE_SCAN_STATISTICS_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace scan_statistics {
+
+using Clock = std::chrono::steady_clock;
+
+enum class Phase : std::uint8_t {
+    DirectoryEnumeration,
+    FileRead,
+    CommentLocation,
+    PatternMatching,
+};
+
+constexpr std::size_t phase_count{4};
+
+struct FileTiming {
+    std::chrono::nanoseconds elapsed;
+    std::string path;
+};
+
+struct QueueSample {
+    std::chrono::nanoseconds since_start;
+    std::size_t depth;
+};
+
+/*
+ * Counters owned by a single worker. Everything is updated without
+ * synchronization and only read once the worker has been joined, so leaving
+ * them on costs a handful of clock reads per file.
+ */
+class WorkerCounters {
+ public:
+    static constexpr std::size_t slowest_file_count{10};
+
+    void AddPhase(const Phase phase, const Clock::duration elapsed) {
+        phases_[static_cast<std::size_t>(phase)] += elapsed;
+    }
+
+    void AddBusy(const Clock::duration elapsed) { busy_ += elapsed; }
+
+    void AddIdle(const Clock::duration elapsed) { idle_ += elapsed; }
+
+    void AddContents(const std::size_t bytes, const std::size_t lines,
+                     const std::size_t comment_bytes) {
+        bytes_ += bytes;
+        lines_ += lines;
+        comment_bytes_ += comment_bytes;
+    }
+
+    /*
+     * Keeps path if it is among the slowest_file_count slowest files this
+     * worker has seen so far.
+     */
+    void RecordFile(Clock::duration elapsed, std::string_view path);
+
+    void RecordQueueDepth(const std::chrono::nanoseconds since_start,
+                          const std::size_t depth) {
+        queue_samples_.emplace_back(since_start, depth);
+    }
+
+ private:
+    friend class ScanStatistics;
+
+    std::array<Clock::duration, phase_count> phases_{};
+    Clock::duration busy_{};
+    Clock::duration idle_{};
+    std::size_t bytes_{0};
+    std::size_t lines_{0};
+    std::size_t comment_bytes_{0};
+    std::vector<FileTiming> slowest_files_{};
+    std::vector<QueueSample> queue_samples_{};
+};
+
+/*
+ * The scan-wide view: the start time every worker measures against, the
+ * shared queue depth sampling schedule, and the merged totals.
+ */
+class ScanStatistics {
+ public:
+    static constexpr std::chrono::milliseconds queue_sample_interval{10};
+
+    void Start();
+
+    /*
+     * Returns true for at most one caller per queue_sample_interval; that
+     * caller records the depth in its own counters.
+     */
+    bool ClaimQueueSample(Clock::time_point now);
+
+    std::chrono::nanoseconds SinceStart(const Clock::time_point now) const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(now -
+                                                                    start_);
+    }
+
+    void Merge(std::span<const WorkerCounters* const> workers);
+
+    void PrintReport(std::ostream& stream) const;
+
+    void WriteJson(std::ostream& stream) const;
+
+ private:
+    struct WorkerTotals {
+        std::chrono::nanoseconds busy;
+        std::chrono::nanoseconds idle;
+    };
+
+    /*
+     * Copies take a snapshot, so merged statistics can be handed out by
+     * value once the scan is over.
+     */
+    struct SampleSchedule {
+        std::atomic<Clock::rep> next{0};
+
+        SampleSchedule() = default;
+        SampleSchedule(const SampleSchedule& other)
+            : next{other.next.load(std::memory_order_relaxed)} {}
+        SampleSchedule& operator=(const SampleSchedule& other) {
+            next.store(other.next.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+            return *this;
+        }
+    };
+
+    Clock::time_point start_{};
+    SampleSchedule next_queue_sample_{};
+    std::chrono::nanoseconds wall_time_{};
+    std::array<std::chrono::nanoseconds, phase_count> phases_{};
+    std::size_t bytes_{0};
+    std::size_t lines_{0};
+    std::size_t comment_bytes_{0};
+    std::vector<WorkerTotals> workers_{};
+    std::vector<QueueSample> queue_samples_{};
+    std::vector<FileTiming> slowest_files_{};
+};
+
+}  // namespace scan_statistics
+#endif  // SRC_INCLUDE_SCAN_STATISTICS_HPP_
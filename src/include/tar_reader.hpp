@@ -0,0 +1,97 @@
+/*
+ *  tar_reader.hpp - Streaming reader for tar archives
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_TAR_READER_HPP_
+#define SRC_INCLUDE_TAR_READER_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+namespace tar_reading {
+
+struct Member {
+    /*
+     * Relative to the archive, without any leading "./" or "/".
+     */
+    std::string path;
+    std::uint64_t size;
+};
+
+/*
+ * Reads an uncompressed tar archive (ustar, pax or GNU) front to back
+ * without ever seeking backwards, so a pipe works as well as a file. Only
+ * regular files are returned; directories, links and devices are skipped.
+ * The path "-" reads the archive from stdin.
+ */
+class TarReader {
+ public:
+    explicit TarReader(const std::filesystem::path& archive);
+    TarReader(const TarReader&) = delete;
+    TarReader& operator=(const TarReader&) = delete;
+    ~TarReader();
+
+    bool IsOpen() const;
+
+    /*
+     * The next regular file, or nullopt once the archive ends. Whatever was
+     * left unread of the previous member is skipped.
+     */
+    std::optional<Member> Next();
+
+    /*
+     * Reads the contents of the member Next returned last into contents,
+     * reusing its capacity. Returns false on a truncated archive.
+     */
+    bool ReadContents(std::string& contents);
+
+    /*
+     * Why the last call to Next or ReadContents stopped early, if it did.
+     */
+    const std::optional<std::string>& Error() const;
+
+ private:
+    static constexpr std::size_t block_size{512};
+
+    using Block = std::array<char, block_size>;
+
+    bool ReadBlock(Block& block);
+
+    bool ReadBytes(char* destination, std::size_t size);
+
+    bool Skip(std::uint64_t size);
+
+    bool ReadExtension(std::uint64_t size, std::string& text);
+
+    bool Fail(std::string error);
+
+ private:
+    std::FILE* stream_{nullptr};
+    bool owns_stream_{false};
+    std::uint64_t remaining_{0};
+    std::uint64_t padding_{0};
+    bool finished_{false};
+    std::optional<std::string> error_{std::nullopt};
+};
+
+}  // namespace tar_reading
+#endif  // SRC_INCLUDE_TAR_READER_HPP_
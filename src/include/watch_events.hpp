@@ -0,0 +1,79 @@
+/*
+ *  watch_events.hpp - Turns inotify events into the paths watch mode rescans
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_WATCH_EVENTS_HPP_
+#define SRC_INCLUDE_WATCH_EVENTS_HPP_
+
+#include <filesystem>
+#include <map>
+#include <span>
+#include <string>
+#include <unordered_map>
+
+#include "Parser.hpp"
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+
+namespace watch_mode {
+
+/*
+ * The directory each watch descriptor stands for, kept in step with the
+ * directories the parser has entered.
+ */
+class WatchSet {
+ public:
+    explicit WatchSet(const int inotify) : inotify_{inotify} {}
+
+    /*
+     * Returns the watch descriptor, or -1 for a directory that vanished
+     * before it could be watched; its parent's watch reports the deletion
+     * anyway. Throws std::system_error once inotify runs out of watches.
+     */
+    int Add(parser_info::Parser::ScannedDirectory&& directory);
+
+    const parser_info::Parser::ScannedDirectory* Find(int watch) const;
+
+    void Forget(int watch);
+
+    void RemoveBelow(const std::filesystem::path& path);
+
+ private:
+    const int inotify_;
+    std::unordered_map<int, parser_info::Parser::ScannedDirectory>
+        directories_{};
+};
+
+/*
+ * Pending rescans keyed on their path, so repeated events for one file
+ * (every write fires IN_MODIFY) collapse into a single target.
+ */
+using PendingTargets = std::map<std::string, parser_info::Parser::Target>;
+
+/*
+ * Adds what event asks to rescan to pending: the file or directory it names,
+ * the whole directory when an ignore file in it changed, or every root once
+ * the kernel dropped events.
+ */
+void QueueEvent(const inotify_event& event, bool use_ignore_files,
+                std::span<const std::filesystem::path> roots,
+                WatchSet& watches, PendingTargets& pending);
+
+}  // namespace watch_mode
+#endif
+#endif  // SRC_INCLUDE_WATCH_EVENTS_HPP_
@@ -0,0 +1,69 @@
+/*
+ *  watch_mode.hpp - Keeping scan totals current as a tree changes
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef SRC_INCLUDE_WATCH_MODE_HPP_
+#define SRC_INCLUDE_WATCH_MODE_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+
+#include "profile.hpp"
+
+namespace watch_mode {
+
+struct WatchOptions {
+    std::filesystem::path socket_path{};
+    /*
+     * How long the tree has to stay quiet before the changes seen so far are
+     * rescanned, so a burst of writes costs a single pass.
+     */
+    std::chrono::milliseconds settle_time{100};
+    /*
+     * The longest changes wait to be rescanned, counted from the first of
+     * them, so a file that is written to without pause (a log, say) does not
+     * hold off rescans for good.
+     */
+    std::chrono::milliseconds max_settle_time{1000};
+};
+
+/*
+ * Called with the summary of the initial scan (changed_paths is zero) and
+ * again after every batch of changes has been rescanned.
+ */
+using UpdateCallback = std::function<void(const profile::ScanSummary& summary,
+                                          std::size_t changed_paths)>;
+
+/*
+ * Scans config's roots once, then keeps the totals current by rescanning
+ * only the paths inotify reports as created, modified, moved or deleted.
+ * Editing an ignore file rescans the directory holding it. Every client
+ * connecting to the Unix socket at options.socket_path is sent the current
+ * summary (profile::SummaryJson) and disconnected.
+ *
+ * Blocks until the process receives SIGINT or SIGTERM, so call it before
+ * starting any other threads. Throws std::system_error when inotify or the
+ * socket cannot be set up, or when the platform has no inotify.
+ */
+void Watch(const profile::ScanConfig& config, const WatchOptions& options,
+           const profile::HitCallback& on_hits,
+           const UpdateCallback& on_update);
+
+}  // namespace watch_mode
+#endif  // SRC_INCLUDE_WATCH_MODE_HPP_
@@ -0,0 +1,424 @@
+/*
+ *  inflate.cpp - Decompression of zlib streams
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/inflate.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace inflating {
+namespace {
+constexpr unsigned max_code_length{15};
+
+/*
+ * Codes up to fast_bits long are decoded with a single table lookup; longer
+ * ones, which only the rarest symbols get, are decoded a bit at a time.
+ */
+constexpr unsigned fast_bits{10};
+
+constexpr std::array<std::uint16_t, 29> length_bases{
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr std::array<std::uint8_t, 29> length_extra_bits{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+    2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr std::array<std::uint16_t, 30> distance_bases{
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385, 24577};
+constexpr std::array<std::uint8_t, 30> distance_extra_bits{
+    0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// the order dynamic blocks list the lengths of the code length code in
+constexpr std::array<std::uint8_t, 19> code_length_order{
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+/*
+ * Reads deflate's least significant bit first stream. Past the end of the
+ * input it reads zeros and counts them, so a truncated stream only has to
+ * be caught where it could otherwise decode forever, through Overrun.
+ */
+class BitReader {
+ public:
+    explicit BitReader(const std::string_view input) : input_{input} {}
+
+    std::uint32_t Peek(const unsigned count) {
+        if (count_ < count) {
+            this->Refill();
+        }
+        return static_cast<std::uint32_t>(bits_ &
+                                          ((std::uint64_t{1} << count) - 1));
+    }
+
+    void Drop(const unsigned count) {
+        bits_ >>= count;
+        count_ -= count;
+    }
+
+    std::uint32_t Take(const unsigned count) {
+        const std::uint32_t value{this->Peek(count)};
+        this->Drop(count);
+        return value;
+    }
+
+    void AlignToByte() { this->Drop(count_ % 8); }
+
+    /*
+     * Appends the next length bytes straight from the input. Only valid on
+     * a byte boundary.
+     */
+    bool CopyBytes(const std::size_t length, std::string& output) {
+        const std::size_t position{position_ - count_ / 8};
+        bits_ = 0;
+        count_ = 0;
+        padding_ = 0;
+        if (position > input_.size() || input_.size() - position < length) {
+            return false;
+        }
+        output.append(input_.substr(position, length));
+        position_ = position + length;
+        return true;
+    }
+
+    /*
+     * Whether anything past the end of the input has been consumed.
+     */
+    bool Overrun() const { return padding_ * 8 > count_; }
+
+ private:
+    void Refill() {
+        while (count_ <= 56) {
+            std::uint64_t byte{0};
+            if (position_ < input_.size()) {
+                byte = static_cast<unsigned char>(input_[position_]);
+            } else {
+                ++padding_;
+            }
+            ++position_;
+            bits_ |= byte << count_;
+            count_ += 8;
+        }
+    }
+
+ private:
+    std::string_view input_;
+    std::size_t position_{0};
+    std::uint64_t bits_{0};
+    unsigned count_{0};
+    std::size_t padding_{0};
+};
+
+/*
+ * A canonical Huffman code. fast holds symbol << 4 | length for every code
+ * of at most fast_bits bits, at every index whose low bits spell it in
+ * stream order, and 0 where a longer code begins; counts and symbols
+ * describe the whole code for decoding those.
+ */
+struct Huffman {
+    std::array<std::uint16_t, std::size_t{1} << fast_bits> fast{};
+    std::array<std::uint16_t, max_code_length + 1> counts{};
+    std::array<std::uint16_t, 288> symbols{};
+};
+
+/*
+ * Fails for lengths that describe more codes than fit; codes with unused
+ * bit patterns are allowed, and decoding one of those fails instead.
+ */
+bool BuildHuffman(Huffman& code, const std::span<const std::uint8_t> lengths) {
+    code.fast.fill(0);
+    code.counts.fill(0);
+    for (const std::uint8_t length : lengths) {
+        code.counts[length]++;
+    }
+    code.counts[0] = 0;
+
+    int left{1};
+    for (unsigned length{1}; length <= max_code_length; ++length) {
+        left = (left << 1) - code.counts[length];
+        if (left < 0) {
+            return false;
+        }
+    }
+
+    std::array<std::uint16_t, max_code_length + 1> offsets{};
+    for (unsigned length{1}; length < max_code_length; ++length) {
+        offsets[length + 1] =
+            static_cast<std::uint16_t>(offsets[length] + code.counts[length]);
+    }
+    for (std::size_t symbol{0}; symbol < lengths.size(); ++symbol) {
+        if (lengths[symbol] != 0) {
+            code.symbols[offsets[lengths[symbol]]++] =
+                static_cast<std::uint16_t>(symbol);
+        }
+    }
+
+    // codes are spelled most significant bit first, but arrive least
+    // significant bit first
+    unsigned next_code{0};
+    std::size_t index{0};
+    for (unsigned length{1}; length <= fast_bits; ++length) {
+        for (std::size_t count{0}; count < code.counts[length]; ++count) {
+            unsigned reversed{0};
+            for (unsigned bit{0}; bit < length; ++bit) {
+                reversed |= ((next_code >> bit) & 1u) << (length - 1 - bit);
+            }
+            const auto entry{
+                static_cast<std::uint16_t>(code.symbols[index++] << 4 | length)};
+            for (std::size_t slot{reversed}; slot < code.fast.size();
+                 slot += std::size_t{1} << length) {
+                code.fast[slot] = entry;
+            }
+            ++next_code;
+        }
+        next_code <<= 1;
+    }
+    return true;
+}
+
+int Decode(BitReader& bits, const Huffman& code) {
+    if (const std::uint16_t entry{code.fast[bits.Peek(fast_bits)]};
+        entry != 0) {
+        bits.Drop(entry & 0xf);
+        return entry >> 4;
+    }
+
+    int value{0};
+    int first{0};
+    int index{0};
+    for (unsigned length{1}; length <= max_code_length; ++length) {
+        value |= static_cast<int>(bits.Take(1));
+        const int count{code.counts[length]};
+        if (value - count < first) {
+            return code.symbols[static_cast<std::size_t>(index + value -
+                                                         first)];
+        }
+        index += count;
+        first = (first + count) << 1;
+        value <<= 1;
+    }
+    return -1;
+}
+
+bool InflateCodes(BitReader& bits, const Huffman& literals,
+                  const Huffman& distances, std::string& output) {
+    while (true) {
+        const int symbol{Decode(bits, literals)};
+        if (symbol < 0 || bits.Overrun()) {
+            return false;
+        } else if (symbol < 256) {
+            output.push_back(static_cast<char>(symbol));
+            continue;
+        } else if (symbol == 256) {
+            return true;
+        }
+
+        const auto length_code{static_cast<std::size_t>(symbol - 257)};
+        if (length_code >= length_bases.size()) {
+            return false;
+        }
+        const std::size_t length{length_bases[length_code] +
+                                 bits.Take(length_extra_bits[length_code])};
+
+        const int distance_code{Decode(bits, distances)};
+        if (distance_code < 0 ||
+            static_cast<std::size_t>(distance_code) >= distance_bases.size()) {
+            return false;
+        }
+        const auto code_index{static_cast<std::size_t>(distance_code)};
+        const std::size_t distance{distance_bases[code_index] +
+                                   bits.Take(distance_extra_bits[code_index])};
+        if (distance > output.size()) {
+            return false;
+        }
+
+        const std::size_t start{output.size() - distance};
+        if (distance >= length) {
+            output.append(output, start, length);
+        } else {
+            // the copy overlaps what it writes, repeating the last distance
+            // bytes
+            const std::size_t end{output.size()};
+            output.resize(end + length);
+            for (std::size_t offset{0}; offset < length; ++offset) {
+                output[end + offset] = output[start + offset];
+            }
+        }
+    }
+}
+
+const Huffman& FixedLiterals() {
+    static const Huffman code{[] {
+        std::array<std::uint8_t, 288> lengths{};
+        std::fill(lengths.begin(), lengths.begin() + 144, 8);
+        std::fill(lengths.begin() + 144, lengths.begin() + 256, 9);
+        std::fill(lengths.begin() + 256, lengths.begin() + 280, 7);
+        std::fill(lengths.begin() + 280, lengths.end(), 8);
+        Huffman fixed{};
+        BuildHuffman(fixed, lengths);
+        return fixed;
+    }()};
+    return code;
+}
+
+const Huffman& FixedDistances() {
+    static const Huffman code{[] {
+        std::array<std::uint8_t, 30> lengths{};
+        lengths.fill(5);
+        Huffman fixed{};
+        BuildHuffman(fixed, lengths);
+        return fixed;
+    }()};
+    return code;
+}
+
+bool InflateDynamic(BitReader& bits, std::string& output) {
+    const std::size_t literal_count{bits.Take(5) + 257};
+    const std::size_t distance_count{bits.Take(5) + 1};
+    const std::size_t code_length_count{bits.Take(4) + 4};
+    if (literal_count > 286 || distance_count > 30) {
+        return false;
+    }
+
+    std::array<std::uint8_t, 19> code_lengths{};
+    for (std::size_t index{0}; index < code_length_count; ++index) {
+        code_lengths[code_length_order[index]] =
+            static_cast<std::uint8_t>(bits.Take(3));
+    }
+    Huffman code_length_code{};
+    if (!BuildHuffman(code_length_code, code_lengths)) {
+        return false;
+    }
+
+    std::array<std::uint8_t, 286 + 30> lengths{};
+    const std::size_t total{literal_count + distance_count};
+    for (std::size_t index{0}; index < total;) {
+        const int symbol{Decode(bits, code_length_code)};
+        if (symbol < 0 || bits.Overrun()) {
+            return false;
+        } else if (symbol < 16) {
+            lengths[index++] = static_cast<std::uint8_t>(symbol);
+            continue;
+        }
+
+        std::uint8_t repeated{0};
+        std::size_t repeat{0};
+        if (symbol == 16) {
+            if (index == 0) {
+                return false;
+            }
+            repeated = lengths[index - 1];
+            repeat = 3 + bits.Take(2);
+        } else if (symbol == 17) {
+            repeat = 3 + bits.Take(3);
+        } else {
+            repeat = 11 + bits.Take(7);
+        }
+        if (index + repeat > total) {
+            return false;
+        }
+        std::fill_n(lengths.begin() + static_cast<std::ptrdiff_t>(index),
+                    repeat, repeated);
+        index += repeat;
+    }
+
+    // without an end of block code the block could never end
+    if (lengths[256] == 0) {
+        return false;
+    }
+
+    Huffman literals{};
+    Huffman distances{};
+    return BuildHuffman(literals,
+                        std::span{lengths}.first(literal_count)) &&
+           BuildHuffman(distances, std::span{lengths}.subspan(
+                                       literal_count, distance_count)) &&
+           InflateCodes(bits, literals, distances, output);
+}
+
+std::uint32_t Adler32(std::string_view data) {
+    // the most bytes that can be summed before the sums could overflow
+    constexpr std::size_t run_length{5552};
+    constexpr std::uint32_t modulus{65521};
+
+    std::uint32_t low{1};
+    std::uint32_t high{0};
+    while (!data.empty()) {
+        const std::size_t run{std::min(data.size(), run_length)};
+        for (const char byte : data.substr(0, run)) {
+            low += static_cast<unsigned char>(byte);
+            high += low;
+        }
+        low %= modulus;
+        high %= modulus;
+        data.remove_prefix(run);
+    }
+    return high << 16 | low;
+}
+}  // namespace
+
+bool InflateZlib(const std::string_view input, std::string& output,
+                 const std::size_t size_hint) {
+    output.clear();
+    output.reserve(size_hint);
+
+    BitReader bits{input};
+    const std::uint32_t method{bits.Take(8)};
+    const std::uint32_t flags{bits.Take(8)};
+    if ((method & 0xf) != 8 || (method >> 4) > 7 ||
+        (method << 8 | flags) % 31 != 0 || (flags & 0x20) != 0) {
+        return false;
+    }
+
+    bool last{false};
+    while (!last) {
+        last = bits.Take(1) != 0;
+        const std::uint32_t type{bits.Take(2)};
+        bool inflated{false};
+        if (type == 0) {
+            bits.AlignToByte();
+            const std::uint32_t length{bits.Take(16)};
+            const std::uint32_t complement{bits.Take(16)};
+            inflated = length == (~complement & 0xffff) &&
+                       bits.CopyBytes(length, output);
+        } else if (type == 1) {
+            inflated =
+                InflateCodes(bits, FixedLiterals(), FixedDistances(), output);
+        } else if (type == 2) {
+            inflated = InflateDynamic(bits, output);
+        }
+
+        if (!inflated || bits.Overrun()) {
+            return false;
+        }
+    }
+
+    bits.AlignToByte();
+    std::uint32_t checksum{0};
+    for (std::size_t byte{0}; byte < 4; ++byte) {
+        checksum = checksum << 8 | bits.Take(8);
+    }
+    return !bits.Overrun() && checksum == Adler32(output);
+}
+
+}  // namespace inflating
@@ -0,0 +1,228 @@
+/*
+ *  keyword_matcher.cpp - Construction of the multi-pattern keyword automaton
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/keyword_matcher.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <queue>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace keyword_matching {
+namespace {
+constexpr std::uint32_t alphabet_size{256};
+constexpr std::uint32_t missing_state{std::numeric_limits<std::uint32_t>::max()};
+
+/*
+ * Bytes roughly in order of how often they show up in source code, most
+ * frequent first. Any byte not listed is taken to be rarer than all of them.
+ */
+constexpr std::string_view common_bytes{
+    " e\ntaoinsrlcdu()_;,.=hpmf\"gy/*b{}v-k:w>x'<[]#01&+"};
+
+std::size_t Commonness(const char byte) {
+    const std::size_t rank{common_bytes.find(byte)};
+    return rank == std::string_view::npos ? 0 : common_bytes.size() - rank;
+}
+}  // namespace
+
+KeywordAutomaton::KeywordAutomaton(const std::span<const Keyword> keywords)
+    : patterns_{},
+      transitions_(alphabet_size, missing_state),
+      output_offsets_{},
+      outputs_{} {
+    std::vector<std::vector<std::uint32_t>> state_outputs{1};
+
+    for (std::uint32_t index{0}; index < keywords.size(); ++index) {
+        const auto& [literal, word_boundary] = keywords[index];
+        if (literal.empty()) {
+            throw std::invalid_argument{"Keywords may not be empty"};
+        }
+
+        std::uint32_t state{0};
+        for (const char character : literal) {
+            std::uint32_t& next{
+                transitions_[(state << 8) |
+                             static_cast<unsigned char>(character)]};
+            if (next == missing_state) {
+                next = static_cast<std::uint32_t>(state_outputs.size());
+                state_outputs.emplace_back();
+                transitions_.resize(transitions_.size() + alphabet_size,
+                                    missing_state);
+            }
+            state = transitions_[(state << 8) |
+                                 static_cast<unsigned char>(character)];
+        }
+
+        state_outputs[state].push_back(index);
+        patterns_.emplace_back(literal.size(), word_boundary);
+    }
+
+    std::vector<std::uint32_t> failure(state_outputs.size(), 0);
+    std::queue<std::uint32_t> pending{};
+
+    for (std::uint32_t byte{0}; byte < alphabet_size; ++byte) {
+        if (std::uint32_t& next{transitions_[byte]}; next == missing_state) {
+            next = 0;
+        } else {
+            pending.push(next);
+        }
+    }
+
+    while (!pending.empty()) {
+        const std::uint32_t state{pending.front()};
+        pending.pop();
+
+        for (std::uint32_t byte{0}; byte < alphabet_size; ++byte) {
+            const std::uint32_t fallback{
+                transitions_[(failure[state] << 8) | byte]};
+
+            if (std::uint32_t& next{transitions_[(state << 8) | byte]};
+                next == missing_state) {
+                next = fallback;
+            } else {
+                failure[next] = fallback;
+                state_outputs[next].insert(state_outputs[next].end(),
+                                           state_outputs[fallback].cbegin(),
+                                           state_outputs[fallback].cend());
+                pending.push(next);
+            }
+        }
+    }
+
+    output_offsets_.reserve(state_outputs.size() + 1);
+    for (const std::vector<std::uint32_t>& matches : state_outputs) {
+        output_offsets_.push_back(static_cast<std::uint32_t>(outputs_.size()));
+        outputs_.insert(outputs_.end(), matches.cbegin(), matches.cend());
+    }
+    output_offsets_.push_back(static_cast<std::uint32_t>(outputs_.size()));
+}
+
+LiteralPrefilter::LiteralPrefilter(
+    const std::span<const KeywordAutomaton::Keyword> keywords)
+    : groups_{}, literals_{}, longest_anchor_{0} {
+    for (const auto& [literal, _] : keywords) {
+        if (literal.empty()) {
+            throw std::invalid_argument{"Keywords may not be empty"};
+        }
+
+        std::size_t anchor{0};
+        for (std::size_t position{1}; position < literal.size(); ++position) {
+            if (Commonness(literal[position]) < Commonness(literal[anchor])) {
+                anchor = position;
+            }
+        }
+        literals_.push_back(Literal{
+            .text = std::string{literal},
+            .anchor = anchor,
+        });
+        longest_anchor_ = std::max(longest_anchor_, anchor);
+
+        const char byte{literal[anchor]};
+        if (std::ranges::any_of(groups_, [byte](const auto& group) {
+                return std::ranges::find(group.bytes.cbegin(),
+                                         group.bytes.cbegin() + group.count,
+                                         byte) !=
+                       group.bytes.cbegin() + group.count;
+            })) {
+            continue;
+        } else if (groups_.empty() ||
+                   groups_.back().count == groups_.back().bytes.size()) {
+            groups_.emplace_back();
+        }
+        groups_.back().bytes[groups_.back().count++] = byte;
+    }
+}
+
+const char* LiteralPrefilter::KeywordAround(const char* const position,
+                                            const char* const begin,
+                                            const char* const end) const {
+    const char* start{end};
+    for (const auto& [text, anchor] : literals_) {
+        if (text[anchor] != *position ||
+            static_cast<std::size_t>(position - begin) < anchor) {
+            continue;
+        }
+        const char* const candidate{position - anchor};
+        if (static_cast<std::size_t>(end - candidate) >= text.size() &&
+            candidate < start &&
+            std::memcmp(candidate, text.data(), text.size()) == 0) {
+            start = candidate;
+        }
+    }
+    return start;
+}
+
+/*
+ * The text is searched in windows that double in size, each group only up
+ * to the best occurrence found in the window so far. Finding an occurrence
+ * then costs about as much as the distance to it, however many groups there
+ * are, rather than every group searching on to its own next occurrence.
+ * Anchor bytes are looked for up to longest_anchor_ bytes past where an
+ * occurrence could start, since that is how far into a keyword they sit.
+ */
+const char* LiteralPrefilter::Next(const char* const begin,
+                                   const char* const end) const {
+    const auto past_anchors{[this, end](const char* const start) {
+        return static_cast<std::size_t>(end - start) > longest_anchor_
+                   ? start + longest_anchor_
+                   : end;
+    }};
+
+    const char* window_begin{begin};
+    for (std::size_t window{first_window}; window_begin != end; window *= 2) {
+        const char* const window_end{
+            static_cast<std::size_t>(end - window_begin) > window
+                ? window_begin + window
+                : end};
+        const char* found{window_end};
+        for (const byte_scanner::ByteSet& group : groups_) {
+            const char* limit{past_anchors(found)};
+            for (const char* position{
+                     byte_scanner::FindAnyByte(window_begin, limit, group)};
+                 position < limit;
+                 position = byte_scanner::FindAnyByte(position + 1, limit,
+                                                      group)) {
+                if (const char* const start{
+                        this->KeywordAround(position, begin, end)};
+                    start < found) {
+                    found = start;
+                    limit = past_anchors(found);
+                    if (position >= limit) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (found != window_end) {
+            return found;
+        }
+        window_begin = window_end;
+    }
+    return end;
+}
+
+}  // namespace keyword_matching
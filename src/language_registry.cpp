@@ -0,0 +1,373 @@
+/*
+ *  language_registry.cpp - Perfect hashed lookup of languages by extension
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/language_registry.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "include/byte_scanner.hpp"
+#include "include/comment_lexer.hpp"
+#include "include/comment_syntax.hpp"
+
+namespace language_registry {
+namespace {
+constexpr std::string_view blank_characters{" \t\r"};
+
+std::string_view Trim(std::string_view text) {
+    const std::size_t start{text.find_first_not_of(blank_characters)};
+    if (start == std::string_view::npos) {
+        return {};
+    }
+    text.remove_prefix(start);
+    return text.substr(0, text.find_last_not_of(blank_characters) + 1);
+}
+
+[[noreturn]] void Fail(const std::filesystem::path& language_file,
+                       const std::size_t line_number,
+                       const std::string_view problem) {
+    throw std::runtime_error{std::format("{}:{}: {}", language_file.string(),
+                                         line_number, problem)};
+}
+
+/*
+ * Everything that can start a comment or a string in code. The lexer only
+ * looks for up to four bytes at once.
+ */
+std::optional<byte_scanner::ByteSet> CodeBytes(
+    const std::string_view line_comment, const std::string_view block_open,
+    const std::string_view quotes) {
+    std::string bytes{};
+    const auto add{[&bytes](const char byte) {
+        if (bytes.find(byte) == std::string::npos) {
+            bytes.push_back(byte);
+        }
+    }};
+    if (!line_comment.empty()) {
+        add(line_comment.front());
+    }
+    if (!block_open.empty()) {
+        add(block_open.front());
+    }
+    std::ranges::for_each(quotes, add);
+
+    if (bytes.size() > 4) {
+        return std::nullopt;
+    }
+    byte_scanner::ByteSet set{};
+    std::ranges::copy(bytes, set.bytes.begin());
+    set.count = bytes.size();
+    return set;
+}
+}  // namespace
+
+LanguageRegistry::LanguageRegistry(
+    const std::optional<std::filesystem::path>& language_file) {
+    if (language_file.has_value()) {
+        this->Load(language_file.value());
+    }
+
+    languages_.reserve(parser_info::builtin_languages.size() +
+                       definitions_.size());
+    for (const parser_info::BuiltinLanguage& language :
+         parser_info::builtin_languages) {
+        languages_.push_back(Language{
+            .name = language.name,
+            .extensions = language.extensions,
+            .syntax = &comment_lexing::SyntaxFor(language.format),
+        });
+    }
+
+    syntaxes_.reserve(definitions_.size());
+    for (const Definition& definition : definitions_) {
+        syntaxes_.push_back(comment_lexing::Syntax{
+            .line_comment = definition.line_comment,
+            .block_open = definition.block_open,
+            .block_close = definition.block_close,
+            .code_bytes = CodeBytes(definition.line_comment,
+                                    definition.block_open, definition.quotes)
+                              .value(),
+            .nested_blocks = definition.nested_comments,
+            .line_continuation = false,
+            .char_literals = false,
+            .multiline_strings = false,
+            .backtick_strings = false,
+            .regex_literals = false,
+            .cpp_raw_strings = false,
+            .verbatim_strings = false,
+            .rust_raw_strings = false,
+            .zig_multiline = false,
+            .triple_quotes = false,
+            .docstrings = false,
+            .raw_backticks = false,
+            .word_start_comments = false,
+            .long_brackets = false,
+        });
+        languages_.push_back(Language{
+            .name = definition.name,
+            .extensions = definition.extensions,
+            .syntax = &syntaxes_.back(),
+        });
+        fingerprint_.append(std::format(
+            "[{}]\n{}\n{}\n{} {}\n{}\n{}\n", definition.name,
+            definition.extensions, definition.line_comment,
+            definition.block_open, definition.block_close,
+            definition.nested_comments, definition.quotes));
+    }
+
+    if (language_file.has_value() && !definitions_.empty()) {
+        this->HashExtensions(language_file.value());
+    }
+}
+
+void LanguageRegistry::Load(const std::filesystem::path& language_file) {
+    std::ifstream input{language_file, std::ios::binary};
+    if (!input) {
+        throw std::runtime_error{std::format(
+            "Could not open language file {}", language_file.string())};
+    }
+
+    std::unordered_set<std::string> defined_extensions{};
+    const auto finish{[&]() {
+        if (definitions_.empty()) {
+            return;
+        }
+        const Definition& definition{definitions_.back()};
+        const std::size_t line_number{definition.line_number};
+        if (definition.extensions.empty()) {
+            Fail(language_file, line_number,
+                 std::format("{} has no extensions", definition.name));
+        } else if (definition.line_comment.empty() &&
+                   definition.block_open.empty()) {
+            Fail(language_file, line_number,
+                 std::format("{} has no comments", definition.name));
+        } else if (!CodeBytes(definition.line_comment, definition.block_open,
+                              definition.quotes)
+                        .has_value()) {
+            Fail(language_file, line_number,
+                 std::format("{}'s comments and quotes start with more than "
+                             "four different characters",
+                             definition.name));
+        }
+        ForEachExtension(definition.extensions,
+                         [&](const std::string_view extension) {
+                             if (!defined_extensions
+                                      .emplace(extension)
+                                      .second) {
+                                 Fail(language_file, line_number,
+                                      std::format("{} is defined twice",
+                                                  extension));
+                             }
+                         });
+    }};
+
+    std::string line{};
+    std::size_t line_number{0};
+    while (std::getline(input, line)) {
+        line_number++;
+        const std::string_view text{Trim(line)};
+        if (text.empty() || text.front() == '#' || text.front() == ';') {
+            continue;
+        }
+
+        if (text.front() == '[') {
+            const std::string_view name{
+                Trim(text.substr(1, text.find(']') - 1))};
+            if (!text.ends_with(']') || name.empty()) {
+                Fail(language_file, line_number, "Malformed language name");
+            }
+            finish();
+            definitions_.push_back(Definition{
+                .name = std::string{name},
+                .line_number = line_number,
+            });
+            continue;
+        }
+
+        const std::size_t equals{text.find('=')};
+        if (equals == std::string_view::npos) {
+            Fail(language_file, line_number, "Expected key = value");
+        } else if (definitions_.empty()) {
+            Fail(language_file, line_number,
+                 "Expected a [Language] section first");
+        }
+        const std::string_view key{Trim(text.substr(0, equals))};
+        const std::string_view value{Trim(text.substr(equals + 1))};
+        Definition& definition{definitions_.back()};
+
+        if (key == "extensions") {
+            definition.extensions.clear();
+            ForEachExtension(value, [&](const std::string_view extension) {
+                if (extension.size() < 2 || extension.front() != '.' ||
+                    extension.find_first_of("/\\\t") !=
+                        std::string_view::npos) {
+                    Fail(language_file, line_number,
+                         std::format("Invalid extension {}", extension));
+                }
+                if (!definition.extensions.empty()) {
+                    definition.extensions.push_back(' ');
+                }
+                definition.extensions.append(extension);
+            });
+        } else if (key == "line_comment") {
+            if (value.find_first_of(blank_characters) !=
+                std::string_view::npos) {
+                Fail(language_file, line_number,
+                     "A line comment marker can not contain blanks");
+            }
+            definition.line_comment = value;
+        } else if (key == "block_comment") {
+            const std::size_t space{value.find_first_of(blank_characters)};
+            const std::string_view close{
+                space == std::string_view::npos
+                    ? std::string_view{}
+                    : Trim(value.substr(space))};
+            if (close.empty() ||
+                close.find_first_of(blank_characters) !=
+                    std::string_view::npos) {
+                Fail(language_file, line_number,
+                     "Expected an opening and a closing marker");
+            }
+            definition.block_open = value.substr(0, space);
+            definition.block_close = close;
+        } else if (key == "nested_comments") {
+            if (value != "true" && value != "false") {
+                Fail(language_file, line_number, "Expected true or false");
+            }
+            definition.nested_comments = value == "true";
+        } else if (key == "quotes") {
+            if (value.find_first_not_of("\"'`") != std::string_view::npos) {
+                Fail(language_file, line_number,
+                     "Only \", ' and ` can be quotes");
+            }
+            definition.quotes = value;
+        } else {
+            Fail(language_file, line_number,
+                 std::format("Unknown key {}", key));
+        }
+    }
+    finish();
+}
+
+/*
+ * Defined extensions come first, and the built-in ones they take over are
+ * left out, so no extension is ever hashed twice.
+ */
+void LanguageRegistry::HashExtensions(
+    const std::filesystem::path& language_file) {
+    std::vector<ExtensionSlot> entries{};
+    std::unordered_set<std::string_view> defined{};
+    for (std::size_t language{parser_info::builtin_languages.size()};
+         language < languages_.size(); ++language) {
+        ForEachExtension(languages_[language].extensions,
+                         [&](const std::string_view extension) {
+                             defined.insert(extension);
+                             entries.push_back(ExtensionSlot{
+                                 extension,
+                                 static_cast<std::uint32_t>(language)});
+                         });
+    }
+    for (const ExtensionSlot& slot : builtin_extensions.slots) {
+        if (!slot.extension.empty() && !defined.contains(slot.extension)) {
+            entries.push_back(slot);
+        }
+    }
+
+    // a larger table makes a working seed more likely still
+    for (std::size_t slot_count{SlotCountFor(entries.size())};
+         slot_count <= SlotCountFor(entries.size()) * 64; slot_count *= 2) {
+        defined_slots_.resize(slot_count);
+        if (const std::optional<std::uint64_t> seed{
+                PlaceExtensions(defined_slots_, entries)}) {
+            slots_ = defined_slots_;
+            seed_ = seed.value();
+            return;
+        }
+    }
+    throw std::runtime_error{std::format(
+        "Could not hash the extensions of {}", language_file.string())};
+}
+
+std::optional<Match> LanguageRegistry::Find(
+    const std::filesystem::path& file) const {
+    return this->FindExtension(
+        std::basic_string_view<std::filesystem::path::value_type>{
+            file.native()});
+}
+
+std::optional<Match> LanguageRegistry::Find(
+    const std::string_view file) const {
+    return this->FindExtension(file);
+}
+
+template <typename Char>
+std::optional<Match> LanguageRegistry::FindExtension(
+    const std::basic_string_view<Char> file) const {
+    const std::basic_string_view<Char> extension{ExtensionOf(file)};
+    if (extension.empty()) {
+        return std::nullopt;
+    }
+
+    const ExtensionSlot& slot{
+        slots_[SlotIndex(HashExtension(extension, seed_), slots_.size())]};
+    if (!SameExtension(slot.extension, extension)) {
+        return std::nullopt;
+    }
+    return Match{
+        .extension = slot.extension,
+        .language = &languages_[slot.language],
+    };
+}
+
+std::span<const Language> LanguageRegistry::Languages() const {
+    return languages_;
+}
+
+const std::string& LanguageRegistry::Fingerprint() const {
+    return fingerprint_;
+}
+
+std::string DescribeComments(const comment_lexing::Syntax& syntax) {
+    std::string description{syntax.line_comment};
+    for (const std::string_view marker :
+         {syntax.block_open, syntax.block_close,
+          syntax.docstrings ? std::string_view{"\"\"\""}
+                            : std::string_view{}}) {
+        if (!marker.empty()) {
+            if (!description.empty()) {
+                description.push_back(' ');
+            }
+            description.append(marker);
+        }
+    }
+    return description;
+}
+
+}  // namespace language_registry
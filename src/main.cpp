@@ -16,12 +16,20 @@
  *  with this program. If not, see <https://www.gnu.org/licenses/>
  */
 
-#include <array>
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
 #include <exception>
 #include <filesystem>
+#include <format>
+#include <fstream>
 #include <iomanip>
 #include <ios>
 #include <iostream>
+#include <iterator>
+#include <optional>
+#include <ostream>
 #include <print>
 #include <span>
 #include <string>
@@ -30,8 +38,14 @@
 #include <vector>
 
 #include "argparse/argparse.hpp"
-#include "include/Parser.hpp"
 #include "include/directory_validator.hpp"
+#include "include/language_registry.hpp"
+#include "include/output_collector.hpp"
+#include "include/partial_result.hpp"
+#include "include/profile.hpp"
+#include "include/result_format.hpp"
+#include "include/scan_statistics.hpp"
+#include "include/watch_mode.hpp"
 
 constexpr bool NoEmptyRegexes(const std::span<std::string> regexes) {
     for (const std::string_view regex : regexes) {
@@ -42,21 +56,201 @@ constexpr bool NoEmptyRegexes(const std::span<std::string> regexes) {
     return true;
 }
 
-constexpr std::array<std::pair<std::string_view, std::string_view>, 10>
-    supported_languages{{
-        {"C", "//"},
-        {"C++", "//"},
-        {"C Header Files", "//"},
-        {"C++ Header Files", "//"},
-        {"JavaScript", "//"},
-        {"TypeScript", "//"},
-        {"Rust", "//"},
-        {"Zig", "//"},
-        {"C#", "//"},
-        {"Python", "#"},
-    }};
+/*
+ * KEYWORD or KEYWORD>N. A '>' only starts the limit when a number follows
+ * it, so custom regexes holding one can still be named.
+ */
+std::optional<profile::Threshold> ParseThreshold(
+    const std::string_view argument) {
+    profile::Threshold threshold{
+        .pattern = std::string{argument},
+        .limit = 0,
+    };
+
+    if (const std::size_t separator{argument.rfind('>')};
+        separator != std::string_view::npos &&
+        separator + 1 < argument.size() &&
+        std::ranges::all_of(argument.substr(separator + 1), [](const char c) {
+            return c >= '0' && c <= '9';
+        })) {
+        const auto [end, error]{std::from_chars(
+            argument.data() + separator + 1,
+            argument.data() + argument.size(), threshold.limit)};
+        if (error != std::errc{}) {
+            return std::nullopt;
+        }
+        threshold.pattern.resize(separator);
+    }
+
+    if (threshold.pattern.empty()) {
+        return std::nullopt;
+    }
+    return threshold;
+}
+
+/*
+ * I/N, counting shards from 1 the way CI systems number parallel jobs.
+ */
+std::optional<profile::Shard> ParseShard(const std::string_view argument) {
+    const std::size_t separator{argument.find('/')};
+    if (separator == std::string_view::npos) {
+        return std::nullopt;
+    }
+
+    std::size_t index{0};
+    std::size_t count{0};
+    const char* const end{argument.data() + argument.size()};
+    const auto [index_end, index_error]{std::from_chars(
+        argument.data(), argument.data() + separator, index)};
+    const auto [count_end, count_error]{
+        std::from_chars(argument.data() + separator + 1, end, count)};
+    if (index_error != std::errc{} || count_error != std::errc{} ||
+        index_end != argument.data() + separator || count_end != end ||
+        index == 0 || index > count) {
+        return std::nullopt;
+    }
+    return profile::Shard{
+        .index = index - 1,
+        .count = count,
+    };
+}
+
+// a scan that exceeds a threshold still ran fine, so it gets its own status
+constexpr int threshold_exit_code{2};
+
+int ReportThresholds(const profile::ScanSummary& summary) {
+    for (const std::string& threshold : summary.exceeded) {
+        std::cerr << "Threshold Exceeded: " << threshold << std::endl;
+    }
+    return summary.exceeded.empty() ? 0 : threshold_exit_code;
+}
 
 constexpr std::size_t max_column_width{18};
+constexpr std::size_t extension_column_width{30};
+
+void LogHits(const profile::FileHits& file,
+             const result_formatting::OutputFormat format,
+             output_collection::OutputCollector& output) {
+    std::string& buffer{output.Buffer(file.worker)};
+
+    if (format == result_formatting::OutputFormat::JsonLines) {
+        result_formatting::AppendJsonHits(buffer, file);
+        output.EndRecord(file.worker, file.path);
+        return;
+    } else if (format == result_formatting::OutputFormat::Binary) {
+        result_formatting::AppendBinaryHits(buffer, file);
+        output.EndRecord(file.worker, file.path);
+        return;
+    }
+
+    for (const profile::HitRecord& hit : file.hits) {
+        if (!hit.custom) {
+            std::format_to(std::back_inserter(buffer),
+                           "{0} Found: \nFile: {1}\nLine Number: {2}\nLine: "
+                           "{3}\n\n",
+                           hit.keyword, file.path.c_str(), hit.line_number,
+                           hit.line);
+        } else {
+            std::format_to(std::back_inserter(buffer),
+                           "Regex {0} Found: \nFile: {1}\nLine Number: "
+                           "{2}\nLine: "
+                           "{3}\n\n",
+                           hit.keyword, file.path.c_str(), hit.line_number,
+                           hit.line);
+        }
+    }
+
+    output.EndRecord(file.worker, file.path);
+}
+
+void PrintSummary(const profile::ScanSummary& summary) {
+    std::cout << "Files Profiled: " << summary.file_count << std::endl;
+    for (const profile::PatternTotal& total : summary.patterns) {
+        if (!total.custom) {
+            std::cout << total.pattern << "s Found: " << total.count
+                      << std::endl;
+        }
+    }  // TODO(not_a_real_todo) test
+    if (std::ranges::any_of(summary.patterns, &profile::PatternTotal::custom)) {
+        std::cout
+            << std::endl
+            << "------------------------------------ Customs ------------------"
+               "-----------------"
+            << std::endl;
+        for (const profile::PatternTotal& total : summary.patterns) {
+            if (total.custom) {
+                std::cout << "Amount of " << total.pattern
+                          << " Found: " << total.count << std::endl;
+            }
+        }
+    }
+
+    std::cout
+        << std::endl
+        << "------------------------------------ Summary ------------------"
+           "-----------------"
+        << std::endl;
+    std::cout << std::endl
+              << std::left << std::setw(19) << "File Extension" << std::left
+              << "|" << std::left << std::setw(20) << "Files" << std::endl;
+    std::cout
+        << "---------------------------------------------------------------"
+           "-----------------"
+        << std::endl;
+    for (const auto& [file_extension, frequency] : summary.extension_counts) {
+        std::cout << std::left << std::setw(19) << file_extension << "|"
+                  << std::setw(20) << frequency << std::endl;
+        std::cout
+            << "---------------------------------------------------------------"
+               "-----------------"
+            << std::endl;
+    }
+}
+
+void PrintUpdate(const profile::ScanSummary& summary,
+                 const std::size_t changed_paths) {
+    std::cout << "Rescanned " << changed_paths
+              << " Changed Paths. Files Profiled: " << summary.file_count;
+    for (const profile::PatternTotal& total : summary.patterns) {
+        std::cout << ", " << total.pattern << ": " << total.count;
+    }
+    std::cout << std::endl;
+}
+
+void PrintChanges(const std::string_view revision,
+                  const profile::ChangeSummary& changes) {
+    std::cout << "Changes Since " << revision << " ("
+              << changes.base.substr(0, 12) << "), " << changes.deleted_files
+              << " Files Deleted" << std::endl;
+    for (const profile::PatternChange& change : changes.changes) {
+        std::cout << change.pattern << ": +" << change.added << " -"
+                  << change.removed << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+void ReportScanStatistics(
+    const scan_statistics::ScanStatistics& statistics, const bool print_report,
+    const std::optional<std::filesystem::path>& statistics_file,
+    std::ostream& stream) {
+    if (print_report) {
+        statistics.PrintReport(stream);
+    }
+
+    if (!statistics_file.has_value()) {
+        return;
+    } else if (statistics_file.value() == "-") {
+        statistics.WriteJson(stream);
+        return;
+    }
+
+    std::ofstream output{statistics_file.value(), std::ios::trunc};
+    statistics.WriteJson(output);
+    if (!output.good()) {
+        std::cerr << "Could not write statistics file "
+                  << statistics_file.value() << std::endl;
+    }
+}
 
 constexpr const char* version{"1.0.2"};
 
@@ -65,7 +259,12 @@ int main(int argc, char** argv) {
                                              argparse::default_arguments::none);
 
     argument_parser.add_argument("--directory", "-d")
-        .help("Directory to Profile");
+        .default_value(std::vector<std::string>{})
+        .append()
+        .help("Directory to Profile (Repeat To Profile Several In One Run)");
+
+    argument_parser.add_argument("--tar")
+        .help("Tar Archive To Profile Instead Of A Directory (- For Stdin)");
 
     argument_parser.add_argument("-c", "--custom")
         .default_value(std::vector<std::string>{})
@@ -76,6 +275,80 @@ int main(int argc, char** argv) {
         .help("Log Found Comment to Stdout")
         .flag();
 
+    argument_parser.add_argument("--sort")
+        .help("Log Found Comments Sorted By File And Line")
+        .flag();
+
+    argument_parser.add_argument("--format")
+        .default_value(std::string{"text"})
+        .help("Output Format: text, jsonl Or binary");
+
+    argument_parser.add_argument("--stats")
+        .help("Report Timings, Throughput And The Slowest Files")
+        .flag();
+
+    argument_parser.add_argument("--stats-json")
+        .help("Write Scan Statistics As JSON To This File (- For Stdout)");
+
+    argument_parser.add_argument("--no-ignore")
+        .help("Do Not Skip Paths Matched By .gitignore Or .profileignore")
+        .flag();
+
+    argument_parser.add_argument("--watch")
+        .help("Keep Counts Current As Files Change (Linux Only)")
+        .flag();
+
+    argument_parser.add_argument("--socket")
+        .help("Unix Socket Serving The Summary As JSON In Watch Mode");
+
+    argument_parser.add_argument("-j", "--jobs")
+        .help("Threads Matching Patterns (Defaults To One Per Core)")
+        .scan<'u', std::size_t>();
+
+    argument_parser.add_argument("--io-threads")
+        .help("Threads Walking And Reading Files Ahead Of The Matching Threads")
+        .default_value(std::size_t{0})
+        .scan<'u', std::size_t>();
+
+    argument_parser.add_argument("--auto-tune")
+        .help("Move Threads Between Reading And Matching As The Scan Goes")
+        .flag();
+
+    argument_parser.add_argument("--io-uring")
+        .help("Read Files In Batches Through io_uring (Linux Only)")
+        .flag();
+
+    argument_parser.add_argument("--fail-on")
+        .default_value(std::vector<std::string>{})
+        .append()
+        .help("Exit With Status 2 As Soon As A Pattern Is Found More Than N "
+              "Times (PATTERN[>N], N Defaults To 0)");
+
+    argument_parser.add_argument("--max-hits")
+        .help("Exit With Status 2 As Soon As More Than This Many Matches Are "
+              "Found")
+        .scan<'u', std::size_t>();
+
+    argument_parser.add_argument("--shard")
+        .help("Only Profile Part I Of N (I/N) Of The Files, Split By Path");
+
+    argument_parser.add_argument("--partial")
+        .help("Write This Run's Summary To A Partial Result File For --merge");
+
+    argument_parser.add_argument("--merge")
+        .nargs(argparse::nargs_pattern::at_least_one)
+        .help("Print The Combined Summary Of Every Shard's Partial Result");
+
+    argument_parser.add_argument("--changed-since")
+        .help("Only Profile Files Changed Since This Git Revision, Reporting "
+              "Matches Added And Removed");
+
+    argument_parser.add_argument("--languages")
+        .help("File Defining Extra Languages And Their Comment Markers");
+
+    argument_parser.add_argument("--cache")
+        .help("Reuse Results For Unchanged Files Stored In This Cache File");
+
     argument_parser.add_argument("-h", "--help")
         .help("Display This Message And Exit")
         .flag();
@@ -118,48 +391,347 @@ int main(int argc, char** argv) {
             << std::endl;
         return 0;
     } else if (argument_parser.get<bool>("-a")) {
+        std::optional<language_registry::LanguageRegistry> languages{};
+        try {
+            languages.emplace(argument_parser.present("--languages"));
+        } catch (const std::exception& err) {
+            std::cerr << "FATAL: " << err.what() << std::endl;
+            return 1;
+        }
+
+        const std::string rule(
+            max_column_width + extension_column_width + max_column_width, '-');
         std::cout
             << std::endl
             << "Supported Languages (Contact spineda.wpi.alum@gmail.com or "
-               "submit a github issue for suggestions):"
+               "submit a github issue for suggestions, or define your own "
+               "with --languages):"
             << std::endl
             << std::endl
-            << "-------------------------------" << std::endl
-            << std::left << std::setw(max_column_width) << "Language"
-            << std::left << "|" << std::left << std::setw(max_column_width)
+            << rule << std::endl
+            << std::left << std::setw(max_column_width) << "Language" << "|"
+            << std::setw(extension_column_width) << "Extensions" << "|"
             << "Comment Type" << std::endl
-            << "-------------------------------" << std::endl;
-        for (const auto [file_type, comment_type] : supported_languages) {
-            std::cout << std::left << std::setw(max_column_width) << file_type
-                      << std::left << "|" << std::string{max_column_width / 2}
-                      << std::setw(max_column_width) << comment_type
+            << rule << std::endl;
+        for (const language_registry::Language& language :
+             languages->Languages()) {
+            std::cout << std::left << std::setw(max_column_width)
+                      << language.name << "|"
+                      << std::setw(extension_column_width)
+                      << language.extensions << "|"
+                      << language_registry::DescribeComments(*language.syntax)
                       << std::endl;
         }
         return 0;
     }
 
-    std::optional<std::string> dir_str = argument_parser.present("-d");
-    std::filesystem::path directory(std::filesystem::canonical(
-        std::filesystem::absolute(dir_str.value_or("."))));
+    const std::optional<std::string> archive{argument_parser.present("--tar")};
+    const std::vector<std::string> merge_files{
+        argument_parser.present<std::vector<std::string>>("--merge").value_or(
+            std::vector<std::string>{})};
+    std::vector<std::filesystem::path> directories{};
+    if (!merge_files.empty()) {
+        if (archive.has_value() || argument_parser.get<bool>("--watch")) {
+            std::cerr << "FATAL: --merge only combines partial results and "
+                         "scans nothing itself"
+                      << std::endl;
+            return 1;
+        }
+    } else if (archive.has_value()) {
+        if (argument_parser.get<bool>("--watch")) {
+            std::cerr << "FATAL: An archive can not be watched" << std::endl;
+            return 1;
+        }
+    } else {
+        std::vector<std::string> dir_strs{
+            argument_parser.get<std::vector<std::string>>("-d")};
+        if (dir_strs.empty()) {
+            dir_strs.emplace_back(".");
+        }
+
+        for (const std::string& dir_str : dir_strs) {
+            const std::filesystem::path directory{
+                std::filesystem::absolute(dir_str)};
+            if (!directory_validation::DirectoryExists(directory)) {
+                std::cerr << "FATAL: Directory " << directory
+                          << " does not exist!" << std::endl;
+                return -1;
+            }
+            directories.push_back(std::filesystem::canonical(directory));
+        }
+    }
+
+    std::optional<profile::Shard> shard{std::nullopt};
+    if (const std::optional<std::string> shard_str{
+            argument_parser.present("--shard")}) {
+        shard = ParseShard(shard_str.value());
+        if (!shard.has_value()) {
+            std::cerr << "FATAL: Invalid shard " << shard_str.value()
+                      << ", expected I/N with 1 <= I <= N" << std::endl;
+            return 1;
+        } else if (argument_parser.get<bool>("--watch")) {
+            std::cerr << "FATAL: A shard can not be watched" << std::endl;
+            return 1;
+        }
+    }
+
+    const std::optional<std::string> changed_since{
+        argument_parser.present("--changed-since")};
+    if (changed_since.has_value() &&
+        (archive.has_value() || !merge_files.empty() || shard.has_value() ||
+         argument_parser.present("--partial").has_value() ||
+         argument_parser.get<bool>("--watch"))) {
+        std::cerr << "FATAL: --changed-since only profiles a git working tree "
+                     "once, unsharded"
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<profile::Threshold> thresholds{};
+    for (const std::string& argument :
+         argument_parser.get<std::vector<std::string>>("--fail-on")) {
+        const std::optional<profile::Threshold> threshold{
+            ParseThreshold(argument)};
+        if (!threshold.has_value()) {
+            std::cerr << "FATAL: Invalid threshold " << argument << std::endl;
+            return 1;
+        }
+        thresholds.push_back(threshold.value());
+    }
+    const std::optional<std::size_t> max_hits{
+        argument_parser.present<std::size_t>("--max-hits")};
+    if ((!thresholds.empty() || max_hits.has_value()) &&
+        argument_parser.get<bool>("--watch")) {
+        std::cerr << "FATAL: Thresholds can not be used with --watch"
+                  << std::endl;
+        return 1;
+    }
 
-    if (!directory_validation::DirectoryExists(directory)) {
-        std::cerr << "FATAL: Directory " << directory << " does not exist!"
+    const std::optional<result_formatting::OutputFormat> format{
+        result_formatting::ParseOutputFormat(
+            argument_parser.get<std::string>("--format"))};
+    if (!format.has_value()) {
+        std::cerr << "FATAL: Unknown output format "
+                  << argument_parser.get<std::string>("--format") << std::endl;
+        return 1;
+    } else if (format == result_formatting::OutputFormat::Binary &&
+               argument_parser.get<bool>("--watch")) {
+        std::cerr << "FATAL: The binary format can not be used with --watch"
+                  << std::endl;
+        return 1;
+    } else if (format == result_formatting::OutputFormat::Binary &&
+               changed_since.has_value()) {
+        std::cerr << "FATAL: The binary format can not be used with "
+                     "--changed-since"
                   << std::endl;
-        return -1;
+        return 1;
     }
 
-    std::cout << "Profiling Directory " << directory << std::endl << std::endl;
+    // everything meant for people goes to stderr when stdout carries records
+    const bool text_output{format == result_formatting::OutputFormat::Text};
+    std::ostream& messages{text_output ? std::cout : std::cerr};
+
+    if (!merge_files.empty()) {
+        messages << "Merging " << merge_files.size() << " Partial Results"
+                 << std::endl
+                 << std::endl;
+    } else if (archive.has_value()) {
+        messages << "Profiling Archive "
+                 << (archive == "-" ? std::string{"<stdin>"} : archive.value())
+                 << std::endl
+                 << std::endl;
+    } else {
+        for (const std::filesystem::path& directory : directories) {
+            messages << "Profiling Directory " << directory << std::endl;
+        }
+        if (changed_since.has_value()) {
+            messages << "Profiling Changes Since " << changed_since.value()
+                     << std::endl;
+        }
+        messages << std::endl;
+    }
 
     try {
+        profile::ScanConfig config{
+            .directory = directories.empty() ? std::filesystem::path{"."}
+                                             : directories.front(),
+            .extra_directories = {},
+            .archive = archive,
+            .custom_regexes = {},
+            .language_file = argument_parser.present("--languages"),
+            .cache_file = argument_parser.present("--cache"),
+            .use_ignore_files = !argument_parser.get<bool>("--no-ignore"),
+            .thread_count = argument_parser.present<std::size_t>("-j")
+                                .value_or(profile::DefaultThreadCount()),
+            .io_thread_count =
+                argument_parser.get<std::size_t>("--io-threads"),
+            .auto_tune = argument_parser.get<bool>("--auto-tune"),
+            .io_backend = argument_parser.get<bool>("--io-uring")
+                              ? profile::IoBackend::IoUring
+                              : profile::IoBackend::Blocking,
+            .thresholds = std::move(thresholds),
+            .max_hits = max_hits,
+            .stop_token = {},
+            .shard = shard,
+        };
+        if (directories.size() > 1) {
+            config.extra_directories.assign(directories.cbegin() + 1,
+                                            directories.cend());
+        }
+
         if (std::vector<std::string> regexes{
                 argument_parser.get<std::vector<std::string>>("-c")};
             regexes.size() != 0 && NoEmptyRegexes(regexes)) {
-            parser_info::Parser parser{argument_parser.get<bool>("-l"),
-                                       std::move(regexes)};
-            parser.ParseFiles(directory);
+            config.custom_regexes = std::move(regexes);
+        }
+
+        if (merge_files.empty()) {
+            messages << "Concurrent Threads Supported: " << config.thread_count
+                     << std::endl;
+            if (config.io_thread_count != 0) {
+                messages << "I/O Threads: " << config.io_thread_count
+                         << (config.auto_tune ? " (Auto-Tuned)" : "")
+                         << std::endl;
+            }
+            if (shard.has_value()) {
+                messages << "Shard: " << shard->index + 1 << "/"
+                         << shard->count << std::endl;
+            }
+            messages << std::endl;
+        }
+
+        std::optional<output_collection::OutputCollector> output{std::nullopt};
+        profile::HitCallback on_hits{};
+        if (!text_output || argument_parser.get<bool>("-l")) {
+            output.emplace(stdout, profile::WorkerCount(config),
+                           argument_parser.get<bool>("--sort"));
+            on_hits = [&output, &format](const profile::FileHits& file) {
+                LogHits(file, format.value(), output.value());
+            };
+        }
+        if (format == result_formatting::OutputFormat::Binary) {
+            std::string header{};
+            result_formatting::AppendBinaryHeader(header);
+            output->Write(header);
+        }
+
+        const auto report{[&](const profile::ScanSummary& summary,
+                              const std::size_t changed_paths) {
+            if (output.has_value()) {
+                output->Finish();
+            }
+
+            for (const std::string& error : summary.errors) {
+                std::cerr << error << std::endl;
+            }
+
+            if (!text_output) {
+                std::string record{};
+                if (format == result_formatting::OutputFormat::JsonLines) {
+                    result_formatting::AppendJsonSummary(record, summary);
+                } else {
+                    result_formatting::AppendBinarySummary(
+                        record, summary, output->BytesWritten());
+                }
+                output->Write(record);
+                output->Finish();
+            } else if (changed_paths != 0) {
+                PrintUpdate(summary, changed_paths);
+                return;
+            } else {
+                PrintSummary(summary);
+            }
+
+            if (changed_paths != 0) {
+                return;
+            } else if (const std::optional<std::string> statistics_file{
+                           argument_parser.present("--stats-json")};
+                       argument_parser.get<bool>("--stats") ||
+                       statistics_file.has_value()) {
+                ReportScanStatistics(summary.statistics,
+                                     argument_parser.get<bool>("--stats"),
+                                     statistics_file, messages);
+            }
+            messages << std::endl;
+        }};
+
+        if (!merge_files.empty()) {
+            std::vector<partial_results::PartialResult> partials{};
+            for (const std::string& file : merge_files) {
+                std::optional<partial_results::PartialResult> partial{
+                    partial_results::ReadPartial(file)};
+                if (!partial.has_value()) {
+                    std::cerr << "FATAL: " << file
+                              << " is not a partial result file" << std::endl;
+                    return 1;
+                }
+                partials.push_back(std::move(partial.value()));
+            }
+
+            profile::ScanSummary summary{};
+            try {
+                // checked against the shards' own thresholds, and then
+                // against any given here
+                summary = partial_results::MergePartials(partials);
+                for (std::string& threshold : profile::ExceededThresholds(
+                         summary, config.thresholds, max_hits)) {
+                    if (std::ranges::find(summary.exceeded, threshold) ==
+                        summary.exceeded.end()) {
+                        summary.exceeded.push_back(std::move(threshold));
+                    }
+                }
+            } catch (const std::invalid_argument& err) {
+                std::cerr << "FATAL: " << err.what() << std::endl;
+                return 1;
+            }
+            report(summary, 0);
+            return ReportThresholds(summary);
+        } else if (changed_since.has_value()) {
+            const profile::ChangeSummary changes{profile::ScanChanges(
+                config, changed_since.value(), on_hits)};
+            if (output.has_value()) {
+                output->Finish();
+            }
+            if (text_output) {
+                PrintChanges(changed_since.value(), changes);
+            } else {
+                std::string record{};
+                result_formatting::AppendJsonChanges(
+                    record, changed_since.value(), changes);
+                output->Write(record);
+            }
+            report(changes.summary, 0);
+            return ReportThresholds(changes.summary);
+        } else if (argument_parser.get<bool>("--watch")) {
+            const watch_mode::WatchOptions watch_options{
+                .socket_path = argument_parser.present("--socket").value_or(
+                    (std::filesystem::temp_directory_path() / "profile.sock")
+                        .string()),
+            };
+            messages << "Watching For Changes, Summaries Are Served On "
+                     << watch_options.socket_path << std::endl
+                     << std::endl;
+            watch_mode::Watch(config, watch_options, on_hits, report);
         } else {
-            parser_info::Parser parser{argument_parser.get<bool>("-l")};
-            parser.ParseFiles(directory);
+            const profile::ScanSummary summary{profile::Scan(config, on_hits)};
+            report(summary, 0);
+
+            if (const std::optional<std::string> partial_file{
+                    argument_parser.present("--partial")};
+                partial_file.has_value() &&
+                !partial_results::WritePartial(
+                    partial_file.value(),
+                    partial_results::PartialResult{
+                        .shard = shard.value_or(profile::Shard{}),
+                        .summary = summary,
+                        .thresholds = config.thresholds,
+                        .max_hits = config.max_hits,
+                    })) {
+                std::cerr << "Could not write partial result file "
+                          << partial_file.value() << std::endl;
+                return 1;
+            }
+            return ReportThresholds(summary);
         }
     } catch (const std::exception& err) {
         std::println("Exception Ocurred: {}\nLine: {}\n", err.what(), __LINE__);
@@ -0,0 +1,97 @@
+/*
+ *  output_collector.cpp - Batched and optionally sorted verbose output
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/output_collector.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace output_collection {
+
+OutputCollector::OutputCollector(std::FILE* stream,
+                                 const std::size_t worker_count,
+                                 const bool sorted)
+    : stream_{stream},
+      buffers_(worker_count),
+      write_lock_{},
+      bytes_written_{0},
+      sorted_{sorted} {}
+
+void OutputCollector::EndRecord(const std::size_t worker,
+                                const std::filesystem::path& file) {
+    WorkerBuffer& buffer{buffers_[worker]};
+
+    if (sorted_) {
+        if (!buffer.text.empty()) {
+            buffer.records.emplace_back(file.string(), std::move(buffer.text));
+            buffer.text.clear();
+        }
+    } else if (buffer.text.size() >= flush_threshold) {
+        this->Write(buffer.text);
+        buffer.text.clear();
+    }
+}
+
+void OutputCollector::Finish() {
+    if (!sorted_) {
+        for (WorkerBuffer& buffer : buffers_) {
+            this->Write(buffer.text);
+            buffer.text.clear();
+        }
+        std::fflush(stream_);
+        return;
+    }
+
+    std::vector<std::pair<std::string, std::string>> records{};
+    for (WorkerBuffer& buffer : buffers_) {
+        std::ranges::move(buffer.records, std::back_inserter(records));
+        buffer.records.clear();
+    }
+    std::ranges::sort(records, {}, &std::pair<std::string, std::string>::first);
+
+    std::string batch{};
+    for (const auto& [_, text] : records) {
+        batch.append(text);
+        if (batch.size() >= flush_threshold) {
+            this->Write(batch);
+            batch.clear();
+        }
+    }
+    this->Write(batch);
+    std::fflush(stream_);
+}
+
+void OutputCollector::Write(const std::string_view text) {
+    if (text.empty()) {
+        return;
+    }
+
+    std::scoped_lock<std::mutex> lock{write_lock_};
+    std::fwrite(text.data(), 1, text.size(), stream_);
+    bytes_written_ += text.size();
+}
+
+}  // namespace output_collection
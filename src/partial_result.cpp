@@ -0,0 +1,216 @@
+/*
+ *  partial_result.cpp - Saving and merging the results of sharded scans
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/partial_result.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <ios>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "include/binary_io.hpp"
+
+namespace partial_results {
+namespace {
+using binary_io::Append;
+using binary_io::AppendText;
+using binary_io::Cursor;
+constexpr std::string_view magic{"PRFSHARD"};
+}  // namespace
+
+bool WritePartial(const std::filesystem::path& file,
+                  const PartialResult& partial) {
+    const auto& [shard, summary, thresholds, max_hits] = partial;
+
+    std::string buffer{magic};
+    Append(buffer, format_version);
+    Append(buffer, static_cast<std::uint32_t>(shard.index));
+    Append(buffer, static_cast<std::uint32_t>(shard.count));
+    Append(buffer, std::uint32_t{summary.stopped_early});
+    Append(buffer, static_cast<std::uint64_t>(summary.file_count));
+    Append(buffer, static_cast<std::uint64_t>(summary.thread_count));
+
+    Append(buffer, static_cast<std::uint32_t>(summary.patterns.size()));
+    for (const auto& [pattern, count, custom] : summary.patterns) {
+        Append(buffer, std::uint32_t{custom});
+        Append(buffer, static_cast<std::uint64_t>(count));
+        AppendText(buffer, pattern);
+    }
+    Append(buffer, static_cast<std::uint32_t>(summary.extension_counts.size()));
+    for (const auto& [extension, frequency] : summary.extension_counts) {
+        Append(buffer, static_cast<std::uint64_t>(frequency));
+        AppendText(buffer, extension);
+    }
+    Append(buffer, static_cast<std::uint32_t>(summary.errors.size()));
+    for (const std::string& error : summary.errors) {
+        AppendText(buffer, error);
+    }
+    Append(buffer, static_cast<std::uint32_t>(thresholds.size()));
+    for (const auto& [pattern, limit] : thresholds) {
+        Append(buffer, static_cast<std::uint64_t>(limit));
+        AppendText(buffer, pattern);
+    }
+    Append(buffer, std::uint32_t{max_hits.has_value()});
+    Append(buffer, static_cast<std::uint64_t>(max_hits.value_or(0)));
+
+    // written beside file and renamed over it, so a shard job killed
+    // halfway never leaves a truncated result behind for the merge
+    std::filesystem::path temporary_file{file};
+    temporary_file += ".tmp";
+
+    {
+        std::ofstream output{temporary_file,
+                             std::ios::binary | std::ios::trunc};
+        output.write(buffer.data(),
+                     static_cast<std::streamsize>(buffer.size()));
+        if (!output.good()) {
+            return false;
+        }
+    }
+
+    std::error_code error{};
+    std::filesystem::rename(temporary_file, file, error);
+    return !error;
+}
+
+std::optional<PartialResult> ReadPartial(const std::filesystem::path& file) {
+    std::ifstream input{file, std::ios::binary};
+    const std::string contents{std::istreambuf_iterator<char>{input},
+                               std::istreambuf_iterator<char>{}};
+    if (input.bad() || !contents.starts_with(magic)) {
+        return std::nullopt;
+    }
+
+    Cursor cursor{std::string_view{contents}.substr(magic.size())};
+    if (cursor.Read<std::uint32_t>() != format_version) {
+        return std::nullopt;
+    }
+
+    PartialResult partial{};
+    auto& [shard, summary, thresholds, max_hits] = partial;
+    shard.index = cursor.Read<std::uint32_t>();
+    shard.count = cursor.Read<std::uint32_t>();
+    summary.stopped_early = cursor.Read<std::uint32_t>() != 0;
+    summary.file_count = static_cast<std::size_t>(cursor.Read<std::uint64_t>());
+    summary.thread_count =
+        static_cast<std::size_t>(cursor.Read<std::uint64_t>());
+
+    // a count past the end of the file fails the cursor before it can make
+    // any of these loops run long
+    for (std::uint32_t pattern_count{cursor.Read<std::uint32_t>()};
+         pattern_count != 0 && cursor.Ok(); --pattern_count) {
+        const bool custom{cursor.Read<std::uint32_t>() != 0};
+        const std::size_t count{
+            static_cast<std::size_t>(cursor.Read<std::uint64_t>())};
+        summary.patterns.emplace_back(cursor.ReadText(), count, custom);
+    }
+    for (std::uint32_t extension_count{cursor.Read<std::uint32_t>()};
+         extension_count != 0 && cursor.Ok(); --extension_count) {
+        const std::size_t frequency{
+            static_cast<std::size_t>(cursor.Read<std::uint64_t>())};
+        summary.extension_counts[cursor.ReadText()] += frequency;
+    }
+    for (std::uint32_t error_count{cursor.Read<std::uint32_t>()};
+         error_count != 0 && cursor.Ok(); --error_count) {
+        summary.errors.push_back(cursor.ReadText());
+    }
+    for (std::uint32_t threshold_count{cursor.Read<std::uint32_t>()};
+         threshold_count != 0 && cursor.Ok(); --threshold_count) {
+        const std::size_t limit{
+            static_cast<std::size_t>(cursor.Read<std::uint64_t>())};
+        thresholds.push_back(profile::Threshold{
+            .pattern = cursor.ReadText(),
+            .limit = limit,
+        });
+    }
+    const bool has_max_hits{cursor.Read<std::uint32_t>() != 0};
+    const std::size_t max_hits_value{
+        static_cast<std::size_t>(cursor.Read<std::uint64_t>())};
+    if (has_max_hits) {
+        max_hits = max_hits_value;
+    }
+
+    if (!cursor.Ok() || !cursor.AtEnd() || shard.index >= shard.count) {
+        return std::nullopt;
+    }
+    return partial;
+}
+
+profile::ScanSummary MergePartials(
+    const std::span<const PartialResult> partials) {
+    if (partials.empty()) {
+        throw std::invalid_argument{"No partial results to merge"};
+    }
+
+    const std::size_t shard_count{partials.front().shard.count};
+    const std::vector<profile::Threshold>& thresholds{
+        partials.front().thresholds};
+    const std::optional<std::size_t> max_hits{partials.front().max_hits};
+    std::vector<bool> seen(shard_count, false);
+    std::vector<profile::ScanSummary> summaries{};
+    for (const PartialResult& partial : partials) {
+        const auto& [shard, summary, shard_thresholds, shard_max_hits] =
+            partial;
+        if (shard.count != shard_count) {
+            throw std::invalid_argument{std::format(
+                "Partial results split the scan {} and {} ways", shard_count,
+                shard.count)};
+        } else if (seen[shard.index]) {
+            throw std::invalid_argument{std::format(
+                "Shard {}/{} is given twice", shard.index + 1, shard_count)};
+        } else if (shard_max_hits != max_hits ||
+                   !std::ranges::equal(
+                       shard_thresholds, thresholds,
+                       [](const profile::Threshold& left,
+                          const profile::Threshold& right) {
+                           return left.pattern == right.pattern &&
+                                  left.limit == right.limit;
+                       })) {
+            throw std::invalid_argument{
+                "Partial results were scanned with different thresholds"};
+        }
+        seen[shard.index] = true;
+        summaries.push_back(summary);
+    }
+
+    for (std::size_t index{0}; index < shard_count; ++index) {
+        if (!seen[index]) {
+            throw std::invalid_argument{
+                std::format("Shard {}/{} is missing", index + 1, shard_count)};
+        }
+    }
+
+    // a shard only ever saw its own share of the totals
+    profile::ScanSummary merged{profile::MergeSummaries(summaries)};
+    merged.exceeded =
+        profile::ExceededThresholds(merged, thresholds, max_hits);
+    return merged;
+}
+
+}  // namespace partial_results
@@ -0,0 +1,217 @@
+/*
+ *  path_arena.cpp - Compact storage for the paths a scan visits
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/path_arena.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace path_arena {
+namespace {
+constexpr char separator{
+    static_cast<char>(std::filesystem::path::preferred_separator)};
+
+bool EndsWithSeparator(const std::string_view path) {
+    return !path.empty() && (path.back() == '/' || path.back() == separator);
+}
+
+/*
+ * A separator goes between a parent and its child unless the parent already
+ * ends with one, or is empty.
+ */
+bool NeedsSeparator(const std::string_view parent) {
+    return !parent.empty() && !EndsWithSeparator(parent);
+}
+}  // namespace
+
+/*
+ * Moves on to the next block that is large enough, so that the blocks kept
+ * by Reset are reused in order, and only allocates when none is left.
+ */
+char* BumpArena::Allocate(const std::size_t size) {
+    while (current_ < blocks_.size() &&
+           blocks_[current_].size - used_ < size) {
+        current_++;
+        used_ = 0;
+    }
+    if (current_ == blocks_.size()) {
+        const std::size_t block{std::max(block_size, size)};
+        blocks_.push_back(Block{
+            .memory = std::make_unique_for_overwrite<char[]>(block),
+            .size = block,
+        });
+        used_ = 0;
+    }
+
+    char* const memory{blocks_[current_].memory.get() + used_};
+    used_ += size;
+    return memory;
+}
+
+std::string_view BumpArena::Copy(const std::string_view text) {
+    if (text.empty()) {
+        return std::string_view{""};
+    }
+    char* const copy{this->Allocate(text.size())};
+    std::memcpy(copy, text.data(), text.size());
+    return std::string_view{copy, text.size()};
+}
+
+void BumpArena::Reset() {
+    current_ = 0;
+    used_ = 0;
+}
+
+PathArena::PathArena(const std::size_t writer_count)
+    : buckets_{}, writers_(writer_count), next_run_{0} {}
+
+PathArena::~PathArena() {
+    for (std::atomic<Node*>& bucket : buckets_) {
+        delete[] bucket.load();
+    }
+}
+
+const PathArena::Node& PathArena::At(const PathId path) const {
+    const std::uint64_t position{std::uint64_t{path} +
+                                 (std::uint64_t{1} << first_bucket_bits)};
+    const std::size_t bucket{
+        static_cast<std::size_t>(std::bit_width(position)) - 1 -
+        first_bucket_bits};
+    return buckets_[bucket].load(std::memory_order_acquire)
+        [position - (std::uint64_t{1} << (bucket + first_bucket_bits))];
+}
+
+/*
+ * Whoever first needs a bucket allocates it; if two writers race for it,
+ * the loser frees its copy and uses the winner's.
+ */
+PathArena::Node& PathArena::Claim(const PathId path) {
+    const std::uint64_t position{std::uint64_t{path} +
+                                 (std::uint64_t{1} << first_bucket_bits)};
+    const std::size_t bucket{
+        static_cast<std::size_t>(std::bit_width(position)) - 1 -
+        first_bucket_bits};
+
+    Node* nodes{buckets_[bucket].load(std::memory_order_acquire)};
+    if (nodes == nullptr) {
+        Node* const allocated{
+            new Node[std::size_t{1} << (bucket + first_bucket_bits)]};
+        if (buckets_[bucket].compare_exchange_strong(
+                nodes, allocated, std::memory_order_acq_rel)) {
+            nodes = allocated;
+        } else {
+            delete[] allocated;
+        }
+    }
+    return nodes[position - (std::uint64_t{1} << (bucket + first_bucket_bits))];
+}
+
+PathId PathArena::Add(const std::size_t writer, const PathId parent,
+                      const std::string_view name) {
+    Writer& slot{writers_[writer]};
+    if (slot.next == slot.end) {
+        const std::uint64_t first{
+            next_run_.fetch_add(id_run, std::memory_order_relaxed)};
+        if (first >= no_path) {
+            throw std::length_error{"Too many paths to scan"};
+        }
+        slot.next = first;
+        slot.end = std::min<std::uint64_t>(first + id_run, no_path);
+    }
+
+    const PathId path{static_cast<PathId>(slot.next++)};
+    const std::string_view copy{slot.names.Copy(name)};
+    this->Claim(path) = Node{
+        .name = copy.data(),
+        .length = static_cast<std::uint32_t>(copy.size()),
+        .parent = parent,
+    };
+    return path;
+}
+
+std::string_view PathArena::Name(const PathId path) const {
+    const Node& node{this->At(path)};
+    return std::string_view{node.name, node.length};
+}
+
+std::string_view PathArena::Root(PathId path) const {
+    while (this->At(path).parent != no_path) {
+        path = this->At(path).parent;
+    }
+    return this->Name(path);
+}
+
+/*
+ * Measures the path first, then fills it in from its end, so full_path is
+ * sized once and never reallocated for a path that fits.
+ */
+void PathArena::Resolve(const PathId path, std::string& full_path) const {
+    std::size_t length{0};
+    for (PathId current{path}; current != no_path;) {
+        const Node& node{this->At(current)};
+        length += node.length;
+        if (node.parent != no_path &&
+            NeedsSeparator(this->Name(node.parent))) {
+            length++;
+        }
+        current = node.parent;
+    }
+
+    full_path.resize(length);
+    std::size_t end{length};
+    for (PathId current{path}; current != no_path;) {
+        const Node& node{this->At(current)};
+        end -= node.length;
+        std::memcpy(full_path.data() + end, node.name, node.length);
+        if (node.parent != no_path &&
+            NeedsSeparator(this->Name(node.parent))) {
+            full_path[--end] = separator;
+        }
+        current = node.parent;
+    }
+}
+
+void PathArena::AppendName(std::string& full_path,
+                           const std::string_view name) {
+    if (NeedsSeparator(full_path)) {
+        full_path.push_back(separator);
+    }
+    full_path.append(name);
+}
+
+void PathArena::Clear() {
+    for (Writer& writer : writers_) {
+        writer.names.Reset();
+        writer.next = 0;
+        writer.end = 0;
+    }
+    next_run_.store(0);
+}
+
+}  // namespace path_arena
@@ -0,0 +1,320 @@
+/*
+ *  profile.cpp - Library entry points wrapping the parser
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/profile.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <format>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "include/Parser.hpp"
+#include "include/git_repository.hpp"
+#include "include/json_writer.hpp"
+
+namespace profile {
+
+std::size_t DefaultThreadCount() {
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+std::size_t WorkerCount(const ScanConfig& config) {
+    return (config.thread_count != 0 ? config.thread_count
+                                     : DefaultThreadCount()) +
+           config.io_thread_count;
+}
+
+ScanSummary Scan(const ScanConfig& config, const HitCallback& on_hits) {
+    parser_info::Parser parser{config, on_hits};
+    return config.archive.has_value()
+               ? parser.ParseArchive(config.archive.value())
+               : parser.ParseFiles();
+}
+
+/*
+ * Roots are resolved to find where they are in the working tree, but files
+ * are scanned by the paths a walk of the roots would reach them by, so both
+ * scans spell every file the same way, hits read the same as in a full scan
+ * and a cache is shared with it. A file below several roots belongs to the
+ * outermost.
+ */
+ChangeSummary ScanChanges(const ScanConfig& config,
+                          const std::string_view revision,
+                          const HitCallback& on_hits) {
+    if (config.archive.has_value() || config.shard.has_value()) {
+        throw std::invalid_argument{
+            "Changes can only be scanned in a working tree, and unsharded"};
+    }
+
+    parser_info::Parser current{config, on_hits, true};
+    const std::vector<std::filesystem::path>& roots{current.Roots()};
+    git_reading::Repository repository{roots.front()};
+    const std::filesystem::path& work_tree{repository.WorkTree()};
+
+    // every root's path below the top of the working tree, ending in '/'
+    // unless it is the top itself
+    std::vector<std::string> root_prefixes{};
+    for (const std::filesystem::path& root : roots) {
+        std::error_code error{};
+        const std::filesystem::path relative{
+            std::filesystem::canonical(root, error)
+                .lexically_relative(work_tree)};
+        if (error) {
+            throw std::runtime_error{
+                std::format("Could not open directory {}", root.string())};
+        } else if (relative.empty() || *relative.begin() == "..") {
+            throw std::runtime_error{
+                std::format("{} is not inside the git working tree {}",
+                            root.string(), work_tree.string())};
+        }
+        root_prefixes.push_back(relative == "." ? std::string{}
+                                                : relative.generic_string() +
+                                                      '/');
+    }
+    const auto owner{[&root_prefixes](const std::string_view path) {
+        std::optional<std::size_t> outermost{std::nullopt};
+        for (std::size_t index{0}; index < root_prefixes.size(); ++index) {
+            if (path.starts_with(root_prefixes[index]) &&
+                (!outermost.has_value() ||
+                 root_prefixes[index].size() <
+                     root_prefixes[outermost.value()].size())) {
+                outermost = index;
+            }
+        }
+        return outermost;
+    }};
+
+    ScanConfig base_config{config};
+    base_config.cache_file.reset();
+    parser_info::Parser base{base_config, {}, true};
+
+    const git_reading::ObjectId commit{repository.ResolveCommit(revision)};
+    const std::vector<git_reading::ChangedFile> changed{
+        repository.ChangesSince(
+            commit,
+            [&owner, &current](const std::string_view path) {
+                return owner(path).has_value() && current.IsSourceFile(path);
+            },
+            WorkerCount(config))};
+
+    std::vector<std::vector<std::size_t>> root_changes(roots.size());
+    for (std::size_t index{0}; index < changed.size(); ++index) {
+        root_changes[owner(changed[index].path).value()].push_back(index);
+    }
+
+    // every change a scan of the roots would visit, with its path there
+    std::vector<std::pair<std::size_t, std::string>> selected{};
+    for (std::size_t root{0}; root < roots.size(); ++root) {
+        std::vector<std::string> files{};
+        for (const std::size_t index : root_changes[root]) {
+            files.push_back(
+                changed[index].path.substr(root_prefixes[root].size()));
+        }
+        std::vector<std::optional<std::string>> paths{
+            current.Select(roots[root], files)};
+        for (std::size_t file{0}; file < files.size(); ++file) {
+            if (paths[file].has_value()) {
+                selected.emplace_back(root_changes[root][file],
+                                      std::move(paths[file].value()));
+            }
+        }
+    }
+
+    std::vector<std::string> current_files{};
+    std::vector<std::string> base_files{};
+    std::vector<git_reading::ObjectId> base_blobs{};
+    for (const auto& [index, path] : selected) {
+        if (!changed[index].deleted) {
+            current_files.push_back(path);
+        }
+        if (changed[index].base.has_value()) {
+            base_files.push_back(path);
+            base_blobs.push_back(changed[index].base.value());
+        }
+    }
+
+    ChangeSummary result{
+        .summary = current.ParseFileList(current_files),
+        .base = git_reading::ToHex(commit),
+        .deleted_files = 0,
+        .changes = {},
+    };
+    const ScanSummary base_summary{base.ParseSnapshot(
+        base_files, [&repository, &base_blobs](const std::size_t index,
+                                               std::string& contents) {
+            return repository.ReadBlob(base_blobs[index], contents);
+        })};
+    for (const std::string& error : base_summary.errors) {
+        result.summary.errors.push_back(
+            std::format("{} at {}", error, revision));
+    }
+    result.summary.stopped_early =
+        result.summary.stopped_early || base_summary.stopped_early;
+
+    for (const PatternTotal& total : result.summary.patterns) {
+        result.changes.push_back(PatternChange{
+            .pattern = total.pattern,
+            .added = 0,
+            .removed = 0,
+            .custom = total.custom,
+        });
+    }
+    for (const auto& [index, path] : selected) {
+        const std::optional<std::span<const std::size_t>> after{
+            changed[index].deleted ? std::nullopt : current.FileCounts(path)};
+        const std::optional<std::span<const std::size_t>> before{
+            changed[index].base.has_value() ? base.FileCounts(path)
+                                            : std::nullopt};
+        for (std::size_t pattern{0}; pattern < result.changes.size();
+             ++pattern) {
+            const std::size_t now{after.has_value() ? (*after)[pattern] : 0};
+            const std::size_t then{before.has_value() ? (*before)[pattern]
+                                                      : 0};
+            if (now > then) {
+                result.changes[pattern].added += now - then;
+            } else {
+                result.changes[pattern].removed += then - now;
+            }
+        }
+        if (changed[index].deleted) {
+            result.deleted_files++;
+        }
+    }
+
+    // a change is held to the thresholds by what it adds, not by what the
+    // files it touches already held
+    ScanSummary added{};
+    for (const PatternChange& change : result.changes) {
+        added.patterns.push_back(PatternTotal{
+            .pattern = change.pattern,
+            .count = change.added,
+            .custom = change.custom,
+        });
+    }
+    result.summary.exceeded =
+        ExceededThresholds(added, config.thresholds, config.max_hits);
+
+    return result;
+}
+
+std::string SummaryJson(const ScanSummary& summary) {
+    std::string json{};
+    std::format_to(std::back_inserter(json),
+                   "{{\"files\":{},\"threads\":{},\"patterns\":[",
+                   summary.file_count, summary.thread_count);
+    for (std::size_t index{0}; index < summary.patterns.size(); ++index) {
+        const PatternTotal& total{summary.patterns[index]};
+        json.append(index == 0 ? "{\"pattern\":" : ",{\"pattern\":");
+        json_writing::AppendJsonString(json, total.pattern);
+        std::format_to(std::back_inserter(json),
+                       ",\"count\":{},\"custom\":{}}}", total.count,
+                       total.custom);
+    }
+    json.append("],\"extensions\":{");
+    bool first{true};
+    for (const auto& [extension, frequency] : summary.extension_counts) {
+        json.append(first ? "" : ",");
+        json_writing::AppendJsonString(json, extension);
+        std::format_to(std::back_inserter(json), ":{}", frequency);
+        first = false;
+    }
+    json.append("},\"errors\":[");
+    for (std::size_t index{0}; index < summary.errors.size(); ++index) {
+        json.append(index == 0 ? "" : ",");
+        json_writing::AppendJsonString(json, summary.errors[index]);
+    }
+    json.append("],\"exceeded\":[");
+    for (std::size_t index{0}; index < summary.exceeded.size(); ++index) {
+        json.append(index == 0 ? "" : ",");
+        json_writing::AppendJsonString(json, summary.exceeded[index]);
+    }
+    std::format_to(std::back_inserter(json), "],\"stopped_early\":{}}}\n",
+                   summary.stopped_early);
+    return json;
+}
+
+std::vector<std::string> ExceededThresholds(
+    const ScanSummary& summary, const std::span<const Threshold> thresholds,
+    const std::optional<std::size_t> max_hits) {
+    std::vector<std::string> exceeded{};
+    for (const auto& [pattern, limit] : thresholds) {
+        const auto total{std::ranges::find(summary.patterns, pattern,
+                                           &PatternTotal::pattern)};
+        if (total == summary.patterns.end()) {
+            throw std::invalid_argument{
+                std::format("No pattern {} to set a threshold on", pattern)};
+        } else if (total->count > limit) {
+            exceeded.push_back(std::format("{}>{}", pattern, limit));
+        }
+    }
+
+    std::size_t hits{0};
+    for (const PatternTotal& total : summary.patterns) {
+        hits += total.count;
+    }
+    if (max_hits.has_value() && hits > max_hits.value()) {
+        exceeded.push_back(std::format("hits>{}", max_hits.value()));
+    }
+    return exceeded;
+}
+
+ScanSummary MergeSummaries(const std::span<const ScanSummary> summaries) {
+    ScanSummary merged{};
+    for (const ScanSummary& summary : summaries) {
+        if (&summary == &summaries.front()) {
+            merged.patterns = summary.patterns;
+            for (PatternTotal& total : merged.patterns) {
+                total.count = 0;
+            }
+        } else if (!std::ranges::equal(
+                       summary.patterns, merged.patterns,
+                       [](const PatternTotal& left, const PatternTotal& right) {
+                           return left.pattern == right.pattern &&
+                                  left.custom == right.custom;
+                       })) {
+            throw std::invalid_argument{
+                "Summaries to merge count different patterns"};
+        }
+
+        merged.file_count += summary.file_count;
+        merged.thread_count = std::max(merged.thread_count,
+                                       summary.thread_count);
+        for (std::size_t index{0}; index < summary.patterns.size(); ++index) {
+            merged.patterns[index].count += summary.patterns[index].count;
+        }
+        for (const auto& [extension, frequency] : summary.extension_counts) {
+            merged.extension_counts[extension] += frequency;
+        }
+        merged.errors.insert(merged.errors.end(), summary.errors.cbegin(),
+                             summary.errors.cend());
+        merged.stopped_early = merged.stopped_early || summary.stopped_early;
+    }
+    return merged;
+}
+
+}  // namespace profile
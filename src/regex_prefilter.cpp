@@ -0,0 +1,208 @@
+/*
+ *  regex_prefilter.cpp - Literal extraction for prefiltering custom regexes
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/regex_prefilter.hpp"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace regex_prefilter {
+namespace {
+constexpr bool IsDigit(const char character) {
+    return character >= '0' && character <= '9';
+}
+
+constexpr bool IsAlphanumeric(const char character) {
+    return IsDigit(character) || (character >= 'a' && character <= 'z') ||
+           (character >= 'A' && character <= 'Z');
+}
+
+/*
+ * Returns the index just past the escape sequence starting at position
+ * (which holds the backslash).
+ */
+std::size_t SkipEscape(const std::string_view pattern, std::size_t position) {
+    position++;
+    if (position >= pattern.size()) {
+        return position;
+    }
+
+    switch (pattern[position]) {
+        case 'x':
+            return position + 3;
+        case 'u':
+            return position + 5;
+        case 'c':
+            return position + 2;
+        default:
+            break;
+    }
+
+    if (IsDigit(pattern[position])) {
+        while (position < pattern.size() && IsDigit(pattern[position])) {
+            position++;
+        }
+        return position;
+    }
+    return position + 1;
+}
+
+/*
+ * Returns the index just past the ']' closing the class opened at position.
+ */
+std::size_t SkipClass(const std::string_view pattern, std::size_t position) {
+    position++;
+    while (position < pattern.size() && pattern[position] != ']') {
+        position = pattern[position] == '\\' ? SkipEscape(pattern, position)
+                                              : position + 1;
+    }
+    return position + 1;
+}
+
+/*
+ * Returns the index just past the ')' closing the group opened at position.
+ */
+std::size_t SkipGroup(const std::string_view pattern, std::size_t position) {
+    std::size_t depth{0};
+    while (position < pattern.size()) {
+        switch (pattern[position]) {
+            case '\\':
+                position = SkipEscape(pattern, position);
+                continue;
+            case '[':
+                position = SkipClass(pattern, position);
+                continue;
+            case '(':
+                depth++;
+                break;
+            case ')':
+                if (--depth == 0) {
+                    return position + 1;
+                }
+                break;
+            default:
+                break;
+        }
+        position++;
+    }
+    return position;
+}
+}  // namespace
+
+std::string RequiredLiteral(const std::string_view pattern) {
+    std::string longest{};
+    std::string current{};
+
+    const auto end_run{[&longest, &current]() {
+        if (current.size() > longest.size()) {
+            longest = current;
+        }
+        current.clear();
+    }};
+
+    std::size_t position{0};
+    while (position < pattern.size()) {
+        const char character{pattern[position]};
+        bool is_literal{false};
+        char literal{character};
+        std::size_t next{position + 1};
+
+        switch (character) {
+            case '|':
+                return {};
+            case '(':
+                next = SkipGroup(pattern, position);
+                break;
+            case '[':
+                next = SkipClass(pattern, position);
+                break;
+            case '\\':
+                next = SkipEscape(pattern, position);
+                if (next == position + 2 &&
+                    !IsAlphanumeric(pattern[position + 1])) {
+                    is_literal = true;
+                    literal = pattern[position + 1];
+                }
+                break;
+            case '.':
+            case '^':
+            case '$':
+            case '*':
+            case '+':
+            case '?':
+            case '{':
+            case '}':
+            case ')':
+            case ']':
+                break;
+            default:
+                is_literal = true;
+                break;
+        }
+
+        // quantifiers apply to the atom just read, and some engines accept
+        // several in a row, any of which can make it optional
+        bool optional{false};
+        bool quantified{false};
+        while (next < pattern.size()) {
+            const std::size_t quantifier{next};
+            switch (pattern[next]) {
+                case '*':
+                case '?':
+                    optional = true;
+                    next++;
+                    break;
+                case '+':
+                    next++;
+                    break;
+                case '{':
+                    optional = optional || (next + 1 < pattern.size() &&
+                                            pattern[next + 1] == '0');
+                    next = pattern.find('}', next);
+                    next = next == std::string_view::npos ? pattern.size()
+                                                          : next + 1;
+                    break;
+                default:
+                    break;
+            }
+            if (next == quantifier) {
+                break;
+            }
+            quantified = true;
+            // a '?' straight after a quantifier only makes it lazy
+            if (next < pattern.size() && pattern[next] == '?') {
+                next++;
+            }
+        }
+
+        if (is_literal && !optional) {
+            current.push_back(literal);
+        }
+        if (!is_literal || quantified) {
+            end_run();
+        }
+
+        position = next;
+    }
+    end_run();
+
+    return longest;
+}
+
+}  // namespace regex_prefilter
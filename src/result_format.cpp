@@ -0,0 +1,204 @@
+/*
+ *  result_format.cpp - JSON Lines and binary encoders for scan results
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/result_format.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "include/json_writer.hpp"
+#include "include/profile.hpp"
+
+namespace result_formatting {
+namespace {
+constexpr std::size_t record_alignment{8};
+
+/*
+ * Appends record followed by text and enough zeros to reach the next
+ * record boundary, filling in the record's size on the way.
+ */
+template <typename Record>
+void AppendRecord(std::string& buffer, Record record,
+                  const std::string_view text) {
+    const std::size_t size{(sizeof(Record) + text.size() + record_alignment -
+                            1) /
+                           record_alignment * record_alignment};
+    record.size = static_cast<std::uint32_t>(size);
+
+    const std::size_t start{buffer.size()};
+    buffer.resize(start + size);
+    std::memcpy(buffer.data() + start, &record, sizeof(Record));
+    std::memcpy(buffer.data() + start + sizeof(Record), text.data(),
+                text.size());
+}
+}  // namespace
+
+std::optional<OutputFormat> ParseOutputFormat(const std::string_view name) {
+    if (name == "text") {
+        return OutputFormat::Text;
+    } else if (name == "jsonl") {
+        return OutputFormat::JsonLines;
+    } else if (name == "binary") {
+        return OutputFormat::Binary;
+    } else {
+        return std::nullopt;
+    }
+}
+
+void AppendJsonHits(std::string& buffer, const profile::FileHits& file) {
+    for (const profile::HitRecord& hit : file.hits) {
+        buffer.append("{\"type\":\"hit\",\"path\":");
+        json_writing::AppendJsonString(buffer, file.path.c_str());
+        std::format_to(std::back_inserter(buffer),
+                       ",\"line_number\":{},\"pattern\":{},\"keyword\":",
+                       hit.line_number, hit.pattern);
+        json_writing::AppendJsonString(buffer, hit.keyword);
+        std::format_to(std::back_inserter(buffer),
+                       ",\"custom\":{},\"column\":{},\"length\":{},\"line\":",
+                       hit.custom, hit.column, hit.length);
+        json_writing::AppendJsonString(buffer, hit.line);
+        buffer.append("}\n");
+    }
+}
+
+void AppendJsonChanges(std::string& buffer, const std::string_view revision,
+                       const profile::ChangeSummary& changes) {
+    buffer.append("{\"type\":\"changes\",\"revision\":");
+    json_writing::AppendJsonString(buffer, revision);
+    buffer.append(",\"base\":");
+    json_writing::AppendJsonString(buffer, changes.base);
+    std::format_to(std::back_inserter(buffer),
+                   ",\"deleted_files\":{},\"changes\":[",
+                   changes.deleted_files);
+    for (std::size_t index{0}; index < changes.changes.size(); ++index) {
+        const profile::PatternChange& change{changes.changes[index]};
+        buffer.append(index == 0 ? "{\"pattern\":" : ",{\"pattern\":");
+        json_writing::AppendJsonString(buffer, change.pattern);
+        std::format_to(std::back_inserter(buffer),
+                       ",\"added\":{},\"removed\":{},\"custom\":{}}}",
+                       change.added, change.removed, change.custom);
+    }
+    buffer.append("]}\n");
+}
+
+void AppendJsonSummary(std::string& buffer,
+                       const profile::ScanSummary& summary) {
+    buffer.append("{\"type\":\"summary\",\"summary\":");
+    std::string json{profile::SummaryJson(summary)};
+    json.pop_back();
+    buffer.append(json);
+    buffer.append("}\n");
+}
+
+void AppendBinaryHeader(std::string& buffer) {
+    const BinaryHeader header{
+        .magic = {'P', 'R', 'F', 'H', 'I', 'T', 'S', '\0'},
+        .version = binary_format_version,
+        .reserved = 0,
+    };
+    buffer.append(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void AppendBinaryHits(std::string& buffer, const profile::FileHits& file) {
+    const std::string_view path{file.path.c_str()};
+    AppendRecord(buffer,
+                 BinaryFile{
+                     .kind = RecordKind::File,
+                     .size = 0,
+                     .hit_count = static_cast<std::uint32_t>(file.hits.size()),
+                     .path_length = static_cast<std::uint32_t>(path.size()),
+                 },
+                 path);
+
+    for (const profile::HitRecord& hit : file.hits) {
+        AppendRecord(buffer,
+                     BinaryHit{
+                         .kind = RecordKind::Hit,
+                         .size = 0,
+                         .line_number = hit.line_number,
+                         .pattern = static_cast<std::uint32_t>(hit.pattern),
+                         .column = static_cast<std::uint32_t>(hit.column),
+                         .length = static_cast<std::uint32_t>(hit.length),
+                         .line_length =
+                             static_cast<std::uint32_t>(hit.line.size()),
+                     },
+                     hit.line);
+    }
+}
+
+void AppendBinarySummary(std::string& buffer,
+                         const profile::ScanSummary& summary,
+                         const std::uint64_t summary_offset) {
+    for (std::size_t pattern{0}; pattern < summary.patterns.size();
+         ++pattern) {
+        const profile::PatternTotal& total{summary.patterns[pattern]};
+        AppendRecord(
+            buffer,
+            BinaryPattern{
+                .kind = RecordKind::Pattern,
+                .size = 0,
+                .count = total.count,
+                .pattern = static_cast<std::uint32_t>(pattern),
+                .custom = total.custom,
+                .name_length = static_cast<std::uint32_t>(total.pattern.size()),
+                .reserved = 0,
+            },
+            total.pattern);
+    }
+
+    for (const auto& [extension, frequency] : summary.extension_counts) {
+        AppendRecord(buffer,
+                     BinaryExtension{
+                         .kind = RecordKind::Extension,
+                         .size = 0,
+                         .files = frequency,
+                         .name_length =
+                             static_cast<std::uint32_t>(extension.size()),
+                         .reserved = 0,
+                     },
+                     extension);
+    }
+
+    for (const std::string& error : summary.errors) {
+        AppendRecord(
+            buffer,
+            BinaryError{
+                .kind = RecordKind::Error,
+                .size = 0,
+                .text_length = static_cast<std::uint32_t>(error.size()),
+                .reserved = 0,
+            },
+            error);
+    }
+
+    const BinaryTrailer trailer{
+        .magic = {'P', 'R', 'F', 'T', 'R', 'A', 'I', 'L'},
+        .summary_offset = summary_offset,
+        .file_count = summary.file_count,
+        .thread_count = summary.thread_count,
+    };
+    buffer.append(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+}
+
+}  // namespace result_formatting
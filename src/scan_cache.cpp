@@ -0,0 +1,302 @@
+/*
+ *  scan_cache.cpp - Loading, lookup and saving of the incremental scan cache
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/scan_cache.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "include/binary_io.hpp"
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
+namespace scan_cache {
+namespace {
+using binary_io::Append;
+using binary_io::Cursor;
+constexpr std::string_view magic{"PRFCACHE"};
+constexpr std::size_t header_size{magic.size() + 4 + 4 + 8 + 8};
+constexpr std::size_t entry_header_size{4 + 4 + 8 + 8 + 8 + 4 + 4};
+}  // namespace
+
+#if !defined(_WIN32)
+std::optional<FileStamp> StampFile(const std::filesystem::path& file) {
+    return StampFile(file.native());
+}
+
+std::optional<FileStamp> StampFile(const std::string& file) {
+    struct stat file_info{};
+    if (stat(file.c_str(), &file_info) != 0) {
+        return std::nullopt;
+    }
+
+#if defined(__APPLE__)
+    const timespec& modified{file_info.st_mtimespec};
+#else
+    const timespec& modified{file_info.st_mtim};
+#endif
+    return FileStamp{
+        .size = static_cast<std::uint64_t>(file_info.st_size),
+        .modified =
+            static_cast<std::int64_t>(modified.tv_sec) * 1'000'000'000 +
+            static_cast<std::int64_t>(modified.tv_nsec),
+        .inode = static_cast<std::uint64_t>(file_info.st_ino),
+    };
+}
+#else
+std::optional<FileStamp> StampFile(const std::filesystem::path& file) {
+    std::error_code error{};
+    const std::uintmax_t size{std::filesystem::file_size(file, error)};
+    if (error) {
+        return std::nullopt;
+    }
+    const std::filesystem::file_time_type modified{
+        std::filesystem::last_write_time(file, error)};
+    if (error) {
+        return std::nullopt;
+    }
+
+    return FileStamp{
+        .size = static_cast<std::uint64_t>(size),
+        .modified = static_cast<std::int64_t>(
+            modified.time_since_epoch().count()),
+        .inode = 0,
+    };
+}
+
+std::optional<FileStamp> StampFile(const std::string& file) {
+    return StampFile(std::filesystem::path{file});
+}
+#endif
+
+std::uint64_t HashPatterns(const std::span<const std::string_view> patterns) {
+    std::uint64_t hash{14695981039346656037ull};
+    for (const std::string_view pattern : patterns) {
+        for (const char character : pattern) {
+            hash ^= static_cast<unsigned char>(character);
+            hash *= 1099511628211ull;
+        }
+        hash ^= 0xff;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+ScanCache::ScanCache(std::filesystem::path cache_file,
+                     const std::uint64_t pattern_hash)
+    : cache_file_{std::move(cache_file)},
+      pattern_hash_{pattern_hash},
+      reader_{},
+      cached_entries_{},
+      uses_{},
+      fresh_lock_{},
+      fresh_records_{},
+      fresh_count_{0} {
+    if (const std::optional<std::string_view> contents{
+            reader_.Load(cache_file_)};
+        contents.has_value()) {
+        this->Index(contents.value());
+    }
+}
+
+void ScanCache::Index(const std::string_view contents) {
+    Cursor cursor{contents};
+
+    if (cursor.ReadBytes(magic.size()) != magic ||
+        cursor.Read<std::uint32_t>() != format_version) {
+        return;
+    }
+    cursor.Read<std::uint32_t>();
+    if (cursor.Read<std::uint64_t>() != pattern_hash_) {
+        return;
+    }
+
+    const std::uint64_t entry_count{cursor.Read<std::uint64_t>()};
+    std::size_t indexed{0};
+    for (std::uint64_t entry{0}; entry < entry_count && cursor.Ok(); ++entry) {
+        const std::size_t record_start{cursor.Position()};
+        const std::uint32_t record_length{cursor.Read<std::uint32_t>()};
+        const std::uint32_t path_length{cursor.Read<std::uint32_t>()};
+        const FileStamp stamp{
+            .size = cursor.Read<std::uint64_t>(),
+            .modified = cursor.Read<std::int64_t>(),
+            .inode = cursor.Read<std::uint64_t>(),
+        };
+        cursor.Read<std::uint32_t>();
+        cursor.Read<std::uint32_t>();
+        const std::string_view path{cursor.ReadBytes(path_length)};
+        cursor.ReadBytes(record_length - (cursor.Position() - record_start));
+
+        if (!cursor.Ok() || record_length < entry_header_size + path_length) {
+            cached_entries_.clear();
+            return;
+        }
+
+        cached_entries_.insert_or_assign(
+            path, CachedEntry{
+                      .index = indexed++,
+                      .record = contents.substr(record_start, record_length),
+                      .stamp = stamp,
+                  });
+    }
+
+    uses_.assign(indexed, EntryUse::Untouched);
+}
+
+bool ScanCache::Lookup(const std::string_view path, const FileStamp& stamp,
+                       const std::size_t pattern_count,
+                       parser_info::FileResult& result) {
+    const auto found{cached_entries_.find(path)};
+    if (found == cached_entries_.end() || found->second.stamp != stamp) {
+        return false;
+    }
+
+    Cursor cursor{found->second.record};
+    cursor.ReadBytes(entry_header_size - 8);
+    const std::uint32_t stored_patterns{cursor.Read<std::uint32_t>()};
+    const std::uint32_t hit_count{cursor.Read<std::uint32_t>()};
+    cursor.ReadBytes(path.size());
+
+    if (stored_patterns != pattern_count) {
+        return false;
+    }
+
+    result.Reset(pattern_count);
+    for (std::size_t& count : result.pattern_counts) {
+        count = static_cast<std::size_t>(cursor.Read<std::uint64_t>());
+    }
+    for (std::uint32_t hit{0}; hit < hit_count; ++hit) {
+        const std::uint64_t line_number{cursor.Read<std::uint64_t>()};
+        const std::uint32_t pattern{cursor.Read<std::uint32_t>()};
+        const std::uint32_t column{cursor.Read<std::uint32_t>()};
+        const std::uint32_t length{cursor.Read<std::uint32_t>()};
+        const std::string_view line{
+            cursor.ReadBytes(cursor.Read<std::uint32_t>())};
+        result.hits.emplace_back(static_cast<std::size_t>(line_number),
+                                 std::size_t{pattern}, line,
+                                 std::size_t{column}, std::size_t{length});
+    }
+
+    if (!cursor.Ok()) {
+        result.Reset(pattern_count);
+        return false;
+    }
+
+    uses_[found->second.index] = EntryUse::Reused;
+    return true;
+}
+
+void ScanCache::Store(const std::string_view path, const FileStamp& stamp,
+                      const parser_info::FileResult& result) {
+    std::string record{};
+    Append(record, std::uint32_t{0});
+    Append(record, static_cast<std::uint32_t>(path.size()));
+    Append(record, stamp.size);
+    Append(record, stamp.modified);
+    Append(record, stamp.inode);
+    Append(record, static_cast<std::uint32_t>(result.pattern_counts.size()));
+    Append(record, static_cast<std::uint32_t>(result.hits.size()));
+    record.append(path);
+    for (const std::size_t count : result.pattern_counts) {
+        Append(record, static_cast<std::uint64_t>(count));
+    }
+    for (const auto& [line_number, pattern, line, column, length] :
+         result.hits) {
+        Append(record, static_cast<std::uint64_t>(line_number));
+        Append(record, static_cast<std::uint32_t>(pattern));
+        Append(record, static_cast<std::uint32_t>(column));
+        Append(record, static_cast<std::uint32_t>(length));
+        Append(record, static_cast<std::uint32_t>(line.size()));
+        record.append(line);
+    }
+
+    const std::uint32_t record_length{static_cast<std::uint32_t>(record.size())};
+    std::memcpy(record.data(), &record_length, sizeof(record_length));
+
+    if (const auto found{cached_entries_.find(path)};
+        found != cached_entries_.end()) {
+        uses_[found->second.index] = EntryUse::Replaced;
+    }
+
+    std::scoped_lock<std::mutex> lock{fresh_lock_};
+    fresh_records_.append(record);
+    fresh_count_++;
+}
+
+/*
+ * Entries this run never looked at are kept as long as their file still
+ * has the stamp they were stored under, so a run that only visits part of
+ * the tree (one that stops early, one shard, a list of files) does not
+ * forget the rest of it.
+ */
+bool ScanCache::Save() const {
+    std::vector<std::string_view> kept{};
+    for (const auto& [path, entry] : cached_entries_) {
+        if (uses_[entry.index] == EntryUse::Reused ||
+            (uses_[entry.index] == EntryUse::Untouched &&
+             StampFile(std::string{path}) == entry.stamp)) {
+            kept.push_back(entry.record);
+        }
+    }
+
+    std::string header{magic};
+    Append(header, format_version);
+    Append(header, std::uint32_t{0});
+    Append(header, pattern_hash_);
+    Append(header, static_cast<std::uint64_t>(kept.size() + fresh_count_));
+
+    std::filesystem::path temporary_file{cache_file_};
+    temporary_file += ".tmp";
+
+    {
+        std::ofstream output{temporary_file,
+                             std::ios::binary | std::ios::trunc};
+        output.write(header.data(), static_cast<std::streamsize>(header_size));
+        for (const std::string_view record : kept) {
+            output.write(record.data(),
+                         static_cast<std::streamsize>(record.size()));
+        }
+        output.write(fresh_records_.data(),
+                     static_cast<std::streamsize>(fresh_records_.size()));
+
+        if (!output.good()) {
+            return false;
+        }
+    }
+
+    std::error_code error{};
+    std::filesystem::rename(temporary_file, cache_file_, error);
+    return !error;
+}
+
+}  // namespace scan_cache
@@ -0,0 +1,231 @@
+/*
+ *  scan_statistics.cpp - Merging and reporting of scan statistics
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/scan_statistics.hpp"
+
+#include "include/json_writer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <format>
+#include <iomanip>
+#include <ios>
+#include <iterator>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace scan_statistics {
+namespace {
+constexpr std::array<std::string_view, phase_count> phase_names{
+    "Directory Enumeration",
+    "File Open/Read",
+    "Comment Location",
+    "Pattern Matching",
+};
+
+constexpr std::array<std::string_view, phase_count> phase_keys{
+    "directory_enumeration",
+    "file_read",
+    "comment_location",
+    "pattern_matching",
+};
+
+constexpr bool SlowerFirst(const FileTiming& left, const FileTiming& right) {
+    return left.elapsed > right.elapsed;
+}
+
+double Milliseconds(const std::chrono::nanoseconds elapsed) {
+    return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+double Seconds(const std::chrono::nanoseconds elapsed) {
+    return std::chrono::duration<double>(elapsed).count();
+}
+
+const std::string separator(80, '-');
+}  // namespace
+
+void WorkerCounters::RecordFile(const Clock::duration elapsed,
+                                const std::string_view path) {
+    const std::chrono::nanoseconds nanoseconds{
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)};
+
+    // min-heap on elapsed time, so the fastest kept file is at the front
+    if (slowest_files_.size() < slowest_file_count) {
+        slowest_files_.emplace_back(nanoseconds, std::string{path});
+        std::ranges::push_heap(slowest_files_, SlowerFirst);
+    } else if (nanoseconds > slowest_files_.front().elapsed) {
+        std::ranges::pop_heap(slowest_files_, SlowerFirst);
+        slowest_files_.back() = FileTiming{nanoseconds, std::string{path}};
+        std::ranges::push_heap(slowest_files_, SlowerFirst);
+    }
+}
+
+void ScanStatistics::Start() {
+    start_ = Clock::now();
+    next_queue_sample_.next.store(start_.time_since_epoch().count(),
+                             std::memory_order_relaxed);
+}
+
+bool ScanStatistics::ClaimQueueSample(const Clock::time_point now) {
+    Clock::rep next{
+        next_queue_sample_.next.load(std::memory_order_relaxed)};
+    const Clock::rep current{now.time_since_epoch().count()};
+    if (current < next) [[likely]] {
+        return false;
+    }
+
+    const Clock::rep following{
+        current + std::chrono::duration_cast<Clock::duration>(
+                      queue_sample_interval)
+                      .count()};
+    return next_queue_sample_.next.compare_exchange_strong(
+        next, following, std::memory_order_relaxed);
+}
+
+void ScanStatistics::Merge(
+    const std::span<const WorkerCounters* const> workers) {
+    wall_time_ = this->SinceStart(Clock::now());
+
+    for (const WorkerCounters* const counters : workers) {
+        for (std::size_t phase{0}; phase < phase_count; ++phase) {
+            phases_[phase] +=
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    counters->phases_[phase]);
+        }
+        bytes_ += counters->bytes_;
+        lines_ += counters->lines_;
+        comment_bytes_ += counters->comment_bytes_;
+        workers_.emplace_back(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                counters->busy_),
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                counters->idle_));
+        queue_samples_.insert(queue_samples_.end(),
+                              counters->queue_samples_.cbegin(),
+                              counters->queue_samples_.cend());
+        slowest_files_.insert(slowest_files_.end(),
+                              counters->slowest_files_.cbegin(),
+                              counters->slowest_files_.cend());
+    }
+
+    std::ranges::sort(queue_samples_, {}, &QueueSample::since_start);
+    std::ranges::sort(slowest_files_, SlowerFirst);
+    if (slowest_files_.size() > WorkerCounters::slowest_file_count) {
+        slowest_files_.resize(WorkerCounters::slowest_file_count);
+    }
+}
+
+void ScanStatistics::PrintReport(std::ostream& stream) const {
+    const double wall_seconds{Seconds(wall_time_)};
+    const double megabytes{static_cast<double>(bytes_) / 1e6};
+
+    stream << std::endl
+           << "---------------------------------- Statistics -----------------"
+              "-----------------"
+           << std::endl;
+    stream << std::fixed << std::setprecision(3);
+    stream << std::left << std::setw(28) << "Wall Time (s)" << "| "
+           << wall_seconds << std::endl;
+    for (std::size_t phase{0}; phase < phase_count; ++phase) {
+        stream << std::left << std::setw(28)
+               << std::string{phase_names[phase]} + " (ms)" << "| "
+               << Milliseconds(phases_[phase]) << std::endl;
+    }
+    stream << std::left << std::setw(28) << "Bytes Processed" << "| "
+           << bytes_ << std::endl;
+    stream << std::left << std::setw(28) << "Lines Processed" << "| "
+           << lines_ << std::endl;
+    stream << std::left << std::setw(28) << "Comment Bytes Matched" << "| "
+           << comment_bytes_ << std::endl;
+    stream << std::left << std::setw(28) << "Throughput (MB/s)" << "| "
+           << (wall_seconds > 0 ? megabytes / wall_seconds : 0.0)
+           << std::endl;
+
+    stream << separator << std::endl
+           << std::left << std::setw(10) << "Thread" << "| " << std::setw(16)
+           << "Busy (ms)" << "| " << "Idle (ms)" << std::endl
+           << separator << std::endl;
+    for (std::size_t worker{0}; worker < workers_.size(); ++worker) {
+        stream << std::left << std::setw(10) << worker << "| "
+               << std::setw(16) << Milliseconds(workers_[worker].busy) << "| "
+               << Milliseconds(workers_[worker].idle) << std::endl;
+    }
+
+    const auto peak{std::ranges::max_element(queue_samples_, {},
+                                             &QueueSample::depth)};
+    stream << separator << std::endl
+           << std::left << std::setw(28) << "Peak Queue Depth" << "| "
+           << (peak == queue_samples_.end() ? 0 : peak->depth) << " ("
+           << queue_samples_.size() << " samples)" << std::endl;
+
+    stream << separator << std::endl << "Slowest Files (ms):" << std::endl;
+    for (const auto& [elapsed, path] : slowest_files_) {
+        stream << std::right << std::setw(12) << Milliseconds(elapsed) << "  "
+               << path << std::endl;
+    }
+    stream << std::defaultfloat << std::setprecision(6);
+}
+
+void ScanStatistics::WriteJson(std::ostream& stream) const {
+    std::string json{};
+    std::format_to(std::back_inserter(json),
+                   "{{\"wall_seconds\":{:.6f},\"phases_ms\":{{",
+                   Seconds(wall_time_));
+    for (std::size_t phase{0}; phase < phase_count; ++phase) {
+        std::format_to(std::back_inserter(json), "{}\"{}\":{:.3f}",
+                       phase == 0 ? "" : ",", phase_keys[phase],
+                       Milliseconds(phases_[phase]));
+    }
+    std::format_to(std::back_inserter(json),
+                   "}},\"bytes\":{},\"lines\":{},\"comment_bytes\":{},"
+                   "\"threads\":[",
+                   bytes_, lines_, comment_bytes_);
+    for (std::size_t worker{0}; worker < workers_.size(); ++worker) {
+        std::format_to(std::back_inserter(json),
+                       "{}{{\"busy_ms\":{:.3f},\"idle_ms\":{:.3f}}}",
+                       worker == 0 ? "" : ",",
+                       Milliseconds(workers_[worker].busy),
+                       Milliseconds(workers_[worker].idle));
+    }
+    json.append("],\"queue_depth\":[");
+    for (std::size_t sample{0}; sample < queue_samples_.size(); ++sample) {
+        std::format_to(std::back_inserter(json), "{}[{:.3f},{}]",
+                       sample == 0 ? "" : ",",
+                       Milliseconds(queue_samples_[sample].since_start),
+                       queue_samples_[sample].depth);
+    }
+    json.append("],\"slowest_files\":[");
+    for (std::size_t file{0}; file < slowest_files_.size(); ++file) {
+        json.append(file == 0 ? "{\"path\":" : ",{\"path\":");
+        json_writing::AppendJsonString(json, slowest_files_[file].path);
+        std::format_to(std::back_inserter(json), ",\"ms\":{:.3f}}}",
+                       Milliseconds(slowest_files_[file].elapsed));
+    }
+    json.append("]}\n");
+
+    stream << json;
+}
+
+}  // namespace scan_statistics
@@ -0,0 +1,370 @@
+/*
+ *  tar_reader.cpp - Streaming reader for tar archives
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/tar_reader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace tar_reading {
+namespace {
+constexpr std::size_t name_offset{0};
+constexpr std::size_t name_length{100};
+constexpr std::size_t size_offset{124};
+constexpr std::size_t size_length{12};
+constexpr std::size_t checksum_offset{148};
+constexpr std::size_t checksum_length{8};
+constexpr std::size_t type_offset{156};
+constexpr std::size_t magic_offset{257};
+constexpr std::string_view posix_magic{"ustar\0", 6};
+constexpr std::size_t prefix_offset{345};
+constexpr std::size_t prefix_length{155};
+
+/*
+ * Long names and pax headers past this are treated as a corrupt archive
+ * rather than read into memory.
+ */
+constexpr std::uint64_t extension_limit{1024 * 1024};
+
+std::string_view Field(const std::string_view header, const std::size_t offset,
+                       const std::size_t length) {
+    const std::string_view field{header.substr(offset, length)};
+    return field.substr(0, field.find('\0'));
+}
+
+/*
+ * Octal, padded with spaces or NULs, or base-256 when the high bit of the
+ * first byte is set, which GNU tar uses for sizes of 8 GiB and up.
+ */
+std::optional<std::uint64_t> ParseNumber(const std::string_view field) {
+    std::uint64_t value{0};
+    if (!field.empty() && (static_cast<unsigned char>(field.front()) & 0x80)) {
+        for (std::size_t index{0}; index < field.size(); ++index) {
+            const unsigned char byte{static_cast<unsigned char>(
+                index == 0 ? field[index] & 0x7f : field[index])};
+            if (value > (UINT64_MAX >> 8)) {
+                return std::nullopt;
+            }
+            value = (value << 8) | byte;
+        }
+        return value;
+    }
+
+    std::size_t index{0};
+    while (index < field.size() && field[index] == ' ') {
+        ++index;
+    }
+    for (; index < field.size() && field[index] != ' ' && field[index] != '\0';
+         ++index) {
+        if (field[index] < '0' || field[index] > '7' ||
+            value > (UINT64_MAX >> 3)) {
+            return std::nullopt;
+        }
+        value = (value << 3) | static_cast<std::uint64_t>(field[index] - '0');
+    }
+    return value;
+}
+
+/*
+ * The checksum is the sum of the header with its own field read as spaces.
+ * Some old writers summed signed chars, so either sum is accepted.
+ */
+bool ChecksumMatches(const std::string_view header) {
+    const std::optional<std::uint64_t> stored{
+        ParseNumber(header.substr(checksum_offset, checksum_length))};
+    if (!stored.has_value()) {
+        return false;
+    }
+
+    std::uint64_t unsigned_sum{0};
+    std::int64_t signed_sum{0};
+    for (std::size_t index{0}; index < header.size(); ++index) {
+        const bool in_checksum{index >= checksum_offset &&
+                               index < checksum_offset + checksum_length};
+        const char byte{in_checksum ? ' ' : header[index]};
+        unsigned_sum += static_cast<unsigned char>(byte);
+        signed_sum += static_cast<signed char>(byte);
+    }
+    return stored == unsigned_sum ||
+           static_cast<std::int64_t>(stored.value()) == signed_sum;
+}
+
+std::uint64_t Padding(const std::uint64_t size, const std::size_t block) {
+    return (block - size % block) % block;
+}
+
+/*
+ * Pax records are "<length> <key>=<value>\n", length counting the whole
+ * record. Only the keys that change where a member's data is or what it is
+ * called matter here. Returns false for a record whose length does not fit
+ * it, or that has no space after the length.
+ */
+bool ApplyPaxRecords(const std::string_view records,
+                     std::optional<std::string>& path,
+                     std::optional<std::uint64_t>& size) {
+    std::size_t position{0};
+    while (position < records.size()) {
+        std::size_t length{0};
+        const char* const begin{records.data() + position};
+        const auto [end, error] =
+            std::from_chars(begin, records.data() + records.size(), length);
+        if (error != std::errc{} || length == 0 ||
+            length > records.size() - position) {
+            return false;
+        }
+
+        const std::size_t key_start{
+            static_cast<std::size_t>(end - records.data()) + 1};
+        if (key_start > position + length || *end != ' ') {
+            return false;
+        }
+        const std::string_view record{
+            records.substr(key_start, position + length - key_start)};
+        position += length;
+
+        const std::size_t equals{record.find('=')};
+        if (equals == std::string_view::npos || !record.ends_with('\n')) {
+            continue;
+        }
+        const std::string_view key{record.substr(0, equals)};
+        const std::string_view value{
+            record.substr(equals + 1, record.size() - equals - 2)};
+
+        if (key == "path") {
+            path.emplace(value);
+        } else if (std::uint64_t parsed{0};
+                   key == "size" &&
+                   std::from_chars(value.data(), value.data() + value.size(),
+                                   parsed)
+                           .ec == std::errc{}) {
+            size = parsed;
+        }
+    }
+    return true;
+}
+
+/*
+ * Drops the "./" and "/" prefixes archivers like to add, so reported paths
+ * read the same however the archive was made.
+ */
+std::string NormalizePath(std::string path) {
+    std::size_t start{0};
+    while (true) {
+        if (path.compare(start, 2, "./") == 0) {
+            start += 2;
+        } else if (path.compare(start, 1, "/") == 0) {
+            start += 1;
+        } else {
+            break;
+        }
+    }
+    path.erase(0, start);
+    return path;
+}
+}  // namespace
+
+TarReader::TarReader(const std::filesystem::path& archive) {
+    if (archive == "-") {
+#if defined(_WIN32)
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        stream_ = stdin;
+        return;
+    }
+
+#if defined(_WIN32)
+    stream_ = _wfopen(archive.c_str(), L"rb");
+#else
+    stream_ = std::fopen(archive.c_str(), "rb");
+#endif
+    owns_stream_ = stream_ != nullptr;
+}
+
+TarReader::~TarReader() {
+    if (owns_stream_) {
+        std::fclose(stream_);
+    }
+}
+
+bool TarReader::IsOpen() const { return stream_ != nullptr; }
+
+const std::optional<std::string>& TarReader::Error() const { return error_; }
+
+bool TarReader::Fail(std::string error) {
+    error_.emplace(std::move(error));
+    return false;
+}
+
+bool TarReader::ReadBytes(char* const destination, const std::size_t size) {
+    if (std::fread(destination, 1, size, stream_) != size) {
+        return this->Fail("Tar archive is truncated");
+    }
+    return true;
+}
+
+bool TarReader::ReadBlock(Block& block) {
+    return this->ReadBytes(block.data(), block.size());
+}
+
+/*
+ * Seeking is tried first since members that are not source files can be
+ * large; pipes cannot seek, so they fall back to reading.
+ */
+bool TarReader::Skip(std::uint64_t size) {
+    if (size == 0) {
+        return true;
+    } else if (size <= static_cast<std::uint64_t>(LONG_MAX) &&
+               std::fseek(stream_, static_cast<long>(size), SEEK_CUR) == 0) {
+        return true;
+    }
+
+    std::array<char, 64 * 1024> discard{};
+    while (size != 0) {
+        const std::size_t chunk{static_cast<std::size_t>(
+            std::min<std::uint64_t>(size, discard.size()))};
+        if (!this->ReadBytes(discard.data(), chunk)) {
+            return false;
+        }
+        size -= chunk;
+    }
+    return true;
+}
+
+bool TarReader::ReadExtension(const std::uint64_t size, std::string& text) {
+    if (size > extension_limit) {
+        return this->Fail("Tar archive has an oversized extended header");
+    }
+    text.resize(static_cast<std::size_t>(size));
+    return this->ReadBytes(text.data(), text.size()) &&
+           this->Skip(Padding(size, block_size));
+}
+
+std::optional<Member> TarReader::Next() {
+    if (stream_ == nullptr || finished_ || error_.has_value() ||
+        !this->Skip(remaining_ + padding_)) {
+        return std::nullopt;
+    }
+    remaining_ = 0;
+    padding_ = 0;
+
+    std::optional<std::string> long_path{std::nullopt};
+    std::optional<std::uint64_t> pax_size{std::nullopt};
+    std::string extension{};
+    Block block{};
+
+    while (true) {
+        if (std::fread(block.data(), 1, block.size(), stream_) !=
+            block.size()) {
+            this->Fail("Tar archive ends without an end of archive marker");
+            return std::nullopt;
+        }
+
+        const std::string_view header{block.data(), block.size()};
+        if (std::ranges::all_of(header, [](char c) { return c == '\0'; })) {
+            finished_ = true;
+            return std::nullopt;
+        } else if (!ChecksumMatches(header)) {
+            this->Fail("Tar archive has a corrupt header");
+            return std::nullopt;
+        }
+
+        const std::optional<std::uint64_t> header_size{
+            ParseNumber(header.substr(size_offset, size_length))};
+        if (!header_size.has_value()) {
+            this->Fail("Tar archive has a corrupt member size");
+            return std::nullopt;
+        }
+        // long names and pax records describe the entry after them
+        const char type{header[type_offset]};
+        if (type == 'L' || type == 'x') {
+            if (!this->ReadExtension(header_size.value(), extension)) {
+                return std::nullopt;
+            } else if (type == 'L') {
+                long_path.emplace(extension.substr(0, extension.find('\0')));
+            } else if (!ApplyPaxRecords(extension, long_path, pax_size)) {
+                this->Fail("Tar archive has a corrupt header");
+                return std::nullopt;
+            }
+            continue;
+        }
+
+        const std::uint64_t size{pax_size.value_or(header_size.value())};
+        std::optional<std::string> extended_path{
+            std::exchange(long_path, std::nullopt)};
+        pax_size.reset();
+
+        std::string path{};
+        if (extended_path.has_value()) {
+            path = std::move(extended_path.value());
+        } else {
+            // only POSIX ustar has the prefix field; old GNU headers keep
+            // timestamps there
+            if (const std::string_view prefix{
+                    Field(header, prefix_offset, prefix_length)};
+                header.substr(magic_offset, posix_magic.size()) ==
+                    posix_magic &&
+                !prefix.empty()) {
+                path.append(prefix).push_back('/');
+            }
+            path.append(Field(header, name_offset, name_length));
+        }
+        path = NormalizePath(std::move(path));
+
+        // pre-POSIX archives mark directories with a trailing slash only
+        if ((type != '0' && type != '7' && type != '\0') || path.empty() ||
+            path.ends_with('/')) {
+            if (!this->Skip(size + Padding(size, block_size))) {
+                return std::nullopt;
+            }
+            continue;
+        }
+
+        remaining_ = size;
+        padding_ = Padding(size, block_size);
+        return Member{.path = std::move(path), .size = remaining_};
+    }
+}
+
+bool TarReader::ReadContents(std::string& contents) {
+    if (error_.has_value()) {
+        return false;
+    }
+    contents.resize(static_cast<std::size_t>(remaining_));
+    if (!this->ReadBytes(contents.data(), contents.size())) {
+        return false;
+    }
+    remaining_ = 0;
+    return true;
+}
+
+}  // namespace tar_reading
@@ -0,0 +1,345 @@
+/*
+ *  uring_reader.cpp - Batched file reads through io_uring
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/uring_reader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#endif
+
+namespace uring_reading {
+
+#if defined(__linux__)
+namespace {
+/*
+ * Three submissions per file, rounded up to a power of two.
+ */
+constexpr unsigned ring_entries{BatchReader::batch_size * 4};
+
+enum Step : std::uint64_t {
+    Open = 0,
+    Read = 1,
+    Close = 2,
+};
+
+std::uint64_t UserData(const std::size_t file, const Step step) {
+    return (static_cast<std::uint64_t>(file) << 2) | step;
+}
+
+int Setup(const unsigned entries, io_uring_params& params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int Enter(const int ring, const unsigned submit, const unsigned wait) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, ring, submit, wait,
+                                    IORING_ENTER_GETEVENTS, nullptr, 0));
+}
+
+int Register(const int ring, const unsigned opcode, const void* argument,
+             const unsigned count) {
+    return static_cast<int>(
+        syscall(__NR_io_uring_register, ring, opcode, argument, count));
+}
+}  // namespace
+
+/*
+ * The raw ring: the shared submission and completion queues mapped from the
+ * kernel, the registered file table and the buffers.
+ */
+struct BatchReader::Ring {
+    int fd{-1};
+    void* queues{MAP_FAILED};
+    std::size_t queues_size{0};
+    io_uring_sqe* entries{static_cast<io_uring_sqe*>(MAP_FAILED)};
+    std::size_t entries_size{0};
+
+    unsigned* sq_tail{nullptr};
+    unsigned sq_mask{0};
+    unsigned* sq_array{nullptr};
+    unsigned* cq_head{nullptr};
+    unsigned* cq_tail{nullptr};
+    unsigned cq_mask{0};
+    io_uring_cqe* completions{nullptr};
+
+    std::unique_ptr<char[]> buffers{};
+    bool fixed_buffers{false};
+    bool available{false};
+
+    Ring();
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+    ~Ring();
+
+    bool Open();
+
+    bool SupportsOperations();
+
+    void Push(const io_uring_sqe& entry);
+};
+
+BatchReader::Ring::Ring() { available = this->Open(); }
+
+BatchReader::Ring::~Ring() {
+    if (entries != MAP_FAILED) {
+        munmap(entries, entries_size);
+    }
+    if (queues != MAP_FAILED) {
+        munmap(queues, queues_size);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool BatchReader::Ring::Open() {
+    io_uring_params params{};
+#if defined(IORING_SETUP_DEFER_TASKRUN)
+    // only this thread submits, and completions are reaped right after
+    // waiting for them, so the kernel can skip its cross-thread signalling
+    params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+#endif
+    fd = Setup(ring_entries, params);
+    if (fd < 0) {
+        params = io_uring_params{};
+        fd = Setup(ring_entries, params);
+    }
+    if (fd < 0 || !(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        return false;
+    }
+
+    queues_size = std::max<std::size_t>(
+        params.sq_off.array + params.sq_entries * sizeof(unsigned),
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    queues = mmap(nullptr, queues_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    entries_size = params.sq_entries * sizeof(io_uring_sqe);
+    entries = static_cast<io_uring_sqe*>(
+        mmap(nullptr, entries_size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (queues == MAP_FAILED || entries == MAP_FAILED) {
+        return false;
+    }
+
+    char* const base{static_cast<char*>(queues)};
+    sq_tail = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+    sq_mask = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+    cq_head = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+    completions = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+
+    // an empty table: every file of a batch is opened straight into a slot
+    std::array<int, batch_size> files{};
+    files.fill(-1);
+    if (Register(fd, IORING_REGISTER_FILES, files.data(), batch_size) < 0 ||
+        !this->SupportsOperations()) {
+        return false;
+    }
+
+    // registered buffers are pinned and count against RLIMIT_MEMLOCK; plain
+    // reads into the same buffers still work when that runs out
+    buffers = std::make_unique_for_overwrite<char[]>(batch_size * buffer_size);
+    std::array<iovec, batch_size> vectors{};
+    for (std::size_t slot{0}; slot < batch_size; ++slot) {
+        vectors[slot] = iovec{
+            .iov_base = buffers.get() + slot * buffer_size,
+            .iov_len = buffer_size,
+        };
+    }
+    fixed_buffers =
+        Register(fd, IORING_REGISTER_BUFFERS, vectors.data(), batch_size) == 0;
+    return true;
+}
+
+bool BatchReader::Ring::SupportsOperations() {
+    constexpr unsigned probed_operations{256};
+    std::vector<std::byte> storage(
+        sizeof(io_uring_probe) + probed_operations * sizeof(io_uring_probe_op));
+    io_uring_probe* const probe{reinterpret_cast<io_uring_probe*>(
+        storage.data())};
+    if (Register(fd, IORING_REGISTER_PROBE, probe, probed_operations) < 0) {
+        return false;
+    }
+
+    return std::ranges::all_of(
+        std::array{IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_READ_FIXED,
+                   IORING_OP_CLOSE},
+        [probe](const unsigned operation) {
+            return operation <= probe->last_op &&
+                   (probe->ops[operation].flags & IO_URING_OP_SUPPORTED);
+        });
+}
+
+void BatchReader::Ring::Push(const io_uring_sqe& entry) {
+    const unsigned tail{*sq_tail};
+    const unsigned index{tail & sq_mask};
+    entries[index] = entry;
+    sq_array[index] = index;
+    std::atomic_ref<unsigned>{*sq_tail}.store(tail + 1,
+                                              std::memory_order_release);
+}
+
+BatchReader::BatchReader()
+    : ring_{std::make_unique<Ring>()}, results_{} {
+    results_.reserve(batch_size);
+}
+
+BatchReader::~BatchReader() = default;
+
+bool BatchReader::IsAvailable() const { return ring_->available; }
+
+/*
+ * The read is hard linked to the open so the close after it still runs when
+ * the read fails; a failed open cancels nothing worth keeping. A read that
+ * fills its buffer completely may have stopped short of the end of the file,
+ * so it is handed back to the caller to read again.
+ */
+std::span<const std::optional<std::string_view>> BatchReader::Read(
+    const std::span<const char* const> files) {
+    results_.assign(files.size(), std::nullopt);
+    if (!ring_->available || files.empty()) {
+        return results_;
+    }
+
+    for (std::size_t file{0}; file < files.size(); ++file) {
+        char* const buffer{ring_->buffers.get() + file * buffer_size};
+
+        io_uring_sqe open{};
+        open.opcode = IORING_OP_OPENAT;
+        open.flags = IOSQE_IO_LINK;
+        open.fd = AT_FDCWD;
+        open.addr = reinterpret_cast<std::uint64_t>(files[file]);
+        // direct descriptors never reach the file descriptor table, and the
+        // kernel rejects O_CLOEXEC for them
+        open.open_flags = O_RDONLY;
+        open.file_index = static_cast<std::uint32_t>(file + 1);
+        open.user_data = UserData(file, Step::Open);
+        ring_->Push(open);
+
+        io_uring_sqe read{};
+        read.opcode = ring_->fixed_buffers ? IORING_OP_READ_FIXED
+                                           : IORING_OP_READ;
+        read.flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+        read.fd = static_cast<std::int32_t>(file);
+        read.addr = reinterpret_cast<std::uint64_t>(buffer);
+        read.len = static_cast<std::uint32_t>(buffer_size);
+        read.off = 0;
+        read.buf_index = static_cast<std::uint16_t>(file);
+        read.user_data = UserData(file, Step::Read);
+        ring_->Push(read);
+
+        io_uring_sqe close{};
+        close.opcode = IORING_OP_CLOSE;
+        close.file_index = static_cast<std::uint32_t>(file + 1);
+        close.user_data = UserData(file, Step::Close);
+        ring_->Push(close);
+    }
+
+    const unsigned expected{static_cast<unsigned>(files.size() * 3)};
+    std::array<std::int32_t, batch_size> opened{};
+    std::array<std::int32_t, batch_size> read{};
+    unsigned to_submit{expected};
+    unsigned completed{0};
+
+    while (completed < expected) {
+        const int submitted{Enter(ring_->fd, to_submit, expected - completed)};
+        if (submitted < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                continue;
+            }
+            // what was submitted may still be running, so the buffers cannot
+            // be handed out again
+            ring_->available = false;
+            return results_;
+        }
+        to_submit -= static_cast<unsigned>(submitted);
+
+        unsigned head{*ring_->cq_head};
+        const unsigned tail{std::atomic_ref<unsigned>{*ring_->cq_tail}.load(
+            std::memory_order_acquire)};
+        for (; head != tail; ++head, ++completed) {
+            const io_uring_cqe& completion{
+                ring_->completions[head & ring_->cq_mask]};
+            const std::size_t file{
+                static_cast<std::size_t>(completion.user_data >> 2)};
+            switch (completion.user_data & 3) {
+                case Step::Open:
+                    opened[file] = completion.res;
+                    break;
+                case Step::Read:
+                    read[file] = completion.res;
+                    break;
+                default:
+                    break;
+            }
+        }
+        std::atomic_ref<unsigned>{*ring_->cq_head}.store(
+            head, std::memory_order_release);
+    }
+
+    for (std::size_t file{0}; file < files.size(); ++file) {
+        if (opened[file] == -EINVAL) {
+            // kernels before 5.15 cannot open into the file table
+            ring_->available = false;
+        } else if (opened[file] >= 0 && read[file] >= 0 &&
+                   static_cast<std::size_t>(read[file]) < buffer_size) {
+            results_[file].emplace(ring_->buffers.get() + file * buffer_size,
+                                   static_cast<std::size_t>(read[file]));
+        }
+    }
+    if (!ring_->available) {
+        results_.assign(files.size(), std::nullopt);
+    }
+    return results_;
+}
+#else
+struct BatchReader::Ring {};
+
+BatchReader::BatchReader() : ring_{}, results_{} {}
+
+BatchReader::~BatchReader() = default;
+
+bool BatchReader::IsAvailable() const { return false; }
+
+std::span<const std::optional<std::string_view>> BatchReader::Read(
+    const std::span<const char* const> files) {
+    results_.assign(files.size(), std::nullopt);
+    return results_;
+}
+#endif
+
+}  // namespace uring_reading
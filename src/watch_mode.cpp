@@ -0,0 +1,386 @@
+/*
+ *  watch_mode.cpp - inotify driven incremental rescans and summary socket
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include "include/watch_mode.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "include/Parser.hpp"
+#include "include/ignore_rules.hpp"
+#include "include/profile.hpp"
+#include "include/watch_events.hpp"
+
+#if defined(__linux__)
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace watch_mode {
+#if defined(__linux__)
+namespace {
+constexpr std::uint32_t directory_events{
+    IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_FROM |
+    IN_MOVED_TO | IN_ONLYDIR};
+
+[[noreturn]] void ThrowLastError(const char* what) {
+    throw std::system_error{errno, std::generic_category(), what};
+}
+
+class FileDescriptor {
+ public:
+    explicit FileDescriptor(const int descriptor) : descriptor_{descriptor} {}
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+    ~FileDescriptor() {
+        if (descriptor_ >= 0) {
+            close(descriptor_);
+        }
+    }
+
+    int Get() const { return descriptor_; }
+
+ private:
+    const int descriptor_;
+};
+
+/*
+ * Blocks SIGINT and SIGTERM for the lifetime of the object so they can be
+ * read from a signalfd instead. Threads started in the meantime inherit the
+ * mask, which is why Watch has to run before any others exist.
+ */
+class BlockedSignals {
+ public:
+    BlockedSignals() {
+        sigemptyset(&signals_);
+        sigaddset(&signals_, SIGINT);
+        sigaddset(&signals_, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals_, &previous_);
+    }
+    BlockedSignals(const BlockedSignals&) = delete;
+    BlockedSignals& operator=(const BlockedSignals&) = delete;
+    ~BlockedSignals() { pthread_sigmask(SIG_SETMASK, &previous_, nullptr); }
+
+    const sigset_t& Signals() const { return signals_; }
+
+ private:
+    sigset_t signals_{};
+    sigset_t previous_{};
+};
+
+/*
+ * A listening Unix socket; the socket file is removed again on
+ * destruction.
+ */
+class SummarySocket {
+ public:
+    explicit SummarySocket(const std::filesystem::path& path)
+        : path_{path},
+          descriptor_{socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK |
+                                          SOCK_CLOEXEC,
+                             0)} {
+        if (descriptor_.Get() < 0) {
+            ThrowLastError("Could not create the summary socket");
+        }
+
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        const std::string native{path_.string()};
+        if (native.size() >= sizeof(address.sun_path)) {
+            throw std::system_error{
+                std::make_error_code(std::errc::filename_too_long),
+                "Summary socket path is too long"};
+        }
+        std::memcpy(address.sun_path, native.c_str(), native.size() + 1);
+
+        // a stale socket from a run that was killed would block the bind
+        if (std::error_code error{};
+            std::filesystem::is_socket(path_, error)) {
+            std::filesystem::remove(path_, error);
+        }
+        if (bind(descriptor_.Get(), reinterpret_cast<sockaddr*>(&address),
+                 sizeof(address)) != 0) {
+            ThrowLastError("Could not bind the summary socket");
+        }
+        bound_ = true;
+        if (listen(descriptor_.Get(), 16) != 0) {
+            ThrowLastError("Could not listen on the summary socket");
+        }
+    }
+    SummarySocket(const SummarySocket&) = delete;
+    SummarySocket& operator=(const SummarySocket&) = delete;
+    ~SummarySocket() {
+        if (bound_) {
+            std::error_code error{};
+            std::filesystem::remove(path_, error);
+        }
+    }
+
+    int Get() const { return descriptor_.Get(); }
+
+    /*
+     * Sends text to every client waiting to connect and hangs up on them.
+     */
+    void ServePending(const std::string_view text) const {
+        while (true) {
+            const FileDescriptor client{
+                accept4(descriptor_.Get(), nullptr, nullptr, SOCK_CLOEXEC)};
+            if (client.Get() < 0) {
+                return;
+            }
+
+            std::size_t sent{0};
+            while (sent < text.size()) {
+                const ssize_t written{send(client.Get(), text.data() + sent,
+                                           text.size() - sent, MSG_NOSIGNAL)};
+                if (written <= 0) {
+                    break;
+                }
+                sent += static_cast<std::size_t>(written);
+            }
+        }
+    }
+
+ private:
+    const std::filesystem::path path_;
+    const FileDescriptor descriptor_;
+    bool bound_{false};
+};
+
+bool IsAtOrBelow(const std::string_view path, const std::string_view root) {
+    return path.starts_with(root) &&
+           (path.size() == root.size() ||
+            path[root.size()] == std::filesystem::path::preferred_separator);
+}
+
+void DrainEvents(const int inotify, const bool use_ignore_files,
+                 const std::span<const std::filesystem::path> roots,
+                 WatchSet& watches, PendingTargets& pending) {
+    alignas(inotify_event) std::array<char, 64 * 1024> buffer{};
+
+    while (true) {
+        const ssize_t length{read(inotify, buffer.data(), buffer.size())};
+        if (length <= 0) {
+            return;
+        }
+
+        // the kernel pads every event so the next one stays aligned
+        for (std::size_t offset{0};
+             offset < static_cast<std::size_t>(length);) {
+            const inotify_event* const event{
+                reinterpret_cast<const inotify_event*>(buffer.data() +
+                                                       offset)};
+            QueueEvent(*event, use_ignore_files, roots, watches, pending);
+            offset += sizeof(inotify_event) + event->len;
+        }
+    }
+}
+
+void AddWatches(parser_info::Parser& parser, WatchSet& watches) {
+    for (parser_info::Parser::ScannedDirectory& directory :
+         parser.TakeScannedDirectories()) {
+        watches.Add(std::move(directory));
+    }
+}
+}  // namespace
+
+int WatchSet::Add(parser_info::Parser::ScannedDirectory&& directory) {
+    const int watch{inotify_add_watch(inotify_, directory.path.c_str(),
+                                      directory_events)};
+    if (watch >= 0) {
+        directories_.insert_or_assign(watch, std::move(directory));
+    } else if (errno == ENOSPC) {
+        throw std::system_error{errno, std::generic_category(),
+                                "Ran out of inotify watches (see "
+                                "fs.inotify.max_user_watches)"};
+    }
+    return watch;
+}
+
+const parser_info::Parser::ScannedDirectory* WatchSet::Find(
+    const int watch) const {
+    const auto found{directories_.find(watch)};
+    return found == directories_.end() ? nullptr : &found->second;
+}
+
+void WatchSet::Forget(const int watch) { directories_.erase(watch); }
+
+void WatchSet::RemoveBelow(const std::filesystem::path& path) {
+    const std::string root{path.string()};
+    std::erase_if(directories_, [this, &root](const auto& entry) {
+        if (!IsAtOrBelow(entry.second.path.native(), root)) {
+            return false;
+        }
+        inotify_rm_watch(inotify_, entry.first);
+        return true;
+    });
+}
+
+void QueueEvent(const inotify_event& event, const bool use_ignore_files,
+                const std::span<const std::filesystem::path> roots,
+                WatchSet& watches, PendingTargets& pending) {
+    if (event.mask & IN_Q_OVERFLOW) {
+        // events were lost, so nothing short of every whole tree is safe
+        pending.clear();
+        for (const std::filesystem::path& root : roots) {
+            pending.insert_or_assign(
+                root.string(), parser_info::Parser::Target{root, nullptr});
+        }
+        return;
+    } else if (event.mask & IN_IGNORED) {
+        watches.Forget(event.wd);
+        return;
+    }
+
+    const parser_info::Parser::ScannedDirectory* const directory{
+        watches.Find(event.wd)};
+    if (directory == nullptr || event.len == 0) {
+        return;
+    }
+
+    const std::string_view name{event.name};
+    if (use_ignore_files &&
+        std::ranges::find(ignore_rules::ignore_file_names, name) !=
+            ignore_rules::ignore_file_names.end()) {
+        // the rules for everything in this directory may have changed; the
+        // rescan watches again whatever is still not ignored
+        parser_info::Parser::Target target{directory->path,
+                                           directory->parent_scope};
+        watches.RemoveBelow(target.path);
+        pending.insert_or_assign(target.path.string(), std::move(target));
+        return;
+    }
+
+    const std::filesystem::path changed{directory->path / name};
+    if ((event.mask & IN_ISDIR) && (event.mask & (IN_MOVED_FROM | IN_DELETE))) {
+        watches.RemoveBelow(changed);
+    }
+    pending.insert_or_assign(
+        changed.string(),
+        parser_info::Parser::Target{changed, directory->ignore_scope});
+}
+
+void Watch(const profile::ScanConfig& config, const WatchOptions& options,
+           const profile::HitCallback& on_hits,
+           const UpdateCallback& on_update) {
+    const BlockedSignals blocked{};
+    const FileDescriptor signals{signalfd(-1, &blocked.Signals(), SFD_CLOEXEC)};
+    const FileDescriptor inotify{inotify_init1(IN_NONBLOCK | IN_CLOEXEC)};
+    if (signals.Get() < 0 || inotify.Get() < 0) {
+        ThrowLastError("Could not start watching");
+    }
+    const SummarySocket socket{options.socket_path};
+
+    parser_info::Parser parser{config, on_hits, true};
+    WatchSet watches{inotify.Get()};
+
+    on_update(parser.ParseFiles(), 0);
+    AddWatches(parser, watches);
+
+    PendingTargets pending{};
+    std::optional<std::chrono::steady_clock::time_point> pending_since{};
+    std::array<pollfd, 3> descriptors{{
+        {signals.Get(), POLLIN, 0},
+        {inotify.Get(), POLLIN, 0},
+        {socket.Get(), POLLIN, 0},
+    }};
+
+    while (true) {
+        // every event restarts the settle time, but none of them push the
+        // rescan past max_settle_time after the first
+        int timeout{-1};
+        if (!pending.empty()) {
+            const std::chrono::milliseconds left{
+                std::chrono::ceil<std::chrono::milliseconds>(
+                    pending_since.value() + options.max_settle_time -
+                    std::chrono::steady_clock::now())};
+            timeout = static_cast<int>(
+                std::clamp(left, std::chrono::milliseconds{0},
+                           options.settle_time)
+                    .count());
+        }
+        const int ready{
+            timeout == 0 ? 0
+                         : poll(descriptors.data(), descriptors.size(),
+                                timeout)};
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        } else if (ready < 0) {
+            ThrowLastError("Could not wait for changes");
+        }
+
+        if (ready == 0) {
+            std::vector<parser_info::Parser::Target> targets{};
+            for (auto& [_, target] : pending) {
+                targets.push_back(std::move(target));
+            }
+            pending.clear();
+            pending_since.reset();
+
+            parser.Rescan(targets);
+            AddWatches(parser, watches);
+            on_update(parser.Summarize(), targets.size());
+            continue;
+        }
+
+        if (descriptors[0].revents & POLLIN) {
+            signalfd_siginfo received{};
+            if (read(signals.Get(), &received, sizeof(received)) < 0) {
+                ThrowLastError("Could not read the stop signal");
+            }
+            return;
+        }
+        if (descriptors[1].revents & POLLIN) {
+            DrainEvents(inotify.Get(), config.use_ignore_files, parser.Roots(),
+                        watches, pending);
+            if (!pending.empty() && !pending_since.has_value()) {
+                pending_since = std::chrono::steady_clock::now();
+            }
+        }
+        if (descriptors[2].revents & POLLIN) {
+            socket.ServePending(profile::SummaryJson(parser.Summarize()));
+        }
+    }
+}
+#else
+void Watch(const profile::ScanConfig&, const WatchOptions&,
+           const profile::HitCallback&, const UpdateCallback&) {
+    throw std::system_error{
+        std::make_error_code(std::errc::function_not_supported),
+        "Watch mode needs inotify, which this platform does not have"};
+}
+#endif
+}  // namespace watch_mode
@@ -0,0 +1,155 @@
+/*
+ *  comment_lexer_test.cpp - Tests for finding the comments of a file
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "byte_scanner.hpp"
+#include "comment_lexer.hpp"
+#include "comment_syntax.hpp"
+#include "include/checks.hpp"
+#include "profile.hpp"
+
+namespace checks {
+namespace {
+using parser_info::CommentFormat;
+
+/*
+ * The comments the lexer finds on each line of text.
+ */
+std::vector<std::vector<std::string>> Comments(const CommentFormat format,
+                                               const std::string_view text) {
+    comment_lexing::CommentLexer lexer{format};
+    std::vector<std::vector<std::string>> lines{};
+    byte_scanner::ForEachLine(text, [&](const std::string_view line,
+                                        std::size_t) {
+        lines.emplace_back();
+        for (const std::string_view comment : lexer.NextLine(line)) {
+            lines.back().emplace_back(comment);
+        }
+    });
+    return lines;
+}
+
+struct LexerCase {
+    std::string_view description;
+    CommentFormat format;
+    std::string_view text;
+    std::vector<std::vector<std::string>> comments;
+};
+
+/*
+ * How many lines of the files in directory the scan counts pattern on,
+ * first when it only counts and then when it collects hits.
+ */
+std::vector<std::size_t> CountsOf(const TemporaryDirectory& directory,
+                                  const std::string_view pattern) {
+    std::vector<std::size_t> counts{};
+    for (const bool collect_hits : {false, true}) {
+        profile::ScanConfig config{};
+        config.directory = directory.Path();
+        config.use_ignore_files = false;
+        config.thread_count = 1;
+        const profile::ScanSummary summary{profile::Scan(
+            config, collect_hits ? profile::HitCallback{[](const auto&) {}}
+                                 : profile::HitCallback{})};
+        for (const profile::PatternTotal& total : summary.patterns) {
+            if (total.pattern == pattern) {
+                counts.push_back(total.count);
+            }
+        }
+    }
+    return counts;
+}
+}  // namespace
+
+void RunCommentLexerTests() {
+    const std::vector<LexerCase> cases{
+        {
+            "a // inside a string is not a comment",
+            CommentFormat::CFamily,
+            "const char* url = \"http://example.com\"; // real\n",
+            {{"// real"}},
+        },
+        {
+            "a quote in a character literal does not open a string",
+            CommentFormat::CFamily,
+            "char quote = '\"'; // real\n",
+            {{"// real"}},
+        },
+        {
+            "a block comment spans lines",
+            CommentFormat::CFamily,
+            "int a; /* first\nsecond\nthird */ int b;\n",
+            {{"/* first"}, {"second"}, {"third */"}},
+        },
+        {
+            "block comments do not nest in C",
+            CommentFormat::CFamily,
+            "/* outer /* inner */ code();\n",
+            {{"/* outer /* inner */"}},
+        },
+        {
+            "block comments nest in Rust",
+            CommentFormat::Rust,
+            "/* outer /* inner */ still\nouter */ code(); // tail\n",
+            {{"/* outer /* inner */ still"}, {"outer */", "// tail"}},
+        },
+        {
+            "code and strings between two comments are left out",
+            CommentFormat::CFamily,
+            "int a = f(/*x*/ \"BUG\"); // note\n",
+            {{"/*x*/", "// note"}},
+        },
+        {
+            "a docstring is a comment",
+            CommentFormat::Python,
+            "def f():\n    \"\"\"TODO first\n    second\"\"\"\n"
+            "    x = \"# not\"  # real\n",
+            {{}, {"\"\"\"TODO first"}, {"    second\"\"\""}, {"# real"}},
+        },
+        {
+            "an assigned triple quoted string is not a docstring",
+            CommentFormat::Python,
+            "x = '''TODO not\nstill not'''  # real\n",
+            {{}, {"# real"}},
+        },
+        {
+            "Lua block and line comments on one line stay apart",
+            CommentFormat::Lua,
+            "x = \"--no\" --[[ block ]] y = 1 -- tail\n",
+            {{"--[[ block ]]", "-- tail"}},
+        },
+    };
+
+    for (const auto& [description, format, text, comments] : cases) {
+        Check(Comments(format, text) == comments, description);
+    }
+
+    // every count depends on only the comments reaching the matcher
+    const TemporaryDirectory directory{};
+    directory.Write("between.cpp", "int a = f(/*x*/ \"BUG\"); // note\n"
+                                   "int b = 0; /* BUG */ \"x\"; // BUG\n");
+    Check(CountsOf(directory, "BUG") == std::vector<std::size_t>{1, 1},
+          "a pattern in a string between two comments is not counted, and "
+          "one in both comments on a line counts once");
+}
+
+}  // namespace checks
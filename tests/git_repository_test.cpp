@@ -0,0 +1,343 @@
+/*
+ *  git_repository_test.cpp - Tests for reading git repositories directly
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <iostream>
+#include <optional>
+#include <print>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "git_repository.hpp"
+#include "include/checks.hpp"
+#include "profile.hpp"
+
+namespace checks {
+namespace {
+#if defined(_WIN32)
+constexpr std::string_view null_device{"NUL"};
+#else
+constexpr std::string_view null_device{"/dev/null"};
+#endif
+
+/*
+ * Builds a small repository with the git command line in a directory of its
+ * own, so that ChangesSince can be held against what git itself reports.
+ * Every setting that changes what git writes is pinned on the command line,
+ * and HOME points into the directory so no user configuration is read.
+ */
+class Fixture {
+ public:
+    Fixture() {
+        std::filesystem::create_directories(this->Directory());
+        std::filesystem::create_directories(this->Plain());
+        SetEnvironment("HOME", root_.Path().string());
+        SetEnvironment("GIT_CONFIG_NOSYSTEM", "1");
+    }
+
+    std::filesystem::path Directory() const {
+        return root_.Path() / "repository";
+    }
+
+    // a directory that is not in any repository
+    std::filesystem::path Plain() const { return root_.Path() / "plain"; }
+
+    /*
+     * Runs git with arguments in the repository, throwing if it fails.
+     */
+    void Git(const std::string_view arguments) const {
+        const std::string command{
+            "git -C \"" + this->Directory().string() +
+            "\" -c user.name=test -c user.email=test@example.com"
+            " -c commit.gpgsign=false -c tag.gpgsign=false"
+            " -c init.defaultBranch=main -c gc.auto=0"
+            " -c core.autocrlf=false " +
+            std::string{arguments} + " > " + std::string{null_device} +
+            " 2>&1"};
+        if (std::system(command.c_str()) != 0) {
+            throw std::runtime_error{"git " + std::string{arguments} +
+                                     " failed"};
+        }
+    }
+
+    void Write(const std::string_view path,
+               const std::string_view contents) const {
+        root_.Write("repository/" + std::string{path}, contents);
+    }
+
+    void Append(const std::string_view path,
+                const std::string_view contents) const {
+        std::ofstream output{this->Directory() / path,
+                             std::ios::binary | std::ios::app};
+        output.write(contents.data(),
+                     static_cast<std::streamsize>(contents.size()));
+    }
+
+ private:
+    static void SetEnvironment(const std::string& name,
+                               const std::string& value) {
+#if defined(_WIN32)
+        _putenv_s(name.c_str(), value.c_str());
+#else
+        setenv(name.c_str(), value.c_str(), 1);
+#endif
+    }
+
+ private:
+    TemporaryDirectory root_{};
+};
+
+bool GitAvailable() {
+    const std::string command{"git --version > " + std::string{null_device} +
+                              " 2>&1"};
+    return std::system(command.c_str()) == 0;
+}
+
+std::string Lines(const std::string_view text, const std::size_t count) {
+    std::string lines{};
+    for (std::size_t line{0}; line < count; ++line) {
+        lines += std::string{text} + " " + std::to_string(line) + "\n";
+    }
+    return lines;
+}
+
+/*
+ * The changes as git diff --name-status would list them, sorted.
+ */
+std::vector<std::string> Describe(
+    const std::vector<git_reading::ChangedFile>& changes) {
+    std::vector<std::string> described{};
+    for (const auto& [path, base, deleted] : changes) {
+        described.push_back((deleted ? "D " : base.has_value() ? "M " : "A ") +
+                            path);
+    }
+    std::ranges::sort(described);
+    return described;
+}
+
+std::optional<git_reading::ObjectId> BaseOf(
+    const std::vector<git_reading::ChangedFile>& changes,
+    const std::string_view path) {
+    for (const git_reading::ChangedFile& change : changes) {
+        if (change.path == path) {
+            return change.base;
+        }
+    }
+    return std::nullopt;
+}
+
+/*
+ * Five commits, the first tagged v1:
+ *
+ *   1. a.cpp, src/b.cpp, docs/readme.md and a 400 line big.txt
+ *   2. appends to big.txt and adds c.cpp; then everything is repacked
+ *      without offset deltas, so the first big.txt is stored as a
+ *      REF_DELTA, and the refs are packed
+ *   3. removes src/b.cpp and adds a 400 line big2.txt
+ *   4. appends to big2.txt; then the loose objects are packed on their own,
+ *      so the first big2.txt is stored as an OFS_DELTA
+ *   5. changes a.cpp, left as loose objects
+ *
+ * after which the working tree changes a.cpp again, stages a new d.cpp,
+ * deletes docs/readme.md, adds f.cpp with intent to add, leaves
+ * tools/e.cpp untracked and only touches c.cpp.
+ */
+void BuildHistory(const Fixture& fixture) {
+    fixture.Git("init -q");
+    fixture.Write("a.cpp", "int a;\n");
+    fixture.Write("src/b.cpp", "int b;\n");
+    fixture.Write("big.txt", Lines("big line", 400));
+    fixture.Write("docs/readme.md", "readme\n");
+    fixture.Git("add -A");
+    fixture.Git("commit -q -m first");
+    fixture.Git("tag -a -m first v1");
+
+    fixture.Append("big.txt", "one more\n");
+    fixture.Write("c.cpp", "int c;\n");
+    fixture.Git("add -A");
+    fixture.Git("commit -q -m second");
+    fixture.Git("-c repack.useDeltaBaseOffset=false repack -q -a -d -f");
+    fixture.Git("pack-refs --all");
+
+    fixture.Git("rm -q src/b.cpp");
+    fixture.Write("big2.txt", Lines("other line", 400));
+    fixture.Git("add -A");
+    fixture.Git("commit -q -m third");
+
+    fixture.Append("big2.txt", "appended\n");
+    fixture.Git("commit -q -a -m fourth");
+    fixture.Git("repack -q -d");
+
+    fixture.Write("a.cpp", "int a = 5;\n");
+    fixture.Git("commit -q -a -m fifth");
+
+    fixture.Write("a.cpp", "int a = 6;\n");
+    fixture.Write("d.cpp", "int d;\n");
+    fixture.Git("add d.cpp");
+    std::filesystem::remove(fixture.Directory() / "docs/readme.md");
+    fixture.Write("tools/e.cpp", "int e;\n");
+    fixture.Write("f.cpp", "int f;\n");
+    fixture.Git("add -N f.cpp");
+    const std::filesystem::path touched{fixture.Directory() / "c.cpp"};
+    std::filesystem::last_write_time(
+        touched,
+        std::filesystem::last_write_time(touched) + std::chrono::seconds{5});
+}
+
+void CheckChanges(git_reading::Repository& repository,
+                  const std::string_view revision,
+                  const std::vector<std::string>& expected) {
+    const std::vector<std::string> changes{Describe(repository.ChangesSince(
+        repository.ResolveCommit(revision),
+        [](std::string_view) { return true; }, 2))};
+    Check(changes == expected,
+          "the changes since " + std::string{revision} + " match git's");
+}
+
+template <typename Callable>
+void CheckThrows(const std::string_view description, Callable&& callable) {
+    bool threw{false};
+    try {
+        callable();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    Check(threw, description);
+}
+}  // namespace
+
+void RunGitRepositoryTests() {
+    if (!GitAvailable()) {
+        std::println(std::cerr, "git_repository: skipped, git was not found");
+        return;
+    }
+
+    const Fixture fixture{};
+    BuildHistory(fixture);
+    // found by looking upwards from a directory git does not track
+    git_reading::Repository repository{fixture.Directory() / "tools"};
+
+    const std::vector<std::string> since_head{
+        "A d.cpp",
+        "A f.cpp",
+        "D docs/readme.md",
+        "M a.cpp",
+    };
+    CheckChanges(repository, "HEAD", since_head);
+    CheckChanges(repository, "HEAD~1", since_head);
+    CheckChanges(repository, "HEAD~2", {
+                                           "A d.cpp",
+                                           "A f.cpp",
+                                           "D docs/readme.md",
+                                           "M a.cpp",
+                                           "M big2.txt",
+                                       });
+    CheckChanges(repository, "HEAD~3", {
+                                           "A big2.txt",
+                                           "A d.cpp",
+                                           "A f.cpp",
+                                           "D docs/readme.md",
+                                           "D src/b.cpp",
+                                           "M a.cpp",
+                                       });
+    CheckChanges(repository, "v1", {
+                                       "A big2.txt",
+                                       "A c.cpp",
+                                       "A d.cpp",
+                                       "A f.cpp",
+                                       "D docs/readme.md",
+                                       "D src/b.cpp",
+                                       "M a.cpp",
+                                       "M big.txt",
+                                   });
+
+    const std::vector<std::string> wanted{Describe(repository.ChangesSince(
+        repository.ResolveCommit("HEAD"),
+        [](const std::string_view path) { return !path.starts_with("docs"); },
+        1))};
+    Check(wanted == std::vector<std::string>{"A d.cpp", "A f.cpp", "M a.cpp"},
+          "paths wanted turns down are left out");
+
+    std::string contents{};
+    const std::optional<git_reading::ObjectId> big{BaseOf(
+        repository.ChangesSince(repository.ResolveCommit("v1"),
+                                [](std::string_view) { return true; }, 1),
+        "big.txt")};
+    Check(big.has_value() && repository.ReadBlob(*big, contents) &&
+              contents == Lines("big line", 400),
+          "a blob stored as a REF_DELTA reads back whole");
+
+    const std::optional<git_reading::ObjectId> big2{BaseOf(
+        repository.ChangesSince(repository.ResolveCommit("HEAD~2"),
+                                [](std::string_view) { return true; }, 1),
+        "big2.txt")};
+    Check(big2.has_value() && repository.ReadBlob(*big2, contents) &&
+              contents == Lines("other line", 400),
+          "a blob stored as an OFS_DELTA reads back whole");
+
+    const std::optional<git_reading::ObjectId> loose{BaseOf(
+        repository.ChangesSince(repository.ResolveCommit("HEAD"),
+                                [](std::string_view) { return true; }, 1),
+        "a.cpp")};
+    Check(loose.has_value() && repository.ReadBlob(*loose, contents) &&
+              contents == "int a = 5;\n",
+          "a loose blob reads back whole");
+
+    const git_reading::ObjectId first{repository.ResolveCommit("v1")};
+    Check(repository.ResolveCommit("HEAD~4") == first &&
+              repository.ResolveCommit("main^^^^") == first &&
+              repository.ResolveCommit("refs/tags/v1") == first,
+          "an annotated packed tag peels to its commit");
+    Check(repository.ResolveCommit(git_reading::ToHex(first).substr(0, 7)) ==
+              first,
+          "an abbreviated name of a packed commit resolves");
+    const git_reading::ObjectId head{repository.ResolveCommit("HEAD")};
+    Check(repository.ResolveCommit(git_reading::ToHex(head).substr(0, 7)) ==
+                  head &&
+              repository.ResolveCommit("@") == head,
+          "an abbreviated name of a loose commit resolves");
+
+    // a scan of the changes only visits some of the files the cache holds
+    profile::ScanConfig config{};
+    config.directory = fixture.Directory();
+    config.thread_count = 1;
+    config.cache_file = fixture.Plain() / "cache";
+    profile::Scan(config);
+    const std::uint64_t cached_files{CacheEntryCount(*config.cache_file)};
+    const profile::ChangeSummary changes{profile::ScanChanges(config, "HEAD")};
+    Check(cached_files == 5 && changes.summary.file_count == 3 &&
+              CacheEntryCount(*config.cache_file) == cached_files,
+          "scanning the changes keeps the cache of the whole tree");
+
+    CheckThrows("an unknown revision throws",
+                [&repository] { repository.ResolveCommit("no-such-branch"); });
+    CheckThrows("a revision past the first commit throws",
+                [&repository] { repository.ResolveCommit("HEAD~5"); });
+    CheckThrows("a directory outside of any repository throws",
+                [&fixture] { git_reading::Repository{fixture.Plain()}; });
+}
+
+}  // namespace checks
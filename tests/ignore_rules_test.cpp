@@ -0,0 +1,154 @@
+/*
+ *  ignore_rules_test.cpp - Tests for gitignore style ignore rules
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ignore_rules.hpp"
+#include "include/checks.hpp"
+
+namespace checks {
+namespace {
+struct GlobCase {
+    std::string_view pattern;
+    std::string_view text;
+    bool matches;
+};
+
+struct RuleCase {
+    std::string_view description;
+    std::string_view rules;
+    std::string_view path;
+    bool is_directory;
+    std::optional<bool> ignored;
+};
+
+std::string Describe(const std::optional<bool> ignored) {
+    return ignored.has_value() ? (ignored.value() ? "ignored" : "kept")
+                               : "unmatched";
+}
+}  // namespace
+
+void RunIgnoreRulesTests() {
+    const std::vector<GlobCase> globs{
+        {"*.cpp", "main.cpp", true},
+        {"*.cpp", "src/main.cpp", false},
+        {"?.h", "a.h", true},
+        {"?.h", "/.h", false},
+        {"[abc].txt", "b.txt", true},
+        {"[!abc].txt", "b.txt", false},
+        {"[a-c].txt", "c.txt", true},
+        {"[a-c", "a", false},
+        {"**/build", "build", true},
+        {"**/build", "a/b/build", true},
+        {"**/build", "a/b/build/c", false},
+        {"logs/**", "logs/a/b.txt", true},
+        {"logs/**", "logs", false},
+        {"a/**/b", "a/b", true},
+        {"a/**/b", "a/x/y/b", true},
+        {"a/**/b", "a/x/y/c", false},
+        {"x**y", "xay", true},
+        {"x**y", "xa/y", false},
+        {"\\*.cpp", "*.cpp", true},
+        {"\\*.cpp", "a.cpp", false},
+    };
+    for (const auto& [pattern, text, matches] : globs) {
+        Check(ignore_rules::GlobMatch(pattern, text) == matches,
+              std::string{pattern} + (matches ? " matches " : " rejects ") +
+                  std::string{text});
+    }
+
+    const std::vector<RuleCase> rules{
+        {"an unanchored name matches at any depth", "*.log\n", "a/b/c.log",
+         false, true},
+        {"a pattern with a slash is anchored", "src/*.cpp\n", "src/a.cpp",
+         false, true},
+        {"an anchored pattern does not match deeper down", "src/*.cpp\n",
+         "lib/src/a.cpp", false, std::nullopt},
+        {"a leading slash anchors a name", "/build\n", "build", true, true},
+        {"a leading slash only matches at the top", "/build\n", "src/build",
+         true, std::nullopt},
+        {"dir/ matches a directory", "build/\n", "src/build", true, true},
+        {"dir/ does not match a file", "build/\n", "src/build", false,
+         std::nullopt},
+        {"**/ matches at the top", "**/gen\n", "gen", true, true},
+        {"**/ matches at any depth", "**/gen\n", "a/b/gen", true, true},
+        {"/** matches everything inside", "vendor/**\n", "vendor/x/y.cpp",
+         false, true},
+        {"a negation after a match keeps the path", "*.log\n!keep.log\n",
+         "keep.log", false, false},
+        {"the last matching rule wins", "!keep.log\n*.log\n", "keep.log",
+         false, true},
+        {"a negation does not affect other paths", "*.log\n!keep.log\n",
+         "other.log", false, true},
+        {"\\! matches a literal exclamation mark", "\\!important\n",
+         "!important", false, true},
+        {"\\# matches a literal hash", "\\#notes\n", "#notes", false, true},
+        {"# starts a comment", "#notes\n", "#notes", false, std::nullopt},
+        {"trailing spaces are dropped", "a.txt   \n", "a.txt", false, true},
+        {"an escaped trailing space is kept", "a\\ \n", "a ", false, true},
+        {"carriage returns are dropped", "a.txt\r\n", "a.txt", false, true},
+    };
+    for (const auto& [description, text, path, is_directory, ignored] :
+         rules) {
+        ignore_rules::RuleSet rule_set{};
+        rule_set.AddRules(text);
+        const std::optional<bool> result{rule_set.Match(path, is_directory)};
+        Check(result == ignored, std::string{description} + ": " +
+                                     std::string{path} + " is " +
+                                     Describe(result) + ", not " +
+                                     Describe(ignored));
+    }
+
+    // the root ignores every log, and one directory takes one back
+    const TemporaryDirectory directory{};
+    directory.Write(".gitignore", "*.log\nnested/generated/\n");
+    directory.Write("nested/.gitignore", "!keep.log\n");
+    directory.Write("nested/.profileignore", "*.tmp\n");
+    const std::filesystem::path root{directory.Path()};
+    const std::filesystem::path nested{root / "nested"};
+
+    const std::shared_ptr<const ignore_rules::IgnoreScope> root_scope{
+        ignore_rules::IgnoreScope::Extend(nullptr, root,
+                                          ignore_rules::ignore_file_names)};
+    const std::shared_ptr<const ignore_rules::IgnoreScope> nested_scope{
+        ignore_rules::IgnoreScope::Extend(root_scope, nested,
+                                          ignore_rules::ignore_file_names)};
+    Check(root_scope->IsIgnored(root / "keep.log", false),
+          "the root's rules ignore its own logs");
+    Check(!nested_scope->IsIgnored(nested / "keep.log", false),
+          "a nested .gitignore overrides its parent");
+    Check(nested_scope->IsIgnored(nested / "other.log", false),
+          "the parent's rules still apply where the nested ones do not match");
+    Check(nested_scope->IsIgnored(nested / "generated", true),
+          "the parent's anchored rules apply below it");
+    Check(nested_scope->IsIgnored(nested / "a.tmp", false),
+          "a .profileignore adds to the .gitignore beside it");
+    Check(!nested_scope->IsIgnored(nested / "a.cpp", false),
+          "paths no rule matches are kept");
+    Check(ignore_rules::IgnoreScope::Extend(root_scope, root / "empty",
+                                            ignore_rules::ignore_file_names) ==
+              root_scope,
+          "a directory without ignore files shares its parent's scope");
+}
+
+}  // namespace checks
@@ -0,0 +1,97 @@
+/*
+ *  checks.hpp - Minimal assertions shared by the test suites
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#ifndef TESTS_INCLUDE_CHECKS_HPP_
+#define TESTS_INCLUDE_CHECKS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace checks {
+
+/*
+ * Records one check, printing description to stderr when it did not pass.
+ * Checks go on after a failure so that a run reports every one of them.
+ */
+void Check(bool passed, std::string_view description);
+
+std::size_t CheckCount();
+
+std::size_t FailureCount();
+
+/*
+ * A directory of its own under the system's temporary directory, removed
+ * with everything in it when this goes out of scope.
+ */
+class TemporaryDirectory {
+ public:
+    TemporaryDirectory();
+    TemporaryDirectory(const TemporaryDirectory&) = delete;
+    TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+    ~TemporaryDirectory();
+
+    const std::filesystem::path& Path() const;
+
+    /*
+     * Writes contents to path, relative to the directory, creating the
+     * directories it is in and replacing whatever it held.
+     */
+    void Write(std::string_view path, std::string_view contents) const;
+
+ private:
+    std::filesystem::path root_{};
+};
+
+/*
+ * A ustar member named name of the given type, its header block followed by
+ * data padded out to whole blocks.
+ */
+std::string TarMember(std::string_view name, char type, std::string_view data);
+
+/*
+ * The two zero blocks that end a tar archive.
+ */
+std::string TarEndOfArchive();
+
+/*
+ * The entry count in the header of the scan cache at cache_file, read the
+ * way scan_cache.hpp lays it out, or zero if there is no such cache.
+ */
+std::uint64_t CacheEntryCount(const std::filesystem::path& cache_file);
+
+/*
+ * The suites main runs, one per file under tests/.
+ */
+void RunInflateTests();
+void RunGitRepositoryTests();
+void RunCommentLexerTests();
+void RunTarReaderTests();
+void RunKeywordMatcherTests();
+void RunRegexPrefilterTests();
+void RunIgnoreRulesTests();
+void RunPartialResultTests();
+void RunScanCacheTests();
+void RunParserTests();
+void RunLanguageRegistryTests();
+void RunWatchModeTests();
+
+}  // namespace checks
+#endif  // TESTS_INCLUDE_CHECKS_HPP_
@@ -0,0 +1,160 @@
+/*
+ *  inflate_test.cpp - Tests for the zlib decompressor
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "include/checks.hpp"
+#include "inflate.hpp"
+
+namespace checks {
+namespace {
+/*
+ * Streams written by zlib itself, one per kind of deflate block.
+ */
+constexpr std::uint8_t stored_stream[]{
+    0x78, 0x01, 0x01, 0x0d, 0x00, 0xf2, 0xff, 0x73, 0x74, 0x6f, 0x72, 0x65,
+    0x64, 0x20, 0x62, 0x6c, 0x6f, 0x63, 0x6b, 0x0a, 0x24, 0x47, 0x04, 0xc7,
+};
+
+constexpr std::uint8_t fixed_stream[]{
+    0x78, 0x01, 0x4b, 0xcb, 0xac, 0x48, 0x4d, 0x51, 0x48, 0x43, 0x22, 0x33,
+    0x4a, 0xd3, 0xd2, 0x72, 0x13, 0xf3, 0x14, 0x92, 0xf3, 0x53, 0x52, 0x8b,
+    0xb9, 0xd2, 0x28, 0x94, 0x07, 0x00, 0xb1, 0xd8, 0x23, 0x08,
+};
+
+constexpr std::uint8_t dynamic_stream[]{
+    0x78, 0xda, 0x5d, 0xd1, 0x3b, 0x12, 0x40, 0x00, 0x14, 0x43, 0xd1, 0xde,
+    0x2a, 0x2c, 0x41, 0x12, 0xdf, 0xe5, 0x18, 0x14, 0x66, 0xd0, 0xdb, 0xbd,
+    0xd6, 0xbb, 0xe5, 0xed, 0xce, 0x24, 0xfb, 0xfb, 0xac, 0xf7, 0xb9, 0xb5,
+    0xd7, 0xf9, 0x1c, 0x6d, 0xd7, 0xec, 0xff, 0x54, 0x4d, 0xd7, 0x4c, 0xcd,
+    0xbe, 0xe6, 0x50, 0x73, 0xac, 0x39, 0xd5, 0x9c, 0x6b, 0x2e, 0x60, 0x90,
+    0x05, 0x97, 0x00, 0x13, 0x64, 0x02, 0x4d, 0xb0, 0x09, 0x38, 0x41, 0x27,
+    0xf0, 0x04, 0x9f, 0xe1, 0x33, 0x77, 0x83, 0xcf, 0xf0, 0x19, 0x3e, 0xc3,
+    0x67, 0xf8, 0x0c, 0x9f, 0xe1, 0x33, 0x7c, 0x81, 0x2f, 0xf0, 0x85, 0xc7,
+    0xc2, 0x17, 0xf8, 0x02, 0x5f, 0xe0, 0x0b, 0x7c, 0x81, 0x2f, 0x4b, 0xf3,
+    0x01, 0x18, 0xf3, 0xcf, 0xa9,
+};
+
+constexpr std::uint8_t empty_stream[]{
+    0x78, 0x9c, 0x03, 0x00, 0x00, 0x00, 0x00, 0x01,
+};
+
+std::string Bytes(const std::span<const std::uint8_t> bytes) {
+    return std::string{bytes.begin(), bytes.end()};
+}
+
+std::string StoredText() { return "stored block\n"; }
+
+std::string FixedText() {
+    std::string text{};
+    for (int repeat{0}; repeat < 3; ++repeat) {
+        text += "fixed fixed fixed huffman codes\n";
+    }
+    return text;
+}
+
+std::string DynamicText() {
+    std::string text{};
+    for (int line{0}; line < 40; ++line) {
+        text += "dynamic line " + std::to_string(line) + "\n";
+    }
+    return text;
+}
+
+void CheckInflates(const std::string_view name, const std::string& stream,
+                   const std::string& expected) {
+    std::string output{};
+    Check(inflating::InflateZlib(stream, output) && output == expected,
+          std::string{name} + " stream inflates to its text");
+
+    // no prefix of a stream is a stream of its own
+    bool any_truncation_accepted{false};
+    for (std::size_t length{0}; length < stream.size(); ++length) {
+        any_truncation_accepted |=
+            inflating::InflateZlib(std::string_view{stream}.substr(0, length),
+                                   output);
+    }
+    Check(!any_truncation_accepted,
+          std::string{name} + " stream is rejected when truncated");
+}
+
+void CheckRejected(const std::string_view description,
+                   const std::string& stream) {
+    std::string output{};
+    Check(!inflating::InflateZlib(stream, output), description);
+}
+}  // namespace
+
+void RunInflateTests() {
+    CheckInflates("stored", Bytes(stored_stream), StoredText());
+    CheckInflates("fixed", Bytes(fixed_stream), FixedText());
+    CheckInflates("dynamic", Bytes(dynamic_stream), DynamicText());
+    CheckInflates("empty", Bytes(empty_stream), "");
+
+    {
+        std::string output{"left over from before"};
+        Check(inflating::InflateZlib(Bytes(stored_stream), output, 64) &&
+                  output == StoredText(),
+              "output is replaced rather than appended to");
+    }
+    {
+        // git packs store objects back to back
+        std::string output{};
+        Check(inflating::InflateZlib(Bytes(fixed_stream) + "next object",
+                                     output) &&
+                  output == FixedText(),
+              "data after the end of a stream is ignored");
+    }
+
+    std::string stream{Bytes(dynamic_stream)};
+    stream.back() = static_cast<char>(stream.back() ^ 0x01);
+    CheckRejected("a stream failing its Adler-32 checksum is rejected",
+                  stream);
+
+    stream = Bytes(stored_stream);
+    stream[1] = static_cast<char>(stream[1] ^ 0x01);
+    CheckRejected("a header failing its check bits is rejected", stream);
+
+    // 0x79 0x18 names method 9 and passes the header check
+    stream = Bytes(stored_stream);
+    stream[0] = 0x79;
+    stream[1] = 0x18;
+    CheckRejected("a method other than deflate is rejected", stream);
+
+    // 0x78 0x20 sets FDICT and still passes the header check
+    stream = Bytes(stored_stream);
+    stream[1] = 0x20;
+    CheckRejected("a stream using a preset dictionary is rejected", stream);
+
+    // a final block of type 3, which does not exist
+    CheckRejected("a block of the reserved type is rejected",
+                  Bytes(std::vector<std::uint8_t>{0x78, 0x01, 0x07, 0x00}));
+
+    stream = Bytes(stored_stream);
+    stream[5] = static_cast<char>(stream[5] ^ 0x01);
+    CheckRejected("a stored block whose length fails its complement is "
+                  "rejected",
+                  stream);
+}
+
+}  // namespace checks
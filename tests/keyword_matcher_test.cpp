@@ -0,0 +1,145 @@
+/*
+ *  keyword_matcher_test.cpp - Tests for the keyword automaton
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "comment_syntax.hpp"
+#include "include/checks.hpp"
+#include "keyword_matcher.hpp"
+
+namespace checks {
+namespace {
+using keyword_matching::KeywordAutomaton;
+
+/*
+ * Where the automaton finds keyword in text, in order.
+ */
+std::vector<std::size_t> AutomatonMatches(const KeywordAutomaton& automaton,
+                                          const std::string_view text,
+                                          const std::size_t keyword) {
+    std::vector<std::size_t> begins{};
+    automaton.ForEachMatch(
+        text, [&](const std::size_t found, const std::size_t begin) {
+            if (found == keyword) {
+                begins.push_back(begin);
+            }
+        });
+    return begins;
+}
+
+/*
+ * Where std::regex_search finds regex in text, one match after another.
+ */
+std::vector<std::size_t> RegexMatches(const std::regex& regex,
+                                      const std::string_view text) {
+    std::vector<std::size_t> begins{};
+    for (std::regex_iterator<std::string_view::const_iterator> match{
+             text.cbegin(), text.cend(), regex};
+         match != std::regex_iterator<std::string_view::const_iterator>{};
+         ++match) {
+        begins.push_back(static_cast<std::size_t>(match->position(0)));
+    }
+    return begins;
+}
+
+std::optional<std::size_t> First(const std::vector<std::size_t>& begins) {
+    return begins.empty() ? std::nullopt : std::optional{begins.front()};
+}
+}  // namespace
+
+void RunKeywordMatcherTests() {
+    // the regexes the built-in keywords were matched with before the
+    // automaton replaced them
+    const std::array<std::regex, parser_info::builtin_keywords.size()>
+        builtin_regexes{
+            std::regex{"\\bTODO(\\(\\w*\\))?"},
+            std::regex{"\\bFIXME(\\(\\w*\\))?"},
+            std::regex{"\\bBUG(\\(\\w*\\))?"},
+            std::regex{"\\bHACK(\\(\\w*\\))?"},
+        };
+    const std::vector<std::string_view> lines{
+        "",
+        "TODO",
+        "// TODO: at the end of a comment",
+        "TODO(alice): with an owner",
+        "TODO(TODO) inside its own owner",
+        "xTODO _TODO 9TODO are all inside words",
+        "TODOS and TODO_ still start at a boundary",
+        "a.TODO (FIXME) [BUG] {HACK}",
+        "FIXMEFIXME BUGBUG HACKHACK",
+        "DEBUG debug HACKED hack",
+        "TOD FIXM BU HAC are all too short",
+        "TODOFIXME BUG",
+        "\xc3\x84TODO after a byte that is not a word character",
+        "/*BUG*/ /**HACK**/ #FIXME",
+        "TODO TODO TODO on one line",
+    };
+
+    // the Parser only records whether a line matches and where first
+    const KeywordAutomaton builtin{parser_info::builtin_keywords};
+    for (const std::string_view line : lines) {
+        for (std::size_t keyword{0}; keyword < builtin_regexes.size();
+             ++keyword) {
+            Check(First(AutomatonMatches(builtin, line, keyword)) ==
+                      First(RegexMatches(builtin_regexes[keyword], line)),
+                  std::string{parser_info::builtin_keywords[keyword].literal} +
+                      " matches \"" + std::string{line} +
+                      "\" where its regex does");
+        }
+    }
+
+    // keywords overlapping one another, with and without word boundaries,
+    // every occurrence of which the automaton has to report
+    const std::array<KeywordAutomaton::Keyword, 6> overlapping{{
+        {"he", false},
+        {"she", false},
+        {"his", false},
+        {"hers", false},
+        {"BUG", true},
+        {"DEBUG", true},
+    }};
+    const std::array<std::regex, overlapping.size()> overlapping_regexes{
+        std::regex{"he"},   std::regex{"she"},     std::regex{"his"},
+        std::regex{"hers"}, std::regex{"\\bBUG"}, std::regex{"\\bDEBUG"},
+    };
+    const std::vector<std::string_view> overlapping_lines{
+        "ushers",
+        "she sells his hers shells",
+        "hishershe",
+        "DEBUG BUG DEBUGBUG xBUG",
+    };
+    const KeywordAutomaton automaton{overlapping};
+    for (const std::string_view line : overlapping_lines) {
+        for (std::size_t keyword{0}; keyword < overlapping.size();
+             ++keyword) {
+            Check(AutomatonMatches(automaton, line, keyword) ==
+                      RegexMatches(overlapping_regexes[keyword], line),
+                  std::string{overlapping[keyword].literal} +
+                      " occurs in \"" + std::string{line} +
+                      "\" wherever its regex does");
+        }
+    }
+}
+
+}  // namespace checks
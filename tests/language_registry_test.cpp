@@ -0,0 +1,428 @@
+/*
+ *  language_registry_test.cpp - Tests for language files and extension lookup
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "byte_scanner.hpp"
+#include "comment_lexer.hpp"
+#include "comment_syntax.hpp"
+#include "include/checks.hpp"
+#include "language_registry.hpp"
+
+namespace checks {
+namespace {
+using language_registry::LanguageRegistry;
+
+/*
+ * The built-in language of file, looked up in builtin_extensions the way a
+ * registry without a language file does, but while compiling.
+ */
+constexpr std::optional<std::uint32_t> BuiltinLanguageOf(
+    const std::string_view file) {
+    const std::string_view extension{language_registry::ExtensionOf(file)};
+    if (extension.empty()) {
+        return std::nullopt;
+    }
+    const language_registry::ExtensionSlot& slot{
+        language_registry::builtin_extensions
+            .slots[language_registry::SlotIndex(
+                language_registry::HashExtension(
+                    extension, language_registry::builtin_extensions.seed),
+                language_registry::builtin_extensions.slots.size())]};
+    if (!language_registry::SameExtension(slot.extension, extension)) {
+        return std::nullopt;
+    }
+    return slot.language;
+}
+
+static_assert(BuiltinLanguageOf("main.cpp") == 1);
+static_assert(BuiltinLanguageOf("src/lib.rs") == 5);
+static_assert(BuiltinLanguageOf("archive.tar.h") == 0);
+static_assert(!BuiltinLanguageOf("main.cppx").has_value());
+static_assert(!BuiltinLanguageOf("main.cp").has_value());
+static_assert(!BuiltinLanguageOf(".c").has_value());
+static_assert(!BuiltinLanguageOf("dir.c/Makefile").has_value());
+
+/*
+ * Whether an extension listed twice keeps every seed from placing it.
+ */
+constexpr bool RepeatsArePlaced() {
+    std::array<language_registry::ExtensionSlot, 16> slots{};
+    const std::array<language_registry::ExtensionSlot, 3> entries{{
+        {".a", 0},
+        {".b", 1},
+        {".a", 2},
+    }};
+    return language_registry::PlaceExtensions(slots, entries).has_value();
+}
+
+static_assert(!RepeatsArePlaced());
+
+/*
+ * The comments a lexer for syntax finds on each line of text.
+ */
+std::vector<std::vector<std::string>> Comments(
+    const comment_lexing::Syntax& syntax, const std::string_view text) {
+    comment_lexing::CommentLexer lexer{syntax};
+    std::vector<std::vector<std::string>> lines{};
+    byte_scanner::ForEachLine(text, [&](const std::string_view line,
+                                        std::size_t) {
+        lines.emplace_back();
+        for (const std::string_view comment : lexer.NextLine(line)) {
+            lines.back().emplace_back(comment);
+        }
+    });
+    return lines;
+}
+
+/*
+ * The name of the language of file, or nothing if it has none.
+ */
+std::string NameOf(const LanguageRegistry& registry,
+                   const std::filesystem::path& file) {
+    const std::optional<language_registry::Match> match{registry.Find(file)};
+    return match.has_value() ? std::string{match->language->name}
+                             : std::string{};
+}
+
+/*
+ * What building a registry from a language file holding contents throws,
+ * or nothing if it does not.
+ */
+std::string ProblemWith(const TemporaryDirectory& directory,
+                        const std::string_view contents) {
+    directory.Write("languages.ini", contents);
+    try {
+        const LanguageRegistry registry{directory.Path() / "languages.ini"};
+    } catch (const std::runtime_error& error) {
+        return error.what();
+    }
+    return {};
+}
+
+struct ProblemCase {
+    std::string_view description;
+    std::string_view contents;
+    // the line the problem is reported on and how it is described
+    std::size_t line_number;
+    std::string_view problem;
+};
+
+/*
+ * Every extension of one to three lowercase letters or digits that no
+ * built-in language claims.
+ */
+std::vector<std::string> UnknownExtensions() {
+    constexpr std::string_view characters{
+        "abcdefghijklmnopqrstuvwxyz0123456789"};
+    std::vector<std::string> extensions{};
+    std::vector<std::string> shorter{"."};
+    for (std::size_t length{1}; length <= 3; ++length) {
+        std::vector<std::string> longer{};
+        for (const std::string& prefix : shorter) {
+            for (const char character : characters) {
+                longer.push_back(prefix + character);
+            }
+        }
+        for (const std::string& extension : longer) {
+            if (!BuiltinLanguageOf(extension).has_value() &&
+                !BuiltinLanguageOf("file" + extension).has_value()) {
+                extensions.push_back(extension);
+            }
+        }
+        shorter = std::move(longer);
+    }
+    return extensions;
+}
+}  // namespace
+
+void RunLanguageRegistryTests() {
+    // every built-in extension is found, and nothing else is
+    const LanguageRegistry builtin{};
+    for (const parser_info::BuiltinLanguage& language :
+         parser_info::builtin_languages) {
+        language_registry::ForEachExtension(
+            language.extensions, [&](const std::string_view extension) {
+                const std::string file{"dir/file" + std::string{extension}};
+                const std::optional<language_registry::Match> match{
+                    builtin.Find(std::string_view{file})};
+                Check(match.has_value() && match->extension == extension &&
+                          match->language->name == language.name,
+                      file + " is " + std::string{language.name});
+                Check(NameOf(builtin, file) == language.name,
+                      file + " is " + std::string{language.name} +
+                          " as a path too");
+            });
+    }
+    Check(builtin.Languages().size() == parser_info::builtin_languages.size(),
+          "without a language file only the built-in languages are known");
+    Check(builtin.Fingerprint().empty(),
+          "without a language file there is no fingerprint");
+
+    // a file name that hashes to a taken slot is still compared in full
+    std::size_t collisions{0};
+    std::vector<std::string> found{};
+    for (const std::string& extension : UnknownExtensions()) {
+        const std::size_t slot{language_registry::SlotIndex(
+            language_registry::HashExtension(
+                std::string_view{extension},
+                language_registry::builtin_extensions.seed),
+            language_registry::builtin_extensions.slots.size())};
+        if (language_registry::builtin_extensions.slots[slot]
+                .extension.empty()) {
+            continue;
+        }
+        collisions++;
+        if (builtin.Find(std::string_view{"file" + extension}).has_value()) {
+            found.push_back(extension);
+        }
+    }
+    Check(collisions != 0, "some unknown extensions share a slot");
+    Check(found.empty(),
+          "unknown extensions sharing a slot with a known one are not found");
+
+    for (const std::string_view file :
+         {"Makefile", ".bashrc", "dir.cpp/README", "file.", "..", "file.CPP"}) {
+        Check(!builtin.Find(file).has_value(),
+              std::string{file} + " has no language");
+    }
+
+    // a language file adds languages and takes over built-in extensions
+    const TemporaryDirectory directory{};
+    directory.Write("languages.ini",
+                    "# comments start with # or ;\n"
+                    "; like this\n"
+                    "\n"
+                    "[Ruby]\n"
+                    "extensions = .rb .rake\n"
+                    "line_comment = #\n"
+                    "block_comment = =begin =end\n"
+                    "\n"
+                    "  [ Haskell ]  \n"
+                    "extensions=.hs\n"
+                    "line_comment\t=\t--\n"
+                    "block_comment = {-   -}\n"
+                    "nested_comments = true\n"
+                    "quotes = \"\n"
+                    "\n"
+                    "[Snakes]\n"
+                    "extensions = .pyi .snake\n"
+                    "line_comment = #\n"
+                    "\n"
+                    "[Quoted]\n"
+                    "extensions = .qt\n"
+                    "line_comment = #\n"
+                    "quotes = `\n");
+    const LanguageRegistry defined{directory.Path() / "languages.ini"};
+    Check(defined.Languages().size() ==
+              parser_info::builtin_languages.size() + 4,
+          "a language file adds its languages after the built-in ones");
+    Check(NameOf(defined, "lib/task.rake") == "Ruby" &&
+              NameOf(defined, "app.rb") == "Ruby",
+          "every extension of a defined language is found");
+    Check(NameOf(defined, "Main.hs") == "Haskell",
+          "blanks around a section name and a key are left out");
+    Check(NameOf(defined, "stubs.pyi") == "Snakes" &&
+              NameOf(defined, "main.py") == "Python",
+          "a defined language takes over only the extensions it lists");
+    Check(NameOf(defined, "main.cpp") == "C++",
+          "built-in extensions are still found");
+    Check(!defined.Fingerprint().empty(),
+          "defined languages have a fingerprint");
+    found.clear();
+    for (const std::string& extension : UnknownExtensions()) {
+        if (extension != ".rb" && extension != ".hs" &&
+            extension != ".qt" &&
+            defined.Find(std::string_view{"file" + extension}).has_value()) {
+            found.push_back(extension);
+        }
+    }
+    Check(found.empty(), "only defined extensions are added");
+
+    const std::optional<language_registry::Match> ruby{
+        defined.Find(std::string_view{"app.rb"})};
+    const std::optional<language_registry::Match> haskell{
+        defined.Find(std::string_view{"Main.hs"})};
+    const std::optional<language_registry::Match> quoted{
+        defined.Find(std::string_view{"text.qt"})};
+    if (ruby.has_value() && haskell.has_value() && quoted.has_value()) {
+        Check(Comments(*ruby->language->syntax,
+                       "x = 'a # b' # real\n=begin\nTODO\n=end\nputs 1\n") ==
+                  std::vector<std::vector<std::string>>{
+                      {"# real"}, {"=begin"}, {"TODO"}, {"=end"}, {}},
+              "a defined language's comments are found outside its quotes");
+        Check(Comments(*haskell->language->syntax,
+                       "f = 'x' -- real\n{- outer {- inner -} still -} g\n") ==
+                  std::vector<std::vector<std::string>>{
+                      {"-- real"}, {"{- outer {- inner -} still -}"}},
+              "a defined language's quotes and nesting are what it says");
+        Check(Comments(*quoted->language->syntax,
+                       "x = `a # b` # real\ny = `# open\n# after\n") ==
+                  std::vector<std::vector<std::string>>{
+                      {"# real"}, {}, {"# after"}},
+              "a backtick quote ends with its line like any other quote");
+    }
+
+    const std::vector<ProblemCase> cases{
+        {
+            "an extension in two languages",
+            "[A]\nextensions = .a .b\nline_comment = #\n"
+            "[B]\nextensions = .c .a\nline_comment = #\n",
+            4,
+            ".a is defined twice",
+        },
+        {
+            "an extension listed twice by one language",
+            "[A]\nextensions = .a .a\nline_comment = #\n",
+            1,
+            ".a is defined twice",
+        },
+        {
+            "an extension without a dot",
+            "[A]\nextensions = .a rb\n",
+            2,
+            "Invalid extension rb",
+        },
+        {
+            "an extension that is only a dot",
+            "[A]\nextensions = .\n",
+            2,
+            "Invalid extension .",
+        },
+        {
+            "an extension with a path separator",
+            "[A]\nextensions = .a/b\n",
+            2,
+            "Invalid extension .a/b",
+        },
+        {
+            "a language without extensions",
+            "[A]\nline_comment = #\n[B]\nextensions = .b\n",
+            1,
+            "A has no extensions",
+        },
+        {
+            "a language without comments",
+            "[A]\nextensions = .a\n",
+            1,
+            "A has no comments",
+        },
+        {
+            "too many characters starting comments and quotes",
+            "[A]\nextensions = .a\nline_comment = #\n"
+            "block_comment = (* *)\nquotes = \"'`\n",
+            1,
+            "A's comments and quotes start with more than four different "
+            "characters",
+        },
+        {
+            "a key before any section",
+            "extensions = .a\n",
+            1,
+            "Expected a [Language] section first",
+        },
+        {
+            "a section name without its bracket",
+            "# fine\n[A\n",
+            2,
+            "Malformed language name",
+        },
+        {
+            "an empty section name",
+            "[ ]\n",
+            1,
+            "Malformed language name",
+        },
+        {
+            "a line without a value",
+            "[A]\nextensions .a\n",
+            2,
+            "Expected key = value",
+        },
+        {
+            "an unknown key",
+            "[A]\nextensions = .a\nline_comments = #\n",
+            3,
+            "Unknown key line_comments",
+        },
+        {
+            "a block comment with one marker",
+            "[A]\nblock_comment = (*\n",
+            2,
+            "Expected an opening and a closing marker",
+        },
+        {
+            "a block comment with three markers",
+            "[A]\nblock_comment = (* *) x\n",
+            2,
+            "Expected an opening and a closing marker",
+        },
+        {
+            "a line comment with blanks",
+            "[A]\nline_comment = / /\n",
+            2,
+            "A line comment marker can not contain blanks",
+        },
+        {
+            "nesting that is not true or false",
+            "[A]\nnested_comments = yes\n",
+            2,
+            "Expected true or false",
+        },
+        {
+            "a quote that can not be one",
+            "[A]\nquotes = \"|\n",
+            2,
+            "Only \", ' and ` can be quotes",
+        },
+    };
+
+    for (const auto& [description, contents, line_number, problem] : cases) {
+        const std::string thrown{ProblemWith(directory, contents)};
+        Check(thrown.ends_with(":" + std::to_string(line_number) + ": " +
+                               std::string{problem}),
+              std::string{description} + " is reported on line " +
+                  std::to_string(line_number) + ", got \"" + thrown + "\"");
+    }
+
+    Check(ProblemWith(directory, "# nothing but comments\n").empty(),
+          "a language file without languages is fine");
+    Check(ProblemWith(directory,
+                      "[A]\nextensions = .a\nline_comment = #\n"
+                      "extensions = .b\n")
+              .empty(),
+          "a repeated key replaces what it held before");
+    bool missing_thrown{false};
+    try {
+        const LanguageRegistry missing{directory.Path() / "missing.ini"};
+    } catch (const std::runtime_error&) {
+        missing_thrown = true;
+    }
+    Check(missing_thrown, "a language file that does not exist is reported");
+}
+
+}  // namespace checks
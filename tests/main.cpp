@@ -0,0 +1,160 @@
+/*
+ *  main.cpp - Test runner for Profile
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <ios>
+#include <iostream>
+#include <print>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "include/checks.hpp"
+
+namespace checks {
+namespace {
+std::size_t check_count{0};
+std::size_t failure_count{0};
+constexpr std::size_t block_size{512};
+
+std::string Octal(std::size_t value, const std::size_t digits) {
+    std::string text(digits, '0');
+    for (std::size_t index{digits}; index-- != 0 && value != 0; value /= 8) {
+        text[index] = static_cast<char>('0' + value % 8);
+    }
+    return text;
+}
+}  // namespace
+
+void Check(const bool passed, const std::string_view description) {
+    ++check_count;
+    if (!passed) {
+        ++failure_count;
+        std::println(std::cerr, "FAILED: {}", description);
+    }
+}
+
+std::size_t CheckCount() { return check_count; }
+
+std::size_t FailureCount() { return failure_count; }
+
+TemporaryDirectory::TemporaryDirectory() {
+    std::random_device device{};
+    root_ = std::filesystem::temp_directory_path() /
+            ("profile-test-" + std::to_string(device()));
+    std::filesystem::create_directories(root_);
+}
+
+TemporaryDirectory::~TemporaryDirectory() {
+    std::error_code error{};
+    std::filesystem::remove_all(root_, error);
+}
+
+const std::filesystem::path& TemporaryDirectory::Path() const { return root_; }
+
+void TemporaryDirectory::Write(const std::string_view path,
+                               const std::string_view contents) const {
+    const std::filesystem::path file{root_ / path};
+    std::filesystem::create_directories(file.parent_path());
+    std::ofstream output{file, std::ios::binary | std::ios::trunc};
+    output.write(contents.data(),
+                 static_cast<std::streamsize>(contents.size()));
+}
+
+std::string TarMember(const std::string_view name, const char type,
+                      const std::string_view data) {
+    std::string header(block_size, '\0');
+    header.replace(0, name.size(), name);
+    header.replace(100, 7, "0000644");
+    header.replace(124, 11, Octal(data.size(), 11));
+    header[156] = type;
+    header.replace(257, 8, std::string_view{"ustar\0" "00", 8});
+
+    header.replace(148, 8, "        ");
+    std::size_t checksum{0};
+    for (const char byte : header) {
+        checksum += static_cast<unsigned char>(byte);
+    }
+    header.replace(148, 7, Octal(checksum, 6) + '\0');
+
+    std::string member{header};
+    member.append(data);
+    member.append((block_size - data.size() % block_size) % block_size, '\0');
+    return member;
+}
+
+std::string TarEndOfArchive() { return std::string(2 * block_size, '\0'); }
+
+std::uint64_t CacheEntryCount(const std::filesystem::path& cache_file) {
+    constexpr std::size_t count_offset{8 + 4 + 4 + 8};
+    std::ifstream input{cache_file, std::ios::binary};
+    char header[count_offset + sizeof(std::uint64_t)]{};
+    input.read(header, sizeof(header));
+    std::uint64_t count{0};
+    if (input.gcount() == sizeof(header)) {
+        std::memcpy(&count, header + count_offset, sizeof(count));
+    }
+    return count;
+}
+
+}  // namespace checks
+
+int main() {
+    constexpr struct {
+        std::string_view name;
+        void (*run)();
+    } suites[]{
+        {"inflate", checks::RunInflateTests},
+        {"git_repository", checks::RunGitRepositoryTests},
+        {"comment_lexer", checks::RunCommentLexerTests},
+        {"tar_reader", checks::RunTarReaderTests},
+        {"keyword_matcher", checks::RunKeywordMatcherTests},
+        {"regex_prefilter", checks::RunRegexPrefilterTests},
+        {"ignore_rules", checks::RunIgnoreRulesTests},
+        {"partial_result", checks::RunPartialResultTests},
+        {"scan_cache", checks::RunScanCacheTests},
+        {"parser", checks::RunParserTests},
+        {"language_registry", checks::RunLanguageRegistryTests},
+        {"watch_mode", checks::RunWatchModeTests},
+    };
+
+    for (const auto& [name, run] : suites) {
+        const std::size_t failures_before{checks::FailureCount()};
+        try {
+            run();
+        } catch (const std::exception& error) {
+            checks::Check(false,
+                          std::format("{} threw: {}", name, error.what()));
+        }
+        std::println("{}: {}", name,
+                     checks::FailureCount() == failures_before ? "passed"
+                                                               : "FAILED");
+    }
+
+    std::println("{} checks, {} failed", checks::CheckCount(),
+                 checks::FailureCount());
+    return checks::FailureCount() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,238 @@
+/*
+ *  parser_test.cpp - Tests for how the scanner counts files
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "include/checks.hpp"
+#include "profile.hpp"
+
+namespace checks {
+namespace {
+struct Totals {
+    std::vector<std::size_t> counts{};
+    std::size_t lines{0};
+
+    bool operator==(const Totals&) const = default;
+};
+
+/*
+ * The count of every pattern in summary, built-in keywords first, and the
+ * lines it counted.
+ */
+Totals TotalsOf(const profile::ScanSummary& summary) {
+    Totals totals{};
+    for (const profile::PatternTotal& total : summary.patterns) {
+        totals.counts.push_back(total.count);
+    }
+    std::ostringstream json{};
+    summary.statistics.WriteJson(json);
+    const std::string text{json.str()};
+    constexpr std::string_view lines_key{"\"lines\":"};
+    if (const std::size_t found{text.find(lines_key)};
+        found != std::string::npos) {
+        totals.lines = std::stoul(text.substr(found + lines_key.size()));
+    }
+    return totals;
+}
+
+/*
+ * The totals of a scan of directory that also looks for the custom regex
+ * NOTE\(\w+\). Without collect_hits nothing needs the hits, so the scan
+ * only counts.
+ */
+Totals TotalsOf(const TemporaryDirectory& directory, const bool collect_hits) {
+    profile::ScanConfig config{};
+    config.directory = directory.Path();
+    config.use_ignore_files = false;
+    config.thread_count = 1;
+    config.custom_regexes = {"NOTE\\(\\w+\\)"};
+    return TotalsOf(profile::Scan(
+        config, collect_hits ? profile::HitCallback{[](const auto&) {}}
+                             : profile::HitCallback{}));
+}
+
+struct CountCase {
+    std::string_view description;
+    std::string_view name;
+    std::string text;
+    // the count of TODO
+    std::size_t todo_count;
+};
+
+/*
+ * Enough lines holding a candidate, most of them in comments but some in
+ * strings, for counting to give up on searching for candidates.
+ */
+std::string DenseCandidates() {
+    std::string text{"/* TODO starts\n"};
+    for (std::size_t line{0}; line < 200; ++line) {
+        text += line % 5 == 0 ? "   still in the block */ int x = 1; /*\n"
+                              : "   TODO " + std::to_string(line) + "\n";
+    }
+    text += "*/\n";
+    for (std::size_t line{0}; line < 100; ++line) {
+        text += line % 3 == 0 ? "auto s = \"TODO in a string\";\n"
+                              : "f(); // TODO NOTE(x) " +
+                                    std::to_string(line) + "\n";
+    }
+    return text;
+}
+
+using HitKey = std::tuple<std::size_t, std::size_t, std::size_t, std::string>;
+
+struct SplitScan {
+    Totals totals{};
+    // line number, pattern, column and line of every hit
+    std::vector<HitKey> hits{};
+};
+
+/*
+ * A scan of directory on two threads, which cuts files of at least
+ * split_file_limit bytes into chunks of about split_chunk_size bytes.
+ */
+SplitScan SplitScanOf(const TemporaryDirectory& directory,
+                      const std::size_t split_file_limit,
+                      const std::size_t split_chunk_size) {
+    profile::ScanConfig config{};
+    config.directory = directory.Path();
+    config.use_ignore_files = false;
+    config.thread_count = 2;
+    config.split_file_limit = split_file_limit;
+    config.split_chunk_size = split_chunk_size;
+
+    SplitScan scan{};
+    std::mutex hits_lock{};
+    scan.totals = TotalsOf(profile::Scan(
+        config, [&scan, &hits_lock](const profile::FileHits& file) {
+            std::scoped_lock<std::mutex> lock{hits_lock};
+            for (const profile::HitRecord& hit : file.hits) {
+                scan.hits.emplace_back(hit.line_number, hit.pattern,
+                                       hit.column, std::string{hit.line});
+            }
+        }));
+    return scan;
+}
+
+/*
+ * Block comments and raw strings many lines long, so that with small chunks
+ * both keep running across chunk boundaries, with keywords inside and
+ * around them that only count in the comments.
+ */
+std::string StraddlingLiterals() {
+    std::string text{};
+    for (std::size_t block{0}; block < 20; ++block) {
+        text += "int x" + std::to_string(block) + " = 0; // HACK " +
+                std::to_string(block) + "\n/* opened here\n";
+        for (std::size_t line{0}; line < 12; ++line) {
+            text += "   TODO inside the block " + std::to_string(line) + "\n";
+        }
+        text += "   closed */ auto s = R\"raw(\n";
+        for (std::size_t line{0}; line < 12; ++line) {
+            text += "// BUG inside the raw string " + std::to_string(line) +
+                    "\n";
+        }
+        text += ")raw\"; // FIXME after it\n";
+    }
+    return text;
+}
+}  // namespace
+
+void RunParserTests() {
+    const std::vector<CountCase> cases{
+        {
+            "a keyword inside a block comment over several lines",
+            "block.cpp",
+            "int a;\n/* first\n   second\n   TODO in the middle\n   last */\n"
+            "int TODO_not = 0;\n",
+            1,
+        },
+        {
+            "a keyword inside strings",
+            "string.cpp",
+            "auto a = \"TODO\"; // fine\n"
+            "auto b = R\"(\n// TODO in a raw string\n)\";\n"
+            "auto c = '\"'; // TODO after a quote character\n",
+            1,
+        },
+        {
+            "a last line without a newline",
+            "last.cpp",
+            "int a;\n// TODO NOTE(x)",
+            1,
+        },
+        {
+            "lines after the last candidate without a newline",
+            "after.cpp",
+            "// TODO\nint a;\nint b;",
+            1,
+        },
+        {
+            "a docstring opened before the first candidate",
+            "docstring.py",
+            "def f():\n    \"\"\"\n    TODO inside\n    \"\"\"\n"
+            "    return '# TODO not a comment'\n",
+            1,
+        },
+        {
+            "candidates dense enough to match every comment",
+            "dense.cpp",
+            DenseCandidates(),
+            160 + 66 + 1,
+        },
+    };
+
+    for (const auto& [description, name, text, todo_count] : cases) {
+        const TemporaryDirectory directory{};
+        directory.Write(name, text);
+        const Totals counted{TotalsOf(directory, false)};
+        const Totals parsed{TotalsOf(directory, true)};
+        Check(counted == parsed,
+              std::string{description} +
+                  ": counting agrees with matching every comment");
+        Check(!parsed.counts.empty() && parsed.counts.front() == todo_count,
+              std::string{description} + ": TODO is counted " +
+                  std::to_string(todo_count) + " times");
+    }
+
+    // a file cut into chunks is counted as if it was read in one go
+    const TemporaryDirectory directory{};
+    directory.Write("split.cpp", StraddlingLiterals());
+    SplitScan whole{
+        SplitScanOf(directory, std::numeric_limits<std::size_t>::max(), 1)};
+    SplitScan split{SplitScanOf(directory, 1024, 200)};
+    std::ranges::sort(whole.hits);
+    std::ranges::sort(split.hits);
+    Check(whole.totals.counts ==
+              std::vector<std::size_t>{20 * 12, 20, 0, 20},
+          "a file scanned whole counts only the keywords in comments");
+    Check(split.totals == whole.totals,
+          "a file cut into chunks counts what the whole file does");
+    Check(split.hits == whole.hits,
+          "a file cut into chunks reports the hits of the whole file, on the "
+          "same lines");
+}
+
+}  // namespace checks
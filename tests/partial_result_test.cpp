@@ -0,0 +1,222 @@
+/*
+ *  partial_result_test.cpp - Tests for saving and merging sharded scans
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "include/checks.hpp"
+#include "partial_result.hpp"
+#include "profile.hpp"
+
+namespace checks {
+namespace {
+using partial_results::PartialResult;
+
+profile::ScanConfig ConfigOf(const std::optional<profile::Shard> shard) {
+    profile::ScanConfig config{};
+    config.use_ignore_files = false;
+    config.thread_count = 1;
+    config.custom_regexes = {"NOTE\\(\\w+\\)"};
+    config.shard = shard;
+    return config;
+}
+
+profile::ScanSummary ScanOf(const TemporaryDirectory& directory,
+                            const std::optional<profile::Shard> shard) {
+    profile::ScanConfig config{ConfigOf(shard)};
+    config.directory = directory.Path();
+    return profile::Scan(config);
+}
+
+/*
+ * How many files each of count shards of the tree at root holds, scanning
+ * root as a directory, or as an archive if is_archive.
+ */
+std::vector<std::size_t> SplitOf(const std::filesystem::path& root,
+                                 const bool is_archive,
+                                 const std::size_t count) {
+    std::vector<std::size_t> split{};
+    for (std::size_t index{0}; index < count; ++index) {
+        profile::ScanConfig config{ConfigOf(profile::Shard{index, count})};
+        if (is_archive) {
+            config.archive = root;
+        } else {
+            config.directory = root;
+        }
+        split.push_back(profile::Scan(config).file_count);
+    }
+    return split;
+}
+
+/*
+ * Every shard of a scan of directory split count ways.
+ */
+std::vector<PartialResult> ShardsOf(
+    const TemporaryDirectory& directory, const std::size_t count,
+    const std::vector<profile::Threshold>& thresholds) {
+    std::vector<PartialResult> partials{};
+    for (std::size_t index{0}; index < count; ++index) {
+        const profile::Shard shard{index, count};
+        partials.push_back(PartialResult{shard, ScanOf(directory, shard),
+                                         thresholds, std::nullopt});
+    }
+    return partials;
+}
+
+/*
+ * Whether merging partials throws std::invalid_argument.
+ */
+bool Rejects(const std::vector<PartialResult>& partials) {
+    try {
+        partial_results::MergePartials(partials);
+    } catch (const std::invalid_argument&) {
+        return true;
+    }
+    return false;
+}
+
+bool SameTotals(const profile::ScanSummary& left,
+                const profile::ScanSummary& right) {
+    if (left.file_count != right.file_count ||
+        left.extension_counts != right.extension_counts ||
+        left.patterns.size() != right.patterns.size()) {
+        return false;
+    }
+    for (std::size_t index{0}; index < left.patterns.size(); ++index) {
+        if (left.patterns[index].pattern != right.patterns[index].pattern ||
+            left.patterns[index].count != right.patterns[index].count ||
+            left.patterns[index].custom != right.patterns[index].custom) {
+            return false;
+        }
+    }
+    return true;
+}
+}  // namespace
+
+void RunPartialResultTests() {
+    const TemporaryDirectory directory{};
+    for (std::size_t file{0}; file < 24; ++file) {
+        const std::string name{"dir" + std::to_string(file % 4) + "/file" +
+                               std::to_string(file)};
+        directory.Write(name + (file % 3 == 0 ? ".py" : ".cpp"),
+                        file % 3 == 0 ? "# TODO one\nx = 1  # NOTE(a)\n"
+                                      : "// FIXME two\nint a; // TODO\n");
+    }
+    const std::vector<profile::Threshold> thresholds{{"TODO", 1}};
+
+    const std::vector<PartialResult> shards{ShardsOf(directory, 3, thresholds)};
+    const profile::ScanSummary merged{partial_results::MergePartials(shards)};
+    const profile::ScanSummary unsharded{ScanOf(directory, std::nullopt)};
+    Check(SameTotals(merged, unsharded),
+          "the merged shards count what one unsharded scan does");
+    Check(merged.exceeded == std::vector<std::string>{"TODO>1"},
+          "the merged totals are held to the thresholds");
+
+    // written, read back and merged again, nothing changes
+    const std::filesystem::path file{directory.Path() / "shard.bin"};
+    std::vector<PartialResult> read_back{};
+    for (const PartialResult& shard : shards) {
+        const std::optional<PartialResult> partial{
+            partial_results::WritePartial(file, shard)
+                ? partial_results::ReadPartial(file)
+                : std::nullopt};
+        Check(partial.has_value() &&
+                  partial->shard.index == shard.shard.index &&
+                  partial->shard.count == shard.shard.count &&
+                  partial->summary.stopped_early ==
+                      shard.summary.stopped_early &&
+                  partial->summary.errors == shard.summary.errors &&
+                  SameTotals(partial->summary, shard.summary),
+              "shard " + std::to_string(shard.shard.index) +
+                  " reads back as it was written");
+        Check(!std::filesystem::exists(file.string() + ".tmp"),
+              "writing a partial result leaves no temporary file behind");
+        if (partial.has_value()) {
+            read_back.push_back(partial.value());
+        }
+    }
+    Check(read_back.size() == shards.size() &&
+              SameTotals(partial_results::MergePartials(read_back), merged),
+          "shards read back merge to the same totals");
+
+    directory.Write("not_a_shard.bin", "PRFSHARD");
+    Check(!partial_results::ReadPartial(directory.Path() / "not_a_shard.bin")
+               .has_value(),
+          "a truncated partial result is not read");
+
+    std::vector<PartialResult> missing{shards};
+    missing.pop_back();
+    Check(Rejects(missing), "a missing shard is rejected");
+
+    std::vector<PartialResult> duplicated{shards};
+    duplicated.back() = duplicated.front();
+    Check(Rejects(duplicated), "a shard given twice is rejected");
+
+    std::vector<PartialResult> mismatched{shards};
+    mismatched.back().thresholds.front().limit = 2;
+    Check(Rejects(mismatched),
+          "shards run with different thresholds are rejected");
+
+    std::vector<PartialResult> split{shards};
+    split.push_back(ShardsOf(directory, 4, thresholds).back());
+    Check(Rejects(split), "shards of scans split differently are rejected");
+    Check(Rejects({}), "merging no shards is rejected");
+
+    // the same files go to the same shards however the tree is reached
+    const TemporaryDirectory spellings{};
+    std::string archive{};
+    for (std::size_t index{0}; index < 60; ++index) {
+        const std::string name{
+            index % 6 == 0 ? "top" + std::to_string(index) + ".cpp"
+                           : "sub" + std::to_string(index % 4) + "/deep/file" +
+                                 std::to_string(index) + ".cpp"};
+        spellings.Write("tree/" + name, "// TODO\n");
+        archive += TarMember(name, '0', "// TODO\n");
+    }
+    spellings.Write("tree.tar", archive + TarEndOfArchive());
+
+    const std::filesystem::path tree{spellings.Path() / "tree"};
+    const std::vector<std::size_t> tree_split{SplitOf(tree, false, 3)};
+    Check(tree_split.size() == 3 &&
+              tree_split[0] + tree_split[1] + tree_split[2] == 60,
+          "every file of the tree is in exactly one shard");
+    Check(SplitOf(tree.string() + "/", false, 3) == tree_split,
+          "a root spelled with a trailing slash shards the same");
+    Check(SplitOf(tree / "." / "", false, 3) == tree_split,
+          "a root spelled with a trailing ./ shards the same");
+    Check(SplitOf(spellings.Path() / "tree.tar", true, 3) == tree_split,
+          "an archive of the tree shards the same as the tree");
+
+    // shards run one after the other can share a cache
+    const std::filesystem::path cache_file{spellings.Path() / "cache"};
+    for (std::size_t index{0}; index < 3; ++index) {
+        profile::ScanConfig config{ConfigOf(profile::Shard{index, 3})};
+        config.directory = tree;
+        config.cache_file = cache_file;
+        profile::Scan(config);
+    }
+    Check(CacheEntryCount(cache_file) == 60,
+          "shards sharing a cache keep each other's entries");
+}
+
+}  // namespace checks
@@ -0,0 +1,123 @@
+/*
+ *  regex_prefilter_test.cpp - Tests for the custom regex literal prefilter
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "include/checks.hpp"
+#include "regex_prefilter.hpp"
+
+namespace checks {
+
+void RunRegexPrefilterTests() {
+    const std::vector<std::string_view> patterns{
+        "TODO\\(\\w+\\)",
+        "a(bc)?d",
+        "(ab)+cd",
+        "(?:x|y)z",
+        "a[bc]d",
+        "[a-z]+ing",
+        "a\\.b",
+        "a\\d+b",
+        "a\\x41b",
+        "a\\u0041b",
+        "a.b",
+        "^abc$",
+        "ab*c",
+        "ab?c",
+        "ab{0,3}c",
+        "ab{0}c",
+        "ab{2,}c",
+        "xa+b",
+        "ab+?c",
+        "ab*?c",
+        "ab{2}?c",
+        "xab+*",
+        "x{2}??",
+        "a{2}*b",
+        "ab+{0,2}c",
+        "ab?+c",
+        "foo|bar",
+        "abc|x",
+    };
+    const std::vector<std::string_view> texts{
+        "",
+        "// xa",
+        "// xab",
+        "xabb",
+        "x",
+        "xx",
+        "xxx",
+        "b",
+        "aab",
+        "ac",
+        "abc",
+        "abbc",
+        "abbbc",
+        "ad",
+        "abd",
+        "abcd",
+        "abcbccd",
+        "cd",
+        "xz",
+        "yz",
+        "a.b",
+        "aXb",
+        "a5b",
+        "aAb",
+        "sing",
+        "xaab",
+        "xaaab",
+        "foo",
+        "bar",
+        "TODO(x)",
+        "TODO()",
+    };
+
+    // the prefilter may only reject texts the regex would not match
+    for (const std::string_view pattern : patterns) {
+        std::regex regex{};
+        try {
+            regex = std::regex{std::string{pattern}};
+        } catch (const std::regex_error&) {
+            // an engine rejecting the pattern never gets to prefilter it
+            continue;
+        }
+        const std::string literal{regex_prefilter::RequiredLiteral(pattern)};
+        for (const std::string_view text : texts) {
+            Check(!std::regex_search(text.cbegin(), text.cend(), regex) ||
+                      text.find(literal) != std::string_view::npos,
+                  "\"" + literal + "\", required by " + std::string{pattern} +
+                      ", is in \"" + std::string{text} + "\" which it matches");
+        }
+    }
+
+    Check(regex_prefilter::RequiredLiteral("TODO\\(\\w+\\)") == "TODO(",
+          "an escaped punctuation character extends the literal");
+    Check(regex_prefilter::RequiredLiteral("xab+*").find('b') ==
+              std::string::npos,
+          "an atom with a starred quantifier stacked on it is optional");
+    Check(regex_prefilter::RequiredLiteral("ab+?c") == "ab",
+          "a lazy quantifier does not make its atom optional");
+    Check(regex_prefilter::RequiredLiteral("foo|bar").empty(),
+          "a top level alternation requires no literal");
+}
+
+}  // namespace checks
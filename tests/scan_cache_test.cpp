@@ -0,0 +1,153 @@
+/*
+ *  scan_cache_test.cpp - Tests for the persistent scan cache
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "file_result.hpp"
+#include "include/checks.hpp"
+#include "profile.hpp"
+#include "scan_cache.hpp"
+
+namespace checks {
+namespace {
+constexpr std::uint64_t pattern_hash{42};
+
+/*
+ * A result with count on its only pattern.
+ */
+parser_info::FileResult ResultOf(const std::size_t count) {
+    parser_info::FileResult result{};
+    result.Reset(1);
+    result.pattern_counts.front() = count;
+    return result;
+}
+
+/*
+ * The count the cache at cache_file holds for file as it is now, if it
+ * holds one.
+ */
+std::optional<std::size_t> CachedCount(const std::filesystem::path& cache_file,
+                                       const std::filesystem::path& file) {
+    scan_cache::ScanCache cache{cache_file, pattern_hash};
+    const std::optional<scan_cache::FileStamp> stamp{
+        scan_cache::StampFile(file)};
+    parser_info::FileResult result{};
+    if (!stamp.has_value() ||
+        !cache.Lookup(file.string(), stamp.value(), 1, result)) {
+        return std::nullopt;
+    }
+    return result.pattern_counts.front();
+}
+
+/*
+ * A scan of directory without ignore files, on one thread, that caches its
+ * results in cache_file.
+ */
+profile::ScanConfig CachedScanOf(const TemporaryDirectory& directory,
+                                 const std::filesystem::path& cache_file) {
+    profile::ScanConfig config{};
+    config.directory = directory.Path();
+    config.use_ignore_files = false;
+    config.thread_count = 1;
+    config.cache_file = cache_file;
+    return config;
+}
+}  // namespace
+
+void RunScanCacheTests() {
+    const TemporaryDirectory directory{};
+    const std::filesystem::path cache_file{directory.Path() / "cache"};
+    const std::filesystem::path reused{directory.Path() / "reused.cpp"};
+    const std::filesystem::path changed{directory.Path() / "changed.cpp"};
+    const std::filesystem::path untouched{directory.Path() / "untouched.cpp"};
+    const std::filesystem::path deleted{directory.Path() / "deleted.cpp"};
+    const std::filesystem::path stale{directory.Path() / "stale.cpp"};
+    std::optional<scan_cache::FileStamp> deleted_stamp{std::nullopt};
+
+    {
+        scan_cache::ScanCache cache{cache_file, pattern_hash};
+        std::size_t count{1};
+        for (const std::filesystem::path& file :
+             {reused, changed, untouched, deleted, stale}) {
+            directory.Write(file.filename().string(), "// TODO\n");
+            cache.Store(file.string(),
+                        scan_cache::StampFile(file).value(), ResultOf(count++));
+        }
+        Check(cache.Save(), "a new cache saves");
+    }
+
+    // a run that only visits some of the files
+    {
+        scan_cache::ScanCache cache{cache_file, pattern_hash};
+        parser_info::FileResult result{};
+        Check(cache.Lookup(reused.string(),
+                           scan_cache::StampFile(reused).value(), 1, result) &&
+                  result.pattern_counts.front() == 1,
+              "a file with the stamp it was stored under is reused");
+
+        directory.Write(changed.filename().string(), "// TODO\n// TODO\n");
+        Check(!cache.Lookup(changed.string(),
+                            scan_cache::StampFile(changed).value(), 1, result),
+              "a file whose stamp changed misses the cache");
+        cache.Store(changed.string(), scan_cache::StampFile(changed).value(),
+                    ResultOf(7));
+
+        deleted_stamp = scan_cache::StampFile(deleted);
+        std::filesystem::remove(deleted);
+        directory.Write(stale.filename().string(), "// TODO\n// FIXME\n");
+        Check(cache.Save(), "a cache read back saves");
+    }
+
+    Check(CachedCount(cache_file, reused) == 1,
+          "a reused entry is saved again");
+    Check(CachedCount(cache_file, changed) == 7,
+          "a stored entry replaces the one it was stored over");
+    Check(CachedCount(cache_file, untouched) == 3,
+          "an entry the run did not visit is kept while its file is unchanged");
+    Check(CachedCount(cache_file, stale) == std::nullopt,
+          "an entry the run did not visit is dropped once its file changed");
+
+    scan_cache::ScanCache cache{cache_file, pattern_hash};
+    parser_info::FileResult result{};
+    Check(deleted_stamp.has_value() &&
+              !cache.Lookup(deleted.string(), deleted_stamp.value(), 1,
+                            result),
+          "an entry whose file was deleted is dropped");
+
+    // a scan stopped by a threshold keeps the files it never reached
+    const TemporaryDirectory tree{};
+    for (std::size_t file{0}; file < 40; ++file) {
+        tree.Write("dir" + std::to_string(file % 4) + "/file" +
+                       std::to_string(file) + ".cpp",
+                   "// TODO\n");
+    }
+    const std::filesystem::path tree_cache{directory.Path() / "tree_cache"};
+    profile::ScanConfig config{CachedScanOf(tree, tree_cache)};
+    profile::Scan(config);
+    config.thresholds = {{"TODO", 0}};
+    const profile::ScanSummary stopped{profile::Scan(config)};
+    Check(stopped.stopped_early && CacheEntryCount(tree_cache) == 40,
+          "a scan that stops early keeps the cache of the files it skipped");
+}
+
+}  // namespace checks
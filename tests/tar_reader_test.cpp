@@ -0,0 +1,83 @@
+/*
+ *  tar_reader_test.cpp - Tests for reading tar archives
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "include/checks.hpp"
+#include "tar_reader.hpp"
+
+namespace checks {
+namespace {
+struct ReadResult {
+    std::optional<std::string> path{};
+    std::string contents{};
+    bool failed{false};
+};
+
+/*
+ * The first member of archive and whether reading the archive failed.
+ */
+ReadResult ReadFirst(const TemporaryDirectory& directory,
+                     const std::string_view archive) {
+    directory.Write("archive.tar", archive);
+    tar_reading::TarReader reader{directory.Path() / "archive.tar"};
+    ReadResult result{};
+    if (const std::optional<tar_reading::Member> member{reader.Next()}) {
+        result.path = member->path;
+        reader.ReadContents(result.contents);
+    }
+    result.failed = reader.Error().has_value();
+    return result;
+}
+}  // namespace
+
+void RunTarReaderTests() {
+    const TemporaryDirectory directory{};
+
+    ReadResult result{
+        ReadFirst(directory, TarMember("./plain.cpp", '0', "int a;\n") +
+                                 TarEndOfArchive())};
+    Check(!result.failed && result.path == "plain.cpp" &&
+              result.contents == "int a;\n",
+          "a plain member reads back without its ./ prefix");
+
+    result = ReadFirst(directory, TarMember("pax", 'x',
+                                            "26 path=long/dir/name.cpp\n"
+                                            "9 size=3\n") +
+                                      TarMember("short.cpp", '0', "abc") +
+                                      TarEndOfArchive());
+    Check(!result.failed && result.path == "long/dir/name.cpp" &&
+              result.contents == "abc",
+          "pax records apply to the member after them");
+
+    // none of these may throw out of the reader
+    for (const std::string_view records :
+         {std::string_view{"1"}, std::string_view{"12path=a.cpp\n"},
+          std::string_view{"0 x=y\n"}, std::string_view{"99 path=a.cpp\n"}}) {
+        result = ReadFirst(directory, TarMember("pax", 'x', records) +
+                                          TarMember("a.cpp", '0', "") +
+                                          TarEndOfArchive());
+        Check(result.failed && !result.path.has_value(),
+              "the malformed pax record \"" + std::string{records} +
+                  "\" is a corrupt header");
+    }
+}
+
+}  // namespace checks
@@ -0,0 +1,223 @@
+/*
+ *  watch_mode_test.cpp - Tests for how watch mode queues inotify events
+ *  Copyright (C) 2024  Sebastian Pineda (spineda.wpi.alum@gmail.com)
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program. If not, see <https://www.gnu.org/licenses/>
+ */
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Parser.hpp"
+#include "ignore_rules.hpp"
+#include "include/checks.hpp"
+#include "watch_events.hpp"
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace checks {
+#if defined(__linux__)
+namespace {
+using parser_info::Parser;
+
+/*
+ * An inotify event laid out the way read returns it, its name padded with
+ * zeros.
+ */
+class EventRecord {
+ public:
+    EventRecord(const int watch, const std::uint32_t mask,
+                const std::string_view name = {}) {
+        inotify_event event{};
+        event.wd = watch;
+        event.mask = mask;
+        event.len = name.empty() ? 0 : name_capacity;
+        std::memcpy(bytes_.data(), &event, sizeof(event));
+        std::memcpy(bytes_.data() + sizeof(event), name.data(), name.size());
+    }
+
+    const inotify_event& Get() const {
+        return *reinterpret_cast<const inotify_event*>(bytes_.data());
+    }
+
+ private:
+    static constexpr std::uint32_t name_capacity{64};
+
+    alignas(inotify_event)
+        std::array<char, sizeof(inotify_event) + name_capacity> bytes_{};
+};
+
+class Inotify {
+ public:
+    Inotify() : descriptor_{inotify_init1(IN_CLOEXEC)} {}
+    Inotify(const Inotify&) = delete;
+    Inotify& operator=(const Inotify&) = delete;
+    ~Inotify() {
+        if (descriptor_ >= 0) {
+            close(descriptor_);
+        }
+    }
+
+    int Get() const { return descriptor_; }
+
+ private:
+    const int descriptor_;
+};
+
+/*
+ * The paths pending holds, in order.
+ */
+std::vector<std::string> PathsOf(const watch_mode::PendingTargets& pending) {
+    std::vector<std::string> paths{};
+    for (const auto& [path, _] : pending) {
+        paths.push_back(path);
+    }
+    return paths;
+}
+}  // namespace
+#endif
+
+void RunWatchModeTests() {
+#if defined(__linux__)
+    const TemporaryDirectory directory{};
+    const std::filesystem::path root{directory.Path() / "root"};
+    const std::filesystem::path other_root{directory.Path() / "other"};
+    const std::filesystem::path sub{root / "sub"};
+    const std::filesystem::path deeper{sub / "deeper"};
+    directory.Write("root/.gitignore", "*.log\n");
+    directory.Write("root/sub/.gitignore", "*.tmp\n");
+    directory.Write("root/sub/deeper/file.cpp", "// TODO\n");
+    directory.Write("other/file.cpp", "// TODO\n");
+    const std::vector<std::filesystem::path> roots{root, other_root};
+
+    const std::shared_ptr<const ignore_rules::IgnoreScope> root_scope{
+        ignore_rules::IgnoreScope::Extend(nullptr, root,
+                                          ignore_rules::ignore_file_names)};
+    const std::shared_ptr<const ignore_rules::IgnoreScope> sub_scope{
+        ignore_rules::IgnoreScope::Extend(root_scope, sub,
+                                          ignore_rules::ignore_file_names)};
+
+    const Inotify inotify{};
+    Check(inotify.Get() >= 0, "inotify starts");
+    watch_mode::WatchSet watches{inotify.Get()};
+    const int root_watch{
+        watches.Add(Parser::ScannedDirectory{root, nullptr, root_scope})};
+    const int sub_watch{
+        watches.Add(Parser::ScannedDirectory{sub, root_scope, sub_scope})};
+    const int deeper_watch{
+        watches.Add(Parser::ScannedDirectory{deeper, sub_scope, sub_scope})};
+    Check(root_watch >= 0 && sub_watch >= 0 && deeper_watch >= 0,
+          "every directory is watched");
+
+    const auto queue{[&](watch_mode::PendingTargets& pending,
+                         const EventRecord& event,
+                         const bool use_ignore_files = true) {
+        watch_mode::QueueEvent(event.Get(), use_ignore_files, roots, watches,
+                               pending);
+    }};
+
+    // every write to a file fires IN_MODIFY, but it is rescanned once
+    watch_mode::PendingTargets pending{};
+    for (int write{0}; write < 5; ++write) {
+        queue(pending, EventRecord{sub_watch, IN_MODIFY, "file.cpp"});
+    }
+    queue(pending, EventRecord{sub_watch, IN_CLOSE_WRITE, "file.cpp"});
+    const std::filesystem::path file{sub / "file.cpp"};
+    Check(PathsOf(pending) == std::vector<std::string>{file.string()},
+          "repeated events for one file coalesce into one target");
+    Check(pending.begin()->second.ignore_scope == sub_scope,
+          "a changed file is rescanned with its directory's rules");
+
+    queue(pending, EventRecord{root_watch, IN_CREATE, "new.cpp"});
+    queue(pending, EventRecord{sub_watch, IN_MODIFY, "file.cpp"});
+    queue(pending, EventRecord{root_watch, IN_MODIFY, "new.cpp"});
+    Check(PathsOf(pending) ==
+              std::vector<std::string>{(root / "new.cpp").string(),
+                                       file.string()},
+          "events for different files each queue their file");
+
+    queue(pending, EventRecord{-1, IN_MODIFY, "lost.cpp"});
+    queue(pending, EventRecord{root_watch, IN_MODIFY});
+    Check(pending.size() == 2,
+          "events without a known watch or a name are left out");
+
+    // once the kernel drops events only whole roots are safe to rescan
+    queue(pending, EventRecord{-1, IN_Q_OVERFLOW});
+    Check(PathsOf(pending) == std::vector<std::string>{other_root.string(),
+                                                       root.string()},
+          "an overflow replaces what was pending with every root");
+    Check(pending.at(root.string()).ignore_scope == nullptr &&
+              pending.at(other_root.string()).ignore_scope == nullptr,
+          "a root is rescanned without inherited rules");
+    queue(pending, EventRecord{-1, IN_Q_OVERFLOW});
+    Check(pending.size() == 2, "a second overflow queues every root once");
+
+    // an edited ignore file changes what its whole directory holds
+    pending.clear();
+    queue(pending, EventRecord{deeper_watch, IN_MODIFY, "file.cpp"});
+    queue(pending, EventRecord{sub_watch, IN_CLOSE_WRITE, ".gitignore"});
+    Check(pending.contains(sub.string()) &&
+              pending.at(sub.string()).ignore_scope == root_scope,
+          "an edited ignore file rescans its directory with its parent's "
+          "rules");
+    Check(watches.Find(sub_watch) == nullptr &&
+              watches.Find(deeper_watch) == nullptr &&
+              watches.Find(root_watch) != nullptr,
+          "an edited ignore file drops the watches below its directory");
+
+    const int profileignore_watch{
+        watches.Add(Parser::ScannedDirectory{sub, root_scope, sub_scope})};
+    pending.clear();
+    queue(pending,
+          EventRecord{profileignore_watch, IN_CREATE, ".profileignore"});
+    Check(PathsOf(pending) == std::vector<std::string>{sub.string()},
+          "a new .profileignore rescans its directory too");
+
+    const int unignored_watch{
+        watches.Add(Parser::ScannedDirectory{sub, root_scope, sub_scope})};
+    pending.clear();
+    queue(pending, EventRecord{unignored_watch, IN_MODIFY, ".gitignore"},
+          false);
+    Check(PathsOf(pending) ==
+                  std::vector<std::string>{(sub / ".gitignore").string()} &&
+              watches.Find(unignored_watch) != nullptr,
+          "without ignore files an ignore file is an ordinary file");
+
+    // a deleted directory takes the watches below it along
+    const int deeper_again{
+        watches.Add(Parser::ScannedDirectory{deeper, sub_scope, sub_scope})};
+    pending.clear();
+    queue(pending, EventRecord{unignored_watch, IN_DELETE | IN_ISDIR,
+                               "deeper"});
+    Check(PathsOf(pending) == std::vector<std::string>{deeper.string()} &&
+              watches.Find(deeper_again) == nullptr &&
+              watches.Find(unignored_watch) != nullptr,
+          "a deleted directory is rescanned and its watches dropped");
+
+    queue(pending, EventRecord{root_watch, IN_IGNORED});
+    Check(watches.Find(root_watch) == nullptr,
+          "a watch the kernel removed is forgotten");
+#endif
+}
+
+}  // namespace checks